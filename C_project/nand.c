@@ -1,502 +1,2076 @@
 #include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structures of gates shared by the library modules.
 #include <errno.h> // For errno and ENOMEM.
-#include <stdlib.h> // For malloc, calloc.
+#include <stdlib.h> // For realloc, free.
+#include <string.h> // For memset, memcpy.
 #include <limits.h> // For UINT_MAX value
+#include <stdint.h> // For uintptr_t.
+
+// Signals connected to the gates which do not belong to any pool.
+static signal_table_t signal_table;
+
+/** @brief Stack of gates shared by all walkthroughs of the system. Every
+ * walkthrough puts a single gate on the stack at most once, so the stack
+ * is kept at least as long as the number of existing gates and walkthroughs
+ * never need to allocate memory (thus they cannot fail and they need no
+ * recursion). The stack is freed when the last gate is deleted.
+ * gates           - array of length capacity.
+ * ranks           - array of length capacity, used when the ranks of gates are renumbered.
+ * capacity        - length of the arrays gates and ranks.
+ * number_of_gates - number of existing logical gates.
+ */
+static struct {
+    nand_t** gates;
+    unsigned long* ranks;
+    size_t capacity;
+    size_t number_of_gates;
+} work_stack;
+
+// Rank of the last created gate. New gates come last in the topological order.
+static unsigned long last_rank = 0;
+
+/**@brief List of the gates reading some gate through a connection left out of the
+ * topological order, because it closed a cycle when it was made. Such a connection
+ * joins the order again once its cycle is broken. While the list is not empty, the
+ * ranks do not describe all paths, so nand_connect_nand_checked also searches the
+ * system for a cycle.
+ * gates    - array of length capacity, its gates have the flag unordered.
+ * length   - number of gates on the list.
+ * capacity - length of the array gates.
+ * lost     - true if a gate was not put on the list for lack of memory. Then every
+ *            nand_connect_nand_checked searches the system, until the last gate
+ *            is deleted.
+ */
+static struct {
+    nand_t** gates;
+    size_t length;
+    size_t capacity;
+    bool lost;
+} unordered;
+
+void nand_forget_gates(size_t count) {
+    work_stack.number_of_gates -= count;
+
+    if (work_stack.number_of_gates == 0) {
+        free(work_stack.gates);
+        free(work_stack.ranks);
+        work_stack.gates = NULL;
+        work_stack.ranks = NULL;
+        work_stack.capacity = 0;
+        free(unordered.gates);
+        unordered.gates = NULL;
+        unordered.length = 0;
+        unordered.capacity = 0;
+        unordered.lost = false;
+    }
+}
+
+void nand_forget_unordered(nand_pool_t const* pool) {
+    for (size_t i = 0; i < unordered.length;) {
+        if (unordered.gates[i]->pool == pool) {
+            unordered.gates[i] = unordered.gates[--unordered.length];
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+// Removes g from the list of gates with unordered connections.
+static void remove_unordered(nand_t* g) {
+    for (size_t i = 0; i < unordered.length; i++) {
+        if (unordered.gates[i] == g) {
+            unordered.gates[i] = unordered.gates[--unordered.length];
+            break;
+        }
+    }
+
+    g->unordered = false;
+}
+
+// Puts g on the list of gates with unordered connections. Lack of memory only
+// marks the list as incomplete.
+static void add_unordered(nand_t* g) {
+    if (g->unordered) {
+        return;
+    }
+    if (unordered.length == unordered.capacity) {
+        size_t new_capacity = unordered.capacity ? 2 * unordered.capacity : 16;
+        nand_t** new_gates = (nand_t**)realloc(unordered.gates, new_capacity * sizeof(nand_t*));
+
+        if (!new_gates) {
+            unordered.lost = true;
+            return;
+        }
+
+        unordered.gates = new_gates;
+        unordered.capacity = new_capacity;
+    }
+
+    g->unordered = true;
+    unordered.gates[unordered.length++] = g;
+}
+
+// Changes the length of the work stack to new_capacity. Returns false if there is no memory.
+static bool resize_work_stack(size_t new_capacity) {
+    nand_t** new_gates = (nand_t**)realloc(work_stack.gates, new_capacity * sizeof(nand_t*));
+
+    if (!new_gates) {
+        return false;
+    }
+
+    work_stack.gates = new_gates;
+
+    unsigned long* new_ranks = (unsigned long*)realloc(work_stack.ranks,
+                                                       new_capacity * sizeof(unsigned long));
+
+    if (!new_ranks) {
+        return false;
+    }
+
+    work_stack.ranks = new_ranks;
+    work_stack.capacity = new_capacity;
+    return true;
+}
+
+// Makes room on the work stack for one more gate. Returns false if there is no memory.
+static bool reserve_work_stack(void) {
+    if (work_stack.number_of_gates < work_stack.capacity) {
+        return true;
+    }
+
+    return resize_work_stack(work_stack.capacity ? 2 * work_stack.capacity : 16);
+}
+
+/**@brief Creates a new gate of the given kind with n ports in the pool (or separately
+ * if pool is NULL). table is kept only by gates of the kind NAND_KIND_LUT, and its
+ * bit 0 is the initial state of a gate of the kind NAND_KIND_DFF.
+ * Returns NULL with errno set to ENOMEM if there is no memory.
+ */
+static nand_t* new_gate(nand_pool_t* pool, uint8_t kind, unsigned n, uint64_t table) {
+    port_t* input_signal = NULL;
+    nand_t* new_nand = NULL;
+    size_t size = ports_size(kind, n);
+
+    if (size) {
+        input_signal = (port_t*)nand_allocate(pool, size);
+
+        if (!input_signal) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        for (unsigned i = 0; i < n; i++) {
+            input_signal[i].direct_signal = NULL;
+            input_signal[i].sharing_gate = NULL;
+        }
+    }
+
+    if (!reserve_work_stack()) {
+        errno = ENOMEM;
+        nand_release(pool, input_signal, size);
+        return NULL;
+    }
+
+    new_nand = (nand_t*)nand_allocate(pool, sizeof(nand_t));
+
+    if (!new_nand) {
+        errno = ENOMEM;
+        nand_release(pool, input_signal, size);
+        input_signal = NULL;
+        return NULL;
+    }
+
+    new_nand->ports = input_signal;
+    new_nand->epoch = 0;
+    new_nand->any_false = false;
+    new_nand->updated = false;
+    new_nand->my_longest_path = 0;
+    new_nand->cache_valid = false;
+    new_nand->kind = kind;
+    new_nand->unordered = false;
+    new_nand->cables = new_nand->inline_cables;
+    new_nand->length_of_cables_array = INLINE_CABLES;
+    new_nand->number_of_cables = 0;
+    new_nand->number_of_ports = n;
+    new_nand->next_port = 0;
+    new_nand->index = 0;
+    new_nand->owner = 0;
+    new_nand->rank = ++last_rank;
+    new_nand->depth = n && kind != NAND_KIND_DFF ? -1 : 0;
+    new_nand->pool = pool;
+    work_stack.number_of_gates++;
+
+    if (kind == NAND_KIND_LUT) {
+        *lut_table(new_nand) = table;
+    }
+    if (kind == NAND_KIND_DFF) {
+        *flip_flop_state(new_nand) = table & 1;
+    }
+    if (pool) {
+        pool->number_of_gates++;
+    }
+
+    return new_nand;
+}
+
+nand_t* nand_new(unsigned n) {
+    nand_write_lock();
+    nand_t* g = new_gate(NULL, NAND_KIND_NAND, n, 0);
+    nand_write_unlock();
+    return g;
+}
+
+nand_t* nand_new_in(nand_pool_t *p, unsigned n) {
+    if (!p) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nand_write_lock();
+    nand_t* g = new_gate(p, NAND_KIND_NAND, n, 0);
+    nand_write_unlock();
+    return g;
+}
+
+static int new_many(nand_pool_t* p, nand_t** g, size_t m, unsigned const* n) {
+    if ((!g || !n) && m > 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Room on the work stack is made once for all gates.
+    if (work_stack.number_of_gates + m > work_stack.capacity) {
+        size_t new_capacity = work_stack.number_of_gates + m;
+
+        if (new_capacity > SIZE_MAX / sizeof(nand_t*) || !resize_work_stack(new_capacity)) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        g[i] = new_gate(p, NAND_KIND_NAND, n[i], 0);
+
+        if (!g[i]) {
+            while (i > 0) {
+                nand_delete(g[--i]);
+            }
+
+            nand_forget_gates(0); // Frees the work stack if there are no gates.
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int nand_new_many(nand_pool_t *p, nand_t **g, size_t m, unsigned const *n) {
+    nand_write_lock();
+    int result = new_many(p, g, m, n);
+    nand_write_unlock();
+    return result;
+}
+
+nand_t* nand_new_kind(nand_pool_t *p, nand_kind_t kind, unsigned n, uint64_t table) {
+    if ((unsigned)kind > NAND_KIND_DFF || (kind == NAND_KIND_MUX && n != 3) ||
+        (kind == NAND_KIND_LUT && n > LUT_PORTS) || (kind == NAND_KIND_DFF && n != 1)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nand_write_lock();
+    nand_t* g = new_gate(p, (uint8_t)kind, n, table);
+    nand_write_unlock();
+    return g;
+}
+
+/**@brief Replace the last cable in the cables array with
+ * removed one on the position i. Here the cable on the position
+ * i is assumed to be already removed, thus the only thing need
+ * to be done is replacing and updating information about new
+ * cable index in another linked gate. Also updates the number of cables.
+ * @param cables           - array of cables of a logical gate or a signal.
+ * @param number_of_cables - pointer to the number of cables in this array.
+ * @param i                - index of already removed cable in g which
+ *                           where the last one has to be set.
+ */
+static void replace_deleted_cable_with_last_one(cable_t* cables,
+                                                unsigned int* number_of_cables,
+                                                unsigned int i) {
+    unsigned int last_cable = *number_of_cables - 1;
+    unsigned int port_number = cables[last_cable].port_number;
+    nand_t* linked_gate = cables[last_cable].linked_logical_gate;
+
+    // Update cable number.
+    (*number_of_cables)--;
+
+    // If the removed cable was the last one, its port may be already
+    // plugged to another cable and must not be touched.
+    if (i == last_cable) {
+        cables[last_cable].linked_logical_gate = NULL;
+        return;
+    }
+
+    // Put last cable to the i-th cable.
+    cables[i].linked_logical_gate = linked_gate;
+    cables[i].port_number = port_number;
+    cables[last_cable].linked_logical_gate = NULL;
+
+    // Change information about this replacement in linked gate.
+    linked_gate->ports[port_number].cable_index = i;
+}
+
+// Hash function for addresses of the signals.
+static size_t signal_hash(const bool* s) {
+    uintptr_t x = (uintptr_t)s;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    x ^= x >> 29;
+    return (size_t)x;
+}
+
+// Returns the signal table of the gates of the pool (or of the gates without pool).
+static signal_table_t* table_of(nand_pool_t* pool) {
+    return pool ? &pool->signal_table : &signal_table;
+}
+
+// Returns the slot of signal s in the signal table of the pool or NULL if s
+// is not connected to any port of its gates.
+static signal_t* find_signal(nand_pool_t* pool, const bool* s) {
+    signal_table_t* table = table_of(pool);
+
+    if (table->capacity == 0) {
+        return NULL;
+    }
+
+    size_t mask = table->capacity - 1;
+
+    for (size_t i = signal_hash(s) & mask; ; i = (i + 1) & mask) {
+        if (table->slots[i].address == s) {
+            return table->slots + i;
+        }
+        if (!table->slots[i].address) {
+            return NULL;
+        }
+    }
+}
+
+// Doubles the capacity of the signal table. Returns false if there is no memory.
+static bool grow_signal_table(nand_pool_t* pool) {
+    signal_table_t* table = table_of(pool);
+    size_t new_capacity = table->capacity ? 2 * table->capacity : 16;
+    signal_t* new_slots = (signal_t*)nand_allocate(pool, new_capacity * sizeof(signal_t));
+
+    if (!new_slots) {
+        return false;
+    }
+
+    memset(new_slots, 0, new_capacity * sizeof(signal_t));
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        signal_t* old_slot = table->slots + i;
+
+        if (old_slot->address) {
+            size_t j = signal_hash(old_slot->address) & (new_capacity - 1);
+
+            while (new_slots[j].address) {
+                j = (j + 1) & (new_capacity - 1);
+            }
+
+            new_slots[j] = *old_slot;
+        }
+    }
+
+    nand_release(pool, table->slots, table->capacity * sizeof(signal_t));
+    table->slots = new_slots;
+    table->capacity = new_capacity;
+    return true;
+}
+
+// Returns the slot of signal s creating it (without cables) if needed.
+// Returns NULL if there is no memory.
+static signal_t* find_or_insert_signal(nand_pool_t* pool, const bool* s) {
+    signal_table_t* table = table_of(pool);
+    signal_t* signal = find_signal(pool, s);
+
+    if (signal) {
+        return signal;
+    }
+    if (2 * (table->number_of_signals + 1) > table->capacity && !grow_signal_table(pool)) {
+        return NULL;
+    }
+
+    size_t mask = table->capacity - 1;
+    size_t i = signal_hash(s) & mask;
+
+    while (table->slots[i].address) {
+        i = (i + 1) & mask;
+    }
+
+    signal = table->slots + i;
+    signal->address = s;
+    signal->cables = NULL;
+    signal->length_of_cables_array = 0;
+    signal->number_of_cables = 0;
+    table->number_of_signals++;
+    return signal;
+}
+
+// Removes signal without cables from the signal table of the pool. The table
+// is freed when its last signal is removed.
+static void remove_signal(nand_pool_t* pool, signal_t* signal) {
+    signal_table_t* table = table_of(pool);
+    size_t mask = table->capacity - 1;
+    size_t hole = (size_t)(signal - table->slots);
+
+    nand_release(pool, signal->cables, signal->length_of_cables_array * sizeof(cable_t));
+    table->number_of_signals--;
+
+    if (table->number_of_signals == 0) {
+        nand_release(pool, table->slots, table->capacity * sizeof(signal_t));
+        table->slots = NULL;
+        table->capacity = 0;
+        return;
+    }
+
+    // Backward shift deletion keeps probing sequences without holes.
+    for (size_t i = (hole + 1) & mask; table->slots[i].address; i = (i + 1) & mask) {
+        size_t home = signal_hash(table->slots[i].address) & mask;
+
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+
+    table->slots[hole].address = NULL;
+}
+
+// Removes the cable of index cable_index from the signal s read by a gate of the pool.
+static void disconnect_signal_cable(nand_pool_t* pool, const bool* s, unsigned int cable_index) {
+    signal_t* signal = find_signal(pool, s);
+
+    replace_deleted_cable_with_last_one(signal->cables, &signal->number_of_cables, cable_index);
+
+    if (signal->number_of_cables == 0) {
+        remove_signal(pool, signal);
+    }
+}
+
+/** @brief Number of the current walkthrough of the system. Every walkthrough starts
+ * with a new number, thus marks left on the gates by the previous ones (also by those
+ * stopped by an error) are out of date at once and no cleanup walk is needed. Gates
+ * are created with epoch 0, which is never a number of a walkthrough.
+ */
+static unsigned long current_epoch = 0;
+
+// Returns true if g was visited by the current walkthrough.
+static inline bool is_visited(nand_t const* g) {
+    return g->epoch == current_epoch;
+}
+
+// Marks g as visited by the current walkthrough and sets its technical variables
+// to the initial values.
+static inline void visit(nand_t* g) {
+    STATS_ADD(gates_visited, 1);
+    g->epoch = current_epoch;
+    g->updated = false;
+    g->any_false = false;
+    g->my_longest_path = 0;
+}
+
+// Marks cached values of g and of all gates reachable through its cables
+// as out of date. Flip-flops keep their values, which do not depend on their ports.
+static void invalidate_cache(nand_t* g) {
+    size_t top = 0;
+
+    if (!g->cache_valid || g->kind == NAND_KIND_DFF) {
+        return;
+    }
+
+    g->cache_valid = false;
+    work_stack.gates[top++] = g;
+    STATS_ADD(invalidated_gates, 1);
+
+    while (top > 0) {
+        g = work_stack.gates[--top];
+
+        for (unsigned int i = 0; i < g->number_of_cables; i++) {
+            nand_t* linked_gate = g->cables[i].linked_logical_gate;
+
+            // Gate is put on the stack only once, when its cache is turned off.
+            if (linked_gate->cache_valid && linked_gate->kind != NAND_KIND_DFF) {
+                linked_gate->cache_valid = false;
+                work_stack.gates[top++] = linked_gate;
+                STATS_ADD(invalidated_gates, 1);
+            }
+        }
+    }
+}
+
+/**@brief Returns the depth which a gate gets from the port: 1 for a signal, the depth
+ * of the connected gate plus one, -1 for an empty port or a gate whose evaluation fails,
+ * and DEPTH_STALE for a stale gate.
+ */
+static ssize_t port_depth(port_t const* port) {
+    if (port->direct_signal) {
+        return 1;
+    }
+    if (!port->sharing_gate || port->sharing_gate->depth == -1) {
+        return -1;
+    }
+
+    return port->sharing_gate->depth == DEPTH_STALE ? DEPTH_STALE : port->sharing_gate->depth + 1;
+}
+
+// Computes the depth of g from the depths of the gates connected to its ports,
+// which cannot be DEPTH_STALE.
+static ssize_t compute_depth(nand_t const* g) {
+    ssize_t depth = 0;
+
+    for (unsigned int i = 0; i < evaluated_ports(g); i++) {
+        ssize_t input = port_depth(g->ports + i);
+
+        if (input < 0) {
+            return -1;
+        }
+
+        depth = max(input, depth);
+    }
+
+    return depth;
+}
+
+/**@brief Updates the depth of g after a change of one of its ports, which gave the
+ * depth removed (see port_depth) and now gives added. The new depth follows from
+ * these two values, without visiting other ports, unless the port was the only one
+ * giving the depth of g and now gives less; g becomes DEPTH_STALE then and is
+ * computed again by nand_depth. If the depth changes, the gates reachable through
+ * the cables of g become DEPTH_STALE too. Marking stops at gates which are already
+ * stale, so a series of changes costs O(number of gates which become stale).
+ */
+static void update_depth(nand_t* g, ssize_t removed, ssize_t added) {
+    ssize_t depth = g->depth;
+
+    // Depth of a flip-flop is always 0.
+    if (depth == DEPTH_STALE || g->kind == NAND_KIND_DFF) {
+        return;
+    }
+    if (added < 0) {
+        // An empty port makes the depth -1 whatever the other ports are.
+        depth = added;
+    }
+    else if (g->number_of_ports == 1 || (depth >= 0 && added >= depth)) {
+        depth = added;
+    }
+    else if (depth >= 0 ? removed >= depth : removed < 0) {
+        // The port was the only one known to give the depth of g.
+        depth = DEPTH_STALE;
+    }
+
+    if (depth == g->depth) {
+        return;
+    }
+
+    size_t top = 0;
+
+    g->depth = depth;
+    work_stack.gates[top++] = g;
+
+    while (top > 0) {
+        nand_t* gate = work_stack.gates[--top];
+
+        for (unsigned int i = 0; i < gate->number_of_cables; i++) {
+            nand_t* linked_gate = gate->cables[i].linked_logical_gate;
+
+            // Gate is put on the stack only once, when it becomes stale.
+            if (linked_gate->depth != DEPTH_STALE && linked_gate->kind != NAND_KIND_DFF) {
+                linked_gate->depth = DEPTH_STALE;
+                work_stack.gates[top++] = linked_gate;
+                STATS_ADD(invalidated_gates, 1);
+            }
+        }
+    }
+}
+
+static void delete_gate(nand_t* g) {
+    if (!g) {
+        return;
+    }
+
+    cable_t* cable;
+    port_t* port;
+    nand_t* sharing_gate;
+    unsigned int cable_index;
+
+    // Firstly remove cables connected to my ports.
+    for (unsigned i = 0; i < g->number_of_ports; i++) {
+        port = g->ports + i;
+        sharing_gate = port->sharing_gate;
+
+        if (sharing_gate) {
+            cable_index = port->cable_index;
+            replace_deleted_cable_with_last_one(sharing_gate->cables,
+                                                &sharing_gate->number_of_cables,
+                                                cable_index);
+        }
+        else if (port->direct_signal) {
+            disconnect_signal_cable(g->pool, port->direct_signal, port->cable_index);
+        }
+    }
+
+    // Remove my cables.
+    for (unsigned int i = 0; i < g->number_of_cables; i++) {
+        cable = g->cables + i;
+
+        if (cable && cable->linked_logical_gate) {
+            port_t* ports = cable->linked_logical_gate->ports;
+            ssize_t removed = port_depth(ports + cable->port_number);
+            ports[cable->port_number].sharing_gate = NULL;
+            invalidate_cache(cable->linked_logical_gate);
+            update_depth(cable->linked_logical_gate, removed, -1);
+        }
+    }
+
+    if (g->unordered) {
+        remove_unordered(g);
+    }
+
+    nand_pool_t* pool = g->pool;
+
+    if (g->cables != g->inline_cables) {
+        nand_release(pool, g->cables, g->length_of_cables_array * sizeof(cable_t));
+    }
+
+    nand_release(pool, g->ports, ports_size(g->kind, g->number_of_ports));
+    nand_release(pool, g, sizeof(nand_t));
+
+    if (pool) {
+        pool->number_of_gates--;
+    }
+
+    nand_forget_gates(1);
+}
+
+void nand_delete(nand_t *g) {
+    nand_write_lock();
+    delete_gate(g);
+    nand_write_unlock();
+}
+
+/**@brief Joins g_out cable of index cable_index or a direct_signal with a port k of
+ * the gate g_in. If the port k of g_in is already in use this function will take care of
+ * safe removing the old cable (also updating sharing_gate).
+ *
+ * @param g_out         - if direct_signal is NULL then it describes the new sharing gate.
+ * @param g_in          - pointer to the gate which has to be modified.
+ * @param cable_index   - index of the cable in g_out (or in the registered signal
+ *                        direct_signal) which has to be connected to g_in.
+ * @param k             - port number of g_in.
+ * @param direct_signal - is NULL if g_out is not NULL. If is not NULL then keeps pointer
+ *                      - to the boolean signal.
+ */
+static void remove_signal_and_update(nand_t* g_out,
+                                     nand_t* g_in,
+                                     const unsigned int cable_index,
+                                     const unsigned int k,
+                                     const bool* direct_signal) {
+    port_t* g_in_port = g_in->ports + k;
+    nand_t* old_sharing_gate = g_in_port->sharing_gate;
+    const bool* old_direct_signal = g_in_port->direct_signal;
+    unsigned int remove_cable_index = g_in_port->cable_index;
+    ssize_t removed = port_depth(g_in_port);
+
+    // Firstly plug in the new cable. It has to be done before removing
+    // the old one, because the new cable may be the last one which is moved.
+    g_in_port->sharing_gate = g_out;
+    g_in_port->cable_index = cable_index;
+    g_in_port->direct_signal = direct_signal;
+
+    if (old_sharing_gate) {
+        replace_deleted_cable_with_last_one(old_sharing_gate->cables,
+                                            &old_sharing_gate->number_of_cables,
+                                            remove_cable_index);
+    }
+    else if (old_direct_signal) {
+        disconnect_signal_cable(g_in->pool, old_direct_signal, remove_cable_index);
+    }
+
+    invalidate_cache(g_in);
+    update_depth(g_in, removed, port_depth(g_in_port));
+}
+
+/**@brief Changes the length of the cables array to new_length (at least the number
+ * of cables). Cables kept inline in a gate are moved to a new array, other arrays
+ * are reallocated, so that the allocator may extend them in place.
+ * @param pool                   - pool keeping the memory of the cables array or NULL.
+ * @param cables                 - pointer to the cables array.
+ * @param length_of_cables_array - pointer to the length of the cables array.
+ * @param number_of_cables       - number of cables in the array.
+ * @param new_length             - new length of the array.
+ * @param inline_cables          - inline cables of the gate owning the array, or NULL
+ *                                 if the array belongs to a signal.
+ * @return false if there is no memory (the array is left as it was).
+ */
+static bool resize_cables(nand_pool_t* pool, cable_t** cables,
+                          unsigned int* length_of_cables_array,
+                          unsigned int number_of_cables, unsigned int new_length,
+                          cable_t* inline_cables) {
+    cable_t* new_cables;
+
+    if (inline_cables && *cables == inline_cables) {
+        new_cables = (cable_t*)nand_allocate(pool, new_length * sizeof(cable_t));
+
+        if (new_cables) {
+            memcpy(new_cables, inline_cables, number_of_cables * sizeof(cable_t));
+        }
+    }
+    else {
+        new_cables = (cable_t*)nand_reallocate(pool, *cables,
+                                               *length_of_cables_array * sizeof(cable_t),
+                                               new_length * sizeof(cable_t));
+    }
+
+    if (!new_cables) {
+        return false;
+    }
+
+    *cables = new_cables;
+    *length_of_cables_array = new_length;
+    STATS_ADD(cable_regrowths, 1);
+    return true;
+}
+
+/**@brief Appends a cable to the port k of g_in at the end of the cables array,
+ * which acts as a vector in C++.
+ * @param pool                   - pool keeping the memory of the cables array or NULL.
+ * @param cables                 - pointer to the cables array.
+ * @param length_of_cables_array - pointer to the length of the cables array.
+ * @param number_of_cables       - pointer to the number of cables in the array.
+ * @param inline_cables          - inline cables of the gate owning the array, or NULL
+ *                                 if the array belongs to a signal.
+ * @param g_in                   - pointer to the logical gate which will be saved to the
+ *                                 created cable information.
+ * @param k                      - unsigned integer describing the port number in g_in.
+ * @param created                - set to false if there is no memory, true otherwise.
+ * Return value is the index of new created cable.
+ */
+static unsigned int append_cable(nand_pool_t* pool, cable_t** cables,
+                                 unsigned int* length_of_cables_array,
+                                 unsigned int* number_of_cables,
+                                 cable_t* inline_cables,
+                                 nand_t* g_in, unsigned k, bool* created) {
+    if (*number_of_cables == *length_of_cables_array) {
+        if (*length_of_cables_array > UINT_MAX / 2 ||
+            !resize_cables(pool, cables, length_of_cables_array, *number_of_cables,
+                           2 * *length_of_cables_array + 1, inline_cables)) {
+            *created = false;
+            return 0;
+        }
+    }
+
+    unsigned int index_of_free_cable = (*number_of_cables)++;
+
+    (*cables)[index_of_free_cable].linked_logical_gate = g_in;
+    (*cables)[index_of_free_cable].port_number = k;
+    *created = true;
+    return index_of_free_cable;
+}
+
+/**@brief Creates cable in g_out which connects this gate with
+ * g_in in the port k.
+ * @param g_out - sharing gate in which the cable has to be created.
+ * @param g_in  - pointer to the logical gate which will be saved to the
+ *                created cable information.
+ * @param k     - unsigned integer describing the port number in g_in.
+ * Return value is the index of new created cable.
+ */
+static unsigned int create_cable(nand_t* g_out, nand_t* g_in,
+                                 unsigned k, bool* created) {
+    return append_cable(g_out->pool, &g_out->cables, &g_out->length_of_cables_array,
+                        &g_out->number_of_cables, g_out->inline_cables, g_in, k, created);
+}
+
+/**@brief Creates cable in the registered signal s which connects it
+ * with g_in in the port k. Registers s if needed.
+ * Return value is the index of new created cable.
+ */
+static unsigned int create_signal_cable(const bool* s, nand_t* g_in,
+                                        unsigned k, bool* created) {
+    signal_t* signal = find_or_insert_signal(g_in->pool, s);
+
+    if (!signal) {
+        *created = false;
+        return 0;
+    }
+
+    unsigned int index = append_cable(g_in->pool, &signal->cables, &signal->length_of_cables_array,
+                                      &signal->number_of_cables, NULL, g_in, k, created);
+
+    if (!*created && signal->number_of_cables == 0) {
+        remove_signal(g_in->pool, signal);
+    }
+
+    return index;
+}
+
+// Returns true if the connection from g_out to g_in follows the topological order.
+static inline bool ordered(nand_t const* g_out, nand_t const* g_in) {
+    return g_out->rank < g_in->rank;
+}
+
+/**@brief Puts on the work stack (from the position 0) all gates reachable from g_in by
+ * ordered connections and with rank lower than the rank of g_out. Returns false if g_out
+ * is reachable, i.e. the connection from g_out to g_in would close a cycle.
+ */
+static bool collect_forward(nand_t* g_in, nand_t* g_out, size_t* size) {
+    nand_t** list = work_stack.gates;
+
+    *size = 0;
+    visit(g_in);
+    list[(*size)++] = g_in;
+
+    for (size_t next = 0; next < *size; next++) {
+        nand_t* g = list[next];
+
+        for (unsigned int i = 0; i < g->number_of_cables; i++) {
+            nand_t* linked_gate = g->cables[i].linked_logical_gate;
+
+            // Connections to flip-flops are not a part of the order.
+            if (linked_gate->kind == NAND_KIND_DFF) {
+                continue;
+            }
+            if (linked_gate == g_out) {
+                return false;
+            }
+            if (ordered(g, linked_gate) && linked_gate->rank < g_out->rank &&
+                !is_visited(linked_gate)) {
+                visit(linked_gate);
+                list[(*size)++] = linked_gate;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**@brief Appends to the work stack all gates from which g_out is reachable by ordered
+ * connections and with rank higher than the rank of g_in. None of them was collected by
+ * collect_forward, as that would mean a cycle.
+ */
+static void collect_backward(nand_t* g_out, nand_t* g_in, size_t* size) {
+    nand_t** list = work_stack.gates;
+    size_t next = *size;
+
+    visit(g_out);
+    list[(*size)++] = g_out;
+
+    for (; next < *size; next++) {
+        nand_t* g = list[next];
+
+        for (unsigned int i = 0; i < evaluated_ports(g); i++) {
+            nand_t* sharing_gate = g->ports[i].sharing_gate;
+
+            if (sharing_gate && ordered(sharing_gate, g) && sharing_gate->rank > g_in->rank &&
+                !is_visited(sharing_gate)) {
+                visit(sharing_gate);
+                list[(*size)++] = sharing_gate;
+            }
+        }
+    }
+}
+
+static int compare_ranks(const void* a, const void* b) {
+    unsigned long rank_a = (*(nand_t* const*)a)->rank;
+    unsigned long rank_b = (*(nand_t* const*)b)->rank;
+
+    return (rank_a > rank_b) - (rank_a < rank_b);
+}
+
+/**@brief Makes the connection from g_out to g_in ordered, unless it closes a cycle of
+ * ordered connections. This is the algorithm of Pearce and Kelly: only gates with ranks
+ * between the ranks of g_in and g_out which are reachable from g_in, or from which g_out
+ * is reachable, are visited. Their ranks are given out again, the second group first,
+ * and the order inside every group is kept. Connections made earlier stay ordered.
+ * A connection to a flip-flop needs no order, so it never closes a cycle.
+ * @return false if the connection closes a cycle (no rank is changed then).
+ */
+static bool update_order(nand_t* g_out, nand_t* g_in) {
+    if (ordered(g_out, g_in) || g_in->kind == NAND_KIND_DFF) {
+        return true;
+    }
+    if (g_out == g_in) {
+        return false;
+    }
+
+    size_t forward;
+    size_t size;
+
+    current_epoch++;
+
+    if (!collect_forward(g_in, g_out, &forward)) {
+        return false;
+    }
+
+    size = forward;
+    collect_backward(g_out, g_in, &size);
+
+    nand_t** list = work_stack.gates;
+    unsigned long* ranks = work_stack.ranks;
+    size_t backward = size - forward;
+
+    qsort(list, forward, sizeof(nand_t*), compare_ranks);
+    qsort(list + forward, backward, sizeof(nand_t*), compare_ranks);
+
+    // Merges the ranks of both groups.
+    for (size_t i = 0, j = forward, r = 0; r < size; r++) {
+        if (j == size || (i < forward && list[i]->rank < list[j]->rank)) {
+            ranks[r] = list[i++]->rank;
+        }
+        else {
+            ranks[r] = list[j++]->rank;
+        }
+    }
+
+    for (size_t r = 0; r < backward; r++) {
+        list[forward + r]->rank = ranks[r];
+    }
+    for (size_t r = 0; r < forward; r++) {
+        list[r]->rank = ranks[backward + r];
+    }
+
+    return true;
+}
+
+// Makes the connection from g_out to g_in ordered or, if it closes a cycle, puts
+// g_in on the list of gates with unordered connections.
+static void order_connection(nand_t* g_out, nand_t* g_in) {
+    if (!update_order(g_out, g_in)) {
+        add_unordered(g_in);
+    }
+}
+
+/**@brief Tries again to order the connections read by the gates on the list of
+ * unordered connections, as their cycles may have been broken since. A gate whose
+ * connections are all ordered leaves the list.
+ */
+static void order_again(void) {
+    for (size_t i = 0; i < unordered.length;) {
+        nand_t* g = unordered.gates[i];
+        bool all_ordered = true;
+
+        for (unsigned int k = 0; k < evaluated_ports(g); k++) {
+            nand_t* sharing_gate = g->ports[k].sharing_gate;
+
+            if (sharing_gate && !update_order(sharing_gate, g)) {
+                all_ordered = false;
+            }
+        }
+
+        if (all_ordered) {
+            g->unordered = false;
+            unordered.gates[i] = unordered.gates[--unordered.length];
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+/**@brief Returns true if g_out is reachable from g_in by any connections, ordered or
+ * not, except the connections to flip-flops.
+ */
+static bool reachable(nand_t* g_in, nand_t* g_out) {
+    nand_t** stack = work_stack.gates;
+    size_t top = 0;
+
+    current_epoch++;
+    visit(g_in);
+    stack[top++] = g_in;
+
+    while (top > 0) {
+        nand_t* g = stack[--top];
+
+        if (g == g_out) {
+            return true;
+        }
+
+        for (unsigned int i = 0; i < g->number_of_cables; i++) {
+            nand_t* linked_gate = g->cables[i].linked_logical_gate;
+
+            if (linked_gate->kind != NAND_KIND_DFF && !is_visited(linked_gate)) {
+                visit(linked_gate);
+                stack[top++] = linked_gate;
+            }
+        }
+    }
+
+    return false;
+}
+
+static int connect_nand(nand_t* g_out, nand_t* g_in, unsigned k) {
+    if (!g_out || !g_in || k >= g_in->number_of_ports || g_out->pool != g_in->pool) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Create cable in g_out.
+    bool created = false;
+    unsigned int new_cable_index;
+    new_cable_index = create_cable(g_out, g_in, k, &created);
+
+    if (!created) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    remove_signal_and_update(g_out, g_in, new_cable_index, k, NULL);
+
+    // A connection closing a cycle is left out of the order.
+    order_connection(g_out, g_in);
+    return 0;
+}
+
+int nand_connect_nand(nand_t *g_out, nand_t *g_in, unsigned k) {
+    nand_write_lock();
+    int result = connect_nand(g_out, g_in, k);
+    nand_write_unlock();
+    return result;
+}
+
+static int connect_nand_checked(nand_t* g_out, nand_t* g_in, unsigned k) {
+    if (!g_out || !g_in || k >= g_in->number_of_ports || g_out->pool != g_in->pool) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Connections left out of the order get their chance first. Those which still
+    // close cycles are not described by the ranks, so then the system is searched.
+    order_again();
+
+    bool search = (unordered.length > 0 || unordered.lost) && g_in->kind != NAND_KIND_DFF;
+
+    // Ranks changed before a failure still make a topological order.
+    if ((search && reachable(g_in, g_out)) || !update_order(g_out, g_in)) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    bool created = false;
+    unsigned int new_cable_index = create_cable(g_out, g_in, k, &created);
+
+    if (!created) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    remove_signal_and_update(g_out, g_in, new_cable_index, k, NULL);
+    return 0;
+}
+
+int nand_connect_nand_checked(nand_t *g_out, nand_t *g_in, unsigned k) {
+    nand_write_lock();
+    int result = connect_nand_checked(g_out, g_in, k);
+    nand_write_unlock();
+    return result;
+}
+
+static int connect_signal(bool const* s, nand_t* g, unsigned k) {
+    if (!g || !s || k >= g->number_of_ports) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Create cable in the signal.
+    bool created = false;
+    unsigned int new_cable_index;
+    new_cable_index = create_signal_cable(s, g, k, &created);
+
+    if (!created) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    remove_signal_and_update(NULL, g, new_cable_index, k, s);
+    return 0;
+}
+
+int nand_connect_signal(bool const *s, nand_t *g, unsigned k) {
+    nand_write_lock();
+    int result = connect_signal(s, g, k);
+    nand_write_unlock();
+    return result;
+}
+
+/**@brief Hash table (with linear probing) of the signals driving the cables
+ * created by nand_connect_many.
+ * addresses         - array of length capacity, NULL marks a free slot.
+ * counts            - numbers of the edges leaving the signals kept in addresses.
+ * capacity          - zero or a power of two.
+ * number_of_signals - number of occupied slots.
+ */
+typedef struct {
+    const bool** addresses;
+    unsigned int* counts;
+    size_t capacity;
+    size_t number_of_signals;
+} signal_count_t;
+
+// Returns the slot of signal s, which is free if s is not in the map.
+static size_t signal_count_slot(signal_count_t const* map, const bool* s) {
+    size_t mask = map->capacity - 1;
+    size_t i = signal_hash(s) & mask;
+
+    while (map->addresses[i] && map->addresses[i] != s) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+// Doubles the capacity of the map. Returns false if there is no memory.
+static bool grow_signal_count(signal_count_t* map) {
+    signal_count_t new_map;
+
+    new_map.capacity = map->capacity ? 2 * map->capacity : 16;
+    new_map.number_of_signals = map->number_of_signals;
+    new_map.addresses = (const bool**)calloc(new_map.capacity, sizeof(const bool*));
+    new_map.counts = (unsigned int*)malloc(new_map.capacity * sizeof(unsigned int));
+
+    if (!new_map.addresses || !new_map.counts) {
+        free(new_map.addresses);
+        free(new_map.counts);
+        return false;
+    }
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->addresses[i]) {
+            size_t j = signal_count_slot(&new_map, map->addresses[i]);
+            new_map.addresses[j] = map->addresses[i];
+            new_map.counts[j] = map->counts[i];
+        }
+    }
+
+    free(map->addresses);
+    free(map->counts);
+    *map = new_map;
+    return true;
+}
+
+/**@brief Makes room for extra more cables in the cables array. The array is
+ * resized at most once, to the exact length needed. Longer array does not
+ * change the connections, so it may be left as it is if a later step fails.
+ * @return false if there is no memory.
+ */
+static bool reserve_cables(nand_pool_t* pool, cable_t** cables,
+                           unsigned int* length_of_cables_array,
+                           unsigned int number_of_cables, unsigned int extra,
+                           cable_t* inline_cables) {
+    if (number_of_cables > UINT_MAX - extra) {
+        return false;
+    }
+    if (number_of_cables + extra <= *length_of_cables_array) {
+        return true;
+    }
+
+    return resize_cables(pool, cables, length_of_cables_array, number_of_cables,
+                         number_of_cables + extra, inline_cables);
+}
+
+// Removes the cable leading to the port k of g, leaving the port empty. A signal
+// which loses its last cable stays registered.
+static void detach_port(nand_t* g, unsigned int k) {
+    port_t* port = g->ports + k;
+
+    if (port->sharing_gate) {
+        replace_deleted_cable_with_last_one(port->sharing_gate->cables,
+                                            &port->sharing_gate->number_of_cables,
+                                            port->cable_index);
+    }
+    else if (port->direct_signal) {
+        signal_t* signal = find_signal(g->pool, port->direct_signal);
+        replace_deleted_cable_with_last_one(signal->cables, &signal->number_of_cables,
+                                            port->cable_index);
+    }
+
+    port->sharing_gate = NULL;
+    port->direct_signal = NULL;
+}
+
+// Removes the signal s from the signal table of the pool if it has no cables.
+static void remove_signal_if_unused(nand_pool_t* pool, const bool* s) {
+    signal_t* signal = find_signal(pool, s);
+
+    if (signal && signal->number_of_cables == 0) {
+        remove_signal(pool, signal);
+    }
+}
+
+// Checks the edge like nand_connect_nand and nand_connect_signal do. Additionally
+// all gates have to belong to the pool.
+static bool valid_edge(nand_edge_t const* edge, nand_pool_t* pool) {
+    if (!edge->g_in || edge->k >= edge->g_in->number_of_ports || edge->g_in->pool != pool) {
+        return false;
+    }
+    if (edge->g_out) {
+        return !edge->s && edge->g_out->pool == pool;
+    }
+
+    return edge->s != NULL;
+}
+
+static int connect_many(nand_edge_t const* edges, size_t n) {
+    if (!edges && n > 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (!edges[0].g_in) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nand_pool_t* pool = edges[0].g_in->pool;
+    size_t number_of_old_signals = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (!valid_edge(edges + i, pool)) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (edges[i].g_out) {
+            edges[i].g_out->index = 0;
+        }
+        if (edges[i].g_in->ports[edges[i].k].direct_signal) {
+            number_of_old_signals++;
+        }
+    }
+
+    // Signals read by the ports before the connection. Other signals which may
+    // lose their cables are the signals of the edges.
+    const bool** old_signals = NULL;
+    signal_count_t map = {NULL, NULL, 0, 0};
+    int error = 0;
+
+    if (number_of_old_signals > 0) {
+        old_signals = (const bool**)malloc(number_of_old_signals * sizeof(const bool*));
+
+        if (!old_signals) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        number_of_old_signals = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const bool* s = edges[i].g_in->ports[edges[i].k].direct_signal;
+
+            if (s) {
+                old_signals[number_of_old_signals++] = s;
+            }
+        }
+    }
+
+    // Count the edges leaving every gate (in its variable index) and every signal.
+    for (size_t i = 0; i < n; i++) {
+        nand_edge_t const* edge = edges + i;
+
+        if (edge->g_out) {
+            edge->g_out->index++;
+            continue;
+        }
+        if (2 * (map.number_of_signals + 1) > map.capacity && !grow_signal_count(&map)) {
+            error = ENOMEM;
+            break;
+        }
+
+        size_t slot = signal_count_slot(&map, edge->s);
+
+        if (!map.addresses[slot]) {
+            map.addresses[slot] = edge->s;
+            map.counts[slot] = 0;
+            map.number_of_signals++;
+        }
+
+        map.counts[slot]++;
+    }
+
+    // Register new signals and reserve room for all new cables at once. Cables
+    // of the signals are found when the signal table does not change any more.
+    for (size_t i = 0; i < map.capacity && !error; i++) {
+        if (map.addresses[i] && !find_or_insert_signal(pool, map.addresses[i])) {
+            error = ENOMEM;
+        }
+    }
+    for (size_t i = 0; i < map.capacity && !error; i++) {
+        if (map.addresses[i]) {
+            signal_t* signal = find_signal(pool, map.addresses[i]);
+
+            if (!reserve_cables(pool, &signal->cables, &signal->length_of_cables_array,
+                                signal->number_of_cables, map.counts[i], NULL)) {
+                error = ENOMEM;
+            }
+        }
+    }
+    for (size_t i = 0; i < n && !error; i++) {
+        nand_t* g_out = edges[i].g_out;
+
+        // Room is reserved at the first edge of the gate, which resets the counter.
+        if (g_out && g_out->index > 0) {
+            if (!reserve_cables(pool, &g_out->cables, &g_out->length_of_cables_array,
+                                g_out->number_of_cables, g_out->index, g_out->inline_cables)) {
+                error = ENOMEM;
+            }
+
+            g_out->index = 0;
+        }
+    }
+
+    if (error) {
+        // Nothing is connected yet. Only signals registered here have no cables.
+        for (size_t i = 0; i < map.capacity; i++) {
+            if (map.addresses[i]) {
+                remove_signal_if_unused(pool, map.addresses[i]);
+            }
+        }
+
+        free(map.addresses);
+        free(map.counts);
+        free(old_signals);
+        errno = error;
+        return -1;
+    }
+
+    // From now on nothing can fail. Edges are connected in order, so a later edge
+    // leading to the same port wins. Signals are not removed yet.
+    for (size_t i = 0; i < n; i++) {
+        nand_edge_t const* edge = edges + i;
+        port_t* port = edge->g_in->ports + edge->k;
+        cable_t* cables;
+        unsigned int* number_of_cables;
+        ssize_t removed = port_depth(port);
+
+        detach_port(edge->g_in, edge->k);
+
+        if (edge->g_out) {
+            cables = edge->g_out->cables;
+            number_of_cables = &edge->g_out->number_of_cables;
+        }
+        else {
+            signal_t* signal = find_signal(pool, edge->s);
+            cables = signal->cables;
+            number_of_cables = &signal->number_of_cables;
+        }
+
+        cables[*number_of_cables].linked_logical_gate = edge->g_in;
+        cables[*number_of_cables].port_number = edge->k;
+        port->sharing_gate = edge->g_out;
+        port->direct_signal = edge->s;
+        port->cable_index = (*number_of_cables)++;
+        invalidate_cache(edge->g_in);
+        update_depth(edge->g_in, removed, port_depth(port));
+    }
+
+    // Connections which are not overridden by later edges join the order.
+    for (size_t i = 0; i < n; i++) {
+        nand_edge_t const* edge = edges + i;
+
+        if (edge->g_out && edge->g_in->ports[edge->k].sharing_gate == edge->g_out) {
+            order_connection(edge->g_out, edge->g_in);
+        }
+    }
+
+    // Signals which lost all their cables are not registered any more.
+    for (size_t i = 0; i < number_of_old_signals; i++) {
+        remove_signal_if_unused(pool, old_signals[i]);
+    }
+    for (size_t i = 0; i < map.capacity; i++) {
+        if (map.addresses[i]) {
+            remove_signal_if_unused(pool, map.addresses[i]);
+        }
+    }
+
+    free(map.addresses);
+    free(map.counts);
+    free(old_signals);
+    return 0;
+}
+
+int nand_connect_many(nand_edge_t const *edges, size_t n) {
+    nand_write_lock();
+    int result = connect_many(edges, n);
+    nand_write_unlock();
+    return result;
+}
+
+// Invalidates caches of the gates of the pool reading the signal s.
+static void signal_changed_in(nand_pool_t* pool, bool const* s) {
+    signal_t* signal = find_signal(pool, s);
+
+    if (!signal) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < signal->number_of_cables; i++) {
+        invalidate_cache(signal->cables[i].linked_logical_gate);
+    }
+}
+
+void nand_signal_changed(bool const *s) {
+    if (!s) {
+        return;
+    }
+
+    signal_changed_in(NULL, s);
+
+    for (nand_pool_t* pool = nand_pool_list(); pool; pool = pool->next) {
+        signal_changed_in(pool, s);
+    }
+}
+
+bool nand_kind_value(nand_t const* g, unsigned int count, uint64_t bits) {
+    switch (g->kind) {
+        case NAND_KIND_AND:
+            return count == g->number_of_ports;
+        case NAND_KIND_OR:
+            return count > 0;
+        case NAND_KIND_XOR:
+            return count & 1;
+        case NAND_KIND_MUX:
+            return bits & 1 ? bits >> 2 & 1 : bits >> 1 & 1;
+        case NAND_KIND_LUT:
+            return *lut_table(g) >> bits & 1;
+        case NAND_KIND_DFF:
+            return *flip_flop_state(g);
+        default:
+            return count < g->number_of_ports;
+    }
+}
+
+void nand_flip_flop_set(nand_t* g, bool value) {
+    if (*flip_flop_state(g) == value) {
+        return;
+    }
+
+    *flip_flop_state(g) = value;
+    g->cached_output_signal = value;
+
+    for (unsigned int i = 0; i < g->number_of_cables; i++) {
+        invalidate_cache(g->cables[i].linked_logical_gate);
+    }
+}
+
+bool nand_kind_output(nand_t const* g, bool cached) {
+    unsigned int count = 0;
+    uint64_t bits = 0;
+
+    for (unsigned int k = 0; k < evaluated_ports(g); k++) {
+        port_t const* port = g->ports + k;
+        bool value = port->direct_signal ? *port->direct_signal :
+                     cached ? port->sharing_gate->cached_output_signal :
+                              port->sharing_gate->gate_output_signal;
+
+        count += value;
+        bits |= k < 64 ? (uint64_t)value << k : 0;
+    }
+
+    return nand_kind_value(g, count, bits);
+}
+
+/**@brief This function processes the system "back" from the gate g (back means that we
+ * go the sharing_gate instead of linked_logical_gate). It is a depth first search on the
+ * work stack: the gate on the top of the stack processes its ports starting from next_port
+ * until a port leads to an unvisited gate which cannot be updated at once. This gate is put
+ * on the stack and the port is taken into account after this gate is updated. If system of gates is correct (i.e. there is
+ * no cycle, every port is not empty) every visited gate will keep correct values of
+ * gate_output_signal, my_longest_path, updated. Also the variable maximal_length
+ * will keep the longest path in connected component of g. Technical variables of the visited
+ * gates are left as they are in both cases, the next walkthrough ignores them.
+ * @param g                 - pointer to the unvisited logical gate which needs to be processed.
+ * @param maximum_length    - global maximum_length of whole system.
+ * @return true if the system "back" from g is correct and false otherwise (a visited but not
+ *         updated gate means a cycle).
+ */
+static bool evaluate_gate(nand_t* g, ssize_t* maximum_length) {
+    nand_t** stack = work_stack.gates;
+    port_t* port;
+    nand_t* sharing_gate;
+    size_t top = 0;
+
+    // Local copies of technical variables of the gate on the top of the stack,
+    // because the compiler cannot keep in registers values which may be changed
+    // through the direct_signal pointers.
+    unsigned int i = 0;
+    unsigned int number_of_ports = evaluated_ports(g);
+    bool any_false = false;
+    ssize_t longest_path = 0;
+
+    visit(g);
+    stack[top++] = g;
+    STATS_MAX(max_stack_depth, top);
+
+    for (;;) {
+        for (; i < number_of_ports; i++) {
+            port = g->ports + i;
+            sharing_gate = port->sharing_gate;
+
+            if (port->direct_signal) { // Signal-nand connection.
+                any_false |= !*port->direct_signal;
+                longest_path = max(1, longest_path);
+            }
+            else if (!sharing_gate) { // Empty port - no connection.
+                STATS_ADD(empty_port_aborts, 1);
+                return false;
+            }
+            else if (!is_visited(sharing_gate)) { // Nand-nand connection to a new gate.
+                // Most of the gates can be updated at once, without going there
+                // through the stack. Otherwise the new gate keeps processed part.
+                unsigned int j = 0;
+                unsigned int sharing_ports = evaluated_ports(sharing_gate);
+                bool sharing_any_false = false;
+                ssize_t sharing_longest_path = 0;
+
+                for (; j < sharing_ports; j++) {
+                    port_t* sharing_port = sharing_gate->ports + j;
+                    nand_t* next_gate = sharing_port->sharing_gate;
+
+                    if (sharing_port->direct_signal) {
+                        sharing_any_false |= !*sharing_port->direct_signal;
+                        sharing_longest_path = max(1, sharing_longest_path);
+                    }
+                    else if (next_gate && is_visited(next_gate) && next_gate->updated) {
+                        sharing_any_false |= !next_gate->gate_output_signal;
+                        sharing_longest_path = max(next_gate->my_longest_path + 1, sharing_longest_path);
+                    }
+                    else {
+                        break;
+                    }
+                }
+
+                visit(sharing_gate);
+                sharing_gate->any_false = sharing_any_false;
+                sharing_gate->my_longest_path = sharing_longest_path;
+
+                if (j < sharing_ports) {
+                    sharing_gate->next_port = j;
+                    break;
+                }
+
+                STATS_ADD(edges_traversed, j);
+                sharing_gate->updated = true;
+                sharing_gate->gate_output_signal = sharing_gate->kind ?
+                    nand_kind_output(sharing_gate, false) : sharing_any_false;
+                *maximum_length = max(sharing_longest_path, *maximum_length);
+                any_false |= !sharing_gate->gate_output_signal;
+                longest_path = max(sharing_longest_path + 1, longest_path);
+            }
+            else if (!sharing_gate->updated) { // Cycle condition.
+                STATS_ADD(cycle_aborts, 1);
+                return false;
+            }
+            else { // Nand-nand connection to an updated gate.
+                any_false |= !sharing_gate->gate_output_signal;
+                longest_path = max(sharing_gate->my_longest_path + 1, longest_path);
+            }
+        }
+
+        if (i < number_of_ports) { // Go to the new gate.
+            g->next_port = i;
+            g->any_false = any_false;
+            g->my_longest_path = longest_path;
+
+            g = sharing_gate;
+            stack[top++] = g;
+            STATS_MAX(max_stack_depth, top);
+            i = g->next_port;
+            number_of_ports = evaluated_ports(g);
+            any_false = g->any_false;
+            longest_path = g->my_longest_path;
+            continue;
+        }
+
+        // All ports processed.
+        STATS_ADD(edges_traversed, number_of_ports);
+        g->updated = true;
+        g->gate_output_signal = g->kind ? nand_kind_output(g, false) : any_false;
+        g->my_longest_path = longest_path;
+        *maximum_length = max(longest_path, *maximum_length);
+
+        if (--top == 0) {
+            return true;
+        }
+
+        // Back to the gate which has the updated gate on the port next_port.
+        sharing_gate = g;
+        g = stack[top - 1];
+        i = g->next_port + 1;
+        number_of_ports = evaluated_ports(g);
+        any_false = g->any_false | !sharing_gate->gate_output_signal;
+        longest_path = max(sharing_gate->my_longest_path + 1, g->my_longest_path);
+    }
+}
+
+ssize_t nand_evaluate(nand_t **g, bool *s, size_t m) {
+    if (!g || !s || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nand_t *gate;
+    ssize_t maximum_length = -1;
+
+    current_epoch++;
+    STATS_ADD(evaluations, 1);
+
+    for (size_t i = 0; i < m; i++) {
+        gate = g[i];
+
+        if (!gate) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (!is_visited(gate) && !evaluate_gate(gate, &maximum_length)) {
+            errno = ECANCELED;
+            return -1;
+        }
+
+        s[i] = gate->gate_output_signal;
+    }
+
+    return maximum_length;
+}
 
-// Macro representing logical gate without ports.
-#define NO_PORTS 0
-
-// Macro for counting maximum value.
-#define max(x, y) (((x) >= (y)) ? (x) : (y))
-
-struct Port;
-struct Cable;
-
-/**@brief This structure represents single logical gate.
- * ports                  - array of Port structure. Its length is represented
- *                          by the variable number_of_ports.
- * cables                 - array of Cable structure representing all nand-nand
- *                          connections. Its length is represented by the variable
- *                          length_of_cables.
- * number_of_ports        - unsigned integer representing the number of the gates input.
- * length_of_cables_array - unsigned integer representing the length of cables.
- * number_of_cables       - unsigned integer representing the true number of cables
- *                          in the logical gate. Because struct Cable* cables acts in the same
- *                          manner as vector in C++ we have number_of_cables <= length_of_cables_array.
-  * my_longest_path       - ssize_t variable representing the longest path from this gate to the
-  *                         boolean signal or to the gate without ports. Initial value is 0. Before
-  *                         every nand_evaluate function call this variable is set to 0.
- * visited                - boolean technical variable created for DFS in nand_evaluate function.
- *                          Initially is set to false. Before every nand_evaluate this value is always false.
- * updated                - boolean technical variable supporting DFS and cycle detection in nand_evaluate.
- * gate_output_signal     - boolean variable describing the gate output during the nand_evaluate function.
- * any_false              - technical boolean variable which is true if some of the ports of this gate
- *                          keeps signal false and is false otherwise. This variable facilities rapid
- *                          computations of gate_output_signal.
- */
-typedef struct nand {
-    struct Port* ports;
-    struct Cable* cables;
-    unsigned int number_of_ports;
-    unsigned int length_of_cables_array;
-    unsigned int number_of_cables;
-    ssize_t my_longest_path;
-    bool visited;
-    bool gate_output_signal;
-    bool updated;
-    bool any_false;
-} nand_t;
-
-/** @brief Structure which represents a single cable of logical gate.
- * port_number         - unsigned number representing the port
- *                       number of the gate which is linked by this cable.
- * linked_logical_gate - the address of the gate which is linked by this
- *                       cable.
- */
-typedef struct Cable {
-    unsigned port_number;
-    nand_t* linked_logical_gate;
-} cable_t;
-
-/** @brief Structure which represents ports of the logical gate.
- * direct_signal  - if the signal is shared from a boolean signal
- *                  it will keep its address. Is whether the signal
- *                  is shared from another gate or there is no signal.
- * sharing_gate   - if an input signal is shared from another gate it
- *                  will hold its address. Is NULL whether there is no
- *                  income signal or signal is shared directly from a
- *                  boolean signal.
- * signal         - keeps the transferred signal
- *                  otherwise its behaviour is random,
+/**@brief Brings cached values of g up to date. This is the same walkthrough as in
+ * evaluate_gate, but only gates with invalid cache are put on the work stack, thus
+ * cached part of the system is never walked again. A gate which is visited but has
+ * invalid cache lies on the work stack, so reaching it again means a cycle.
+ * @param g          - pointer to the logical gate with invalid cache.
+ * @return true if the system "back" from g is correct and false otherwise.
  */
-typedef struct Port {
-    const bool* direct_signal;
-    nand_t* sharing_gate;
-    unsigned int cable_index;
-} port_t;
+static bool cached_gate(nand_t* g) {
+    port_t* port;
+    nand_t* sharing_gate = NULL;
+    size_t top = 0;
+    bool correct_system = true;
 
-nand_t* nand_new(unsigned n) {
-    port_t* input_signal = NULL;
-    nand_t* new_nand = NULL;
+    visit(g);
+    g->next_port = 0;
+    work_stack.gates[top++] = g;
 
-    if (n) {
-        input_signal = (port_t*)malloc(n * sizeof(port_t));
+    while (top > 0 && correct_system) {
+        g = work_stack.gates[top - 1];
 
-        if (!input_signal) {
-            errno = ENOMEM;
-            return NULL;
-        }
+        unsigned int i = g->next_port;
+        bool any_false = g->any_false;
+        ssize_t longest_path = g->my_longest_path;
 
-        for (unsigned i = 0; i < n; i++) {
-            input_signal[i].direct_signal = NULL;
-            input_signal[i].sharing_gate = NULL;
+        for (; i < evaluated_ports(g); i++) {
+            port = g->ports + i;
+            sharing_gate = port->sharing_gate;
+
+            if (port->direct_signal) { // Signal-nand connection.
+                any_false |= !*port->direct_signal;
+                longest_path = max(1, longest_path);
+            }
+            else if (!sharing_gate) { // Empty port - no connection.
+                STATS_ADD(empty_port_aborts, 1);
+                correct_system = false;
+                break;
+            }
+            else if (!sharing_gate->cache_valid) { // Nand-nand connection to a gate to update.
+                correct_system = !is_visited(sharing_gate); // Cycle condition.
+                STATS_ADD(cycle_aborts, !correct_system);
+                break;
+            }
+            else { // Nand-nand connection to a cached gate.
+                any_false |= !sharing_gate->cached_output_signal;
+                longest_path = max(sharing_gate->cached_longest_path + 1, longest_path);
+            }
         }
-    }
 
-    new_nand = (nand_t*)malloc(sizeof(nand_t));
+        g->next_port = i;
+        g->any_false = any_false;
+        g->my_longest_path = longest_path;
 
-    if (!new_nand) {
-        errno = ENOMEM;
-        free(input_signal);
-        input_signal = NULL;
-        return NULL;
+        if (!correct_system) {
+            break;
+        }
+        if (i < evaluated_ports(g)) {
+            visit(sharing_gate);
+            sharing_gate->next_port = 0;
+            work_stack.gates[top++] = sharing_gate;
+            STATS_MAX(max_stack_depth, top);
+        }
+        else { // All ports processed.
+            STATS_ADD(edges_traversed, evaluated_ports(g));
+            g->cached_longest_path = longest_path;
+            g->cached_output_signal = g->kind ? nand_kind_output(g, true) : any_false;
+            g->cache_valid = true;
+            top--;
+        }
     }
 
-    new_nand->ports = input_signal;
-    new_nand->visited = false;
-    new_nand->any_false = false;
-    new_nand->updated = false;
-    new_nand->my_longest_path = 0;
-    new_nand->cables = NULL;
-    new_nand->length_of_cables_array = 0;
-    new_nand->number_of_cables = 0;
-    new_nand->number_of_ports = n;
-    return new_nand;
+    return correct_system;
 }
 
-/**@brief Replace the last cable in the logical gate g with
- * removed one on the position i. Here the cable on the position
- * i is assumed to be already removed, thus the only thing need
- * to be done is replacing and updating information about new
- * cable index in another linked gate. Also updates the number of cables.
- * @param g - pointer to the logical gate.
- * @param i - index of already removed cable in g which
- *            where the last one has to be set.
- */
-static void replace_deleted_cable_with_last_one(nand_t* g, unsigned int i) {
-    unsigned int number_of_cables = g->number_of_cables - 1;
-    unsigned int port_number = g->cables[number_of_cables].port_number;
-    nand_t* linked_gate = g->cables[number_of_cables].linked_logical_gate;
+ssize_t nand_evaluate_cached(nand_t **g, bool *s, size_t m) {
+    if (!g || !s || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
 
-    // Put last cable to the i-th cable.
-    g->cables[i].linked_logical_gate = linked_gate;
-    g->cables[i].port_number = port_number;
-    g->cables[number_of_cables].linked_logical_gate = NULL;
+    ssize_t maximum_length = -1;
 
-    // Change information about this replacement in linked gate.
-    linked_gate->ports[port_number].cable_index = i;
+    current_epoch++;
+    STATS_ADD(evaluations, 1);
 
-    // Update cable number.
-    g->number_of_cables--;
-}
+    for (size_t i = 0; i < m; i++) {
+        if (!g[i]) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (!g[i]->cache_valid && !cached_gate(g[i])) {
+            errno = ECANCELED;
+            return -1;
+        }
 
-void nand_delete(nand_t *g) {
-    if (!g) {
-        return;
+        // Longest path grows along cables, so the maximum is reached
+        // in one of the evaluated gates.
+        s[i] = g[i]->cached_output_signal;
+        maximum_length = max(g[i]->cached_longest_path, maximum_length);
     }
 
-    cable_t* cable;
-    port_t* port;
-    nand_t* sharing_gate;
-    unsigned int cable_index;
+    return maximum_length;
+}
 
-    // Firstly remove cables connected to my ports.
-    for (unsigned i = 0; i < g->number_of_ports; i++) {
-        port = g->ports + i;
-        sharing_gate = port->sharing_gate;
+// Returns true if the gate a lies on a lower level of the system than the gate b.
+static inline bool lower_level(nand_t const* a, nand_t const* b) {
+    return a->cached_longest_path < b->cached_longest_path;
+}
 
-        if (sharing_gate) {
-            cable_index = port->cable_index;
-            replace_deleted_cable_with_last_one(sharing_gate, cable_index);
-        }
+/**@brief Puts g with valid cache into the event queue, unless it is already there.
+ * The queue is a binary heap on the work stack ordered by cached_longest_path, and
+ * every gate is put there at most once in one walkthrough, so it never overflows.
+ */
+static void push_event(nand_t* g, size_t* size) {
+    if (!g->cache_valid || is_visited(g)) {
+        return;
     }
 
-    // Remove my cables.
-    for (unsigned int i = 0; i < g->number_of_cables; i++) {
-        cable = g->cables + i;
+    nand_t** heap = work_stack.gates;
+    size_t i = (*size)++;
 
-        if (cable && cable->linked_logical_gate) {
-            port_t* ports = cable->linked_logical_gate->ports;
-            ports[cable->port_number].sharing_gate = NULL;
-        }
+    visit(g);
+
+    while (i > 0 && lower_level(g, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
 
-    free(g->cables);
-    free(g->ports);
-    free(g);
+    heap[i] = g;
 }
 
-/**@brief Joins g_out cable of index cable_index or a direct_signal with a port k of
- * the gate g_in. If the port k of g_in is already in use this function will take care of
- * safe removing the old cable (also updating sharing_gate).
- *
- * @param g_out         - if direct_signal is NULL then it describes the new sharing gate.
- * @param g_in          - pointer to the gate which has to be modified.
- * @param cable_index   - index of the cable in g_out which has to be connected to g_in.
- * @param k             - port number of g_in.
- * @param direct_signal - is NULL if g_out is not NULL. If is not NULL then keeps pointer
- *                      - to the boolean signal.
- */
-static void remove_signal_and_update(nand_t* g_out,
-                                     nand_t* g_in,
-                                     const unsigned int cable_index,
-                                     const unsigned int k,
-                                     const bool* direct_signal) {
-    port_t* g_in_port = g_in->ports + k;
+// Takes the gate of the lowest level out of the event queue.
+static nand_t* pop_event(size_t* size) {
+    nand_t** heap = work_stack.gates;
+    nand_t* first = heap[0];
+    nand_t* last = heap[--*size];
+    size_t i = 0;
+
+    while (2 * i + 1 < *size) {
+        size_t child = 2 * i + 1;
 
-    if (g_in_port->sharing_gate || g_in_port->direct_signal) {
-        if (g_in_port->direct_signal) {
-            g_in_port->sharing_gate = g_out;
-            g_in_port->direct_signal = direct_signal;
-            g_in_port->cable_index = cable_index;
+        if (child + 1 < *size && lower_level(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!lower_level(heap[child], last)) {
+            break;
         }
-        else {
-            nand_t* sharing_gate = g_in_port->sharing_gate;
-            unsigned int remove_cable_index = g_in_port->cable_index;
-            unsigned int last_cable_index_sharing_gate = sharing_gate->number_of_cables - 1;
 
-            // Firstly plug in the new cable of g_out
-            g_in_port->sharing_gate = g_out;
-            g_in_port->cable_index = cable_index;
-            g_in_port->direct_signal = direct_signal;
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = last;
+    return first;
+}
 
-            // Replace last cable in the place of removed cable
-            // in g_in.
-            cable_t* last_cable_sharing_gate = &sharing_gate->cables[last_cable_index_sharing_gate];
-            cable_t* remove_cable = &sharing_gate->cables[remove_cable_index];
+// Puts the gates of the pool with valid cache reading the signal s into the event queue.
+static void push_signal_events(nand_pool_t* pool, bool const* s, size_t* size) {
+    signal_t* signal = find_signal(pool, s);
 
-            remove_cable->linked_logical_gate = last_cable_sharing_gate->linked_logical_gate;
-            remove_cable->port_number = last_cable_sharing_gate->port_number;
-            last_cable_sharing_gate->linked_logical_gate->ports[remove_cable->port_number].cable_index = remove_cable_index;
-            last_cable_sharing_gate->linked_logical_gate = NULL;
-            sharing_gate->number_of_cables--;
-        }
+    if (!signal) {
+        return;
     }
-    else {
-        g_in_port->sharing_gate = g_out;
-        g_in_port->direct_signal = direct_signal;
-        g_in_port->cable_index = cable_index;
+
+    for (unsigned int i = 0; i < signal->number_of_cables; i++) {
+        push_event(signal->cables[i].linked_logical_gate, size);
     }
 }
 
-/**@brief Creates cable in g_out which connects this gate with
- * g_in in the port k.
- * @param g_out - sharing gate in which the cable has to be created.
- * @param g_in  - pointer to the logical gate which will be saved to the
- *                created cable information.
- * @param k     - unsigned integer describing the port number in g_in.
- * Return value is the index of new created cable.
+/**@brief Pushes the new value of a signal forward through the cached values. Every
+ * gate of the queue lies on a higher level than the gates connected to its ports, so
+ * taking gates level by level computes each of them once, after all its inputs.
+ * A gate whose output does not change stops the propagation. Gates with invalid
+ * cache are skipped, as all gates reachable from them are invalid too. Gates whose
+ * output flipped are left visited and updated.
  */
-static unsigned int create_cable(nand_t* g_out, nand_t* g_in,
-                                 unsigned k, bool* created) {
-    unsigned int index_of_free_cable;
+static void propagate_events(bool const* s) {
+    size_t size = 0;
 
-    if (g_out->number_of_cables < g_out->length_of_cables_array) {
-        index_of_free_cable =  g_out->number_of_cables;
-        g_out->cables[index_of_free_cable].linked_logical_gate = g_in;
-        g_out->cables[index_of_free_cable].port_number = k;
-        g_out->number_of_cables++;
-        *created = true;
-        return index_of_free_cable;
+    push_signal_events(NULL, s, &size);
+
+    for (nand_pool_t* pool = nand_pool_list(); pool; pool = pool->next) {
+        push_signal_events(pool, s, &size);
     }
-    else {
-        if (g_out->length_of_cables_array > UINT_MAX / 2) {
-            *created = false;
-            return 0;
-        }
 
-        index_of_free_cable = g_out->length_of_cables_array;
-        unsigned int new_length = 2 * index_of_free_cable + 1;
-        cable_t* new_cables = (cable_t*)calloc(new_length, sizeof(cable_t));
+    while (size > 0) {
+        nand_t* g = pop_event(&size);
+        bool any_false = false;
 
-        if (!new_cables) {
-            *created = false;
-            return 0;
+        for (unsigned int i = 0; i < g->number_of_ports && !any_false && !g->kind; i++) {
+            port_t* port = g->ports + i;
+
+            if (port->direct_signal) {
+                any_false = !*port->direct_signal;
+            }
+            else {
+                any_false = !port->sharing_gate->cached_output_signal;
+            }
         }
 
-        // Copy an old content.
-        for (unsigned int i = 0; i < g_out->length_of_cables_array; i++) {
-            new_cables[i].linked_logical_gate = g_out->cables[i].linked_logical_gate;
-            new_cables[i].port_number = g_out->cables[i].port_number;
+        if (g->kind) {
+            any_false = nand_kind_output(g, true);
+        }
+        if (any_false == g->cached_output_signal) {
+            continue;
         }
 
-        // The last one.
-        new_cables[index_of_free_cable].linked_logical_gate = g_in;
-        new_cables[index_of_free_cable].port_number = k;
+        g->cached_output_signal = any_false;
+        g->updated = true;
 
-        free(g_out->cables);
-        g_out->cables = new_cables;
-        g_out->length_of_cables_array = new_length;
-        g_out->number_of_cables++;
-        *created = true;
+        for (unsigned int i = 0; i < g->number_of_cables; i++) {
+            push_event(g->cables[i].linked_logical_gate, &size);
+        }
     }
-
-    return index_of_free_cable;
 }
 
-
-int nand_connect_nand(nand_t *g_out, nand_t *g_in, unsigned k) {
-    if (!g_out || !g_in || k >= g_in->number_of_ports) {
+ssize_t nand_signal_set(bool *s, bool v, nand_t **g, bool *flipped, size_t m) {
+    if (!s || (m > 0 && (!g || !flipped))) {
         errno = EINVAL;
         return -1;
     }
 
-    // Create cable in g_out.
-    bool created = false;
-    unsigned int new_cable_index;
-    new_cable_index = create_cable(g_out, g_in, k, &created);
+    current_epoch++;
 
-    if (!created) {
-        errno = ENOMEM;
-        return -1;
+    // Watched gates are brought up to date with the old value of s.
+    for (size_t i = 0; i < m; i++) {
+        if (!g[i]) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (!g[i]->cache_valid && !cached_gate(g[i])) {
+            errno = ECANCELED;
+            return -1;
+        }
     }
 
-    remove_signal_and_update(g_out, g_in, new_cable_index, k, NULL);
-    return 0;
-}
+    current_epoch++;
 
-int nand_connect_signal(bool const *s, nand_t *g, unsigned k) {
-    if (!g || !s || k >= g->number_of_ports) {
-        errno = EINVAL;
-        return -1;
+    if (*s != v) {
+        *s = v;
+        propagate_events(s);
     }
 
-    remove_signal_and_update(NULL, g, 0, k, s);
-    return 0;
-}
-
-// Recursive function for setting visited gate g back to unvisited,
-// not updated and with longest_path = 0.
-static void change_values_back_to_false_recursive(nand_t* g) {
-    port_t* port;
+    ssize_t number_of_flipped = 0;
 
-    if (!g) {
-        return;
+    for (size_t i = 0; i < m; i++) {
+        flipped[i] = is_visited(g[i]) && g[i]->updated;
+        number_of_flipped += flipped[i];
     }
 
-    // Update my values back to the unvisited status.
-    g->my_longest_path = 0;
-    g->any_false = false;
-    g->updated = false;
-    g->visited = false;
-
-    for (unsigned int i = 0; i < g->number_of_ports; i++) {
-        port = g->ports + i;
+    return number_of_flipped;
+}
 
-        // If sharing gate was visited then go there recursively.
-        if (port->sharing_gate && port->sharing_gate->visited) {
-            change_values_back_to_false_recursive(port->sharing_gate);
+ssize_t nand_topological_order(nand_t **g, size_t m, nand_t ***order) {
+    nand_t** stack = work_stack.gates;
+    nand_t** list = NULL;
+    size_t length_of_list = 0;
+    size_t capacity_of_list = 0;
+    size_t top = 0;
+    int error = 0;
+
+    current_epoch++;
+
+    // Depth first search like in evaluate_gate. Gate is put on the list
+    // when all gates connected to its ports are already there. The gates
+    // of g are the first roots, and the gates connected to the ports of the
+    // listed flip-flops follow them.
+    for (size_t r = 0, f = 0; (r < m || f < length_of_list) && !error;) {
+        nand_t* root;
+
+        if (r < m) {
+            root = g[r++];
+
+            if (!root) {
+                error = EINVAL;
+                break;
+            }
         }
-    }
-}
+        else {
+            nand_t* flip_flop = list[f++];
 
-// At the end of nand_evaluate or during nand_evaluate (if system is not
-// correct) sets all technical variables of visited gates to the initial values.
-static void change_values_back_to_false(nand_t** g, size_t index) {
-    nand_t* gate;
+            if (flip_flop->kind != NAND_KIND_DFF || flip_flop->ports->direct_signal) {
+                continue;
+            }
 
-    for (size_t i = 0; i <= index; i++) {
-        gate = g[i];
+            root = flip_flop->ports->sharing_gate;
 
-        if (!gate) {
+            if (!root) {
+                error = ECANCELED; // Empty port of a flip-flop.
+                break;
+            }
+        }
+        if (is_visited(root)) {
             continue;
         }
 
-        change_values_back_to_false_recursive(gate);
-    }
-}
-
-// Sets all technical variables of logical gate g to
-// the initial values.
-static void set_to_unvisited(nand_t* g) {
-    g->visited = false;
-    g->updated = false;
-    g->any_false = false;
-    g->my_longest_path = 0;
-}
+        visit(root);
+        root->next_port = 0;
+        stack[top++] = root;
 
-/**@brief This function processes a single gate during a recursive walkthrough of the system.
- * If system of gates is correct (i.e. there is no cycle, every nand is not NULL, every port is not empty)
- * it will update the gate g in the sense that g will keep correct values of gate_output_signal,
- * my_longest_path, visited, updated. Also if the system is correct the variable maximal_length
- * will keep the longest path in connected component of g "back" to the signal (back means
- * that we go the sharing_gate instead of linked_logical_gate). If system is not correct it will return
- * false and also will raise is_cycle in case of cycle error or empty_port in case of empty port of g.
- * @param g                 - pointer to the logical gate which needs to be processed.
- * @param maximum_length    - global maximum_length of whole system.
- * @param is_cycle          - technical pointer to boolean variable which is true if system
- *                            has cycle.
- * @param empty_port        - technical pointer to boolean variable which is true if some of
- *                            the ports of the g is empty.
- * @return true if the system "back" from g is correct and false otherwise.
- */
-static bool recursive_gate(nand_t* g, ssize_t* maximum_length,
-                           bool* is_cycle,
-                           bool* empty_port) {
-    port_t* port;
-    g->visited = true;
+        while (top > 0) {
+            nand_t* gate = stack[top - 1];
+            nand_t* sharing_gate = NULL;
+            unsigned int i = gate->next_port;
 
-    if (g->number_of_ports == NO_PORTS) {
-        g->gate_output_signal = false;
-        g->my_longest_path = 0;
-    }
+            for (; i < evaluated_ports(gate); i++) {
+                port_t* port = gate->ports + i;
+                sharing_gate = port->sharing_gate;
 
-    for (unsigned int i = 0; i < g->number_of_ports; i++) {
-        port = g->ports + i;
+                if (port->direct_signal) {
+                    continue;
+                }
+                if (!sharing_gate || (is_visited(sharing_gate) && !sharing_gate->updated)) {
+                    error = ECANCELED; // Empty port or cycle.
+                    break;
+                }
+                if (!is_visited(sharing_gate)) {
+                    break;
+                }
+            }
 
-        if (port->direct_signal) { // Signal-nand connection.
-            if (*port->direct_signal == false) {
-                g->any_false = true;
+            if (error) {
+                break;
             }
 
-            g->my_longest_path = max(1, g->my_longest_path);
-            *maximum_length = max(g->my_longest_path, *maximum_length);
-        }
-        else if (port->sharing_gate) { // Nand-nand connection.
-            bool correct_system = true;
+            gate->next_port = i;
 
-            // Cycle condition.
-            if (port->sharing_gate->visited && !port->sharing_gate->updated) {
-                set_to_unvisited(g);
-                *is_cycle = true;
-                return false;
+            if (i < evaluated_ports(gate)) {
+                visit(sharing_gate);
+                sharing_gate->next_port = 0;
+                stack[top++] = sharing_gate;
+                continue;
             }
-            if (!port->sharing_gate->visited) {
-                correct_system = recursive_gate(port->sharing_gate,
-                                                maximum_length,
-                                                is_cycle, empty_port);
-            }
-            if (correct_system) {
-                g->my_longest_path = max(port->sharing_gate->my_longest_path + 1, g->my_longest_path);
+            if (length_of_list == capacity_of_list) {
+                size_t new_capacity = capacity_of_list ? 2 * capacity_of_list : 16;
+                nand_t** new_list = NULL;
 
-                if (port->sharing_gate->gate_output_signal == false) {
-                    g->any_false = true;
+                if (capacity_of_list < UINT_MAX / 2) {
+                    new_list = (nand_t**)realloc(list, new_capacity * sizeof(nand_t*));
                 }
+                if (!new_list) {
+                    error = ENOMEM;
+                    break;
+                }
+
+                list = new_list;
+                capacity_of_list = new_capacity;
             }
-            else { // System not correct
-                set_to_unvisited(g);
-                return false;
-            }
-        }
-        else { // Empty port - no connection.
-            set_to_unvisited(g);
-            *empty_port = true;
-            return false;
+
+            gate->updated = true;
+            gate->index = (unsigned int)length_of_list;
+            list[length_of_list++] = gate;
+            top--;
         }
     }
 
-    g->updated = true;
-    *maximum_length = max(g->my_longest_path, *maximum_length);
-
-    if (g->any_false) {
-        g->gate_output_signal = true;
-    }
-    else {
-        g->gate_output_signal = false;
+    if (error) {
+        free(list);
+        errno = error;
+        return -1;
     }
 
-    return true;
+    *order = list;
+    return (ssize_t)length_of_list;
 }
 
-ssize_t nand_evaluate(nand_t **g, bool *s, size_t m) {
-    if (!g || !s || m == 0) {
+ssize_t nand_depth(nand_t *g) {
+    if (!g) {
         errno = EINVAL;
         return -1;
     }
 
-    nand_t *gate;
-    bool correct_system = true;
-    bool is_cycle = false;
-    bool empty_port = false;
-    ssize_t maximum_length = -1;
+    nand_t** stack = work_stack.gates;
+    size_t top = 0;
 
-    for (size_t i = 0; i < m; i++) {
-        gate = g[i];
+    current_epoch++;
 
-        if (gate && !gate->visited) {
-            correct_system = recursive_gate(gate, &maximum_length, &is_cycle, &empty_port);
-        }
-        else if (!gate) {
-            if (i > 0) {
-                change_values_back_to_false(g, i - 1);
-            }
+    // Stale gates "back" from g are computed by DFS like in evaluate_gate. Gates which
+    // are not stale are not entered, and a stale gate on the stack means a cycle,
+    // whose gates stay stale.
+    if (g->depth == DEPTH_STALE) {
+        visit(g);
+        g->next_port = 0;
+        stack[top++] = g;
+    }
 
-            errno = EINVAL;
-            return -1;
-        }
-        if (correct_system) {
-            s[i] = gate->gate_output_signal;
-        }
-        else {
-            if (is_cycle) {
-                errno = ECANCELED;
+    while (top > 0) {
+        nand_t* gate = stack[top - 1];
+        nand_t* sharing_gate = NULL;
+        unsigned int i = gate->next_port;
 
-                if (i > 0) {
-                    change_values_back_to_false(g, i - 1);
+        for (; i < evaluated_ports(gate); i++) {
+            sharing_gate = gate->ports[i].sharing_gate;
+
+            if (sharing_gate && sharing_gate->depth == DEPTH_STALE) {
+                if (is_visited(sharing_gate)) {
+                    STATS_ADD(cycle_aborts, 1);
+                    errno = ECANCELED;
+                    return -1;
                 }
+
+                break;
             }
-            else if (empty_port) {
-                errno = ECANCELED;
-                change_values_back_to_false(g, i);
-            }
+        }
 
-            return -1;
+        gate->next_port = i;
+
+        if (i < evaluated_ports(gate)) {
+            visit(sharing_gate);
+            sharing_gate->next_port = 0;
+            stack[top++] = sharing_gate;
+            STATS_MAX(max_stack_depth, top);
+            continue;
         }
+
+        gate->depth = compute_depth(gate);
+        top--;
     }
 
-    change_values_back_to_false(g, m - 1);
-    return maximum_length;
+    if (g->depth < 0) {
+        STATS_ADD(empty_port_aborts, 1);
+        errno = ECANCELED; // Empty port.
+        return -1;
+    }
+
+    return g->depth;
 }
+
 ssize_t nand_fan_out(nand_t const *g) {
     if (!g) {
         errno = EINVAL;
@@ -507,6 +2081,15 @@ ssize_t nand_fan_out(nand_t const *g) {
     return answer;
 }
 
+int nand_kind(nand_t const *g) {
+    if (!g) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return g->kind;
+}
+
 void* nand_input(nand_t const *g, unsigned k) {
     if (!g || k >= g->number_of_ports) {
         errno = EINVAL;
@@ -534,3 +2117,28 @@ nand_t* nand_output(nand_t const *g, ssize_t k) {
 
     return g->cables[k].linked_logical_gate;
 }
+
+#ifdef NAND_STATS
+nand_stats_t nand_stats_counters;
+#endif
+
+int nand_stats(nand_stats_t *stats) {
+    if (!stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#ifdef NAND_STATS
+    *stats = nand_stats_counters;
+    return 0;
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+void nand_stats_reset(void) {
+#ifdef NAND_STATS
+    memset(&nand_stats_counters, 0, sizeof(nand_stats_counters));
+#endif
+}
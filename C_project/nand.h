@@ -3,17 +3,152 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct nand nand_t;
+typedef struct nand_compiled nand_compiled_t;
+typedef struct nand_pool nand_pool_t;
+typedef struct nand_circuit nand_circuit_t;
+typedef struct nand_jit nand_jit_t;
+typedef struct nand_module nand_module_t;
+typedef struct nand_context nand_context_t;
+
+// Native code of a compiled system made by nand_jit: evaluates it under 64 * words
+// patterns, with in and out laid out like in nand_compiled_evaluate_lanes. It uses
+// memory of its nand_jit_t, so calls of one function must not overlap.
+typedef void (*nand_jit_function_t)(uint64_t const *in, uint64_t *out, size_t words);
+
+// Connection of the port k of the gate g_in with the gate g_out or the boolean
+// signal s (exactly one of them is not NULL).
+typedef struct {
+  nand_t     *g_out;
+  bool const *s;
+  nand_t     *g_in;
+  unsigned    k;
+} nand_edge_t;
+
+// Counters of the work done by the library since the last nand_stats_reset. They
+// are kept only if the library is compiled with NAND_STATS (make STATS=1).
+typedef struct {
+  uint64_t evaluations;       // calls of nand_evaluate and nand_evaluate_cached
+  uint64_t gates_visited;     // gates entered by walkthroughs of the system
+  uint64_t edges_traversed;   // ports read by evaluation of these gates
+  uint64_t max_stack_depth;   // the highest work stack of a walkthrough
+  uint64_t cycle_aborts;      // walkthroughs stopped by a cycle
+  uint64_t empty_port_aborts; // walkthroughs stopped by an empty port
+  uint64_t invalidated_gates; // gates marked by invalidation of caches and depths
+  uint64_t cable_regrowths;   // reallocations of cable arrays
+} nand_stats_t;
+
+// Stuck-at fault of a node of a compiled system: the boolean signal i is the node i,
+// gates follow the signals. Patterns are numbered like the bits of the words of
+// nand_compiled_evaluate_lanes: the pattern p is the bit p % 64 of the word p / 64.
+typedef struct {
+  uint32_t node;     // node whose output is stuck
+  bool     value;    // value at which it is stuck
+  bool     detected; // true if some pattern changes some output of the system
+  uint64_t pattern;  // the first such pattern, if detected
+} nand_fault_t;
+
+// Counterexample of nand_equivalent: values of the signals read by the compared
+// gates under which the gates g1[output] and g2[output] differ. Both arrays are
+// allocated by nand_equivalent and freed by free.
+typedef struct {
+  size_t        output;            // index of the differing pair of gates
+  size_t        number_of_signals; // number of signals read by the gates
+  bool const  **signals;           // the signals
+  bool         *values;            // their values
+} nand_counterexample_t;
+
+// Kinds of gates. A gate of the kind NAND_KIND_MUX has 3 ports and gives the value
+// of the port 2 if the port 0 is true and of the port 1 otherwise. A gate of the
+// kind NAND_KIND_LUT has at most 6 ports and gives the bit number
+// v_0 + 2 v_1 + ... + 2^(n-1) v_(n-1) of its table, where v_k is the value of the port k.
+// A gate of the kind NAND_KIND_DFF is a D flip-flop with 1 port: it gives its state,
+// which starts as the bit 0 of its table and takes the value of the port at every
+// clock cycle of nand_step, so feedback through it is not a cycle.
+typedef enum {
+  NAND_KIND_NAND,
+  NAND_KIND_AND,
+  NAND_KIND_OR,
+  NAND_KIND_XOR,
+  NAND_KIND_MUX,
+  NAND_KIND_LUT,
+  NAND_KIND_DFF,
+} nand_kind_t;
 
 nand_t* nand_new(unsigned n);
 void    nand_delete(nand_t *g);
 int     nand_connect_nand(nand_t *g_out, nand_t *g_in, unsigned k);
+int     nand_connect_nand_checked(nand_t *g_out, nand_t *g_in, unsigned k);
 int     nand_connect_signal(bool const *s, nand_t *g, unsigned k);
 ssize_t nand_evaluate(nand_t **g, bool *s, size_t m);
+ssize_t nand_evaluate_cached(nand_t **g, bool *s, size_t m);
+ssize_t nand_evaluate_parallel(nand_t **g, bool *s, size_t m, unsigned threads);
+void    nand_signal_changed(bool const *s);
+ssize_t nand_signal_set(bool *s, bool v, nand_t **g, bool *flipped, size_t m);
+ssize_t nand_optimize(nand_t **g, size_t m);
+int     nand_equivalent(nand_t **g1, nand_t **g2, size_t m, unsigned threads,
+                        nand_counterexample_t *counterexample);
+ssize_t nand_depth(nand_t *g);
 ssize_t nand_fan_out(nand_t const *g);
+int     nand_kind(nand_t const *g);
 void*   nand_input(nand_t const *g, unsigned k);
 nand_t* nand_output(nand_t const *g, ssize_t k);
+int     nand_stats(nand_stats_t *stats);
+void    nand_stats_reset(void);
+
+nand_context_t* nand_context_new(void);
+void            nand_context_delete(nand_context_t *c);
+ssize_t         nand_evaluate_in(nand_context_t *c, nand_t **g, bool *s, size_t m);
+
+nand_pool_t* nand_pool_new(void);
+void         nand_pool_delete(nand_pool_t *p);
+nand_t*      nand_new_in(nand_pool_t *p, unsigned n);
+int          nand_new_many(nand_pool_t *p, nand_t **g, size_t m, unsigned const *n);
+int          nand_connect_many(nand_edge_t const *edges, size_t n);
+nand_t*      nand_new_kind(nand_pool_t *p, nand_kind_t kind, unsigned n, uint64_t table);
+
+nand_compiled_t* nand_compile(nand_t **g, size_t m);
+void             nand_compiled_delete(nand_compiled_t *c);
+ssize_t          nand_compiled_evaluate(nand_compiled_t *c, bool *s);
+int              nand_step(nand_compiled_t *c, size_t cycles);
+size_t           nand_compiled_number_of_signals(nand_compiled_t const *c);
+bool const*      nand_compiled_signal(nand_compiled_t const *c, size_t i);
+ssize_t          nand_compiled_evaluate_lanes(nand_compiled_t *c, uint64_t const *in,
+                                              uint64_t *out, size_t words);
+ssize_t          nand_fault_list(nand_compiled_t const *c, nand_fault_t **faults);
+ssize_t          nand_fault_simulate(nand_compiled_t const *c, uint64_t const *in, size_t words,
+                                     nand_fault_t *faults, size_t n, unsigned threads);
+int              nand_compiled_save(nand_compiled_t const *c, char const *path);
+nand_compiled_t* nand_compiled_load(char const *path, bool const *s, size_t length_of_s);
+int              nand_save(nand_t **g, size_t m, char const *path);
+ssize_t          nand_load(char const *path, nand_pool_t *p, bool const *s, size_t length_of_s,
+                           nand_t ***g);
+nand_compiled_t* nand_import_aiger(FILE *f, bool const *s, size_t length_of_s);
+nand_compiled_t* nand_import_blif(FILE *f, bool const *s, size_t length_of_s);
+
+nand_jit_t*         nand_jit(nand_compiled_t const *c);
+nand_jit_function_t nand_jit_function(nand_jit_t const *j);
+void                nand_jit_delete(nand_jit_t *j);
+
+nand_circuit_t* nand_circuit_new(void);
+void            nand_circuit_delete(nand_circuit_t *c);
+ssize_t         nand_circuit_add(nand_circuit_t *c, unsigned n);
+int             nand_circuit_connect_nand(nand_circuit_t *c, uint32_t g_out, uint32_t g_in, unsigned k);
+int             nand_circuit_connect_signal(nand_circuit_t *c, bool const *s, uint32_t g, unsigned k);
+ssize_t         nand_circuit_evaluate(nand_circuit_t *c, uint32_t const *g, bool *s, size_t m);
+ssize_t         nand_circuit_fan_out(nand_circuit_t const *c, uint32_t g);
+
+nand_module_t* nand_module_new(unsigned inputs, unsigned outputs);
+void           nand_module_delete(nand_module_t *m);
+ssize_t        nand_module_add(nand_module_t *m, unsigned n);
+ssize_t        nand_module_instance(nand_module_t *m, nand_module_t *sub);
+int            nand_module_connect(nand_module_t *m, uint32_t v_out, uint32_t v_in, unsigned k);
+int            nand_module_connect_input(nand_module_t *m, unsigned i, uint32_t v_in, unsigned k);
+int            nand_module_set_output(nand_module_t *m, unsigned j, uint32_t v);
+ssize_t        nand_module_evaluate(nand_module_t *m, bool const *in, bool *out);
 
 #endif
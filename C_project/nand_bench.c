@@ -0,0 +1,1540 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include "memory_tests.h"
+#include "nand.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of measured evaluations in every benchmark.
+#define REPEATS 20
+
+// Number of 64-bit words of input patterns in the lanes benchmark.
+#define LANE_WORDS 8
+
+// Number of 64-bit words of input patterns in the jit benchmark.
+#define JIT_WORDS 64
+
+// Default number of gates in the generated circuits.
+#define DEFAULT_GATES 100000
+
+// Returns the current time in seconds.
+static double seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Measures nand_evaluate of the gate out and prints the time per gate.
+static void measure(char const *name, nand_t *out, size_t gates) {
+  bool s;
+  double start = seconds();
+
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(&out, &s, 1) >= 0);
+
+  double ns = (seconds() - start) * 1e9 / REPEATS / gates;
+  printf("%s gates=%zu ns_per_gate=%.2f\n", name, gates, ns);
+
+  start = seconds();
+  nand_compiled_t *c = nand_compile(&out, 1);
+  assert(c);
+  double compile_ns = (seconds() - start) * 1e9 / gates;
+
+  start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_compiled_evaluate(c, &s) >= 0);
+
+  ns = (seconds() - start) * 1e9 / REPEATS / gates;
+  printf("%s compiled gates=%zu ns_per_gate=%.2f compile_ns_per_gate=%.2f\n",
+         name, gates, ns, compile_ns);
+
+  // The same system under 64 * LANE_WORDS input patterns at once.
+  size_t signals = nand_compiled_number_of_signals(c);
+  uint64_t *in = calloc(signals * LANE_WORDS, sizeof(uint64_t));
+  uint64_t lanes_out[LANE_WORDS];
+  assert(in);
+
+  start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_compiled_evaluate_lanes(c, in, lanes_out, LANE_WORDS) >= 0);
+
+  ns = (seconds() - start) * 1e9 / REPEATS / gates / (64 * LANE_WORDS);
+  printf("%s lanes gates=%zu patterns=%d ns_per_gate_pattern=%.4f\n",
+         name, gates, 64 * LANE_WORDS, ns);
+  free(in);
+  nand_compiled_delete(c);
+}
+
+// Chain of n negations of a single signal.
+static void deep(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  bool s_in = true;
+  assert(g);
+
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(1);
+    assert(g[i]);
+    if (i == 0)
+      assert(nand_connect_signal(&s_in, g[i], 0) == 0);
+    else
+      assert(nand_connect_nand(g[i - 1], g[i], 0) == 0);
+  }
+
+  measure("deep", g[n - 1], n);
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+}
+
+// A single gate with n - 1 ports, each fed by its own negation of a signal.
+static void wide(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  bool s_in = true;
+  assert(g && n > 1);
+
+  g[0] = nand_new(n - 1);
+  assert(g[0]);
+
+  for (size_t i = 1; i < n; ++i) {
+    g[i] = nand_new(1);
+    assert(g[i]);
+    assert(nand_connect_signal(&s_in, g[i], 0) == 0);
+    assert(nand_connect_nand(g[i], g[0], i - 1) == 0);
+  }
+
+  measure("wide", g[0], n);
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+}
+
+// Builds and destroys a chain of n two-port gates, separately and in a pool.
+static void build(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  bool s_in = true;
+  assert(g && n > 1);
+
+  for (int in_pool = 0; in_pool < 2; ++in_pool) {
+    nand_pool_t *p = in_pool ? nand_pool_new() : NULL;
+    double start = seconds();
+
+    for (size_t i = 0; i < n; ++i) {
+      g[i] = p ? nand_new_in(p, 2) : nand_new(2);
+      assert(g[i]);
+      assert(nand_connect_signal(&s_in, g[i], 0) == 0);
+      if (i > 0)
+        assert(nand_connect_nand(g[i - 1], g[i], 1) == 0);
+    }
+
+    double built = seconds();
+
+    if (p)
+      nand_pool_delete(p);
+    else
+      for (size_t i = 0; i < n; ++i)
+        nand_delete(g[i]);
+
+    double end = seconds();
+    printf("build%s gates=%zu build_ns_per_gate=%.2f delete_ns_per_gate=%.2f\n",
+           in_pool ? " pool" : "", n, (built - start) * 1e9 / n, (end - built) * 1e9 / n);
+  }
+
+  free(g);
+}
+
+// Builds the chain of the build benchmark in a pool with the bulk functions.
+static void bulk(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  unsigned *ports = malloc(n * sizeof *ports);
+  nand_edge_t *edges = malloc(2 * n * sizeof *edges);
+  bool s_in = true;
+  size_t m = 0;
+  assert(g && ports && edges && n > 1);
+
+  for (size_t i = 0; i < n; ++i)
+    ports[i] = 2;
+
+  nand_pool_t *p = nand_pool_new();
+  double start = seconds();
+
+  assert(nand_new_many(p, g, n, ports) == 0);
+  for (size_t i = 0; i < n; ++i) {
+    edges[m++] = (nand_edge_t){NULL, &s_in, g[i], 0};
+    if (i > 0)
+      edges[m++] = (nand_edge_t){g[i - 1], NULL, g[i], 1};
+  }
+  assert(nand_connect_many(edges, m) == 0);
+
+  double built = seconds();
+  nand_pool_delete(p);
+  printf("bulk pool gates=%zu build_ns_per_gate=%.2f\n", n, (built - start) * 1e9 / n);
+
+  free(edges);
+  free(ports);
+  free(g);
+}
+
+// Random system of n two-port gates, with pointers and as a compact circuit.
+static void circuit(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  uint32_t *h = malloc(n * sizeof *h);
+  bool *s = malloc(n * sizeof *s);
+  bool s_in = true;
+  nand_circuit_t *c = nand_circuit_new();
+  assert(g && h && s && c && n > 1);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    ssize_t handle = nand_circuit_add(c, 2);
+    assert(g[i] && handle >= 0);
+    h[i] = handle;
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i == 0 || rand() % 8 == 0) {
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+        assert(nand_circuit_connect_signal(c, &s_in, h[i], k) == 0);
+      } else {
+        size_t j = i - 1 - rand() % (i < 1000 ? i : 1000);
+        assert(nand_connect_nand(g[j], g[i], k) == 0);
+        assert(nand_circuit_connect_nand(c, h[j], h[i], k) == 0);
+      }
+    }
+  }
+
+  double start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(g, s, n) >= 0);
+  double ns = (seconds() - start) * 1e9 / REPEATS / n;
+
+  start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_circuit_evaluate(c, h, s, n) >= 0);
+  double circuit_ns = (seconds() - start) * 1e9 / REPEATS / n;
+
+  printf("circuit gates=%zu ns_per_gate=%.2f circuit_ns_per_gate=%.2f\n", n, ns, circuit_ns);
+
+  nand_circuit_delete(c);
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(s);
+  free(h);
+  free(g);
+}
+
+// Random system of n two-port gates evaluated by a growing number of threads.
+static void parallel(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  bool *s = malloc(n * sizeof *s);
+  bool s_in = true;
+  assert(g && s && n > 1);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i == 0 || rand() % 8 == 0)
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i < 1000 ? i : 1000)], g[i], k) == 0);
+    }
+  }
+
+  double start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(g, s, n) >= 0);
+  printf("parallel gates=%zu threads=serial ns_per_gate=%.2f\n", n,
+         (seconds() - start) * 1e9 / REPEATS / n);
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  for (unsigned threads = 1; threads <= online; threads *= 2) {
+    start = seconds();
+    for (int i = 0; i < REPEATS; ++i)
+      assert(nand_evaluate_parallel(g, s, n, threads) >= 0);
+    printf("parallel gates=%zu threads=%u ns_per_gate=%.2f\n", n, threads,
+           (seconds() - start) * 1e9 / REPEATS / n);
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(s);
+  free(g);
+}
+
+// Random blocks of 1024 two-port gates, each reading its own 16 signals. One signal
+// is toggled at a time and the last gates of the blocks are evaluated again by
+// nand_evaluate and by nand_signal_set.
+static void toggle(size_t n) {
+  enum { BLOCK = 1024, BLOCK_SIGNALS = 16 };
+  size_t blocks = (n + BLOCK - 1) / BLOCK;
+  nand_t **g = malloc(n * sizeof *g);
+  nand_t **out = malloc(blocks * sizeof *out);
+  bool *s = malloc(blocks * sizeof *s);
+  bool *s_in = calloc(blocks * BLOCK_SIGNALS, sizeof *s_in);
+  assert(g && out && s && s_in && n > 1);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    size_t first = i / BLOCK * BLOCK;
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i == first || rand() % 8 == 0)
+        assert(nand_connect_signal(s_in + i / BLOCK * BLOCK_SIGNALS + rand() % BLOCK_SIGNALS,
+                                   g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i - first < 64 ? i - first : 64)],
+                                 g[i], k) == 0);
+    }
+    if (i + 1 == n || (i + 1) % BLOCK == 0)
+      out[i / BLOCK] = g[i];
+  }
+
+  size_t steps = REPEATS * 10;
+  double start = seconds();
+  for (size_t i = 0; i < steps; ++i) {
+    bool *t = s_in + rand() % (blocks * BLOCK_SIGNALS);
+    *t = !*t;
+    assert(nand_evaluate(out, s, blocks) >= 0);
+  }
+  printf("toggle gates=%zu evaluate_ns_per_step=%.0f\n", n,
+         (seconds() - start) * 1e9 / steps);
+
+  assert(nand_evaluate_cached(out, s, blocks) >= 0);
+  steps *= 100;
+  size_t flips = 0;
+  start = seconds();
+  for (size_t i = 0; i < steps; ++i) {
+    bool *t = s_in + rand() % (blocks * BLOCK_SIGNALS);
+    ssize_t flipped = nand_signal_set(t, !*t, out, s, blocks);
+    assert(flipped >= 0);
+    flips += flipped;
+  }
+  printf("toggle gates=%zu signal_set_ns_per_step=%.0f flipped_outputs_per_step=%.3f\n", n,
+         (seconds() - start) * 1e9 / steps, (double)flips / steps);
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(s_in);
+  free(s);
+  free(out);
+  free(g);
+}
+
+// Random system of n two-port gates rewired by n local edits: by nand_connect_nand
+// to the previous gate, and by nand_connect_nand_checked to one of the 16 nearest
+// gates (the edits closing a cycle are rejected).
+static void checked(size_t n) {
+  nand_t **g = malloc(n * sizeof *g);
+  bool s_in = true;
+  assert(g && n > 16);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k)
+      if (i == 0)
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i < 8 ? i : 8)], g[i], k) == 0);
+  }
+
+  for (int with_check = 0; with_check < 2; ++with_check) {
+    size_t rejected = 0;
+    srand(2);
+    double start = seconds();
+    for (size_t e = 0; e < n; ++e) {
+      size_t i = 8 + rand() % (n - 16);
+      nand_t *g_out = g[i - 8 + rand() % 16], *g_in = g[i];
+      unsigned k = rand() % 2;
+      if (!with_check)
+        assert(nand_connect_nand(g[i - 1], g_in, k) == 0);
+      else if (nand_connect_nand_checked(g_out, g_in, k) != 0)
+        ++rejected;
+    }
+    printf("checked gates=%zu %s ns_per_edit=%.2f rejected=%zu\n", n,
+           with_check ? "checked" : "unchecked", (seconds() - start) * 1e9 / n, rejected);
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+}
+
+// Random system of n two-port gates rewired by local edits, each followed by
+// a query of the longest path of the last gate by nand_depth and by nand_evaluate.
+static void depth(size_t n) {
+  enum { EDITS = 1000 };
+  nand_t **g = malloc(n * sizeof *g);
+  bool s_in = true, s;
+  assert(g && n > 16);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k)
+      if (i == 0)
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i < 8 ? i : 8)], g[i], k) == 0);
+  }
+
+  double query = 0, evaluation = 0;
+  srand(2);
+  for (size_t e = 0; e < EDITS; ++e) {
+    size_t i = 8 + rand() % (n - 8);
+    assert(nand_connect_nand(g[i - 1 - rand() % 8], g[i], rand() % 2) == 0);
+    double start = seconds();
+    ssize_t length = nand_depth(g[n - 1]);
+    query += seconds() - start;
+    start = seconds();
+    assert(nand_evaluate(g + n - 1, &s, 1) == length);
+    evaluation += seconds() - start;
+  }
+  printf("depth gates=%zu depth_ns_per_edit=%.2f evaluate_ns_per_edit=%.2f\n", n,
+         query * 1e9 / EDITS, evaluation * 1e9 / EDITS);
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+}
+
+// Random system of n two-port gates saved to a file, then loaded as a compiled
+// system (mapped, no allocation per gate) and as gates in a pool.
+static void file(size_t n) {
+  char const *path = "/tmp/nand_bench.netlist";
+  nand_t **g = malloc(n * sizeof *g), **h;
+  bool s_in = true, s;
+  assert(g && n > 1);
+
+  srand(1);
+  double start = seconds();
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i == 0 || rand() % 8 == 0)
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i < 1000 ? i : 1000)], g[i], k) == 0);
+    }
+  }
+  printf("file gates=%zu build_ns_per_gate=%.2f\n", n, (seconds() - start) * 1e9 / n);
+
+  start = seconds();
+  assert(nand_save(g + n - 1, 1, path) == 0);
+  printf("file gates=%zu save_ns_per_gate=%.2f\n", n, (seconds() - start) * 1e9 / n);
+
+  start = seconds();
+  nand_compiled_t *c = nand_compiled_load(path, &s_in, 1);
+  assert(c);
+  printf("file gates=%zu compiled_load_ns_per_gate=%.2f\n", n, (seconds() - start) * 1e9 / n);
+  assert(nand_compiled_evaluate(c, &s) >= 0);
+  nand_compiled_delete(c);
+
+  nand_pool_t *p = nand_pool_new();
+  assert(p);
+  start = seconds();
+  assert(nand_load(path, p, &s_in, 1, &h) == 1);
+  printf("file gates=%zu load_ns_per_gate=%.2f\n", n, (seconds() - start) * 1e9 / n);
+  free(h);
+  nand_pool_delete(p);
+  remove(path);
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+}
+
+// Writes a random AIG of n ANDs reading 64 inputs in the format of the importer:
+// binary AIGER, ASCII AIGER or BLIF (every AND is a cover of one cube).
+static void write_aig(FILE *f, size_t n, int format) {
+  enum { INPUTS = 64 };
+  size_t m = INPUTS + n;
+
+  if (format == 2) {
+    fprintf(f, ".model random\n.inputs");
+    for (size_t i = 1; i <= INPUTS; ++i)
+      fprintf(f, " n%zu", i);
+    fprintf(f, "\n.outputs n%zu\n", m);
+  }
+  else {
+    fprintf(f, "%s %zu %d 0 1 %zu\n", format ? "aag" : "aig", m, INPUTS, n);
+    for (size_t i = 1; format && i <= INPUTS; ++i)
+      fprintf(f, "%zu\n", 2 * i);
+    fprintf(f, "%zu\n", 2 * m);
+  }
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    size_t lhs = 2 * (INPUTS + i + 1);
+    size_t window = lhs - 2 < 2000 ? lhs - 2 : 2000;
+    size_t rhs0 = lhs - 1 - rand() % window;
+    size_t rhs1 = rhs0 - 1 - rand() % (rhs0 - 2 < 2000 ? rhs0 - 2 : 2000);
+    if (rhs1 < 2)
+      rhs1 = 2;
+
+    if (format == 0) {
+      for (size_t delta = lhs - rhs0, k = 0; k < 2; ++k, delta = rhs0 - rhs1) {
+        while (delta & ~(size_t)0x7f) {
+          fputc((int)(delta & 0x7f) | 0x80, f);
+          delta >>= 7;
+        }
+        fputc((int)delta, f);
+      }
+    }
+    else if (format == 1)
+      fprintf(f, "%zu %zu %zu\n", lhs, rhs0, rhs1);
+    else
+      fprintf(f, ".names n%zu n%zu n%zu\n%c%c 1\n", rhs0 / 2, rhs1 / 2, lhs / 2,
+              rhs0 & 1 ? '0' : '1', rhs1 & 1 ? '0' : '1');
+  }
+
+  if (format == 2)
+    fprintf(f, ".end\n");
+}
+
+// Imports random AIGs of n ANDs from files in all formats.
+static void import(size_t n) {
+  static char const *const names[] = {"aiger binary", "aiger ascii", "blif"};
+  char const *path = "/tmp/nand_bench.import";
+  bool s_in[64] = {false}, s;
+
+  for (int format = 0; format < 3; ++format) {
+    FILE *f = fopen(path, "wb");
+    assert(f);
+    write_aig(f, n, format);
+    assert(fclose(f) == 0);
+
+    f = fopen(path, "rb");
+    assert(f);
+    double start = seconds();
+    nand_compiled_t *c = format == 2 ? nand_import_blif(f, s_in, 64)
+                                     : nand_import_aiger(f, s_in, 64);
+    double elapsed = seconds() - start;
+    assert(c && fclose(f) == 0);
+    assert(nand_compiled_evaluate(c, &s) >= 0);
+    printf("import %s nodes=%zu ns_per_node=%.2f million_nodes_per_second=%.1f\n",
+           names[format], n, elapsed * 1e9 / n, n / elapsed / 1e6);
+    nand_compiled_delete(c);
+  }
+
+  remove(path);
+}
+
+// Number of signals of the random redundant systems.
+#define REDUNDANT_SIGNALS 16
+
+// Random system of n gates in the pool p with redundant logic: every fourth gate
+// repeats the previous one, every fourth inverts the previous one and some read
+// a constant. The gates without fan-out are written to out, returns their number.
+static size_t redundant_system(nand_pool_t *p, nand_t **g, nand_t **out, bool *s_in, size_t n) {
+  nand_t *zero = nand_new_in(p, 0);
+  assert(zero && n > 2);
+  int previous = 0;
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    int kind = i < 2 ? 0 : rand() % 4;
+    if (kind == 1 && previous == 2)
+      kind = 0;
+    g[i] = nand_new_in(p, kind == 2 ? 1 : 2);
+    assert(g[i]);
+    if (kind == 1) { // Duplicate of the previous gate, with ports swapped.
+      for (unsigned k = 0; k < 2; ++k) {
+        void *input = nand_input(g[i - 1], 1 - k);
+        if ((bool *)input >= s_in && (bool *)input < s_in + REDUNDANT_SIGNALS)
+          assert(nand_connect_signal(input, g[i], k) == 0);
+        else
+          assert(nand_connect_nand(input, g[i], k) == 0);
+      }
+    }
+    else if (kind == 2) // Inverter of the previous gate.
+      assert(nand_connect_nand(g[i - 1], g[i], 0) == 0);
+    else
+      for (unsigned k = 0; k < 2; ++k) {
+        if (i < 8 || rand() % 8 == 0)
+          assert(nand_connect_signal(s_in + rand() % REDUNDANT_SIGNALS, g[i], k) == 0);
+        else if (rand() % 32 == 0)
+          assert(nand_connect_nand(zero, g[i], k) == 0);
+        else
+          assert(nand_connect_nand(g[i - 1 - rand() % (i < 8 ? i : 8)], g[i], k) == 0);
+      }
+    previous = kind;
+  }
+
+  size_t m = 0;
+  for (size_t i = 0; i < n; ++i)
+    if (nand_fan_out(g[i]) == 0)
+      out[m++] = g[i];
+  return m;
+}
+
+// Measures nand_optimize of a random redundant system and nand_evaluate of the gates
+// without fan-out before and after it.
+static void optimize(size_t n) {
+  nand_pool_t *p = nand_pool_new();
+  nand_t **g = malloc(n * sizeof *g), **out = malloc(n * sizeof *out);
+  bool s_in[REDUNDANT_SIGNALS] = {false}, *s_out = malloc(n * sizeof *s_out);
+  assert(p && g && out && s_out);
+  size_t m = redundant_system(p, g, out, s_in, n);
+
+  double before = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(out, s_out, m) >= 0);
+  before = (seconds() - before) / REPEATS;
+
+  double start = seconds();
+  ssize_t removed = nand_optimize(out, m);
+  double elapsed = seconds() - start;
+  assert(removed >= 0);
+
+  double after = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(out, s_out, m) >= 0);
+  after = (seconds() - after) / REPEATS;
+
+  printf("optimize gates=%zu outputs=%zu removed=%zd ns_per_gate=%.2f evaluate_before_ms=%.3f "
+         "evaluate_after_ms=%.3f\n", n, m, removed, elapsed * 1e9 / n, before * 1e3, after * 1e3);
+  nand_pool_delete(p);
+  free(g);
+  free(out);
+  free(s_out);
+}
+
+// Random system of n two-port gates reading nearby gates, evaluated by the
+// interpreter, by the lanes of the compiled system and by its native code.
+static void jit(size_t n) {
+  enum { SIGNALS = 64, WINDOW = 64 };
+  nand_pool_t *p = nand_pool_new();
+  nand_t **g = malloc(n * sizeof *g), **out = malloc(n * sizeof *out);
+  bool s_in[SIGNALS] = {false}, *s_out = malloc(n * sizeof *s_out);
+  assert(p && g && out && s_out);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new_in(p, 2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      size_t j = (size_t)rand() % (WINDOW + SIGNALS);
+      if (j < WINDOW && j < i)
+        assert(nand_connect_nand(g[i - 1 - j], g[i], k) == 0);
+      else
+        assert(nand_connect_signal(s_in + j % SIGNALS, g[i], k) == 0);
+    }
+  }
+  size_t m = 0;
+  for (size_t i = 0; i < n; ++i)
+    if (nand_fan_out(g[i]) == 0)
+      out[m++] = g[i];
+
+  double start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(out, s_out, m) >= 0);
+  double evaluate = (seconds() - start) / REPEATS / n;
+
+  nand_compiled_t *c = nand_compile(out, m);
+  assert(c);
+  size_t signals = nand_compiled_number_of_signals(c);
+  uint64_t *in = calloc(signals * JIT_WORDS, sizeof(uint64_t));
+  uint64_t *lanes_out = malloc(m * JIT_WORDS * sizeof(uint64_t));
+  uint64_t *jit_out = malloc(m * JIT_WORDS * sizeof(uint64_t));
+  assert(in && lanes_out && jit_out);
+  for (size_t i = 0; i < signals * JIT_WORDS; ++i)
+    in[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  // The first calls touch the memory of values and code.
+  assert(nand_compiled_evaluate_lanes(c, in, lanes_out, JIT_WORDS) >= 0);
+  start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_compiled_evaluate_lanes(c, in, lanes_out, JIT_WORDS) >= 0);
+  double lanes = (seconds() - start) / REPEATS / n / (64 * JIT_WORDS);
+
+  start = seconds();
+  nand_jit_t *j = nand_jit(c);
+  double build = seconds() - start;
+  assert(j);
+  nand_jit_function_t f = nand_jit_function(j);
+
+  f(in, jit_out, JIT_WORDS);
+  start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    f(in, jit_out, JIT_WORDS);
+  double native = (seconds() - start) / REPEATS / n / (64 * JIT_WORDS);
+  assert(memcmp(lanes_out, jit_out, m * JIT_WORDS * sizeof(uint64_t)) == 0);
+
+  printf("jit gates=%zu outputs=%zu evaluate_ns_per_gate=%.2f lanes_ns_per_gate_pattern=%.4f "
+         "jit_ns_per_gate_pattern=%.4f jit_build_s=%.2f\n",
+         n, m, evaluate * 1e9, lanes * 1e9, native * 1e9, build);
+  nand_jit_delete(j);
+  nand_compiled_delete(c);
+  nand_pool_delete(p);
+  free(g);
+  free(out);
+  free(s_out);
+  free(in);
+  free(lanes_out);
+  free(jit_out);
+}
+
+// Circuit of the benchmark suite: its gates in the order of creation, its outputs
+// and its input signals.
+typedef struct {
+  nand_pool_t *pool;
+  nand_t **gates, **outputs;
+  size_t count, capacity, number_of_outputs, capacity_of_outputs;
+  bool *signals;
+  size_t number_of_signals;
+} shape_t;
+
+// Input of a gate of the suite: a gate or a signal.
+typedef struct {
+  nand_t *gate;
+  bool *signal;
+} node_t;
+
+static void shape_signals(shape_t *c, size_t count) {
+  c->signals = calloc(count, sizeof(bool));
+  c->number_of_signals = count;
+  assert(c->signals);
+}
+
+static nand_t *shape_gate(shape_t *c, unsigned n) {
+  if (c->count == c->capacity) {
+    c->capacity = c->capacity ? 2 * c->capacity : 1024;
+    c->gates = realloc(c->gates, c->capacity * sizeof *c->gates);
+    assert(c->gates);
+  }
+  nand_t *g = c->pool ? nand_new_in(c->pool, n) : nand_new(n);
+  assert(g);
+  return c->gates[c->count++] = g;
+}
+
+static void shape_output(shape_t *c, nand_t *g) {
+  if (c->number_of_outputs == c->capacity_of_outputs) {
+    c->capacity_of_outputs = c->capacity_of_outputs ? 2 * c->capacity_of_outputs : 64;
+    c->outputs = realloc(c->outputs, c->capacity_of_outputs * sizeof *c->outputs);
+    assert(c->outputs);
+  }
+  c->outputs[c->number_of_outputs++] = g;
+}
+
+static void shape_connect(node_t x, nand_t *g, unsigned k) {
+  if (x.gate)
+    assert(nand_connect_nand(x.gate, g, k) == 0);
+  else
+    assert(nand_connect_signal(x.signal, g, k) == 0);
+}
+
+static node_t nand2(shape_t *c, node_t x, node_t y) {
+  nand_t *g = shape_gate(c, 2);
+  shape_connect(x, g, 0);
+  shape_connect(y, g, 1);
+  return (node_t){g, NULL};
+}
+
+static node_t not1(shape_t *c, node_t x) {
+  nand_t *g = shape_gate(c, 1);
+  shape_connect(x, g, 0);
+  return (node_t){g, NULL};
+}
+
+static node_t signal_node(shape_t *c, size_t i) {
+  return (node_t){NULL, c->signals + i};
+}
+
+// Full adder of 9 NAND gates, returns the sum and writes the carry to *carry.
+static node_t full_adder(shape_t *c, node_t a, node_t b, node_t *carry) {
+  node_t t1 = nand2(c, a, b);
+  node_t x = nand2(c, nand2(c, a, t1), nand2(c, b, t1));
+  node_t t4 = nand2(c, x, *carry);
+  node_t sum = nand2(c, nand2(c, x, t4), nand2(c, *carry, t4));
+  *carry = nand2(c, t1, t4);
+  return sum;
+}
+
+// Chain of negations of a signal.
+static void shape_chain(shape_t *c, size_t n) {
+  shape_signals(c, 1);
+  node_t x = signal_node(c, 0);
+  for (size_t i = 0; i < n; ++i)
+    x = not1(c, x);
+  shape_output(c, x.gate);
+}
+
+// One gate reading n - 1 negations of signals.
+static void shape_wide(shape_t *c, size_t n) {
+  shape_signals(c, 64);
+  nand_t *out = shape_gate(c, n - 1);
+  for (size_t i = 0; i + 1 < n; ++i)
+    shape_connect(not1(c, signal_node(c, i % c->number_of_signals)), out, i);
+  shape_output(c, out);
+}
+
+// One negation of a signal read by n - 1 gates, all of them outputs.
+static void shape_hub(shape_t *c, size_t n) {
+  shape_signals(c, 64);
+  node_t hub = not1(c, signal_node(c, 0));
+  for (size_t i = 0; i + 1 < n; ++i)
+    shape_output(c, nand2(c, hub, signal_node(c, i % c->number_of_signals)).gate);
+}
+
+// Gates reading two random earlier gates or signals; outputs are the gates
+// without fan-out.
+static void shape_random(shape_t *c, size_t n) {
+  shape_signals(c, 64);
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    node_t x[2];
+    for (int k = 0; k < 2; ++k) {
+      size_t j = (size_t)rand() % (i + c->number_of_signals);
+      x[k] = j < i ? (node_t){c->gates[j], NULL} : signal_node(c, j - i);
+    }
+    nand2(c, x[0], x[1]);
+  }
+  for (size_t i = 0; i < n; ++i)
+    if (nand_fan_out(c->gates[i]) == 0)
+      shape_output(c, c->gates[i]);
+}
+
+// Ripple-carry adder of two numbers of n / 9 bits (9 gates per full adder).
+static void shape_ripple(shape_t *c, size_t n) {
+  size_t bits = n / 9 > 0 ? n / 9 : 1;
+  shape_signals(c, 2 * bits);
+  node_t carry = not1(c, not1(c, signal_node(c, 0)));
+  for (size_t i = 0; i < bits; ++i)
+    shape_output(c, full_adder(c, signal_node(c, i), signal_node(c, bits + i), &carry).gate);
+  shape_output(c, carry.gate);
+}
+
+/* Kogge-Stone prefix adder: generate and propagate of every bit, then log2(bits)
+ * levels combining (G, P) with the pair 2^l bits lower, and sum = p XOR carry.
+ * Both G and its negation nG are kept, one combination costs 5 gates. The
+ * number of bits is the largest one giving at most n gates.
+ */
+static size_t prefix_gates(size_t bits) {
+  size_t gates = 5 * bits + 4 * (bits - 1);
+  for (size_t d = 1; d < bits; d *= 2)
+    gates += 5 * (bits - d);
+  return gates;
+}
+
+static void shape_prefix(shape_t *c, size_t n) {
+  size_t bits = 1;
+  while (prefix_gates(2 * bits) <= n)
+    bits *= 2;
+  for (size_t step = bits / 2; step > 0; step /= 2)
+    if (prefix_gates(bits + step) <= n)
+      bits += step;
+  shape_signals(c, 2 * bits);
+  node_t *g = malloc(bits * sizeof *g), *ng = malloc(bits * sizeof *ng);
+  node_t *p = malloc(bits * sizeof *p), *p0 = malloc(bits * sizeof *p0);
+  node_t *next = malloc(3 * bits * sizeof *next);
+  assert(g && ng && p && p0 && next);
+
+  for (size_t i = 0; i < bits; ++i) {
+    node_t a = signal_node(c, i), b = signal_node(c, bits + i);
+    ng[i] = nand2(c, a, b);
+    g[i] = not1(c, ng[i]);
+    p0[i] = p[i] = nand2(c, nand2(c, a, ng[i]), nand2(c, b, ng[i]));
+  }
+  for (size_t d = 1; d < bits; d *= 2) {
+    for (size_t i = d; i < bits; ++i) {
+      node_t gi = nand2(c, ng[i], nand2(c, p[i], g[i - d]));
+      next[i] = gi;
+      next[bits + i] = not1(c, gi);
+      next[2 * bits + i] = not1(c, nand2(c, p[i], p[i - d]));
+    }
+    for (size_t i = d; i < bits; ++i) {
+      g[i] = next[i];
+      ng[i] = next[bits + i];
+      p[i] = next[2 * bits + i];
+    }
+  }
+  shape_output(c, p0[0].gate);
+  for (size_t i = 1; i < bits; ++i) {
+    node_t t = nand2(c, p0[i], g[i - 1]);
+    shape_output(c, nand2(c, nand2(c, p0[i], t), nand2(c, g[i - 1], t)).gate);
+  }
+  shape_output(c, g[bits - 1].gate);
+  free(g);
+  free(ng);
+  free(p);
+  free(p0);
+  free(next);
+}
+
+// Array multiplier of two numbers of about sqrt(n / 11) bits: the row of partial products of
+// every bit of the second number is added to the sum by a row of full adders.
+static void shape_multiplier(shape_t *c, size_t n) {
+  size_t bits = 2;
+  while (11 * (bits + 1) * (bits + 1) <= n)
+    bits++;
+  shape_signals(c, 2 * bits);
+  node_t *row = malloc(bits * sizeof *row);
+  assert(row);
+
+  node_t zero = not1(c, nand2(c, signal_node(c, 0), not1(c, signal_node(c, 0))));
+  node_t top = zero;
+  for (size_t j = 0; j < bits; ++j)
+    row[j] = not1(c, nand2(c, signal_node(c, j), signal_node(c, bits)));
+  for (size_t i = 1; i < bits; ++i) {
+    shape_output(c, row[0].gate);
+    node_t carry = zero;
+    for (size_t j = 0; j < bits; ++j) {
+      node_t product = not1(c, nand2(c, signal_node(c, j), signal_node(c, bits + i)));
+      row[j] = full_adder(c, j + 1 < bits ? row[j + 1] : top, product, &carry);
+    }
+    top = carry;
+  }
+  for (size_t j = 0; j < bits; ++j)
+    shape_output(c, row[j].gate);
+  shape_output(c, top.gate);
+  free(row);
+}
+
+// Number of random rewirings measured for every shape of the suite.
+#define EDITS 1000
+
+// Returns the value in kB of the field (e.g. "VmHWM:") of /proc/self/status, 0 if unknown.
+static size_t status_kb(char const *field) {
+  FILE *f = fopen("/proc/self/status", "r");
+  char line[256];
+  size_t kb = 0, length = strlen(field);
+
+  if (!f)
+    return 0;
+  while (fgets(line, sizeof line, f))
+    if (strncmp(line, field, length) == 0)
+      kb = strtoull(line + length, NULL, 10);
+  fclose(f);
+  return kb;
+}
+
+typedef struct {
+  char const *name;
+  void (*generate)(shape_t *, size_t);
+} suite_shape_t;
+
+static const suite_shape_t suite_shapes[] = {
+  {"chain", shape_chain},
+  {"wide", shape_wide},
+  {"hub", shape_hub},
+  {"random", shape_random},
+  {"ripple", shape_ripple},
+  {"prefix", shape_prefix},
+  {"multiplier", shape_multiplier},
+};
+
+// Builds the i-th shape of about n gates and measures building, evaluation,
+// rewiring and deletion.
+static void suite_shape(size_t i, int in_pool, size_t n) {
+  memory_test_data_t *memory = get_memory_test_data();
+  shape_t c = {0};
+  c.pool = in_pool ? nand_pool_new() : NULL;
+  assert(c.pool || !in_pool);
+
+  size_t rss = status_kb("VmRSS:");
+  unsigned allocations = memory->alloc_counter;
+  double start = seconds();
+  suite_shapes[i].generate(&c, n);
+  double build = seconds() - start;
+  allocations = memory->alloc_counter - allocations;
+
+  bool *s = malloc(c.number_of_outputs * sizeof *s);
+  assert(s);
+  start = seconds();
+  ssize_t path = nand_evaluate(c.outputs, s, c.number_of_outputs);
+  double first = seconds() - start;
+  assert(path >= 0);
+
+  start = seconds();
+  for (int r = 0; r < REPEATS; ++r)
+    assert(nand_evaluate(c.outputs, s, c.number_of_outputs) == path);
+  double repeated = (seconds() - start) / REPEATS;
+
+  // Every edit connects the first port of a random gate to its input again.
+  srand(2);
+  start = seconds();
+  for (int e = 0; e < EDITS; ++e) {
+    nand_t *g = c.gates[(size_t)rand() % c.count];
+    unsigned k = 0;
+    void *input = nand_input(g, k);
+    if ((bool *)input >= c.signals && (bool *)input < c.signals + c.number_of_signals)
+      assert(nand_connect_signal(input, g, k) == 0);
+    else
+      assert(nand_connect_nand(input, g, k) == 0);
+  }
+  double rewire = (seconds() - start) / EDITS;
+  assert(nand_evaluate(c.outputs, s, c.number_of_outputs) == path);
+  size_t peak = status_kb("VmHWM:");
+
+  start = seconds();
+  for (size_t j = c.count; j-- > 0;)
+    nand_delete(c.gates[j]);
+  double deleted = seconds() - start;
+  nand_pool_delete(c.pool);
+
+  double gates = (double)c.count;
+  printf("suite shape=%s pool=%d gates=%zu outputs=%zu path=%zd build_ns_per_gate=%.2f "
+         "allocations_per_gate=%.3f evaluate_ns_per_gate=%.2f repeat_ns_per_gate=%.2f "
+         "rewire_ns_per_edit=%.1f delete_ns_per_gate=%.2f peak_rss_kb=%zu "
+         "bytes_per_gate=%.1f\n",
+         suite_shapes[i].name, in_pool, c.count, c.number_of_outputs, path,
+         build * 1e9 / gates, allocations / gates, first * 1e9 / gates,
+         repeated * 1e9 / gates, rewire * 1e9, deleted * 1e9 / gates, peak,
+         peak > rss ? (peak - rss) * 1024.0 / gates : 0.0);
+  fflush(stdout);
+  free(s);
+  free(c.gates);
+  free(c.outputs);
+  free(c.signals);
+}
+
+// Measures every shape of about n gates with and without a pool, one line per
+// shape. Every shape is built by a new process, so that its peak resident set
+// size does not include memory of the shapes before.
+static void suite(size_t n) {
+  assert(n > 1);
+
+  for (size_t i = 0; i < sizeof suite_shapes / sizeof suite_shapes[0]; ++i)
+    for (int in_pool = 0; in_pool < 2; ++in_pool) {
+      int status;
+      pid_t child = fork();
+      assert(child >= 0);
+
+      if (child == 0) {
+        suite_shape(i, in_pool, n);
+        _exit(0);
+      }
+      assert(waitpid(child, &status, 0) == child && WIFEXITED(status) &&
+             WEXITSTATUS(status) == 0);
+    }
+}
+
+// Adds a gate of the given kind reading the nodes x to the shape.
+static node_t kind_gate(shape_t *c, nand_kind_t kind, uint64_t table, unsigned n, node_t const *x) {
+  if (c->count == c->capacity) {
+    c->capacity = c->capacity ? 2 * c->capacity : 1024;
+    c->gates = realloc(c->gates, c->capacity * sizeof *c->gates);
+    assert(c->gates);
+  }
+  nand_t *g = nand_new_kind(c->pool, kind, n, table);
+  assert(g);
+  for (unsigned k = 0; k < n; ++k)
+    shape_connect(x[k], g, k);
+  return (node_t){c->gates[c->count++] = g, NULL};
+}
+
+// Ripple-carry adder of n / 9 bits built of NAND gates (9 per bit), of gates
+// XOR, AND and OR (5 per bit) and of two 3-input tables per bit. Each one is
+// evaluated by nand_evaluate and compiled.
+static void kinds(size_t n) {
+  static char const *const styles[] = {"nand", "xor_and_or", "lut"};
+  size_t bits = n / 9 > 0 ? n / 9 : 1;
+
+  for (int style = 0; style < 3; ++style) {
+    shape_t c = {0};
+    c.pool = nand_pool_new();
+    assert(c.pool);
+    shape_signals(&c, 2 * bits + 1);
+
+    double start = seconds();
+    node_t carry = signal_node(&c, 2 * bits);
+    for (size_t i = 0; i < bits; ++i) {
+      node_t x[3] = {signal_node(&c, i), signal_node(&c, bits + i), carry};
+      node_t sum;
+      if (style == 0)
+        sum = full_adder(&c, x[0], x[1], &carry);
+      else if (style == 1) {
+        sum = kind_gate(&c, NAND_KIND_XOR, 0, 3, x);
+        node_t y[3] = {kind_gate(&c, NAND_KIND_AND, 0, 2, x),
+                       kind_gate(&c, NAND_KIND_AND, 0, 2, x + 1),
+                       kind_gate(&c, NAND_KIND_AND, 0, 2, (node_t[]){x[0], x[2]})};
+        carry = kind_gate(&c, NAND_KIND_OR, 0, 3, y);
+      }
+      else {
+        sum = kind_gate(&c, NAND_KIND_LUT, 0x96, 3, x);
+        carry = kind_gate(&c, NAND_KIND_LUT, 0xE8, 3, x);
+      }
+      shape_output(&c, sum.gate);
+    }
+    shape_output(&c, carry.gate);
+    double build = seconds() - start;
+
+    bool *s = malloc(c.number_of_outputs * sizeof *s);
+    assert(s);
+    srand(3);
+    for (size_t i = 0; i < c.number_of_signals; ++i)
+      c.signals[i] = rand() & 1;
+    ssize_t path = nand_evaluate(c.outputs, s, c.number_of_outputs);
+    assert(path >= 0);
+    start = seconds();
+    for (int r = 0; r < REPEATS; ++r)
+      assert(nand_evaluate(c.outputs, s, c.number_of_outputs) == path);
+    double evaluate = (seconds() - start) / REPEATS;
+
+    start = seconds();
+    nand_compiled_t *compiled = nand_compile(c.outputs, c.number_of_outputs);
+    double compile = seconds() - start;
+    assert(compiled);
+    ssize_t compiled_path = nand_compiled_evaluate(compiled, s);
+    start = seconds();
+    for (int r = 0; r < REPEATS; ++r)
+      assert(nand_compiled_evaluate(compiled, s) == compiled_path);
+    double compiled_evaluate = (seconds() - start) / REPEATS;
+
+    printf("kinds style=%s bits=%zu gates=%zu path=%zd build_ns_per_bit=%.2f "
+           "evaluate_ns_per_bit=%.2f compile_ns_per_bit=%.2f compiled_path=%zd "
+           "compiled_ns_per_bit=%.2f\n",
+           styles[style], bits, c.count, path, build * 1e9 / bits, evaluate * 1e9 / bits,
+           compile * 1e9 / bits, compiled_path, compiled_evaluate * 1e9 / bits);
+    nand_compiled_delete(compiled);
+    nand_pool_delete(c.pool);
+    free(s);
+    free(c.gates);
+    free(c.outputs);
+    free(c.signals);
+  }
+}
+
+// Number of bits of the adder copied by the benchmark modules.
+#define MODULE_BITS 64
+
+// Module of a full adder of 9 NAND gates: inputs a, b, carry and outputs sum, carry.
+static nand_module_t *full_adder_module(void) {
+  nand_module_t *m = nand_module_new(3, 2);
+  assert(m);
+  ssize_t g[9];
+  for (int i = 0; i < 9; ++i)
+    assert((g[i] = nand_module_add(m, 2)) >= 0);
+  static const int edges[][3] = {{-1, 0, 0}, {-2, 0, 1}, {-1, 1, 0}, {0, 1, 1}, {-2, 2, 0},
+                                 {0, 2, 1}, {1, 3, 0}, {2, 3, 1}, {3, 4, 0}, {-3, 4, 1},
+                                 {3, 5, 0}, {4, 5, 1}, {-3, 6, 0}, {4, 6, 1}, {5, 7, 0},
+                                 {6, 7, 1}, {0, 8, 0}, {4, 8, 1}};
+  for (size_t i = 0; i < sizeof edges / sizeof edges[0]; ++i)
+    if (edges[i][0] < 0)
+      assert(nand_module_connect_input(m, -1 - edges[i][0], g[edges[i][1]], edges[i][2]) == 0);
+    else
+      assert(nand_module_connect(m, g[edges[i][0]], g[edges[i][1]], edges[i][2]) == 0);
+  assert(nand_module_set_output(m, 0, g[7]) == 0 && nand_module_set_output(m, 1, g[8]) == 0);
+  return m;
+}
+
+// Module of a ripple-carry adder of bits bits made of instances of sub, an adder of
+// bits / parts bits. Inputs are a, b and carry, outputs are sum and carry.
+static nand_module_t *adder_module(nand_module_t *sub, unsigned bits, unsigned parts) {
+  unsigned w = bits / parts;
+  nand_module_t *m = nand_module_new(2 * bits + 1, bits + 1);
+  assert(m);
+  ssize_t previous = -1;
+  for (unsigned i = 0; i < parts; ++i) {
+    ssize_t v = nand_module_instance(m, sub);
+    assert(v >= 0);
+    for (unsigned k = 0; k < w; ++k)
+      assert(nand_module_connect_input(m, i * w + k, v, k) == 0 &&
+             nand_module_connect_input(m, bits + i * w + k, v, w + k) == 0 &&
+             nand_module_set_output(m, i * w + k, v + k) == 0);
+    if (previous < 0)
+      assert(nand_module_connect_input(m, 2 * bits, v, 2 * w) == 0);
+    else
+      assert(nand_module_connect(m, previous + w, v, 2 * w) == 0);
+    previous = v;
+  }
+  assert(nand_module_set_output(m, bits, previous + w) == 0);
+  return m;
+}
+
+// Chain of about n / 576 adders of 64 bits, each one adding b to the sum of the
+// previous one, built of modules and flattened into NAND gates of a pool.
+static void module_style(int flat, size_t n) {
+  size_t copies = n / (9 * MODULE_BITS) > 0 ? n / (9 * MODULE_BITS) : 1;
+  size_t gates = copies * 9 * MODULE_BITS;
+  bool in[2 * MODULE_BITS + 1], out[MODULE_BITS + 1];
+  srand(5);
+  for (size_t i = 0; i < sizeof in; ++i)
+    in[i] = rand() & 1;
+
+  size_t rss = status_kb("VmRSS:");
+  double start = seconds();
+  shape_t c = {0};
+  nand_module_t *modules[4] = {NULL};
+  if (flat) {
+    c.pool = nand_pool_new();
+    assert(c.pool);
+    node_t sum[MODULE_BITS], carry = {NULL, in + 2 * MODULE_BITS};
+    for (int i = 0; i < MODULE_BITS; ++i)
+      sum[i] = (node_t){NULL, in + i};
+    for (size_t copy = 0; copy < copies; ++copy)
+      for (int i = 0; i < MODULE_BITS; ++i)
+        sum[i] = full_adder(&c, sum[i], (node_t){NULL, in + MODULE_BITS + i}, &carry);
+    for (int i = 0; i < MODULE_BITS; ++i)
+      shape_output(&c, sum[i].gate);
+    shape_output(&c, carry.gate);
+  }
+  else {
+    // Full adder, adder of 8 bits, adder of 64 bits and the chain of copies.
+    modules[0] = full_adder_module();
+    modules[1] = adder_module(modules[0], 8, 8);
+    modules[2] = adder_module(modules[1], MODULE_BITS, MODULE_BITS / 8);
+    modules[3] = nand_module_new(2 * MODULE_BITS + 1, MODULE_BITS + 1);
+    assert(modules[3]);
+    ssize_t previous = -1;
+    for (size_t copy = 0; copy < copies; ++copy) {
+      ssize_t v = nand_module_instance(modules[3], modules[2]);
+      assert(v >= 0);
+      for (unsigned k = 0; k <= 2 * MODULE_BITS; ++k) {
+        if (k >= MODULE_BITS && k < 2 * MODULE_BITS)
+          assert(nand_module_connect_input(modules[3], k, v, k) == 0);
+        else if (previous < 0)
+          assert(nand_module_connect_input(modules[3], k, v, k) == 0);
+        else
+          assert(nand_module_connect(modules[3], previous + (k < MODULE_BITS ? k : MODULE_BITS),
+                                     v, k) == 0);
+      }
+      previous = v;
+    }
+    for (unsigned j = 0; j <= MODULE_BITS; ++j)
+      assert(nand_module_set_output(modules[3], j, previous + j) == 0);
+  }
+  double build = seconds() - start;
+
+  ssize_t path = flat ? nand_evaluate(c.outputs, out, c.number_of_outputs) :
+                        nand_module_evaluate(modules[3], in, out);
+  assert(path >= 0);
+  start = seconds();
+  for (int r = 0; r < REPEATS; ++r)
+    assert((flat ? nand_evaluate(c.outputs, out, c.number_of_outputs) :
+                   nand_module_evaluate(modules[3], in, out)) == path);
+  double evaluate = (seconds() - start) / REPEATS;
+  size_t peak = status_kb("VmHWM:");
+
+  printf("modules style=%s gates=%zu copies=%zu path=%zd build_ns_per_gate=%.2f "
+         "evaluate_ns_per_gate=%.2f bytes_per_gate=%.2f\n",
+         flat ? "flat" : "module", gates, copies, path, build * 1e9 / gates,
+         evaluate * 1e9 / gates, peak > rss ? (peak - rss) * 1024.0 / gates : 0.0);
+  fflush(stdout);
+  nand_pool_delete(c.pool);
+  free(c.gates);
+  free(c.outputs);
+  for (int i = 3; i >= 0; --i)
+    nand_module_delete(modules[i]);
+}
+
+// Compares a replicated design flattened into gates with the same design made of
+// instances of modules. Every style runs in a new process, like in suite.
+static void modules(size_t n) {
+  for (int flat = 1; flat >= 0; --flat) {
+    int status;
+    pid_t child = fork();
+    assert(child >= 0);
+
+    if (child == 0) {
+      module_style(flat, n);
+      _exit(0);
+    }
+    assert(waitpid(child, &status, 0) == child && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0);
+  }
+}
+
+// Reader thread of the readers benchmark: evaluates the gates in its own context.
+typedef struct {
+  nand_t **g;
+  size_t n;
+  bool *s;
+} bench_reader_t;
+
+static void *bench_reader(void *arg) {
+  bench_reader_t *r = arg;
+  nand_context_t *c = nand_context_new();
+  assert(c);
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate_in(c, r->g, r->s, r->n) >= 0);
+  nand_context_delete(c);
+  return NULL;
+}
+
+// Random system of n two-port gates evaluated at once by a growing number of
+// threads, each with its own context. Every thread evaluates all gates, so with
+// enough processors the time per gate should not grow with the number of threads.
+static void readers(size_t n) {
+  enum { MAX_READERS = 8 };
+  nand_t **g = malloc(n * sizeof *g);
+  bool *s = malloc(MAX_READERS * n * sizeof *s);
+  bool s_in = true;
+  assert(g && s && n > 1);
+
+  srand(1);
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(2);
+    assert(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i == 0 || rand() % 8 == 0)
+        assert(nand_connect_signal(&s_in, g[i], k) == 0);
+      else
+        assert(nand_connect_nand(g[i - 1 - rand() % (i < 1000 ? i : 1000)], g[i], k) == 0);
+    }
+  }
+
+  double start = seconds();
+  for (int i = 0; i < REPEATS; ++i)
+    assert(nand_evaluate(g, s, n) >= 0);
+  printf("readers gates=%zu threads=serial ns_per_gate=%.2f\n", n,
+         (seconds() - start) * 1e9 / REPEATS / n);
+
+  for (unsigned threads = 1; threads <= MAX_READERS; threads *= 2) {
+    pthread_t thread[MAX_READERS];
+    bench_reader_t reader[MAX_READERS];
+    start = seconds();
+    for (unsigned t = 0; t < threads; ++t) {
+      reader[t] = (bench_reader_t){g, n, s + t * n};
+      assert(pthread_create(thread + t, NULL, bench_reader, reader + t) == 0);
+    }
+    for (unsigned t = 0; t < threads; ++t)
+      assert(pthread_join(thread[t], NULL) == 0);
+    double seconds_per_query = (seconds() - start) / REPEATS / threads;
+    printf("readers gates=%zu threads=%u ns_per_gate=%.2f queries_per_second=%.1f\n", n,
+           threads, seconds_per_query * 1e9 / n, 1 / seconds_per_query);
+    for (unsigned t = 1; t < threads; ++t)
+      assert(memcmp(s, s + t * n, n * sizeof *s) == 0);
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(s);
+  free(g);
+}
+
+// Number of 64-bit words of input patterns in the faults benchmark.
+#define FAULT_PATTERN_WORDS 64
+
+// Stuck-at faults of all nodes of a multiplier of about n gates under random
+// patterns, simulated by a growing number of threads. The brute-force estimate is
+// the time of one evaluation of all patterns by nand_compiled_evaluate_lanes times
+// the number of faults, i.e. a full simulation of every faulty system.
+static void faults(size_t n) {
+  shape_t c = {0};
+  c.pool = nand_pool_new();
+  assert(c.pool);
+  shape_multiplier(&c, n);
+  nand_compiled_t *compiled = nand_compile(c.outputs, c.number_of_outputs);
+  assert(compiled);
+
+  size_t signals = nand_compiled_number_of_signals(compiled);
+  uint64_t *in = malloc(signals * FAULT_PATTERN_WORDS * sizeof *in);
+  uint64_t *out = malloc(c.number_of_outputs * FAULT_PATTERN_WORDS * sizeof *out);
+  assert(in && out);
+  srand(6);
+  for (size_t i = 0; i < signals * FAULT_PATTERN_WORDS; ++i)
+    in[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  double start = seconds();
+  assert(nand_compiled_evaluate_lanes(compiled, in, out, FAULT_PATTERN_WORDS) >= 0);
+  double lanes = seconds() - start;
+
+  nand_fault_t *list, *copy;
+  ssize_t n_faults = nand_fault_list(compiled, &list);
+  assert(n_faults > 0);
+  copy = malloc(n_faults * sizeof *copy);
+  assert(copy);
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  for (unsigned threads = 1; threads <= (online > 4 ? online : 4); threads *= 2) {
+    memcpy(copy, list, n_faults * sizeof *copy);
+    start = seconds();
+    ssize_t detected = nand_fault_simulate(compiled, in, FAULT_PATTERN_WORDS, copy, n_faults, threads);
+    double simulate = seconds() - start;
+    assert(detected >= 0);
+    printf("faults gates=%zu patterns=%d faults=%zd threads=%u coverage=%.4f simulate_s=%.3f "
+           "brute_force_estimate_s=%.3f\n", c.count, 64 * FAULT_PATTERN_WORDS, n_faults, threads,
+           (double)detected / n_faults, simulate, lanes * n_faults);
+    fflush(stdout);
+  }
+
+  free(copy);
+  free(list);
+  free(out);
+  free(in);
+  nand_compiled_delete(compiled);
+  nand_pool_delete(c.pool);
+  free(c.gates);
+  free(c.outputs);
+  free(c.signals);
+}
+
+// Proves a random redundant system of n gates equivalent to its copy optimized by
+// nand_optimize, then breaks the original by reconnecting one port of a gate near the
+// end and finds a counterexample.
+static void equivalence(size_t n) {
+  nand_pool_t *p = nand_pool_new(), *q = nand_pool_new();
+  nand_t **g = malloc(n * sizeof *g), **h = malloc(n * sizeof *h);
+  nand_t **g_out = malloc(n * sizeof *g_out), **h_out = malloc(n * sizeof *h_out);
+  bool s_in[REDUNDANT_SIGNALS] = {false};
+  assert(p && q && g && h && g_out && h_out);
+  size_t m = redundant_system(p, g, g_out, s_in, n);
+  assert(redundant_system(q, h, h_out, s_in, n) == m);
+  assert(nand_optimize(h_out, m) >= 0);
+
+  nand_counterexample_t x;
+  double start = seconds();
+  assert(nand_equivalent(g_out, h_out, m, 0, &x) == 1);
+  double equal = seconds() - start;
+
+  // The last gate with two ports reads a signal instead of its first input.
+  size_t i = n - 1;
+  while (nand_input(g[i], 1) == NULL)
+    --i;
+  void *input = nand_input(g[i], 0);
+  assert(nand_connect_signal((bool *)input == s_in ? s_in + 1 : s_in, g[i], 0) == 0);
+  start = seconds();
+  int result = nand_equivalent(g_out, h_out, m, 0, &x);
+  double different = seconds() - start;
+  assert(result >= 0);
+  if (result == 0) {
+    free(x.signals);
+    free(x.values);
+  }
+
+  printf("equivalence gates=%zu outputs=%zu signals=%d equal_s=%.3f broken_equal=%d "
+         "broken_s=%.3f\n", n, m, REDUNDANT_SIGNALS, equal, result, different);
+  nand_pool_delete(p);
+  nand_pool_delete(q);
+  free(g);
+  free(h);
+  free(g_out);
+  free(h_out);
+}
+
+// Sequential system of about n gates: a shift register with feedback of w bits
+// adds its state every cycle to an accumulator of w bits (full adders of 9 NAND
+// gates), so w is about n / 11. It runs with nand_step in one call and in calls
+// of one cycle, and the accumulator is compared with a software model.
+static void step(size_t n) {
+  size_t w = n > 26 ? (n - 4) / 11 : 2;
+  shape_t c = {.pool = nand_pool_new()};
+  nand_t **flops = malloc(2 * w * sizeof *flops);
+  bool *shift = malloc(w), *sum = malloc(w);
+  assert(c.pool && flops && shift && sum);
+
+  // flops[0 .. w - 1] is the shift register, starting from 1, and the rest is the
+  // accumulator, starting from 0.
+  for (size_t i = 0; i < 2 * w; ++i) {
+    flops[i] = nand_new_kind(c.pool, NAND_KIND_DFF, 1, i == 0);
+    assert(flops[i]);
+  }
+  node_t a = {flops[w - 1], NULL}, b = {flops[w - 2], NULL};
+  node_t t = nand2(&c, a, b);
+  node_t feedback = nand2(&c, nand2(&c, a, t), nand2(&c, b, t));
+  shape_connect(feedback, flops[0], 0);
+  for (size_t i = 1; i < w; ++i)
+    shape_connect((node_t){flops[i - 1], NULL}, flops[i], 0);
+  node_t carry = {shape_gate(&c, 0), NULL};
+  for (size_t i = 0; i < w; ++i)
+    shape_connect(full_adder(&c, (node_t){flops[i], NULL}, (node_t){flops[w + i], NULL}, &carry),
+                  flops[w + i], 0);
+
+  double start = seconds();
+  nand_compiled_t *compiled = nand_compile(flops, 2 * w);
+  double compile = seconds() - start;
+  assert(compiled);
+
+  // The first call gives the number of cycles of about half a second.
+  start = seconds();
+  assert(nand_step(compiled, 1000) == 0);
+  size_t cycles = (size_t)(0.5 / ((seconds() - start) / 1000)) + 1;
+  start = seconds();
+  assert(nand_step(compiled, cycles) == 0);
+  double many = seconds() - start;
+  size_t single_cycles = cycles / 10 + 1;
+  start = seconds();
+  for (size_t i = 0; i < single_cycles; ++i)
+    assert(nand_step(compiled, 1) == 0);
+  double single = seconds() - start;
+
+  size_t total = 1000 + cycles + single_cycles;
+  memset(shift, 0, w);
+  memset(sum, 0, w);
+  shift[0] = true;
+  for (size_t cycle = 0; cycle < total; ++cycle) {
+    bool in = shift[w - 1] ^ shift[w - 2], x = false;
+    for (size_t i = 0; i < w; ++i) {
+      bool y = sum[i] ^ shift[i] ^ x;
+      x = (sum[i] & shift[i]) | (x & (sum[i] ^ shift[i]));
+      sum[i] = y;
+    }
+    memmove(shift + 1, shift, w - 1);
+    shift[0] = in;
+  }
+  bool *state = malloc(2 * w);
+  assert(state && nand_compiled_evaluate(compiled, state) >= 0);
+  assert(memcmp(state, shift, w) == 0 && memcmp(state + w, sum, w) == 0);
+
+  printf("step gates=%zu flip_flops=%zu compile_ms=%.3f cycles=%zu cycles_per_s=%.0f "
+         "ns_per_gate_cycle=%.3f single_cycles_per_s=%.0f\n", c.count, 2 * w, compile * 1e3,
+         cycles, cycles / many, many * 1e9 / cycles / c.count, single_cycles / single);
+  nand_compiled_delete(compiled);
+  nand_pool_delete(c.pool);
+  free(c.gates);
+  free(flops);
+  free(shift);
+  free(sum);
+  free(state);
+}
+
+typedef struct {
+  char const *name;
+  void (*function)(size_t);
+} bench_list_t;
+
+#define BENCH(b) {#b, b}
+
+static const bench_list_t bench_list[] = {
+  BENCH(deep),
+  BENCH(wide),
+  BENCH(build),
+  BENCH(bulk),
+  BENCH(circuit),
+  BENCH(parallel),
+  BENCH(toggle),
+  BENCH(checked),
+  BENCH(depth),
+  BENCH(file),
+  BENCH(import),
+  BENCH(optimize),
+  BENCH(suite),
+  BENCH(jit),
+  BENCH(kinds),
+  BENCH(modules),
+  BENCH(readers),
+  BENCH(faults),
+  BENCH(equivalence),
+  BENCH(step),
+};
+
+int main(int argc, char *argv[]) {
+  size_t gates = argc == 3 ? strtoull(argv[2], NULL, 10) : DEFAULT_GATES;
+
+  if (argc == 2 || argc == 3)
+    for (size_t i = 0; i < sizeof bench_list / sizeof bench_list[0]; ++i)
+      if (strcmp(argv[1], bench_list[i].name) == 0) {
+        bench_list[i].function(gates);
+        return 0;
+      }
+
+  fprintf(stderr, "Usage:\n%s benchmark_name [number_of_gates]\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,448 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the circuit.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uint32_t, uint64_t, uintptr_t.
+#include <stdlib.h> // For calloc, realloc, free.
+#include <string.h> // For memset.
+
+// Number of gates and number of ports are kept below these limits, so that a
+// tagged port and a global port number fit in 32 bits.
+#define MAX_GATES ((size_t)1 << 31)
+#define MAX_PORTS ((size_t)UINT32_MAX)
+
+// Operations on the bit arrays of a circuit.
+static inline bool get_bit(uint64_t const* bits, uint32_t i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void set_bit(uint64_t* bits, uint32_t i, bool value) {
+    uint64_t mask = (uint64_t)1 << (i & 63);
+    bits[i >> 6] = value ? bits[i >> 6] | mask : bits[i >> 6] & ~mask;
+}
+
+// Hash function for addresses of the signals.
+static size_t signal_hash(const bool* s) {
+    uintptr_t x = (uintptr_t)s;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    x ^= x >> 29;
+    return (size_t)x;
+}
+
+// Returns the slot of signal s in the table of the circuit (free slot if s is not there).
+static size_t signal_slot(nand_circuit_t const* c, const bool* s) {
+    size_t mask = c->signal_numbers.capacity - 1;
+    size_t i = signal_hash(s) & mask;
+
+    while (c->signal_numbers.addresses[i] && c->signal_numbers.addresses[i] != s) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**@brief Returns the number of signal s, giving it the next number if it has no
+ * number yet. Returns -1 if there is no memory.
+ */
+static ssize_t number_signal(nand_circuit_t* c, const bool* s) {
+    if (2 * (c->signal_numbers.count + 1) > c->signal_numbers.capacity) {
+        size_t new_capacity = c->signal_numbers.capacity ? 2 * c->signal_numbers.capacity : 64;
+        const bool** new_addresses = (const bool**)calloc(new_capacity, sizeof(const bool*));
+        uint32_t* new_numbers = (uint32_t*)malloc(new_capacity * sizeof(uint32_t));
+        const bool** new_signals = (const bool**)realloc(c->signals,
+                                                         new_capacity / 2 * sizeof(const bool*));
+
+        if (new_signals) {
+            c->signals = new_signals;
+        }
+        if (!new_addresses || !new_numbers || !new_signals) {
+            free(new_addresses);
+            free(new_numbers);
+            return -1;
+        }
+
+        size_t mask = new_capacity - 1;
+
+        for (size_t i = 0; i < c->signal_numbers.capacity; i++) {
+            const bool* address = c->signal_numbers.addresses[i];
+
+            if (address) {
+                size_t j = signal_hash(address) & mask;
+
+                while (new_addresses[j]) {
+                    j = (j + 1) & mask;
+                }
+
+                new_addresses[j] = address;
+                new_numbers[j] = c->signal_numbers.numbers[i];
+            }
+        }
+
+        free(c->signal_numbers.addresses);
+        free(c->signal_numbers.numbers);
+        c->signal_numbers.addresses = new_addresses;
+        c->signal_numbers.numbers = new_numbers;
+        c->signal_numbers.capacity = new_capacity;
+    }
+
+    size_t i = signal_slot(c, s);
+
+    if (!c->signal_numbers.addresses[i]) {
+        if (c->signal_numbers.count + 1 >= MAX_GATES) {
+            return -1;
+        }
+
+        c->signal_numbers.addresses[i] = s;
+        c->signal_numbers.numbers[i] = (uint32_t)c->signal_numbers.count;
+        c->signals[c->signal_numbers.count++] = s;
+    }
+
+    return c->signal_numbers.numbers[i];
+}
+
+nand_circuit_t* nand_circuit_new(void) {
+    nand_circuit_t* c = (nand_circuit_t*)calloc(1, sizeof(nand_circuit_t));
+
+    if (!c) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // Ports of the gate g end where ports of the next gate begin.
+    c->first_port = (uint32_t*)malloc(sizeof(uint32_t));
+
+    if (!c->first_port) {
+        free(c);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    c->first_port[0] = 0;
+    return c;
+}
+
+void nand_circuit_delete(nand_circuit_t *c) {
+    if (!c) {
+        return;
+    }
+
+    for (size_t g = 0; g < c->number_of_gates; g++) {
+        free(c->fan_out[g].cables);
+    }
+
+    free(c->first_port);
+    free(c->fan_out);
+    free(c->drivers);
+    free(c->cable_index);
+    free(c->signals);
+    free(c->signal_numbers.addresses);
+    free(c->signal_numbers.numbers);
+    free(c->visited);
+    free(c->updated);
+    free(c->values);
+    free(c->longest_path);
+    free(c->stack);
+    free(c->touched);
+    free(c);
+}
+
+// Reallocates *array to count elements of given size. Returns false if there is
+// no memory (*array stays valid).
+static bool grow(void* array, size_t count, size_t size) {
+    void* new_array = realloc(*(void**)array, count * size);
+
+    if (!new_array) {
+        return false;
+    }
+
+    *(void**)array = new_array;
+    return true;
+}
+
+// Doubles the length of the arrays of gates. Returns false if there is no memory.
+static bool grow_gates(nand_circuit_t* c) {
+    size_t new_capacity = c->capacity ? 2 * c->capacity : 64;
+    size_t words = new_capacity / 64;
+    size_t old_words = c->capacity / 64;
+
+    // Arrays which are already longer stay valid, so growing may be repeated.
+    if (!grow(&c->first_port, new_capacity + 1, sizeof(uint32_t)) ||
+        !grow(&c->fan_out, new_capacity, sizeof(circuit_fan_out_t)) ||
+        !grow(&c->visited, words, sizeof(uint64_t)) ||
+        !grow(&c->updated, words, sizeof(uint64_t)) ||
+        !grow(&c->values, words, sizeof(uint64_t)) ||
+        !grow(&c->longest_path, new_capacity, sizeof(uint32_t)) ||
+        !grow(&c->stack, new_capacity, sizeof(circuit_frame_t)) ||
+        !grow(&c->touched, new_capacity, sizeof(uint32_t))) {
+        return false;
+    }
+
+    memset(c->visited + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    memset(c->updated + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    memset(c->values + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    c->capacity = new_capacity;
+    return true;
+}
+
+ssize_t nand_circuit_add(nand_circuit_t *c, unsigned n) {
+    if (!c) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (c->number_of_gates + 1 >= MAX_GATES || n > MAX_PORTS - c->number_of_ports) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (c->number_of_gates == c->capacity && !grow_gates(c)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (c->number_of_ports + n > c->capacity_of_ports) {
+        size_t new_capacity = c->capacity_of_ports ? 2 * c->capacity_of_ports : 64;
+
+        while (new_capacity < c->number_of_ports + n) {
+            new_capacity *= 2;
+        }
+        if (!grow(&c->drivers, new_capacity, sizeof(uint32_t)) ||
+            !grow(&c->cable_index, new_capacity, sizeof(uint32_t))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        c->capacity_of_ports = new_capacity;
+    }
+
+    uint32_t g = (uint32_t)c->number_of_gates++;
+
+    for (unsigned k = 0; k < n; k++) {
+        c->drivers[c->number_of_ports + k] = EMPTY_PORT;
+    }
+
+    c->number_of_ports += n;
+    c->first_port[g + 1] = (uint32_t)c->number_of_ports;
+    c->fan_out[g].cables = NULL;
+    c->fan_out[g].number_of_cables = 0;
+    c->fan_out[g].length_of_cables_array = 0;
+    return g;
+}
+
+// Returns the global number of the port k of the gate g or EMPTY_PORT if there
+// is no such port.
+static uint32_t port_number(nand_circuit_t const* c, uint32_t g, unsigned k) {
+    if (g >= c->number_of_gates || k >= c->first_port[g + 1] - c->first_port[g]) {
+        return EMPTY_PORT;
+    }
+
+    return c->first_port[g] + k;
+}
+
+// Makes room for one more cable of the gate g. Returns false if there is no memory.
+static bool reserve_cable(nand_circuit_t* c, uint32_t g) {
+    circuit_fan_out_t* fan_out = c->fan_out + g;
+
+    if (fan_out->number_of_cables < fan_out->length_of_cables_array) {
+        return true;
+    }
+    if (fan_out->length_of_cables_array > UINT32_MAX / 2) {
+        return false;
+    }
+
+    uint32_t new_length = fan_out->length_of_cables_array ? 2 * fan_out->length_of_cables_array : 2;
+
+    if (!grow(&fan_out->cables, new_length, sizeof(uint32_t))) {
+        return false;
+    }
+
+    fan_out->length_of_cables_array = new_length;
+    return true;
+}
+
+// Disconnects the port p, removing its cable by putting the last cable in its place.
+static void detach_port(nand_circuit_t* c, uint32_t p) {
+    uint32_t driver = c->drivers[p];
+
+    if (driver != EMPTY_PORT && !(driver & SIGNAL_PORT)) {
+        circuit_fan_out_t* fan_out = c->fan_out + (driver >> 1);
+        uint32_t i = c->cable_index[p];
+        uint32_t last = --fan_out->number_of_cables;
+
+        if (i != last) {
+            fan_out->cables[i] = fan_out->cables[last];
+            c->cable_index[fan_out->cables[i]] = i;
+        }
+    }
+
+    c->drivers[p] = EMPTY_PORT;
+}
+
+int nand_circuit_connect_nand(nand_circuit_t *c, uint32_t g_out, uint32_t g_in, unsigned k) {
+    uint32_t p = c ? port_number(c, g_in, k) : EMPTY_PORT;
+
+    if (p == EMPTY_PORT || g_out >= c->number_of_gates) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Room for the new cable is made before the old one is removed, so that
+    // nothing changes if there is no memory.
+    if (!reserve_cable(c, g_out)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    circuit_fan_out_t* fan_out = c->fan_out + g_out;
+
+    detach_port(c, p);
+    c->drivers[p] = g_out << 1;
+    c->cable_index[p] = fan_out->number_of_cables;
+    fan_out->cables[fan_out->number_of_cables++] = p;
+    return 0;
+}
+
+int nand_circuit_connect_signal(nand_circuit_t *c, bool const *s, uint32_t g, unsigned k) {
+    uint32_t p = c ? port_number(c, g, k) : EMPTY_PORT;
+
+    if (p == EMPTY_PORT || !s) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t number = number_signal(c, s);
+
+    if (number < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    detach_port(c, p);
+    c->drivers[p] = ((uint32_t)number << 1) | SIGNAL_PORT;
+    return 0;
+}
+
+/**@brief Evaluates the gate g of the circuit and all unvisited gates "back" from it. It
+ * is the walkthrough of evaluate_gate in nand.c on the work stack of the circuit: the
+ * frame on the top of the stack processes ports of its gate from next_port until a port
+ * leads to an unvisited gate, which is put on the stack. The port is processed again
+ * when this gate is updated. Every visited gate is put on the list touched.
+ * @param c              - the circuit.
+ * @param g              - unvisited gate to evaluate.
+ * @param touched        - number of gates on the list touched, updated by the function.
+ * @param maximum_length - the longest path found so far, updated by the function.
+ * @return true if the system "back" from g is correct and false otherwise.
+ */
+static bool evaluate_circuit_gate(nand_circuit_t* c, uint32_t g, size_t* touched,
+                                  ssize_t* maximum_length) {
+    uint32_t const* first_port = c->first_port;
+    uint32_t const* drivers = c->drivers;
+    circuit_frame_t* stack = c->stack;
+    size_t top = 0;
+
+    set_bit(c->visited, g, true);
+    set_bit(c->values, g, false);
+    c->longest_path[g] = 0;
+    c->touched[(*touched)++] = g;
+    stack[top++] = (circuit_frame_t){g, first_port[g]};
+
+    while (top > 0) {
+        circuit_frame_t* frame = stack + top - 1;
+        uint32_t gate = frame->gate;
+        uint32_t p = frame->next_port;
+        uint32_t end = first_port[gate + 1];
+        uint32_t sharing_gate = 0;
+        bool any_false = get_bit(c->values, gate);
+        uint32_t longest_path = c->longest_path[gate];
+
+        for (; p < end; p++) {
+            uint32_t driver = drivers[p];
+
+            if (driver == EMPTY_PORT) { // Empty port - no connection.
+                return false;
+            }
+            if (driver & SIGNAL_PORT) { // Signal-nand connection.
+                any_false |= !*c->signals[driver >> 1];
+                longest_path = max(1, longest_path);
+                continue;
+            }
+
+            sharing_gate = driver >> 1;
+
+            if (get_bit(c->updated, sharing_gate)) { // Nand-nand connection to an updated gate.
+                any_false |= !get_bit(c->values, sharing_gate);
+                longest_path = max(c->longest_path[sharing_gate] + 1, longest_path);
+            }
+            else if (get_bit(c->visited, sharing_gate)) { // Cycle condition.
+                return false;
+            }
+            else { // Nand-nand connection to a new gate.
+                break;
+            }
+        }
+
+        frame->next_port = p;
+        set_bit(c->values, gate, any_false);
+        c->longest_path[gate] = longest_path;
+
+        if (p < end) { // Go to the new gate.
+            set_bit(c->visited, sharing_gate, true);
+            set_bit(c->values, sharing_gate, false);
+            c->longest_path[sharing_gate] = 0;
+            c->touched[(*touched)++] = sharing_gate;
+            stack[top++] = (circuit_frame_t){sharing_gate, first_port[sharing_gate]};
+            continue;
+        }
+
+        // All ports processed.
+        set_bit(c->updated, gate, true);
+        *maximum_length = max((ssize_t)longest_path, *maximum_length);
+        top--;
+    }
+
+    return true;
+}
+
+ssize_t nand_circuit_evaluate(nand_circuit_t *c, uint32_t const *g, bool *s, size_t m) {
+    if (!c || !g || !s || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t touched = 0;
+    ssize_t maximum_length = -1;
+    int error = 0;
+
+    for (size_t i = 0; i < m; i++) {
+        if (g[i] >= c->number_of_gates) {
+            error = EINVAL;
+            break;
+        }
+        if (!get_bit(c->visited, g[i]) &&
+            !evaluate_circuit_gate(c, g[i], &touched, &maximum_length)) {
+            error = ECANCELED;
+            break;
+        }
+
+        s[i] = get_bit(c->values, g[i]);
+    }
+
+    // Only the touched gates have technical variables to clear.
+    for (size_t i = 0; i < touched; i++) {
+        set_bit(c->visited, c->touched[i], false);
+        set_bit(c->updated, c->touched[i], false);
+    }
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return maximum_length;
+}
+
+ssize_t nand_circuit_fan_out(nand_circuit_t const *c, uint32_t g) {
+    if (!c || g >= c->number_of_gates) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return c->fan_out[g].number_of_cables;
+}
@@ -0,0 +1,579 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structures of logical gates.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uintptr_t.
+#include <stdlib.h> // For malloc, calloc.
+#include <string.h> // For memset.
+#include <sys/mman.h> // For munmap.
+
+/** @brief Hash table (with linear probing) numbering the boolean signals
+ * during the compilation.
+ * addresses - array of length capacity, NULL marks a free slot.
+ * numbers   - numbers of the signals kept in addresses.
+ * capacity  - a power of two.
+ * count     - number of occupied slots.
+ */
+typedef struct {
+    const bool** addresses;
+    uint32_t* numbers;
+    size_t capacity;
+    size_t count;
+} signal_numbers_t;
+
+// Hash function for addresses of the signals.
+static size_t signal_hash(const bool* s) {
+    uintptr_t x = (uintptr_t)s;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+    x ^= x >> 29;
+    return (size_t)x;
+}
+
+// Returns the slot of signal s in the table (free slot if s is not there).
+static size_t signal_slot(signal_numbers_t const* table, const bool* s) {
+    size_t mask = table->capacity - 1;
+    size_t i = signal_hash(s) & mask;
+
+    while (table->addresses[i] && table->addresses[i] != s) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+// Gives the next number to signal s if it has no number yet.
+// Returns false if there is no memory.
+static bool number_signal(signal_numbers_t* table, const bool* s) {
+    if (2 * (table->count + 1) > table->capacity) {
+        size_t new_capacity = table->capacity ? 2 * table->capacity : 64;
+        signal_numbers_t new_table = {
+            .addresses = (const bool**)calloc(new_capacity, sizeof(const bool*)),
+            .numbers = (uint32_t*)malloc(new_capacity * sizeof(uint32_t)),
+            .capacity = new_capacity,
+            .count = table->count,
+        };
+
+        if (!new_table.addresses || !new_table.numbers) {
+            free(new_table.addresses);
+            free(new_table.numbers);
+            return false;
+        }
+
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->addresses[i]) {
+                size_t j = signal_slot(&new_table, table->addresses[i]);
+                new_table.addresses[j] = table->addresses[i];
+                new_table.numbers[j] = table->numbers[i];
+            }
+        }
+
+        free(table->addresses);
+        free(table->numbers);
+        *table = new_table;
+    }
+
+    size_t i = signal_slot(table, s);
+
+    if (!table->addresses[i]) {
+        table->addresses[i] = s;
+        table->numbers[i] = (uint32_t)table->count++;
+    }
+
+    return true;
+}
+
+// Rounds the size of an array up, so that the next array in the block is aligned.
+static size_t aligned(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+nand_compiled_t* nand_allocate_compiled(size_t number_of_signals,
+                                        size_t number_of_gates,
+                                        size_t number_of_inputs,
+                                        size_t number_of_outputs) {
+    nand_compiled_t* c = (nand_compiled_t*)malloc(sizeof(nand_compiled_t));
+    size_t signals_size = aligned(number_of_signals * sizeof(const bool*));
+    size_t offsets_size = aligned((number_of_gates + 1) * sizeof(uint32_t));
+    size_t inputs_size = aligned(number_of_inputs * sizeof(uint32_t));
+    size_t levels_size = aligned(number_of_gates * sizeof(uint32_t));
+    size_t outputs_size = aligned(number_of_outputs * sizeof(uint32_t));
+    size_t values_size = aligned(number_of_signals + number_of_gates);
+    char* memory = (char*)malloc(signals_size + offsets_size + inputs_size +
+                                 levels_size + outputs_size + values_size);
+
+    if (!c || !memory) {
+        free(c);
+        free(memory);
+        return NULL;
+    }
+
+    c->number_of_signals = number_of_signals;
+    c->number_of_gates = number_of_gates;
+    c->number_of_outputs = number_of_outputs;
+    c->memory = memory;
+    c->signals = (const bool**)memory;
+    memory += signals_size;
+    c->input_offsets = (uint32_t*)memory;
+    memory += offsets_size;
+    c->inputs = (uint32_t*)memory;
+    memory += inputs_size;
+    c->levels = (uint32_t*)memory;
+    memory += levels_size;
+    c->outputs = (uint32_t*)memory;
+    memory += outputs_size;
+    c->values = (uint8_t*)memory;
+    c->longest_path = 0;
+    c->mapping = NULL;
+    c->mapping_size = 0;
+    c->lane_values = NULL;
+    c->lane_memory = NULL;
+    c->registers = NULL;
+    c->number_of_registers = 0;
+    c->step = NULL;
+    return c;
+}
+
+// Bit marking the references to signals among the references to cells.
+#define SIGNAL_BIT ((uint32_t)1 << 31)
+
+// Reference given instead of a cell if there is no memory.
+#define NO_CELL UINT32_MAX
+
+// Cell of a constant which is not made yet.
+#define NO_CONSTANT (UINT32_MAX - 1)
+
+/** @brief NAND cells of the compiled system, made of the gates in topological order.
+ * A NAND gate is one cell, gates of other kinds are lowered into several cells.
+ * Inputs of the cells are references: numbers of signals with SIGNAL_BIT or numbers
+ * of earlier cells, so the cells are in topological order too.
+ * offsets - the inputs of the cell i are inputs[offsets[i]], ..., inputs[offsets[i + 1] - 1].
+ * levels  - longest paths of the cells.
+ */
+typedef struct {
+    uint32_t* offsets;
+    uint32_t* inputs;
+    uint32_t* levels;
+    size_t count;
+    size_t capacity;
+    size_t number_of_inputs;
+    size_t capacity_of_inputs;
+} cells_t;
+
+// Makes room for the given numbers of cells and inputs. Returns false if there is no memory.
+static bool reserve_cells(cells_t* cells, size_t count, size_t number_of_inputs) {
+    if (cells->count + count > cells->capacity) {
+        size_t new_capacity = max(2 * cells->capacity, cells->count + count);
+        uint32_t* new_offsets = (uint32_t*)realloc(cells->offsets, (new_capacity + 1) * sizeof(uint32_t));
+
+        if (!new_offsets) {
+            return false;
+        }
+
+        cells->offsets = new_offsets;
+
+        uint32_t* new_levels = (uint32_t*)realloc(cells->levels, new_capacity * sizeof(uint32_t));
+
+        if (!new_levels) {
+            return false;
+        }
+
+        cells->levels = new_levels;
+        cells->capacity = new_capacity;
+    }
+    if (cells->number_of_inputs + number_of_inputs > cells->capacity_of_inputs) {
+        size_t new_capacity = max(2 * cells->capacity_of_inputs,
+                                  cells->number_of_inputs + number_of_inputs);
+        uint32_t* new_inputs = (uint32_t*)realloc(cells->inputs, new_capacity * sizeof(uint32_t));
+
+        if (!new_inputs) {
+            return false;
+        }
+
+        cells->inputs = new_inputs;
+        cells->capacity_of_inputs = new_capacity;
+    }
+
+    return true;
+}
+
+// Adds the cell with n inputs and returns its reference, or NO_CELL if some input
+// is NO_CELL or there is no memory.
+static uint32_t add_cell(cells_t* cells, uint32_t const* inputs, unsigned int n) {
+    if (cells->count >= SIGNAL_BIT - 2 || !reserve_cells(cells, 1, n)) {
+        return NO_CELL;
+    }
+
+    uint32_t level = 0;
+
+    for (unsigned int k = 0; k < n; k++) {
+        if (inputs[k] == NO_CELL) {
+            return NO_CELL;
+        }
+
+        level = max(inputs[k] & SIGNAL_BIT ? 1 : cells->levels[inputs[k]] + 1, level);
+        cells->inputs[cells->number_of_inputs + k] = inputs[k];
+    }
+
+    cells->offsets[cells->count] = (uint32_t)cells->number_of_inputs;
+    cells->levels[cells->count] = level;
+    cells->number_of_inputs += n;
+    return (uint32_t)cells->count++;
+}
+
+static uint32_t nand1(cells_t* cells, uint32_t a) {
+    return add_cell(cells, &a, 1);
+}
+
+static uint32_t nand2(cells_t* cells, uint32_t a, uint32_t b) {
+    uint32_t inputs[2] = {a, b};
+    return add_cell(cells, inputs, 2);
+}
+
+static uint32_t xor2(cells_t* cells, uint32_t a, uint32_t b) {
+    uint32_t t = nand2(cells, a, b);
+    return nand2(cells, nand2(cells, a, t), nand2(cells, b, t));
+}
+
+// Returns s ? b : a.
+static uint32_t mux(cells_t* cells, uint32_t s, uint32_t a, uint32_t b) {
+    return nand2(cells, nand2(cells, nand1(cells, s), a), nand2(cells, s, b));
+}
+
+// Returns the cell of the constant value, made once for a gate. A cell without
+// inputs is false.
+static uint32_t constant(cells_t* cells, bool value, uint32_t* constants) {
+    if (constants[value] == NO_CONSTANT) {
+        constants[value] = value ? nand1(cells, constant(cells, false, constants)) :
+                                   add_cell(cells, NULL, 0);
+    }
+
+    return constants[value];
+}
+
+/**@brief Lowers the function with the given table of the variables vars[0], ...,
+ * vars[m - 1] by Shannon expansion on the last variable. Halves of the table which
+ * are equal, or constant, need no multiplexer.
+ */
+static uint32_t lut(cells_t* cells, uint64_t table, uint32_t const* vars, unsigned int m,
+                    uint32_t* constants) {
+    if (m == 0) {
+        return constant(cells, table & 1, constants);
+    }
+
+    unsigned int size = 1u << (m - 1);
+    uint64_t mask = ((uint64_t)1 << size) - 1;
+    uint64_t low = table & mask;
+    uint64_t high = table >> size & mask;
+    uint32_t v = vars[m - 1];
+
+    if (low == high) {
+        return lut(cells, low, vars, m - 1, constants);
+    }
+    if (low == 0 && high == mask) {
+        return v;
+    }
+    if (low == mask && high == 0) {
+        return nand1(cells, v);
+    }
+
+    return mux(cells, v, lut(cells, low, vars, m - 1, constants),
+               lut(cells, high, vars, m - 1, constants));
+}
+
+/**@brief Adds the cells of g, whose ports are connected to the references refs,
+ * and returns the reference of the cell giving the value of g, or NO_CELL if there
+ * is no memory. This cell is always a new one, so that every gate has its own node.
+ */
+static uint32_t lower_gate(cells_t* cells, nand_t const* g, uint32_t* refs) {
+    size_t first = cells->count;
+    unsigned int n = g->number_of_ports;
+    uint32_t result;
+
+    switch (g->kind) {
+        case NAND_KIND_NAND:
+            return add_cell(cells, refs, n);
+        case NAND_KIND_AND:
+            return nand1(cells, add_cell(cells, refs, n));
+        case NAND_KIND_OR:
+            // Negations of the inputs overwrite the references.
+            for (unsigned int k = 0; k < n; k++) {
+                refs[k] = nand1(cells, refs[k]);
+            }
+
+            return add_cell(cells, refs, n);
+        case NAND_KIND_XOR:
+            result = n > 0 ? refs[0] : add_cell(cells, NULL, 0);
+
+            for (unsigned int k = 1; k < n; k++) {
+                result = xor2(cells, result, refs[k]);
+            }
+            break;
+        case NAND_KIND_MUX:
+            return mux(cells, refs[0], refs[1], refs[2]);
+        default: {
+            uint32_t constants[2] = {NO_CONSTANT, NO_CONSTANT};
+            uint64_t table = *lut_table(g);
+
+            if (n < LUT_PORTS) {
+                table &= ((uint64_t)1 << (1u << n)) - 1;
+            }
+
+            result = lut(cells, table, refs, n, constants);
+            break;
+        }
+    }
+
+    // Signals and cells of other gates are copied by two negations.
+    if (result != NO_CELL && (result & SIGNAL_BIT || result < first)) {
+        result = nand1(cells, nand1(cells, result));
+    }
+
+    return result;
+}
+
+// Returns the node of the compiled system referred to by ref.
+static uint32_t node_of(uint32_t ref, uint32_t number_of_signals, uint32_t const* positions) {
+    return ref & SIGNAL_BIT ? ref & ~SIGNAL_BIT : number_of_signals + positions[ref];
+}
+
+// Gives a number to the signal s, if it has none, and returns its reference, or
+// NO_CELL if there is no memory.
+static uint32_t signal_ref(signal_numbers_t* table, const bool* s) {
+    if (!number_signal(table, s)) {
+        return NO_CELL;
+    }
+
+    return SIGNAL_BIT | table->numbers[signal_slot(table, s)];
+}
+
+nand_compiled_t* nand_compile(nand_t **g, size_t m) {
+    if (!g || m == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nand_t** order = NULL;
+    ssize_t listed = nand_topological_order(g, m, &order);
+
+    if (listed < 0) {
+        return NULL;
+    }
+
+    size_t number_of_gates = (size_t)listed;
+    size_t number_of_registers = 0;
+    size_t number_of_ports = 0;
+    unsigned int max_ports = 0;
+    signal_numbers_t signal_numbers = {NULL, NULL, 0, 0};
+    cells_t cells = {NULL, NULL, NULL, 0, 0, 0, 0};
+    uint32_t* results = (uint32_t*)malloc(number_of_gates * sizeof(uint32_t));
+    uint32_t* refs = NULL;
+    uint32_t* positions = NULL;
+    uint32_t* first_of_level = NULL;
+    nand_compiled_t* c = NULL;
+    int error = ENOMEM;
+
+    for (size_t i = 0; i < number_of_gates; i++) {
+        number_of_ports += order[i]->number_of_ports;
+        max_ports = max(order[i]->number_of_ports, max_ports);
+    }
+
+    // A system of NAND gates has exactly one cell for every gate.
+    refs = (uint32_t*)malloc(max(max_ports, 1) * sizeof(uint32_t));
+
+    if (!results || !refs || !reserve_cells(&cells, number_of_gates, number_of_ports)) {
+        goto cleanup;
+    }
+
+    // Cells and numbers of signals, in topological order.
+    for (size_t i = 0; i < number_of_gates; i++) {
+        nand_t* gate = order[i];
+
+        // A flip-flop is the signal of its state. A signal on its port is
+        // numbered here, gates on its port come later in the order.
+        if (gate->kind == NAND_KIND_DFF) {
+            results[i] = signal_ref(&signal_numbers, flip_flop_state(gate));
+            number_of_registers++;
+
+            if (results[i] == NO_CELL || (gate->ports->direct_signal &&
+                signal_ref(&signal_numbers, gate->ports->direct_signal) == NO_CELL)) {
+                goto cleanup;
+            }
+
+            continue;
+        }
+
+        for (unsigned int k = 0; k < gate->number_of_ports; k++) {
+            port_t* port = gate->ports + k;
+
+            if (port->direct_signal) {
+                refs[k] = signal_ref(&signal_numbers, port->direct_signal);
+
+                if (refs[k] == NO_CELL) {
+                    goto cleanup;
+                }
+            }
+            else {
+                refs[k] = results[port->sharing_gate->index];
+            }
+        }
+
+        results[i] = lower_gate(&cells, gate, refs);
+
+        if (results[i] == NO_CELL) {
+            error = cells.count >= SIGNAL_BIT - 2 ? EOVERFLOW : ENOMEM;
+            goto cleanup;
+        }
+    }
+
+    size_t number_of_cells = cells.count;
+
+    cells.offsets[number_of_cells] = (uint32_t)cells.number_of_inputs;
+
+    if (signal_numbers.count + number_of_cells > UINT32_MAX || cells.number_of_inputs > UINT32_MAX) {
+        error = EOVERFLOW;
+        goto cleanup;
+    }
+
+    positions = (uint32_t*)malloc(number_of_cells * sizeof(uint32_t));
+    first_of_level = (uint32_t*)calloc(number_of_cells + 2, sizeof(uint32_t));
+    c = nand_allocate_compiled(signal_numbers.count, number_of_cells, cells.number_of_inputs, m);
+
+    if (!positions || !first_of_level || !c) {
+        goto cleanup;
+    }
+    if (number_of_registers > 0) {
+        c->registers = (compiled_register_t*)malloc(number_of_registers *
+                                                    sizeof(compiled_register_t));
+
+        if (!c->registers) {
+            goto cleanup;
+        }
+    }
+
+    // Counting sort by levels.
+    for (size_t i = 0; i < number_of_cells; i++) {
+        first_of_level[cells.levels[i] + 1]++;
+    }
+    for (size_t level = 1; level <= number_of_cells; level++) {
+        first_of_level[level] += first_of_level[level - 1];
+    }
+    for (size_t i = 0; i < number_of_cells; i++) {
+        positions[i] = first_of_level[cells.levels[i]]++;
+    }
+    for (size_t i = 0; i < signal_numbers.capacity; i++) {
+        if (signal_numbers.addresses[i]) {
+            c->signals[signal_numbers.numbers[i]] = signal_numbers.addresses[i];
+        }
+    }
+
+    // Inputs of the cells, written directly on their positions. Number of
+    // inputs of the cells before every position are summed afterwards.
+    uint32_t number_of_signals = (uint32_t)c->number_of_signals;
+
+    memset(c->input_offsets, 0, (number_of_cells + 1) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < number_of_cells; i++) {
+        c->input_offsets[positions[i] + 1] = cells.offsets[i + 1] - cells.offsets[i];
+        c->levels[positions[i]] = cells.levels[i];
+        c->longest_path = max((ssize_t)cells.levels[i], c->longest_path);
+    }
+    for (size_t i = 0; i < number_of_cells; i++) {
+        c->input_offsets[i + 1] += c->input_offsets[i];
+    }
+    for (size_t i = 0; i < number_of_cells; i++) {
+        uint32_t* inputs = c->inputs + c->input_offsets[positions[i]];
+
+        for (uint32_t k = cells.offsets[i]; k < cells.offsets[i + 1]; k++) {
+            *inputs++ = node_of(cells.inputs[k], number_of_signals, positions);
+        }
+    }
+    for (size_t i = 0; i < m; i++) {
+        c->outputs[i] = node_of(results[g[i]->index], number_of_signals, positions);
+    }
+    for (size_t i = 0; c->number_of_registers < number_of_registers; i++) {
+        nand_t* gate = order[i];
+
+        if (gate->kind == NAND_KIND_DFF) {
+            port_t* port = gate->ports;
+            uint32_t input = port->direct_signal ? SIGNAL_BIT |
+                signal_numbers.numbers[signal_slot(&signal_numbers, port->direct_signal)] :
+                results[port->sharing_gate->index];
+
+            c->registers[c->number_of_registers++] = (compiled_register_t){
+                gate, node_of(results[i], number_of_signals, positions),
+                node_of(input, number_of_signals, positions)};
+        }
+    }
+
+    error = 0;
+
+cleanup:
+    free(order);
+    free(results);
+    free(refs);
+    free(positions);
+    free(first_of_level);
+    free(cells.offsets);
+    free(cells.inputs);
+    free(cells.levels);
+    free(signal_numbers.addresses);
+    free(signal_numbers.numbers);
+
+    if (error) {
+        nand_compiled_delete(c);
+        errno = error;
+        return NULL;
+    }
+
+    return c;
+}
+
+void nand_compiled_delete(nand_compiled_t *c) {
+    if (!c) {
+        return;
+    }
+
+    if (c->mapping) {
+        munmap(c->mapping, c->mapping_size);
+    }
+
+    free(c->memory);
+    free(c->lane_memory);
+    free(c->registers);
+    free(c->step);
+    free(c);
+}
+
+ssize_t nand_compiled_evaluate(nand_compiled_t *c, bool *s) {
+    if (!c || !s) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint8_t* values = c->values;
+    uint8_t* gate_values = values + c->number_of_signals;
+    uint32_t const* input_offsets = c->input_offsets;
+    uint32_t const* inputs = c->inputs;
+
+    for (size_t i = 0; i < c->number_of_signals; i++) {
+        values[i] = *c->signals[i];
+    }
+
+    // Single pass in the order of levels. Gate outputs false
+    // only if all its inputs are true.
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        uint8_t all_true = 1;
+
+        for (uint32_t k = input_offsets[i]; k < input_offsets[i + 1]; k++) {
+            all_true &= values[inputs[k]];
+        }
+
+        gate_values[i] = all_true ^ 1;
+    }
+
+    for (size_t i = 0; i < c->number_of_outputs; i++) {
+        s[i] = values[c->outputs[i]];
+    }
+
+    return c->longest_path;
+}
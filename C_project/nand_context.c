@@ -0,0 +1,367 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structures of logical gates.
+#include <errno.h> // For errno and its values.
+#include <sched.h> // For sched_yield.
+#include <stdint.h> // For uint32_t, uint64_t, uintptr_t.
+#include <stdlib.h> // For calloc, realloc, free.
+#include <string.h> // For memset.
+
+// Size of a cache line, the flag of a reader lies alone in its line.
+#define CACHE_LINE 64
+
+/**@brief State of a gate in one evaluation of a context.
+ * gate         - the gate, NULL for a free slot.
+ * generation   - evaluation of the context which wrote the slot. Slots of earlier
+ *                evaluations are free.
+ * updated      - true if value and longest_path are computed, false if the gate
+ *                is on the work stack.
+ * value        - output of the gate.
+ * longest_path - my_longest_path of the gate.
+ */
+typedef struct {
+    nand_t const* gate;
+    uint32_t generation;
+    bool updated;
+    bool value;
+    ssize_t longest_path;
+} context_entry_t;
+
+/**@brief Frame of the walkthrough of a context: the gate, its slot, its first port
+ * which was not processed yet and what is known from the processed ports (the number
+ * of ports which are true, the values of the first 64 ports and the longest path).
+ */
+typedef struct {
+    nand_t const* gate;
+    context_entry_t* entry;
+    unsigned int next_port;
+    unsigned int count;
+    uint64_t bits;
+    ssize_t longest_path;
+} context_frame_t;
+
+/**@brief Evaluation context owned by one thread at a time. The technical variables
+ * which nand_evaluate keeps in the gates are kept here, so any number of contexts
+ * evaluate the same gates at once without writing to them.
+ * active            - true while the context evaluates, read by writers. It lies in
+ *                     its own cache line, so readers never write to a shared line.
+ * entries           - hash table (with linear probing) of the states of the gates,
+ *                     capacity is a power of two. count is the number of slots of the
+ *                     current generation.
+ * stack             - work stack of the walkthrough.
+ * previous, next    - neighbours on the list of all contexts.
+ */
+struct nand_context {
+    char padding_before[CACHE_LINE];
+    bool active;
+    char padding_after[CACHE_LINE - 1];
+    context_entry_t* entries;
+    size_t capacity;
+    size_t count;
+    uint32_t generation;
+    context_frame_t* stack;
+    size_t capacity_of_stack;
+    struct nand_context* previous;
+    struct nand_context* next;
+};
+
+// List of all contexts, changed only by the writer.
+static nand_context_t* contexts = NULL;
+
+// True while some thread is the writer.
+static bool writer = false;
+
+// Number of nested nand_write_lock calls of this thread. The initial-exec model saves
+// a call of __tls_get_addr in every change of the system.
+static __thread unsigned int write_depth __attribute__((tls_model("initial-exec"))) = 0;
+
+void nand_write_lock(void) {
+    if (write_depth++ > 0) {
+        return;
+    }
+
+    while (__atomic_exchange_n(&writer, true, __ATOMIC_SEQ_CST)) {
+        sched_yield();
+    }
+
+    // New readers see the flag and wait, the ones which came earlier are waited for.
+    for (nand_context_t* c = contexts; c; c = c->next) {
+        while (__atomic_load_n(&c->active, __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+}
+
+void nand_write_unlock(void) {
+    if (--write_depth == 0) {
+        __atomic_store_n(&writer, false, __ATOMIC_RELEASE);
+    }
+}
+
+// Makes c a reader: waits until there is no writer, then marks c active.
+static void read_lock(nand_context_t* c) {
+    for (;;) {
+        __atomic_store_n(&c->active, true, __ATOMIC_SEQ_CST);
+
+        if (!__atomic_load_n(&writer, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+
+        __atomic_store_n(&c->active, false, __ATOMIC_RELEASE);
+
+        while (__atomic_load_n(&writer, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+}
+
+static void read_unlock(nand_context_t* c) {
+    __atomic_store_n(&c->active, false, __ATOMIC_RELEASE);
+}
+
+nand_context_t* nand_context_new(void) {
+    nand_context_t* c = (nand_context_t*)calloc(1, sizeof(nand_context_t));
+
+    if (!c) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    nand_write_lock();
+    c->next = contexts;
+
+    if (contexts) {
+        contexts->previous = c;
+    }
+
+    contexts = c;
+    nand_write_unlock();
+    return c;
+}
+
+void nand_context_delete(nand_context_t *c) {
+    if (!c) {
+        return;
+    }
+
+    nand_write_lock();
+
+    if (c->previous) {
+        c->previous->next = c->next;
+    }
+    else {
+        contexts = c->next;
+    }
+    if (c->next) {
+        c->next->previous = c->previous;
+    }
+
+    nand_write_unlock();
+    free(c->entries);
+    free(c->stack);
+    free(c);
+}
+
+// Hash function for addresses of the gates.
+static size_t gate_hash(nand_t const* g) {
+    uint64_t x = (uint64_t)(uintptr_t)g;
+    x ^= x >> 29;
+    x *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(x >> 32);
+}
+
+// Returns the slot of g in the table of c (a free slot if g is not there).
+static context_entry_t* find_entry(nand_context_t const* c, nand_t const* g) {
+    size_t mask = c->capacity - 1;
+    size_t i = gate_hash(g) & mask;
+
+    while (c->entries[i].generation == c->generation && c->entries[i].gate != g) {
+        i = (i + 1) & mask;
+    }
+
+    return c->entries + i;
+}
+
+// Doubles the table of c, keeping the slots of the current generation and moving
+// the slots of the top frames of the work stack. Returns false if there is no memory.
+static bool grow_entries(nand_context_t* c, size_t top) {
+    size_t old_capacity = c->capacity;
+    context_entry_t* old_entries = c->entries;
+    size_t new_capacity = old_capacity ? 2 * old_capacity : 1024;
+    context_entry_t* new_entries = (context_entry_t*)calloc(new_capacity, sizeof(context_entry_t));
+
+    if (!new_entries) {
+        return false;
+    }
+
+    // Slots of the new table are of the generation 0, which is never the current one.
+    c->entries = new_entries;
+    c->capacity = new_capacity;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].generation == c->generation) {
+            *find_entry(c, old_entries[i].gate) = old_entries[i];
+        }
+    }
+
+    for (size_t i = 0; i < top; i++) {
+        c->stack[i].entry = find_entry(c, c->stack[i].gate);
+    }
+
+    free(old_entries);
+    return true;
+}
+
+// Puts g on the work stack of c as a visited gate. Returns false if there is no memory.
+static bool push_gate(nand_context_t* c, nand_t const* g, size_t* top) {
+    if (2 * (c->count + 1) > c->capacity && !grow_entries(c, *top)) {
+        return false;
+    }
+    if (*top == c->capacity_of_stack) {
+        size_t new_capacity = c->capacity_of_stack ? 2 * c->capacity_of_stack : 256;
+        context_frame_t* new_stack = (context_frame_t*)realloc(c->stack,
+                                                               new_capacity * sizeof(context_frame_t));
+
+        if (!new_stack) {
+            return false;
+        }
+
+        c->stack = new_stack;
+        c->capacity_of_stack = new_capacity;
+    }
+
+    context_entry_t* entry = find_entry(c, g);
+
+    entry->gate = g;
+    entry->generation = c->generation;
+    entry->updated = false;
+    c->count++;
+    c->stack[(*top)++] = (context_frame_t){g, entry, 0, 0, 0, 0};
+    return true;
+}
+
+/**@brief Evaluates g, which has no slot yet, and all gates "back" from it which have
+ * none. It is the walkthrough of evaluate_gate in nand.c with the technical variables
+ * in the frames and in the table of c, so the gates are only read.
+ * @return 0, or ECANCELED (cycle or empty port) or ENOMEM.
+ */
+static int evaluate_in(nand_context_t* c, nand_t const* g, ssize_t* maximum_length) {
+    size_t top = 0;
+
+    if (!push_gate(c, g, &top)) {
+        return ENOMEM;
+    }
+
+    while (top > 0) {
+        context_frame_t* frame = c->stack + top - 1;
+        nand_t const* gate = frame->gate;
+        nand_t const* sharing_gate = NULL;
+        unsigned int i = frame->next_port;
+        unsigned int count = frame->count;
+        uint64_t bits = frame->bits;
+        ssize_t longest_path = frame->longest_path;
+
+        for (; i < evaluated_ports(gate); i++) {
+            port_t const* port = gate->ports + i;
+            bool value;
+
+            sharing_gate = port->sharing_gate;
+
+            if (port->direct_signal) { // Signal-nand connection.
+                value = *port->direct_signal;
+                longest_path = max(1, longest_path);
+            }
+            else if (!sharing_gate) { // Empty port - no connection.
+                return ECANCELED;
+            }
+            else {
+                context_entry_t const* entry = find_entry(c, sharing_gate);
+
+                if (entry->generation != c->generation) { // Nand-nand connection to a new gate.
+                    break;
+                }
+                if (!entry->updated) { // Cycle condition.
+                    return ECANCELED;
+                }
+
+                value = entry->value;
+                longest_path = max(entry->longest_path + 1, longest_path);
+            }
+
+            count += value;
+            bits |= i < 64 ? (uint64_t)value << i : 0;
+        }
+
+        frame->next_port = i;
+        frame->count = count;
+        frame->bits = bits;
+        frame->longest_path = longest_path;
+
+        if (i < evaluated_ports(gate)) { // Go to the new gate.
+            if (!push_gate(c, sharing_gate, &top)) {
+                return ENOMEM;
+            }
+
+            continue;
+        }
+
+        // All ports processed.
+        context_entry_t* entry = frame->entry;
+
+        entry->updated = true;
+        entry->value = nand_kind_value(gate, count, bits);
+        entry->longest_path = longest_path;
+        *maximum_length = max(longest_path, *maximum_length);
+        top--;
+    }
+
+    return 0;
+}
+
+ssize_t nand_evaluate_in(nand_context_t *c, nand_t **g, bool *s, size_t m) {
+    if (!c || !g || !s || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t maximum_length = -1;
+    int error = 0;
+
+    read_lock(c);
+
+    // A new generation frees all slots at once.
+    if (++c->generation == 0) {
+        memset(c->entries, 0, c->capacity * sizeof(context_entry_t));
+        c->generation = 1;
+    }
+
+    c->count = 0;
+
+    if (c->capacity == 0 && !grow_entries(c, 0)) {
+        error = ENOMEM;
+    }
+
+    for (size_t i = 0; i < m && !error; i++) {
+        if (!g[i]) {
+            error = EINVAL;
+            break;
+        }
+
+        context_entry_t const* entry = find_entry(c, g[i]);
+
+        if (entry->generation != c->generation) {
+            error = evaluate_in(c, g[i], &maximum_length);
+            entry = find_entry(c, g[i]);
+        }
+
+        s[i] = entry->value;
+    }
+
+    read_unlock(c);
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return maximum_length;
+}
@@ -0,0 +1,874 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <pthread.h> // For pthread_create, pthread_join.
+#include <stdint.h> // For uint32_t, uint64_t.
+#include <stdlib.h> // For malloc, calloc, free, qsort.
+#include <string.h> // For memcpy, memset.
+#include <unistd.h> // For sysconf.
+
+// Number of 64-bit words of random patterns in the signatures of the nodes.
+#define SIGNATURE_WORDS 4
+
+// The largest number of signals enumerated by the check of a pair of outputs.
+#define MAX_SUPPORT 30
+
+// The largest frontier enumerated by the check of a pair of candidate nodes.
+#define WINDOW_LEAVES 10
+
+// The largest frontier kept while a window grows.
+#define MAX_FRONTIER 64
+
+// Number of gates expanded by the check of a pair of candidate nodes.
+#define WINDOW_GATES 32
+
+// Number of words of the patterns of the largest frontier.
+#define WINDOW_WORDS ((1 << WINDOW_LEAVES) / 64)
+
+// Number of failed checks after which a class of nodes is not checked anymore.
+#define CLASS_ATTEMPTS 16
+
+// Number of blocks of patterns taken at once by a thread of the enumeration.
+#define BLOCKS_PER_TAKE 16
+
+// Free slot of the tables.
+#define NO_NODE UINT32_MAX
+
+// Pattern not found by the enumeration.
+#define NO_PATTERN UINT64_MAX
+
+/**@brief Block of SIGNATURE_WORDS words of one node, bit p of the block is its value
+ * under the pattern p of the block. Blocks are never passed by value, vectors wider
+ * than the registers of the target have no stable calling convention.
+ */
+typedef uint64_t block_t __attribute__((vector_size(SIGNATURE_WORDS * sizeof(uint64_t))));
+
+// Columns of the truth table of six variables.
+static const uint64_t variable_words[6] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL,
+};
+
+/**@brief State of nand_equivalent. Nodes are the nodes of the compiled system and two
+ * constants: false_node and false_node + 1 (true). Every node is replaced by the node
+ * it is proved equal to, the node left is kept.
+ * c             - compiled system of g1 followed by g2.
+ * false_node    - number of the constant false.
+ * repr          - the kept node equal to every node, kept nodes are their own.
+ * offsets       - array of length number_of_gates + 1. Canonical inputs of the gate i are
+ *                 inputs[offsets[i]], ..., inputs[offsets[i + 1] - 1].
+ * inputs        - kept nodes of the inputs of the gates, sorted, without repetitions
+ *                 and without constants.
+ * signatures    - values of the nodes under random patterns, aligned part of
+ *                 signature_memory.
+ * strash        - table of gates by their canonical inputs (open addressing).
+ * classes       - table of kept nodes by their signatures (open addressing).
+ * table_mask    - capacity of both tables minus one.
+ * attempts      - number of failed checks of the nodes in classes.
+ * stamps, slots - slot of a node in the current window or cone, valid if its stamp is
+ *                 the current one.
+ * stamp         - the current stamp.
+ * window_values - technical array of the window checks.
+ */
+typedef struct {
+    nand_compiled_t* c;
+    uint32_t false_node;
+    uint32_t* repr;
+    uint32_t* offsets;
+    uint32_t* inputs;
+    block_t* signatures;
+    void* signature_memory;
+    uint32_t* strash;
+    uint32_t* classes;
+    size_t table_mask;
+    uint8_t* attempts;
+    uint32_t* stamps;
+    uint32_t* slots;
+    uint32_t stamp;
+    uint64_t window_values[MAX_FRONTIER + WINDOW_GATES][WINDOW_WORDS];
+} checker_t;
+
+typedef struct enumerator enumerator_t;
+
+/**@brief Thread of the enumeration of the patterns of a cone.
+ * enumeration - the shared state.
+ * values      - blocks of the leaves and the gates of the cone.
+ * thread      - the thread running the worker.
+ * started     - true if thread was created.
+ */
+typedef struct {
+    enumerator_t* enumeration;
+    block_t* values;
+    void* values_memory;
+    pthread_t thread;
+    bool started;
+} cone_worker_t;
+
+/**@brief Cone of two nodes enumerated under all values of its signals. Slots of the
+ * signals are 0, ..., number_of_leaves - 1, gates follow them in topological order.
+ * number_of_leaves  - number of signals of the cone.
+ * number_of_gates   - number of gates of the cone.
+ * offsets, inputs   - slots of the inputs of the gates, like in the checker.
+ * first, second     - slots of the compared nodes, or NO_NODE for a constant.
+ * first_constant,
+ * second_constant   - values of the constants.
+ * number_of_blocks  - number of blocks of patterns.
+ * next_block        - the first block not taken by any thread yet.
+ * pattern           - the lowest differing pattern found, or NO_PATTERN.
+ * number_of_threads - number of workers.
+ * workers           - array of workers.
+ */
+struct enumerator {
+    uint32_t number_of_leaves;
+    uint32_t number_of_gates;
+    uint32_t* offsets;
+    uint32_t* inputs;
+    uint32_t first;
+    uint32_t second;
+    bool first_constant;
+    bool second_constant;
+    uint64_t number_of_blocks;
+    uint64_t next_block;
+    uint64_t pattern;
+    unsigned int number_of_threads;
+    cone_worker_t* workers;
+};
+
+// Returns the first address aligned for blocks in memory allocated with one spare block.
+static block_t* aligned_blocks(void* memory) {
+    uintptr_t address = (uintptr_t)memory;
+    return (block_t*)((address + sizeof(block_t) - 1) & ~(uintptr_t)(sizeof(block_t) - 1));
+}
+
+static bool is_gate(checker_t const* e, uint32_t v) {
+    return v >= e->c->number_of_signals && v < e->false_node;
+}
+
+// Starts a new stamp, i.e. forgets all slots.
+static void new_stamp(checker_t* e) {
+    if (++e->stamp == 0) {
+        memset(e->stamps, 0, (e->false_node + 2) * sizeof(uint32_t));
+        e->stamp = 1;
+    }
+}
+
+static void set_slot(checker_t* e, uint32_t v, uint32_t slot) {
+    e->stamps[v] = e->stamp;
+    e->slots[v] = slot;
+}
+
+static bool has_slot(checker_t const* e, uint32_t v) {
+    return e->stamps[v] == e->stamp;
+}
+
+// Hash function for lists of nodes and for signatures.
+static size_t hash_words(uint32_t const* words, size_t length) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        h = (h ^ words[i]) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+
+    return (size_t)h;
+}
+
+static uint32_t* canonical_inputs(checker_t const* e, uint32_t v, size_t* length) {
+    uint32_t i = v - (uint32_t)e->c->number_of_signals;
+
+    *length = e->offsets[i + 1] - e->offsets[i];
+    return e->inputs + e->offsets[i];
+}
+
+/**@brief Finds the gate with the same canonical inputs as the gate v in the table of
+ * structural hashing, or adds v there. Returns the found gate or NO_NODE.
+ */
+static uint32_t find_or_add_gate(checker_t* e, uint32_t v) {
+    size_t length;
+    uint32_t const* list = canonical_inputs(e, v, &length);
+    size_t i = hash_words(list, length) & e->table_mask;
+
+    for (; e->strash[i] != NO_NODE; i = (i + 1) & e->table_mask) {
+        size_t other_length;
+        uint32_t const* other = canonical_inputs(e, e->strash[i], &other_length);
+
+        if (other_length == length && memcmp(other, list, length * sizeof(uint32_t)) == 0) {
+            return e->strash[i];
+        }
+    }
+
+    e->strash[i] = v;
+    return NO_NODE;
+}
+
+/**@brief Finds the kept node with the same signature as v in the table of classes, or
+ * adds v there. Returns the found node or NO_NODE.
+ */
+static uint32_t find_or_add_class(checker_t* e, uint32_t v) {
+    block_t const* signature = e->signatures + v;
+    size_t i = hash_words((uint32_t const*)signature, sizeof(block_t) / sizeof(uint32_t)) &
+               e->table_mask;
+
+    for (; e->classes[i] != NO_NODE; i = (i + 1) & e->table_mask) {
+        if (memcmp(e->signatures + e->classes[i], signature, sizeof(block_t)) == 0) {
+            return e->classes[i];
+        }
+    }
+
+    e->classes[i] = v;
+    return NO_NODE;
+}
+
+static int compare_nodes(const void* a, const void* b) {
+    uint32_t x = *(uint32_t const*)a, y = *(uint32_t const*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the list of nodes and removes repetitions. Returns the new length.
+static size_t sort_nodes(uint32_t* list, size_t length) {
+    if (length > 16) {
+        qsort(list, length, sizeof(uint32_t), compare_nodes);
+    }
+    else {
+        for (size_t i = 1; i < length; i++) {
+            uint32_t x = list[i];
+            size_t j = i;
+
+            for (; j > 0 && list[j - 1] > x; j--) {
+                list[j] = list[j - 1];
+            }
+
+            list[j] = x;
+        }
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        if (kept == 0 || list[kept - 1] != list[i]) {
+            list[kept++] = list[i];
+        }
+    }
+
+    return kept;
+}
+
+// Inserts v to the sorted frontier, unless it is there. Returns false if it is full.
+static bool add_to_frontier(uint32_t* frontier, size_t* length, uint32_t v) {
+    size_t i = *length;
+
+    while (i > 0 && frontier[i - 1] > v) {
+        i--;
+    }
+    if (i > 0 && frontier[i - 1] == v) {
+        return true;
+    }
+    if (*length == MAX_FRONTIER) {
+        return false;
+    }
+
+    memmove(frontier + i + 1, frontier + i, (*length - i) * sizeof(uint32_t));
+    frontier[i] = v;
+    (*length)++;
+    return true;
+}
+
+/**@brief Checks if the kept nodes u and v are equal as functions of the frontier,
+ * enumerating all its values. window[number_of_gates - 1], ..., window[0] are the gates
+ * above the frontier in topological order.
+ */
+static bool window_equal(checker_t* e, uint32_t u, uint32_t v, uint32_t const* frontier,
+                         size_t leaves, uint32_t const* window, size_t number_of_gates) {
+    size_t words = leaves <= 6 ? 1 : (size_t)1 << (leaves - 6);
+    uint64_t valid = leaves >= 6 ? ~(uint64_t)0 : ((uint64_t)1 << (1 << leaves)) - 1;
+
+    new_stamp(e);
+
+    for (size_t j = 0; j < leaves; j++) {
+        set_slot(e, frontier[j], (uint32_t)j);
+
+        for (size_t w = 0; w < words; w++) {
+            e->window_values[j][w] = j < 6 ? variable_words[j] :
+                                     (w >> (j - 6) & 1) ? ~(uint64_t)0 : 0;
+        }
+    }
+    for (size_t g = number_of_gates; g-- > 0;) {
+        size_t length;
+        uint32_t const* list = canonical_inputs(e, window[g], &length);
+        uint32_t slot = (uint32_t)(leaves + number_of_gates - 1 - g);
+
+        for (size_t w = 0; w < words; w++) {
+            uint64_t all_true = ~(uint64_t)0;
+
+            for (size_t k = 0; k < length; k++) {
+                all_true &= e->window_values[e->slots[list[k]]][w];
+            }
+
+            e->window_values[slot][w] = ~all_true;
+        }
+
+        set_slot(e, window[g], slot);
+    }
+    for (size_t w = 0; w < words; w++) {
+        uint64_t x = u >= e->false_node ? (u == e->false_node ? 0 : ~(uint64_t)0) :
+                                          e->window_values[e->slots[u]][w];
+
+        if ((x ^ e->window_values[e->slots[v]][w]) & valid) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**@brief Tries to prove that the kept node u (earlier than v, or a constant) and the
+ * gate v are equal. The window of the gates above a frontier grows from u and v by
+ * replacing the latest gate of the frontier with its inputs. Every frontier cuts u and
+ * v from the signals, so if they are equal as functions of it, they are equal. The
+ * window is checked whenever the frontier is small enough.
+ */
+static bool check_window(checker_t* e, uint32_t u, uint32_t v) {
+    uint32_t frontier[MAX_FRONTIER], window[WINDOW_GATES];
+    size_t leaves = 0, number_of_gates = 0;
+
+    if (u < e->false_node) {
+        add_to_frontier(frontier, &leaves, u);
+    }
+
+    add_to_frontier(frontier, &leaves, v);
+
+    while (number_of_gates < WINDOW_GATES) {
+        uint32_t x = frontier[leaves - 1];
+
+        if (!is_gate(e, x)) { // Only signals are left.
+            return leaves <= WINDOW_LEAVES &&
+                   window_equal(e, u, v, frontier, leaves, window, number_of_gates);
+        }
+
+        size_t length;
+        uint32_t const* list = canonical_inputs(e, x, &length);
+
+        leaves--;
+        window[number_of_gates++] = x;
+
+        for (size_t k = 0; k < length; k++) {
+            if (!add_to_frontier(frontier, &leaves, list[k])) {
+                return false;
+            }
+        }
+        if (leaves <= WINDOW_LEAVES &&
+            window_equal(e, u, v, frontier, leaves, window, number_of_gates)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Fills the signatures of the signals with random patterns, or with all patterns
+// if there are few signals.
+static void random_signatures(checker_t* e) {
+    size_t number_of_signals = e->c->number_of_signals;
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+
+    for (size_t i = 0; i < number_of_signals; i++) {
+        for (int w = 0; w < SIGNATURE_WORDS; w++) {
+            if (number_of_signals <= 8) {
+                e->signatures[i][w] = i < 6 ? variable_words[i] : (w >> (i - 6) & 1) ? ~(uint64_t)0 : 0;
+            }
+            else {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                e->signatures[i][w] = x;
+            }
+        }
+    }
+
+    memset(e->signatures + e->false_node, 0, sizeof(block_t));
+    memset(e->signatures + e->false_node + 1, 0xff, sizeof(block_t));
+}
+
+/**@brief Replaces every gate, in topological order, with an equal earlier node if it
+ * finds one: a constant (a gate reading false is true, true inputs are dropped and a
+ * gate without inputs is false), the input of an inverter negated again, a gate with
+ * the same set of inputs, or a node with the same signature proved equal by a window.
+ */
+static void sweep(checker_t* e) {
+    nand_compiled_t const* c = e->c;
+    uint32_t number_of_signals = (uint32_t)c->number_of_signals;
+    uint32_t true_node = e->false_node + 1;
+
+    for (uint32_t v = 0; v < number_of_signals; v++) {
+        e->repr[v] = v;
+        find_or_add_class(e, v);
+    }
+
+    e->repr[e->false_node] = e->false_node;
+    e->repr[true_node] = true_node;
+    find_or_add_class(e, e->false_node);
+    find_or_add_class(e, true_node);
+    e->offsets[0] = 0;
+
+    for (uint32_t i = 0; i < c->number_of_gates; i++) {
+        uint32_t v = number_of_signals + i;
+        uint32_t* list = e->inputs + e->offsets[i];
+        size_t length = 0;
+        bool reads_false = false;
+
+        for (uint32_t k = c->input_offsets[i]; k < c->input_offsets[i + 1]; k++) {
+            uint32_t x = e->repr[c->inputs[k]];
+
+            reads_false |= x == e->false_node;
+
+            if (x < e->false_node) {
+                list[length++] = x;
+            }
+        }
+
+        length = reads_false ? 0 : sort_nodes(list, length);
+        e->offsets[i + 1] = e->offsets[i] + (uint32_t)length;
+
+        if (reads_false || length == 0) {
+            e->repr[v] = reads_false ? true_node : e->false_node;
+            continue;
+        }
+        if (length == 1 && is_gate(e, list[0])) {
+            size_t inner_length;
+            uint32_t const* inner = canonical_inputs(e, list[0], &inner_length);
+
+            if (inner_length == 1) { // Double inversion.
+                e->repr[v] = inner[0];
+                continue;
+            }
+        }
+
+        uint32_t same = find_or_add_gate(e, v);
+
+        if (same != NO_NODE) {
+            e->repr[v] = e->repr[same];
+            continue;
+        }
+
+        block_t all_true;
+
+        memset(&all_true, 0xff, sizeof(all_true));
+
+        for (size_t k = 0; k < length; k++) {
+            all_true &= e->signatures[list[k]];
+        }
+
+        e->signatures[v] = ~all_true;
+        e->repr[v] = v;
+
+        uint32_t head = find_or_add_class(e, v);
+
+        if (head != NO_NODE && e->attempts[head] < CLASS_ATTEMPTS) {
+            if (check_window(e, head, v)) {
+                e->repr[v] = head;
+            }
+            else {
+                e->attempts[head]++;
+            }
+        }
+    }
+}
+
+// Evaluates the blocks of patterns taken by the worker, until a differing pattern is
+// found or there are no blocks left.
+static void* cone_worker(void* arg) {
+    cone_worker_t* w = (cone_worker_t*)arg;
+    enumerator_t* n = w->enumeration;
+    block_t* values = w->values;
+    block_t constants[2];
+    uint64_t patterns = (uint64_t)1 << n->number_of_leaves;
+
+    memset(constants, 0, sizeof(block_t));
+    memset(constants + 1, 0xff, sizeof(block_t));
+
+    for (;;) {
+        uint64_t first = __atomic_fetch_add(&n->next_block, BLOCKS_PER_TAKE, __ATOMIC_RELAXED);
+
+        if (first >= n->number_of_blocks ||
+            __atomic_load_n(&n->pattern, __ATOMIC_RELAXED) != NO_PATTERN) {
+            return NULL;
+        }
+
+        uint64_t last = first + BLOCKS_PER_TAKE < n->number_of_blocks ?
+                        first + BLOCKS_PER_TAKE : n->number_of_blocks;
+
+        for (uint64_t b = first; b < last; b++) {
+            for (uint32_t j = 0; j < n->number_of_leaves; j++) {
+                for (int k = 0; k < SIGNATURE_WORDS; k++) {
+                    uint64_t word = b * SIGNATURE_WORDS + (uint64_t)k;
+                    values[j][k] = j < 6 ? variable_words[j] :
+                                   (word >> (j - 6) & 1) ? ~(uint64_t)0 : 0;
+                }
+            }
+            for (uint32_t i = 0; i < n->number_of_gates; i++) {
+                block_t all_true;
+
+                memset(&all_true, 0xff, sizeof(all_true));
+
+                for (uint32_t k = n->offsets[i]; k < n->offsets[i + 1]; k++) {
+                    all_true &= values[n->inputs[k]];
+                }
+
+                values[n->number_of_leaves + i] = ~all_true;
+            }
+
+            block_t const* x = n->first == NO_NODE ? constants + n->first_constant : values + n->first;
+            block_t const* y = n->second == NO_NODE ? constants + n->second_constant : values + n->second;
+
+            for (int k = 0; k < SIGNATURE_WORDS; k++) {
+                uint64_t lane = 64 * (b * SIGNATURE_WORDS + (uint64_t)k);
+                uint64_t difference = (*x)[k] ^ (*y)[k];
+
+                if (lane >= patterns) {
+                    break;
+                }
+                if (patterns - lane < 64) {
+                    difference &= ((uint64_t)1 << (patterns - lane)) - 1;
+                }
+                if (difference != 0) {
+                    uint64_t pattern = lane + (uint64_t)__builtin_ctzll(difference);
+                    uint64_t found = __atomic_load_n(&n->pattern, __ATOMIC_RELAXED);
+
+                    while (pattern < found &&
+                           !__atomic_compare_exchange_n(&n->pattern, &found, pattern, false,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    }
+
+                    return NULL;
+                }
+            }
+        }
+    }
+}
+
+/**@brief Compares the kept nodes a and b under all values of the signals of their cones.
+ * Returns 0 if they are equal, 1 if they differ (the differing values of the signals are
+ * written to values), E2BIG if the cone has more than MAX_SUPPORT signals, or ENOMEM.
+ */
+static int enumerate_cone(checker_t* e, uint32_t a, uint32_t b, unsigned int threads,
+                          bool* values) {
+    size_t number_of_nodes = e->false_node + 2;
+    uint32_t* stack = (uint32_t*)malloc(number_of_nodes * sizeof(uint32_t));
+    uint32_t* gates = (uint32_t*)malloc(number_of_nodes * sizeof(uint32_t));
+    uint32_t support[MAX_SUPPORT];
+    uint32_t number_of_leaves = 0, number_of_gates = 0, number_of_inputs = 0;
+    size_t top = 0;
+    enumerator_t n = {0};
+    int result = ENOMEM;
+
+    if (!stack || !gates) {
+        goto cleanup;
+    }
+
+    // Depth first search of the cone, signals are numbered as they are found.
+    new_stamp(e);
+
+    for (int r = 0; r < 2; r++) {
+        uint32_t root = r == 0 ? a : b;
+
+        if (root < e->false_node && !has_slot(e, root)) {
+            set_slot(e, root, 0);
+            stack[top++] = root;
+        }
+    }
+
+    while (top > 0) {
+        uint32_t v = stack[--top];
+
+        if (!is_gate(e, v)) {
+            if (number_of_leaves == MAX_SUPPORT) {
+                result = E2BIG;
+                goto cleanup;
+            }
+
+            support[number_of_leaves] = v;
+            e->slots[v] = number_of_leaves++;
+            continue;
+        }
+
+        size_t length;
+        uint32_t const* list = canonical_inputs(e, v, &length);
+
+        gates[number_of_gates++] = v;
+        number_of_inputs += (uint32_t)length;
+
+        for (size_t k = 0; k < length; k++) {
+            if (!has_slot(e, list[k])) {
+                set_slot(e, list[k], 0);
+                stack[top++] = list[k];
+            }
+        }
+    }
+
+    // Gates of the cone in topological order get slots after the signals.
+    qsort(gates, number_of_gates, sizeof(uint32_t), compare_nodes);
+
+    for (uint32_t i = 0; i < number_of_gates; i++) {
+        e->slots[gates[i]] = number_of_leaves + i;
+    }
+
+    n.number_of_leaves = number_of_leaves;
+    n.number_of_gates = number_of_gates;
+    n.offsets = (uint32_t*)malloc((number_of_gates + 1) * sizeof(uint32_t));
+    n.inputs = (uint32_t*)malloc((number_of_inputs + 1) * sizeof(uint32_t));
+    n.first = a < e->false_node ? e->slots[a] : NO_NODE;
+    n.second = b < e->false_node ? e->slots[b] : NO_NODE;
+    n.first_constant = a == e->false_node + 1;
+    n.second_constant = b == e->false_node + 1;
+    n.number_of_blocks = ((((uint64_t)1 << number_of_leaves) + 63) / 64 + SIGNATURE_WORDS - 1) /
+                         SIGNATURE_WORDS;
+    n.pattern = NO_PATTERN;
+    n.number_of_threads = (uint64_t)threads > n.number_of_blocks ? (unsigned)n.number_of_blocks :
+                                                                    threads;
+    n.workers = (cone_worker_t*)calloc(n.number_of_threads, sizeof(cone_worker_t));
+
+    if (!n.offsets || !n.inputs || !n.workers) {
+        goto cleanup;
+    }
+
+    n.offsets[0] = 0;
+
+    for (uint32_t i = 0; i < number_of_gates; i++) {
+        size_t length;
+        uint32_t const* list = canonical_inputs(e, gates[i], &length);
+
+        for (size_t k = 0; k < length; k++) {
+            n.inputs[n.offsets[i] + k] = e->slots[list[k]];
+        }
+
+        n.offsets[i + 1] = n.offsets[i] + (uint32_t)length;
+    }
+    for (unsigned int i = 0; i < n.number_of_threads; i++) {
+        cone_worker_t* w = n.workers + i;
+
+        w->enumeration = &n;
+        w->values_memory = malloc((number_of_leaves + number_of_gates + 1) * sizeof(block_t));
+        w->values = aligned_blocks(w->values_memory);
+
+        if (!w->values_memory) {
+            goto cleanup;
+        }
+    }
+
+    // Workers whose threads cannot be created run in the calling thread.
+    for (unsigned int i = 1; i < n.number_of_threads; i++) {
+        n.workers[i].started = pthread_create(&n.workers[i].thread, NULL, cone_worker,
+                                              n.workers + i) == 0;
+    }
+
+    cone_worker(n.workers);
+
+    for (unsigned int i = 1; i < n.number_of_threads; i++) {
+        if (n.workers[i].started) {
+            pthread_join(n.workers[i].thread, NULL);
+        }
+        else {
+            cone_worker(n.workers + i);
+        }
+    }
+
+    result = 0;
+
+    if (n.pattern != NO_PATTERN) {
+        memset(values, 0, e->c->number_of_signals * sizeof(bool));
+
+        for (uint32_t j = 0; j < number_of_leaves; j++) {
+            values[support[j]] = n.pattern >> j & 1;
+        }
+
+        result = 1;
+    }
+
+cleanup:
+    for (unsigned int i = 0; n.workers && i < n.number_of_threads; i++) {
+        free(n.workers[i].values_memory);
+    }
+
+    free(n.workers);
+    free(n.offsets);
+    free(n.inputs);
+    free(stack);
+    free(gates);
+    return result;
+}
+
+// Writes the counterexample of the j-th pair with the values of the signals.
+static int write_counterexample(checker_t const* e, size_t j, bool const* values,
+                                nand_counterexample_t* counterexample) {
+    if (!counterexample) {
+        return 0;
+    }
+
+    size_t number_of_signals = e->c->number_of_signals;
+
+    counterexample->output = j;
+    counterexample->number_of_signals = number_of_signals;
+    counterexample->signals = (bool const**)malloc(max(number_of_signals, 1) * sizeof(bool const*));
+    counterexample->values = (bool*)malloc(max(number_of_signals, 1) * sizeof(bool));
+
+    if (!counterexample->signals || !counterexample->values) {
+        free(counterexample->signals);
+        free(counterexample->values);
+        counterexample->signals = NULL;
+        counterexample->values = NULL;
+        return ENOMEM;
+    }
+
+    memcpy(counterexample->signals, e->c->signals, number_of_signals * sizeof(bool const*));
+    memcpy(counterexample->values, values, number_of_signals * sizeof(bool));
+    return 0;
+}
+
+/**@brief Checks the pairs of outputs of the swept system: kept nodes which are the same
+ * are equal, different signatures give a counterexample at once, and the other pairs
+ * are enumerated. Returns 1 (equal), 0 (not equal) or an error number.
+ */
+static int check_outputs(checker_t* e, size_t m, unsigned int threads,
+                         nand_counterexample_t* counterexample) {
+    nand_compiled_t const* c = e->c;
+    bool* values = (bool*)malloc(max(c->number_of_signals, 1) * sizeof(bool));
+    int result = 1;
+
+    if (!values) {
+        return ENOMEM;
+    }
+
+    for (size_t j = 0; j < m && result == 1; j++) {
+        block_t const* x = e->signatures + e->repr[c->outputs[j]];
+        block_t const* y = e->signatures + e->repr[c->outputs[m + j]];
+
+        for (int k = 0; k < SIGNATURE_WORDS; k++) {
+            uint64_t difference = (*x)[k] ^ (*y)[k];
+
+            if (difference != 0) {
+                unsigned int lane = 64 * k + (unsigned int)__builtin_ctzll(difference);
+
+                for (size_t i = 0; i < c->number_of_signals; i++) {
+                    values[i] = e->signatures[i][lane / 64] >> lane % 64 & 1;
+                }
+
+                result = write_counterexample(e, j, values, counterexample);
+                break;
+            }
+        }
+    }
+
+    bool too_big = false;
+
+    for (size_t j = 0; j < m && result == 1; j++) {
+        uint32_t a = e->repr[c->outputs[j]], b = e->repr[c->outputs[m + j]];
+
+        if (a == b) {
+            continue;
+        }
+
+        int error = enumerate_cone(e, a, b, threads, values);
+
+        if (error == 1) {
+            error = write_counterexample(e, j, values, counterexample);
+            result = error == 0 ? 0 : error;
+        }
+        else if (error == E2BIG) {
+            too_big = true;
+        }
+        else if (error != 0) {
+            result = error;
+        }
+    }
+
+    free(values);
+    return result == 1 && too_big ? E2BIG : result;
+}
+
+int nand_equivalent(nand_t **g1, nand_t **g2, size_t m, unsigned threads,
+                    nand_counterexample_t *counterexample) {
+    if (!g1 || !g2 || m == 0 || m > SIZE_MAX / 2 / sizeof(nand_t*)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nand_t** both = (nand_t**)malloc(2 * m * sizeof(nand_t*));
+
+    if (!both) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(both, g1, m * sizeof(nand_t*));
+    memcpy(both + m, g2, m * sizeof(nand_t*));
+
+    checker_t e = {0};
+
+    e.c = nand_compile(both, 2 * m);
+
+    if (!e.c) {
+        int error = errno;
+        free(both);
+        errno = error;
+        return -1;
+    }
+
+    free(both);
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+
+    nand_compiled_t const* c = e.c;
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates + 2;
+    size_t capacity = 1024;
+    int result = ENOMEM;
+
+    while (capacity < 2 * number_of_nodes) {
+        capacity *= 2;
+    }
+
+    e.false_node = (uint32_t)(number_of_nodes - 2);
+    e.table_mask = capacity - 1;
+    e.repr = (uint32_t*)malloc(number_of_nodes * sizeof(uint32_t));
+    e.offsets = (uint32_t*)malloc((c->number_of_gates + 1) * sizeof(uint32_t));
+    e.inputs = (uint32_t*)malloc((c->input_offsets[c->number_of_gates] + 1) * sizeof(uint32_t));
+    e.signature_memory = malloc((number_of_nodes + 1) * sizeof(block_t));
+    e.signatures = aligned_blocks(e.signature_memory);
+    e.strash = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    e.classes = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    e.attempts = (uint8_t*)calloc(number_of_nodes, sizeof(uint8_t));
+    e.stamps = (uint32_t*)calloc(number_of_nodes, sizeof(uint32_t));
+    e.slots = (uint32_t*)malloc(number_of_nodes * sizeof(uint32_t));
+
+    if (!e.repr || !e.offsets || !e.inputs || !e.signature_memory || !e.strash ||
+        !e.classes || !e.attempts || !e.stamps || !e.slots) {
+        goto cleanup;
+    }
+
+    // NO_NODE is all ones.
+    memset(e.strash, 0xff, capacity * sizeof(uint32_t));
+    memset(e.classes, 0xff, capacity * sizeof(uint32_t));
+    random_signatures(&e);
+    sweep(&e);
+    result = check_outputs(&e, m, threads, counterexample);
+
+cleanup:
+    free(e.repr);
+    free(e.offsets);
+    free(e.inputs);
+    free(e.signature_memory);
+    free(e.strash);
+    free(e.classes);
+    free(e.attempts);
+    free(e.stamps);
+    free(e.slots);
+    nand_compiled_delete(e.c);
+
+    if (result != 0 && result != 1) {
+        errno = result;
+        return -1;
+    }
+
+    return result;
+}
@@ -6,10 +6,13 @@
 #include "memory_tests.h"
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 /** MAKRA SKRACAJĄCE IMPLEMENTACJĘ TESTÓW **/
 
@@ -126,6 +129,1998 @@ static int simple(void) {
   return PASS;
 }
 
+// Testuje obliczanie z pamięcią podręczną wyników bramek.
+static int cached(void) {
+  nand_t *g[3];
+  bool s_in[2], s_out[3], s_ref[3];
+
+  g[0] = nand_new(2);
+  g[1] = nand_new(2);
+  g[2] = nand_new(2);
+  assert(g[0]);
+  assert(g[1]);
+  assert(g[2]);
+
+  TEST_PASS(nand_connect_nand(g[2], g[0], 0));
+  TEST_PASS(nand_connect_nand(g[2], g[0], 1));
+  TEST_PASS(nand_connect_nand(g[2], g[1], 0));
+  TEST_PASS(nand_connect_signal(s_in + 0, g[2], 0));
+  TEST_PASS(nand_connect_signal(s_in + 1, g[2], 1));
+  TEST_PASS(nand_connect_signal(s_in + 1, g[1], 1));
+
+  for (int v = 0; v < 4; ++v) {
+    s_in[0] = v & 1, s_in[1] = v >> 1;
+    nand_signal_changed(s_in + 0);
+    nand_signal_changed(s_in + 1);
+    ASSERT(nand_evaluate(g, s_ref, 3) == 2);
+    ASSERT(nand_evaluate_cached(g, s_out, 3) == 2);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  // Bez zgłoszenia zmiany sygnału wynik pochodzi z pamięci podręcznej.
+  s_in[0] = false;
+  ASSERT(nand_evaluate_cached(g + 2, s_out, 1) == 1 && s_out[0] == false);
+  nand_signal_changed(s_in + 0);
+  ASSERT(nand_evaluate_cached(g, s_out, 3) == 2);
+  ASSERT(s_out[0] == false && s_out[1] == false && s_out[2] == true);
+
+  // Zmiana połączeń unieważnia wyniki bramek leżących za nią.
+  TEST_PASS(nand_connect_nand(g[0], g[1], 1));
+  ASSERT(nand_evaluate_cached(g + 1, s_out, 1) == 3 && s_out[0] == true);
+
+  nand_delete(g[0]);
+  TEST_ECANCELED(nand_evaluate_cached(g + 1, s_out, 1));
+  ASSERT(nand_evaluate_cached(g + 2, s_out, 1) == 1 && s_out[0] == true);
+
+  TEST_PASS(nand_connect_nand(g[1], g[1], 1));
+  TEST_ECANCELED(nand_evaluate_cached(g + 1, s_out, 1));
+  TEST_ECANCELED(nand_evaluate(g + 1, s_out, 1));
+
+  // Po błędzie cyklu nie mogą zostać nieaktualne wyniki.
+  s_in[0] = true;
+  nand_signal_changed(s_in + 0);
+  ASSERT(nand_evaluate(g + 2, s_ref, 1) == 1 && s_ref[0] == false);
+  ASSERT(nand_evaluate_cached(g + 2, s_out, 1) == 1 && s_out[0] == false);
+
+  nand_delete(g[1]);
+  nand_delete(g[2]);
+  return PASS;
+}
+
+// Testuje bardzo długi łańcuch bramek, który przepełniłby stos przy rekurencji.
+// Losowy układ bez cykli: bramka może brać wejścia tylko od bramek o mniejszych numerach.
+// Bramki powstają w puli p, a gdy p jest NULL, osobno.
+static int random_circuit(nand_pool_t *p, nand_t **g, int gates, bool *s_in, int signals) {
+  for (int i = 0; i < gates; ++i) {
+    unsigned n = rand() % 4;
+    g[i] = p ? nand_new_in(p, n) : nand_new(n);
+    assert(g[i]);
+    for (unsigned k = 0; k < n; ++k) {
+      if (i == 0 || rand() % 3 == 0)
+        TEST_PASS(nand_connect_signal(s_in + rand() % signals, g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[rand() % i], g[i], k));
+    }
+  }
+  return PASS;
+}
+
+static int compiled(void) {
+  enum { GATES = 200, SIGNALS = 8, OUTPUTS = 20 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  srand(42);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+
+  nand_t **out = g + GATES - OUTPUTS;
+  nand_compiled_t *c = nand_compile(out, OUTPUTS);
+  ASSERT(c);
+
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = (v >> j) & 1;
+    ssize_t path = nand_evaluate(out, s_ref, OUTPUTS);
+    ASSERT(path >= 0);
+    ASSERT(nand_compiled_evaluate(c, s_out) == path);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+  nand_compiled_delete(c);
+
+  // Te same błędy co przy nand_evaluate.
+  errno = 0;
+  ASSERT(nand_compile(NULL, 1) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_compile(out, 0) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_compiled_evaluate(NULL, s_out) == -1 && errno == EINVAL);
+
+  nand_t *h = nand_new(1);
+  assert(h);
+  errno = 0;
+  ASSERT(nand_compile(&h, 1) == NULL && errno == ECANCELED);
+  TEST_PASS(nand_connect_nand(h, h, 0));
+  errno = 0;
+  ASSERT(nand_compile(&h, 1) == NULL && errno == ECANCELED);
+  nand_delete(h);
+
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int lanes(void) {
+  enum { GATES = 300, SIGNALS = 10, OUTPUTS = 30, WORDS = 19 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS];
+  static uint64_t in[SIGNALS][WORDS], out[OUTPUTS][WORDS];
+
+  srand(7);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+
+  nand_t **o = g + GATES - OUTPUTS;
+  nand_compiled_t *c = nand_compile(o, OUTPUTS);
+  ASSERT(c);
+  size_t signals = nand_compiled_number_of_signals(c);
+  ASSERT(signals <= SIGNALS);
+
+  // Wiersz i tablicy in opisuje i-ty sygnał układu skompilowanego.
+  for (size_t i = 0; i < signals; ++i)
+    for (int w = 0; w < WORDS; ++w)
+      in[i][w] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  ssize_t path = nand_compiled_evaluate(c, s_out);
+  ASSERT(nand_compiled_evaluate_lanes(c, in[0], out[0], WORDS) == path);
+
+  // Każdy bit porównujemy z pojedynczym obliczeniem.
+  for (int w = 0; w < WORDS; w += 6) {
+    for (int b = 0; b < 64; ++b) {
+      for (size_t i = 0; i < signals; ++i)
+        *(bool *)nand_compiled_signal(c, i) = (in[i][w] >> b) & 1;
+      ASSERT(nand_compiled_evaluate(c, s_out) == path);
+      for (int j = 0; j < OUTPUTS; ++j)
+        ASSERT(s_out[j] == ((out[j][w] >> b) & 1));
+    }
+  }
+
+  errno = 0;
+  ASSERT(nand_compiled_evaluate_lanes(c, in[0], out[0], 0) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_compiled_signal(c, signals) == NULL && errno == EINVAL);
+
+  nand_compiled_delete(c);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int jit(void) {
+  enum { GATES = 300, SIGNALS = 10, OUTPUTS = 30, WORDS = 19 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS];
+  static uint64_t in[SIGNALS][WORDS], out[OUTPUTS][WORDS], ref[OUTPUTS][WORDS];
+
+  srand(23);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+  nand_compiled_t *c = nand_compile(g + GATES - OUTPUTS, OUTPUTS);
+  ASSERT(c);
+  for (size_t i = 0; i < nand_compiled_number_of_signals(c); ++i)
+    for (int w = 0; w < WORDS; ++w)
+      in[i][w] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  // Pliki powstają w prywatnym katalogu i znikają razem z nim.
+  char directory[] = "/tmp/nand_example_XXXXXX";
+  ASSERT(mkdtemp(directory));
+  setenv("TMPDIR", directory, 1);
+  nand_jit_t *j = nand_jit(c);
+  int error = errno;
+  unsetenv("TMPDIR");
+  ASSERT(rmdir(directory) == 0);
+  errno = error;
+  if (!j && errno == ENOENT) {
+    // Brak kompilatora w systemie.
+    nand_compiled_delete(c);
+    for (int i = 0; i < GATES; ++i)
+      nand_delete(g[i]);
+    return PASS;
+  }
+  ASSERT(j);
+
+  // Kod maszynowy daje te same wzorce co obliczenie na blokach.
+  ASSERT(nand_compiled_evaluate_lanes(c, in[0], ref[0], WORDS) >= 0);
+  nand_jit_function(j)(in[0], out[0], WORDS);
+  ASSERT(memcmp(out, ref, sizeof out) == 0);
+
+  // Kolejne wywołanie używa tych samych slotów.
+  memset(out, 0, sizeof out);
+  nand_jit_function(j)(in[0], out[0], WORDS);
+  ASSERT(memcmp(out, ref, sizeof out) == 0);
+  nand_jit_delete(j);
+
+  ASSERT(nand_jit(NULL) == NULL && errno == EINVAL);
+  ASSERT(nand_jit_function(NULL) == NULL && errno == EINVAL);
+  setenv("NAND_JIT_CC", "/nonexistent/cc", 1);
+  ASSERT(nand_jit(c) == NULL && errno == ENOENT);
+  setenv("NAND_JIT_CC", "false", 1);
+  ASSERT(nand_jit(c) == NULL && errno == EIO);
+  unsetenv("NAND_JIT_CC");
+
+  nand_compiled_delete(c);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int pool(void) {
+  enum { GATES = 500, SIGNALS = 6, OUTPUTS = 40 };
+  nand_t *g[GATES], *h[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  // Ten sam losowy układ w puli i poza nią.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(11);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+  srand(11);
+  ASSERT(random_circuit(p, h, GATES, s_in, SIGNALS) == PASS);
+
+  nand_t **g_out = g + GATES - OUTPUTS, **h_out = h + GATES - OUTPUTS;
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j) {
+      s_in[j] = (v >> j) & 1;
+      nand_signal_changed(s_in + j);
+    }
+    ssize_t path = nand_evaluate(g_out, s_ref, OUTPUTS);
+    ASSERT(nand_evaluate_cached(h_out, s_out, OUTPUTS) == path);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  // Bramek z różnych pul nie można łączyć.
+  errno = 0;
+  ASSERT(nand_connect_nand(g[0], h[1], 0) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_new_in(NULL, 1) == NULL && errno == EINVAL);
+
+  // Usunięte bramki zwalniają pamięć do ponownego użycia.
+  for (int i = 0; i < GATES / 2; ++i) {
+    nand_delete(h[i]);
+    h[i] = nand_new_in(p, i % 5);
+    ASSERT(h[i] && nand_fan_out(h[i]) == 0);
+    if (i % 5)
+      TEST_PASS(nand_connect_signal(s_in + i % SIGNALS, h[i], 0));
+  }
+  ASSERT(nand_evaluate(h, s_out, 1) >= 0);
+
+  // Usunięcie puli usuwa wszystkie jej bramki.
+  nand_pool_delete(p);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int reconnect(void) {
+  nand_t *g[4];
+
+  g[0] = nand_new(0);
+  g[1] = nand_new(0);
+  g[2] = nand_new(1);
+  g[3] = nand_new(1);
+  assert(g[0] && g[1] && g[2] && g[3]);
+
+  // Przełączany kabel jest ostatnim kablem starego źródła.
+  TEST_PASS(nand_connect_nand(g[1], g[3], 0));
+  TEST_PASS(nand_connect_nand(g[0], g[2], 0));
+  TEST_PASS(nand_connect_nand(g[1], g[2], 0));
+  ASSERT(nand_fan_out(g[0]) == 0 && nand_fan_out(g[1]) == 2);
+
+  nand_delete(g[2]);
+  ASSERT(nand_fan_out(g[1]) == 1 && nand_output(g[1], 0) == g[3]);
+  ASSERT(nand_input(g[3], 0) == g[1]);
+
+  nand_delete(g[0]);
+  nand_delete(g[1]);
+  nand_delete(g[3]);
+  return PASS;
+}
+
+static int epoch(void) {
+  nand_t *g[4];
+  bool s_out[4], s_in = true;
+
+  g[0] = nand_new(1);
+  g[1] = nand_new(2);
+  g[2] = nand_new(1);
+  g[3] = nand_new(1);
+  assert(g[0] && g[1] && g[2] && g[3]);
+
+  // Przerwane obliczenia zostawiają znaczniki, które nie mogą wpłynąć na kolejne.
+  TEST_PASS(nand_connect_signal(&s_in, g[0], 0));
+  TEST_PASS(nand_connect_nand(g[0], g[1], 0));
+  TEST_PASS(nand_connect_nand(g[2], g[1], 1));
+  TEST_PASS(nand_connect_nand(g[1], g[2], 0));
+  TEST_PASS(nand_connect_nand(g[0], g[3], 0));
+  TEST_ECANCELED(nand_evaluate(g + 1, s_out, 1));
+  ASSERT(nand_evaluate(g + 3, s_out, 1) == 2 && s_out[0]);
+  TEST_ECANCELED(nand_evaluate(g + 1, s_out, 1));
+
+  TEST_PASS(nand_connect_signal(&s_in, g[2], 0));
+  ASSERT(nand_evaluate(g, s_out, 4) == 2);
+  ASSERT(!s_out[0] && s_out[1] && !s_out[2] && s_out[3]);
+  s_in = false;
+  ASSERT(nand_evaluate(g, s_out, 4) == 2);
+  ASSERT(s_out[0] && !s_out[1] && s_out[2] && !s_out[3]);
+
+  for (int i = 0; i < 4; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int signal_set(void) {
+  enum { GATES = 200, SIGNALS = 8 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS] = {false}, s_out[GATES], s_ref[GATES], flipped[GATES];
+
+  // Losowy układ bez cykli, druga połowa bramek w puli.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(7);
+  for (int i = 0; i < GATES; ++i) {
+    int first = i < GATES / 2 ? 0 : GATES / 2;
+    g[i] = first ? nand_new_in(p, 2) : nand_new(2);
+    ASSERT(g[i]);
+    for (unsigned k = 0; k < 2; ++k) {
+      if (i < first + 4 || rand() % 4 == 0)
+        TEST_PASS(nand_connect_signal(s_in + rand() % SIGNALS, g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[first + rand() % (i - first)], g[i], k));
+    }
+  }
+
+  ASSERT(nand_evaluate(g, s_out, GATES) >= 0);
+  for (int step = 0; step < 100; ++step) {
+    int j = rand() % SIGNALS;
+    ssize_t n = nand_signal_set(s_in + j, !s_in[j], g, flipped, GATES);
+    ASSERT(nand_evaluate(g, s_ref, GATES) >= 0);
+    ssize_t count = 0;
+    for (int i = 0; i < GATES; ++i) {
+      ASSERT(flipped[i] == (s_ref[i] != s_out[i]));
+      count += flipped[i];
+    }
+    ASSERT(n == count);
+    ASSERT(nand_evaluate_cached(g, s_out, GATES) >= 0);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  // Ta sama wartość nic nie zmienia, a cykl jest zgłaszany przed zmianą sygnału.
+  ASSERT(nand_signal_set(s_in, s_in[0], g, flipped, GATES) == 0);
+  ASSERT(nand_signal_set(s_in, !s_in[0], NULL, NULL, 0) >= 0);
+  TEST_PASS(nand_connect_nand(g[GATES - 1], g[GATES / 2 + 4], 0));
+  TEST_PASS(nand_connect_nand(g[GATES / 2 + 4], g[GATES - 1], 0));
+  bool old = s_in[0];
+  TEST_ECANCELED(nand_signal_set(s_in, !old, g + GATES - 1, flipped, 1));
+  ASSERT(s_in[0] == old);
+  ASSERT(nand_signal_set(NULL, true, NULL, NULL, 0) == -1 && errno == EINVAL);
+
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  nand_pool_delete(p);
+  return PASS;
+}
+
+static int checked(void) {
+  enum { GATES = 60 };
+  nand_t *g[GATES];
+  bool s_in = true, s_out[GATES];
+  int rejected = 0;
+
+  for (int i = 0; i < GATES; ++i) {
+    g[i] = nand_new(2);
+    ASSERT(g[i]);
+    TEST_PASS(nand_connect_signal(&s_in, g[i], 0));
+    TEST_PASS(nand_connect_signal(&s_in, g[i], 1));
+  }
+
+  ASSERT(nand_connect_nand_checked(g[0], g[0], 0) == -1 && errno == ECANCELED);
+  ASSERT(nand_connect_nand_checked(NULL, g[0], 0) == -1 && errno == EINVAL);
+
+  // Połączenia w losowej kolejności: odrzucone są dokładnie te, które zamykają cykl.
+  srand(11);
+  for (int step = 0; step < 2000; ++step) {
+    nand_t *g_out = g[rand() % GATES], *g_in = g[rand() % GATES];
+    unsigned k = rand() % 2;
+    void *old = nand_input(g_in, k);
+
+    if (nand_connect_nand_checked(g_out, g_in, k) == 0) {
+      ASSERT(nand_evaluate(g, s_out, GATES) >= 0);
+      continue;
+    }
+    ASSERT(errno == ECANCELED && nand_input(g_in, k) == old);
+    TEST_PASS(nand_connect_nand(g_out, g_in, k));
+    TEST_ECANCELED(nand_evaluate(g, s_out, GATES));
+    ++rejected;
+
+    int j = 0;
+    while (j < GATES && g[j] != old)
+      ++j;
+    if (j < GATES)
+      TEST_PASS(nand_connect_nand(g[j], g_in, k));
+    else
+      TEST_PASS(nand_connect_signal(old, g_in, k));
+    ASSERT(nand_evaluate(g, s_out, GATES) >= 0);
+  }
+  ASSERT(rejected > 0);
+
+  // Połączenie zamykające cykl wraca do porządku po przerwaniu cyklu, więc
+  // sprawdzane połączenie nie może zamknąć go ponownie.
+  nand_t *u = nand_new(1), *v = nand_new(1);
+  ASSERT(u && v);
+  TEST_PASS(nand_connect_nand(v, u, 0));
+  TEST_PASS(nand_connect_nand(u, v, 0));
+  TEST_PASS(nand_connect_signal(&s_in, u, 0));
+  ASSERT(nand_connect_nand_checked(v, u, 0) == -1 && errno == ECANCELED);
+  ASSERT(nand_evaluate(&v, s_out, 1) >= 0);
+
+  // Dopóki cykl trwa, droga przez połączenie spoza porządku też jest znajdowana.
+  nand_t *a = nand_new(1), *b = nand_new(2), *c = nand_new(1);
+  ASSERT(a && b && c);
+  TEST_PASS(nand_connect_nand(a, b, 0));
+  TEST_PASS(nand_connect_signal(&s_in, b, 1));
+  TEST_PASS(nand_connect_nand(b, a, 0));
+  TEST_PASS(nand_connect_nand_checked(a, c, 0));
+  ASSERT(nand_connect_nand_checked(c, b, 1) == -1 && errno == ECANCELED);
+  ASSERT(nand_input(b, 1) == &s_in);
+
+  nand_delete(u);
+  nand_delete(v);
+  nand_delete(a);
+  nand_delete(b);
+  nand_delete(c);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int file(void) {
+  enum { GATES = 100, SIGNALS = 6, OUTPUTS = 10 };
+  char const *path = "/tmp/nand_example.netlist";
+  nand_t *g[GATES], **h;
+  bool s_in[SIGNALS], slots[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  srand(5);
+  for (int i = 0; i < GATES; ++i) {
+    g[i] = nand_new(1 + i % 3);
+    ASSERT(g[i]);
+    for (int k = 0; k < 1 + i % 3; ++k) {
+      if (i < 2 || rand() % 4 == 0)
+        TEST_PASS(nand_connect_signal(s_in + rand() % SIGNALS, g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[rand() % i], g[i], k));
+    }
+  }
+
+  nand_t **out = g + GATES - OUTPUTS;
+  nand_compiled_t *c = nand_compile(out, OUTPUTS);
+  ASSERT(c);
+  TEST_PASS(nand_compiled_save(c, path));
+
+  // Sygnały wczytanego układu leżą w kolejnych polach tablicy slots.
+  size_t n = nand_compiled_number_of_signals(c);
+  ASSERT(n <= SIGNALS);
+  nand_compiled_t *loaded = nand_compiled_load(path, slots, SIGNALS);
+  ASSERT(loaded && nand_compiled_number_of_signals(loaded) == n);
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+
+  // Tablica sygnałów krótsza, niż wymaga plik, jest odrzucana.
+  ASSERT(n > 0);
+  ASSERT(nand_compiled_load(path, slots, n - 1) == NULL && errno == EINVAL);
+  ASSERT(nand_load(path, p, slots, n - 1, &h) == -1 && errno == EINVAL);
+  ASSERT(nand_load(path, p, slots, n, &h) == OUTPUTS);
+
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = (v >> j) & 1;
+    for (size_t j = 0; j < n; ++j)
+      slots[j] = *nand_compiled_signal(c, j);
+    ssize_t length = nand_evaluate(out, s_ref, OUTPUTS);
+    ASSERT(length > 0);
+    ASSERT(nand_compiled_evaluate(loaded, s_out) == length);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+    ASSERT(nand_evaluate(h, s_out, OUTPUTS) == length);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  nand_compiled_delete(loaded);
+  nand_compiled_delete(c);
+  free(h);
+  nand_pool_delete(p);
+
+  // Uszkodzony plik jest odrzucany.
+  TEST_PASS(nand_save(out, OUTPUTS, path));
+  FILE *f = fopen(path, "r+b");
+  ASSERT(f && fseek(f, -4, SEEK_END) == 0 && fputc(0xff, f) != EOF && fclose(f) == 0);
+  ASSERT(nand_compiled_load(path, slots, SIGNALS) == NULL && errno == EINVAL);
+  f = fopen(path, "wb");
+  ASSERT(f && fputs("NANDNET", f) != EOF && fclose(f) == 0);
+  ASSERT(nand_compiled_load(path, slots, SIGNALS) == NULL && errno == EINVAL);
+  remove(path);
+  ASSERT(nand_compiled_load(path, slots, SIGNALS) == NULL && errno == ENOENT);
+  ASSERT(nand_load(path, NULL, slots, SIGNALS, &h) == -1 && errno == EINVAL);
+
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+// Wczytuje układ z tekstu o długości length (0 oznacza tekst zakończony zerem)
+// z sygnałami w tablicy s o długości n.
+static nand_compiled_t *import(char const *text, size_t length, bool blif, bool const *s,
+                               size_t n) {
+  FILE *f = fmemopen((void *)text, length ? length : strlen(text), "r");
+  assert(f);
+  nand_compiled_t *c = blif ? nand_import_blif(f, s, n) : nand_import_aiger(f, s, n);
+  int error = errno;
+  fclose(f);
+  errno = error;
+  return c;
+}
+
+static int import_formats(void) {
+  static char const aag[] = "aag 7 2 0 2 3\n2\n4\n6\n12\n6 13 15\n12 2 4\n14 3 5\ni0 x\nc\n";
+  static char const aig[] = "aig 5 2 0 2 3\n10\n6\n\x02\x02\x03\x02\x01\x02";
+  static char const blif[] =
+    "# sumator i stałe\n"
+    ".model t\n"
+    ".inputs a b \\\n c\n"
+    ".outputs f g h k p\n"
+    ".names a b c f\n11- 1\n--1 1\n"
+    ".names a g\n1 0\n"
+    ".names h\n1\n"
+    ".names k\n"
+    ".names t p\n1 1\n"
+    ".names a b t\n00 1\n"
+    ".end\n";
+  bool s_in[3] = {false}, s_out[5];
+
+  // Półsumator w obu wersjach AIGER.
+  for (int binary = 0; binary < 2; ++binary) {
+    nand_compiled_t *c = binary ? import(aig, sizeof aig - 1, false, s_in, 3)
+                                : import(aag, sizeof aag - 1, false, s_in, 3);
+    ASSERT(c && nand_compiled_number_of_signals(c) == 2);
+    for (int v = 0; v < 4; ++v) {
+      s_in[0] = v & 1, s_in[1] = v >> 1;
+      ASSERT(nand_compiled_evaluate(c, s_out) > 0);
+      ASSERT(s_out[0] == (s_in[0] != s_in[1]) && s_out[1] == (s_in[0] && s_in[1]));
+    }
+    nand_compiled_delete(c);
+  }
+
+  // Binarny AIGER bez wyjść: bramki AND następują zaraz po nagłówku, także gdy
+  // pierwszy bajt to znak nowej linii.
+  static char const aig_no_outputs[] = "aig 3 1 0 0 2\n\x02\x00\x02\x01";
+  static char const aig_newline[] = "aig 5 4 0 0 1\n\x0a\x00";
+  bool s_four[4] = {false};
+  nand_compiled_t *empty = import(aig_no_outputs, sizeof aig_no_outputs - 1, false, s_in, 3);
+  ASSERT(empty && nand_compiled_number_of_signals(empty) == 1);
+  ASSERT(nand_compiled_evaluate(empty, s_out) >= 0);
+  nand_compiled_delete(empty);
+  empty = import(aig_newline, sizeof aig_newline - 1, false, s_four, 4);
+  ASSERT(empty && nand_compiled_number_of_signals(empty) == 4);
+  nand_compiled_delete(empty);
+
+  // Stałe i wejście podane wprost na wyjście.
+  nand_compiled_t *c = import("aag 1 1 0 3 0\n2\n0\n1\n2\n", 0, false, s_in, 3);
+  ASSERT(c);
+  for (int v = 0; v < 2; ++v) {
+    s_in[0] = v;
+    ASSERT(nand_compiled_evaluate(c, s_out) >= 0);
+    ASSERT(!s_out[0] && s_out[1] && s_out[2] == v);
+  }
+  nand_compiled_delete(c);
+
+  c = import(blif, sizeof blif - 1, true, s_in, 3);
+  ASSERT(c && nand_compiled_number_of_signals(c) == 3);
+  for (int v = 0; v < 8; ++v) {
+    bool a = v & 1, b = (v >> 1) & 1, cc = v >> 2;
+    s_in[0] = a, s_in[1] = b, s_in[2] = cc;
+    ASSERT(nand_compiled_evaluate(c, s_out) > 0);
+    ASSERT(s_out[0] == ((a && b) || cc) && s_out[1] == !a && s_out[2] && !s_out[3]);
+    ASSERT(s_out[4] == (!a && !b));
+  }
+  nand_compiled_delete(c);
+
+  // Błędy: przerzutniki, niezdefiniowane sieci, cykle.
+  ASSERT(!import("aag 1 0 1 0 0\n2 3\n", 0, false, s_in, 3) && errno == EINVAL);
+  ASSERT(!import("aag 2 1 0 1 1\n2\n4\n4 2 6\n", 0, false, s_in, 3) && errno == EINVAL);
+  ASSERT(!import("aig 2 1 0 0 0\n", 0, false, s_in, 3) && errno == EINVAL);
+  ASSERT(!import("aag 3 1 0 1 2\n2\n4\n4 2 6\n6 4 2\n", 0, false, s_in, 3) &&
+         errno == ECANCELED);
+  ASSERT(!import(".inputs a\n.outputs b\n.latch a b 0\n.end\n", 0, true, s_in, 3) &&
+         errno == EINVAL);
+  ASSERT(!import(".outputs b\n.names a b\n1 1\n.end\n", 0, true, s_in, 3) && errno == EINVAL);
+  ASSERT(!import(".outputs x\n.names x y\n1 1\n.names y x\n0 1\n", 0, true, s_in, 3) &&
+         errno == ECANCELED);
+  ASSERT(!import(".inputs a\n.outputs b\n.names a b\n1 1\n0 0\n", 0, true, s_in, 3) &&
+         errno == EINVAL);
+  ASSERT(nand_import_blif(NULL, s_in, 3) == NULL && errno == EINVAL);
+
+  // Więcej wejść, niż mieści tablica sygnałów, jest odrzucane.
+  ASSERT(!import(aag, sizeof aag - 1, false, s_in, 1) && errno == EINVAL);
+  ASSERT(!import(aig, sizeof aig - 1, false, s_in, 1) && errno == EINVAL);
+  ASSERT(!import(blif, sizeof blif - 1, true, s_in, 2) && errno == EINVAL);
+  return PASS;
+}
+
+static int optimize(void) {
+  enum { GATES = 300, SIGNALS = 4, OUTPUTS = 12 };
+  bool s[SIGNALS], s_out[OUTPUTS], s_ref[1 << SIGNALS][OUTPUTS];
+
+  // Stałe, duplikaty i podwójne negacje: usunięte są c2, c1, dbl, a3 i a2.
+  nand_t *f = nand_new(0), *t = nand_new(1), *a = nand_new(2), *a2 = nand_new(2),
+         *a3 = nand_new(3), *inv = nand_new(1), *dbl = nand_new(1), *c1 = nand_new(2),
+         *c2 = nand_new(2), *out[3] = {nand_new(3), nand_new(2), nand_new(2)};
+  ASSERT(f && t && a && a2 && a3 && inv && dbl && c1 && c2 && out[0] && out[1] && out[2]);
+  TEST_PASS(nand_connect_nand(f, t, 0));
+  TEST_PASS(nand_connect_signal(s + 0, a, 0));
+  TEST_PASS(nand_connect_signal(s + 1, a, 1));
+  TEST_PASS(nand_connect_signal(s + 1, a2, 0));
+  TEST_PASS(nand_connect_signal(s + 0, a2, 1));
+  TEST_PASS(nand_connect_signal(s + 0, a3, 0));
+  TEST_PASS(nand_connect_signal(s + 1, a3, 1));
+  TEST_PASS(nand_connect_signal(s + 0, a3, 2));
+  TEST_PASS(nand_connect_nand(a, inv, 0));
+  TEST_PASS(nand_connect_nand(inv, dbl, 0));
+  TEST_PASS(nand_connect_nand(dbl, c1, 0));
+  TEST_PASS(nand_connect_nand(t, c1, 1));
+  TEST_PASS(nand_connect_nand(a2, c2, 0));
+  TEST_PASS(nand_connect_nand(f, c2, 1));
+  TEST_PASS(nand_connect_nand(c1, out[0], 0));
+  TEST_PASS(nand_connect_nand(a3, out[0], 1));
+  TEST_PASS(nand_connect_signal(s + 2, out[0], 2));
+  TEST_PASS(nand_connect_nand(c2, out[1], 0));
+  TEST_PASS(nand_connect_signal(s + 3, out[1], 1));
+  TEST_PASS(nand_connect_nand(t, out[2], 0));
+  TEST_PASS(nand_connect_nand(t, out[2], 1));
+
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int i = 0; i < SIGNALS; ++i)
+      s[i] = v >> i & 1;
+    ASSERT(nand_evaluate(out, s_ref[v], 3) >= 0);
+  }
+  ASSERT(nand_optimize(out, 3) == 5);
+  ASSERT(nand_input(out[0], 0) == inv && nand_input(out[0], 1) == a);
+  ASSERT(nand_input(out[1], 0) == s + 3 && nand_fan_out(t) == 2);
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int i = 0; i < SIGNALS; ++i)
+      s[i] = v >> i & 1;
+    ASSERT(nand_evaluate(out, s_out, 3) >= 0);
+    ASSERT(memcmp(s_out, s_ref[v], 3) == 0);
+  }
+  ASSERT(nand_optimize(out, 3) == 0);
+  nand_delete(out[0]);
+  nand_delete(out[1]);
+  nand_delete(out[2]);
+  nand_delete(inv);
+  nand_delete(a);
+  nand_delete(t);
+  nand_delete(f);
+
+  // Losowy układ z powtórzeniami: funkcje wyjść się nie zmieniają. Usunięte
+  // bramki nie są znane, więc cały układ leży w puli.
+  nand_t *g[GATES];
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(13);
+  for (int i = 0; i < GATES; ++i) {
+    unsigned n = rand() % 10 == 0 ? 0 : 1 + rand() % 3;
+    g[i] = nand_new_in(p, n);
+    ASSERT(g[i]);
+    for (unsigned k = 0; k < n; ++k) {
+      if (i < 4 || rand() % 5 == 0)
+        TEST_PASS(nand_connect_signal(s + rand() % SIGNALS, g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[i - 1 - rand() % (i < 8 ? i : 8)], g[i], k));
+    }
+  }
+
+  nand_t **kept = g + GATES - OUTPUTS;
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int i = 0; i < SIGNALS; ++i)
+      s[i] = v >> i & 1;
+    ASSERT(nand_evaluate(kept, s_ref[v], OUTPUTS) >= 0);
+  }
+  ssize_t removed = nand_optimize(kept, OUTPUTS);
+  ASSERT(removed > 0);
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int i = 0; i < SIGNALS; ++i)
+      s[i] = v >> i & 1;
+    ASSERT(nand_evaluate(kept, s_out, OUTPUTS) >= 0);
+    ASSERT(memcmp(s_out, s_ref[v], OUTPUTS) == 0);
+  }
+  ASSERT(nand_optimize(kept, OUTPUTS) == 0);
+  nand_pool_delete(p);
+  ASSERT(nand_optimize(NULL, 1) == -1 && errno == EINVAL);
+
+  nand_t *cycle = nand_new(1);
+  ASSERT(cycle);
+  TEST_PASS(nand_connect_nand(cycle, cycle, 0));
+  TEST_ECANCELED(nand_optimize(&cycle, 1));
+  nand_delete(cycle);
+  return PASS;
+}
+
+// Porównuje nand_depth z długością ścieżki obliczoną przez nand_evaluate.
+static int same_depth(nand_t **g, int m) {
+  bool s_out;
+  for (int i = 0; i < m; ++i) {
+    errno = 0;
+    ssize_t expected = nand_evaluate(g + i, &s_out, 1);
+    int expected_errno = errno;
+    errno = 0;
+    if (nand_depth(g[i]) != expected || errno != expected_errno)
+      return FAIL;
+  }
+  return PASS;
+}
+
+static int depth(void) {
+  enum { GATES = 80, SIGNALS = 3, CHAIN = 1000 };
+  nand_t *g[GATES], *chain[CHAIN];
+  unsigned ports[GATES];
+  bool s_in[SIGNALS] = {false};
+
+  // Łańcuch: głębokość rośnie przy podłączeniu wejścia i maleje przy skróceniu.
+  for (int i = 0; i < CHAIN; ++i) {
+    chain[i] = nand_new(1);
+    ASSERT(chain[i]);
+    ASSERT(nand_depth(chain[i]) == -1 && errno == ECANCELED);
+  }
+  for (int i = CHAIN - 1; i > 0; --i)
+    TEST_PASS(nand_connect_nand(chain[i - 1], chain[i], 0));
+  TEST_PASS(nand_connect_signal(s_in, chain[0], 0));
+  ASSERT(nand_depth(chain[CHAIN - 1]) == CHAIN);
+  TEST_PASS(nand_connect_signal(s_in, chain[CHAIN / 2], 0));
+  ASSERT(nand_depth(chain[CHAIN - 1]) == CHAIN / 2);
+  ASSERT(nand_depth(chain[CHAIN / 2 - 1]) == CHAIN / 2);
+  nand_delete(chain[CHAIN - 2]);
+  ASSERT(nand_depth(chain[CHAIN - 1]) == -1 && errno == ECANCELED);
+  ASSERT(nand_depth(NULL) == -1 && errno == EINVAL);
+  for (int i = 0; i < CHAIN; ++i)
+    if (i != CHAIN - 2)
+      nand_delete(chain[i]);
+
+  // Losowe zmiany połączeń, także zamykające cykle, usuwanie bramek
+  // i połączenia hurtowe w puli.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(17);
+  for (int i = 0; i < GATES; ++i) {
+    ports[i] = rand() % 4;
+    g[i] = nand_new_in(p, ports[i]);
+    ASSERT(g[i]);
+  }
+  for (int step = 0; step < 3000; ++step) {
+    int i = rand() % GATES, j = rand() % GATES, kind = rand() % 8;
+    unsigned n = ports[i];
+    if (kind == 0) {
+      nand_delete(g[i]);
+      ports[i] = rand() % 4;
+      g[i] = nand_new_in(p, ports[i]);
+      ASSERT(g[i]);
+    }
+    else if (n == 0)
+      continue;
+    else if (kind == 1)
+      TEST_PASS(nand_connect_signal(s_in + rand() % SIGNALS, g[i], rand() % n));
+    else if (kind == 2) {
+      nand_edge_t edges[3];
+      for (int e = 0; e < 3; ++e) {
+        edges[e].g_out = rand() % 2 ? g[rand() % GATES] : NULL;
+        edges[e].s = edges[e].g_out ? NULL : s_in + rand() % SIGNALS;
+        edges[e].g_in = g[i];
+        edges[e].k = rand() % n;
+      }
+      TEST_PASS(nand_connect_many(edges, 3));
+    }
+    else if (j < i || kind == 3)
+      TEST_PASS(nand_connect_nand(g[j], g[i], rand() % n));
+    else if (nand_connect_nand_checked(g[j], g[i], rand() % n) != 0)
+      ASSERT(errno == ECANCELED);
+    ASSERT(same_depth(g, GATES) == PASS);
+  }
+  nand_pool_delete(p);
+  return PASS;
+}
+
+static int stats(void) {
+  enum { CHAIN = 10, WIDE = 3 };
+  nand_t *g[CHAIN], *a, *b;
+  nand_stats_t st, zero = {0};
+  bool s_in = true, s_out[2];
+
+  ASSERT(nand_stats(NULL) == -1 && errno == EINVAL);
+  nand_stats_reset();
+  if (nand_stats(&st) != 0) {
+    // Biblioteka skompilowana bez NAND_STATS nie liczy niczego.
+    ASSERT(errno == ENOTSUP);
+    return PASS;
+  }
+  ASSERT(memcmp(&st, &zero, sizeof st) == 0);
+
+  // Łańcuch i bramka czytająca kilka razy pierwszą bramkę łańcucha,
+  // której tablica kabli musi urosnąć.
+  for (int i = 0; i < CHAIN; ++i) {
+    g[i] = nand_new(1);
+    ASSERT(g[i]);
+    if (i == 0)
+      TEST_PASS(nand_connect_signal(&s_in, g[i], 0));
+    else
+      TEST_PASS(nand_connect_nand(g[i - 1], g[i], 0));
+  }
+  nand_t *wide = nand_new(WIDE);
+  ASSERT(wide);
+  for (int k = 0; k < WIDE; ++k)
+    TEST_PASS(nand_connect_nand(g[0], wide, k));
+  TEST_PASS(nand_stats(&st));
+  ASSERT(st.cable_regrowths >= 1);
+
+  nand_stats_reset();
+  ASSERT(nand_evaluate(g + CHAIN - 1, s_out, 1) == CHAIN);
+  TEST_PASS(nand_stats(&st));
+  ASSERT(st.evaluations == 1 && st.gates_visited == CHAIN && st.edges_traversed == CHAIN);
+  ASSERT(st.max_stack_depth >= 1 && st.max_stack_depth <= CHAIN);
+
+  // Drugie zapytanie o bramkę z aktualną pamięcią podręczną nie odwiedza bramek.
+  nand_stats_reset();
+  ASSERT(nand_evaluate_cached(g + CHAIN - 1, s_out, 1) == CHAIN);
+  ASSERT(nand_evaluate_cached(g + CHAIN - 1, s_out, 1) == CHAIN);
+  TEST_PASS(nand_stats(&st));
+  ASSERT(st.evaluations == 2 && st.gates_visited == CHAIN && st.invalidated_gates == 0);
+  TEST_PASS(nand_connect_signal(&s_in, g[CHAIN / 2], 0));
+  TEST_PASS(nand_stats(&st));
+  ASSERT(st.invalidated_gates >= CHAIN - CHAIN / 2);
+
+  // Przerwania przez pusty port i przez cykl.
+  nand_stats_reset();
+  a = nand_new(1);
+  b = nand_new(1);
+  ASSERT(a && b);
+  ASSERT(nand_evaluate(&a, s_out, 1) == -1 && errno == ECANCELED);
+  TEST_PASS(nand_connect_nand(a, b, 0));
+  TEST_PASS(nand_connect_nand(b, a, 0));
+  ASSERT(nand_evaluate(&a, s_out, 1) == -1 && errno == ECANCELED);
+  TEST_PASS(nand_stats(&st));
+  ASSERT(st.empty_port_aborts == 1 && st.cycle_aborts == 1);
+
+  nand_stats_reset();
+  TEST_PASS(nand_stats(&st));
+  ASSERT(memcmp(&st, &zero, sizeof st) == 0);
+  nand_delete(a);
+  nand_delete(b);
+  nand_delete(wide);
+  for (int i = 0; i < CHAIN; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int fan_out(void) {
+  enum { LINKED = 40 };
+  nand_t *g[LINKED];
+  bool s_out[LINKED];
+
+  // Wyjście bramki w puli i poza nią rośnie z kilku do wielu kabli i maleje.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  for (int in_pool = 0; in_pool < 2; ++in_pool) {
+    nand_t *hub = in_pool ? nand_new_in(p, 0) : nand_new(0);
+    ASSERT(hub);
+    for (int i = 0; i < LINKED; ++i) {
+      g[i] = in_pool ? nand_new_in(p, 1) : nand_new(1);
+      ASSERT(g[i]);
+      TEST_PASS(nand_connect_nand(hub, g[i], 0));
+      ASSERT(nand_fan_out(hub) == i + 1 && nand_output(hub, i) == g[i]);
+    }
+    for (int i = 0; i < LINKED; ++i)
+      ASSERT(nand_input(g[i], 0) == hub);
+    ASSERT(nand_evaluate(g, s_out, LINKED) == 1 && s_out[LINKED - 1]);
+
+    for (int i = 0; i < LINKED; i += 2)
+      nand_delete(g[i]);
+    ASSERT(nand_fan_out(hub) == LINKED / 2);
+    for (int i = 0; i < LINKED / 2; ++i)
+      ASSERT(nand_input(nand_output(hub, i), 0) == hub);
+
+    nand_delete(hub);
+    for (int i = 1; i < LINKED; i += 2)
+      ASSERT(nand_input(g[i], 0) == NULL);
+    for (int i = 1; i < LINKED; i += 2)
+      nand_delete(g[i]);
+  }
+  nand_pool_delete(p);
+  return PASS;
+}
+
+static int many(void) {
+  enum { GATES = 300, SIGNALS = 5, EDGES = 3 * GATES };
+  nand_t *g[GATES], *h[GATES];
+  unsigned n[GATES];
+  bool s_in[SIGNALS], s_out[GATES], s_ref[GATES];
+  static nand_edge_t e[EDGES], f[EDGES];
+  size_t m = 0;
+
+  srand(5);
+  for (int i = 0; i < GATES; ++i) {
+    n[i] = rand() % 4;
+    h[i] = nand_new(n[i]);
+    assert(h[i]);
+  }
+  TEST_PASS(nand_new_many(NULL, g, GATES, n));
+
+  // Krawędzie losowego układu bez cykli. Do niektórych portów prowadzi kilka
+  // krawędzi, wtedy liczy się ostatnia. Część portów jest połączona wcześniej.
+  for (int i = 0; i < GATES; ++i) {
+    for (unsigned k = 0; k < n[i]; ++k) {
+      int copies = rand() % 4 == 0 ? 2 : 1;
+      for (int c = 0; c < copies; ++c) {
+        int j = i == 0 || rand() % 3 == 0 ? -1 - rand() % SIGNALS : rand() % i;
+        e[m] = (nand_edge_t){j < 0 ? NULL : g[j], j < 0 ? s_in - 1 - j : NULL, g[i], k};
+        f[m] = (nand_edge_t){j < 0 ? NULL : h[j], j < 0 ? s_in - 1 - j : NULL, h[i], k};
+        ++m;
+      }
+      if (rand() % 5 == 0) {
+        int j = i == 0 ? -1 : rand() % i;
+        if (j < 0) {
+          TEST_PASS(nand_connect_signal(s_in, g[i], k));
+          TEST_PASS(nand_connect_signal(s_in, h[i], k));
+        } else {
+          TEST_PASS(nand_connect_nand(g[j], g[i], k));
+          TEST_PASS(nand_connect_nand(h[j], h[i], k));
+        }
+      }
+    }
+  }
+
+  // Błędna krawędź – nic nie zostaje połączone.
+  nand_edge_t wrong = e[m - 1];
+  e[m - 1].k = 7;
+  errno = 0;
+  ASSERT(nand_connect_many(e, m) == -1 && errno == EINVAL);
+  e[m - 1] = wrong;
+  errno = 0;
+  ASSERT(nand_connect_many(e, 0) == 0 && nand_connect_many(NULL, 1) == -1 && errno == EINVAL);
+
+  TEST_PASS(nand_connect_many(e, m));
+  for (size_t i = 0; i < m; ++i) {
+    if (f[i].g_out)
+      TEST_PASS(nand_connect_nand(f[i].g_out, f[i].g_in, f[i].k));
+    else
+      TEST_PASS(nand_connect_signal(f[i].s, f[i].g_in, f[i].k));
+  }
+
+  for (int i = 0; i < GATES; ++i) {
+    ASSERT(nand_fan_out(g[i]) == nand_fan_out(h[i]));
+    for (unsigned k = 0; k < n[i]; ++k) {
+      void *in_g = nand_input(g[i], k), *in_h = nand_input(h[i], k);
+      ASSERT(in_g != NULL && in_h != NULL);
+      if ((bool *)in_h >= s_in && (bool *)in_h < s_in + SIGNALS)
+        ASSERT(in_g == in_h);
+    }
+  }
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = (v >> j) & 1;
+    ssize_t path = nand_evaluate(h, s_ref, GATES);
+    ASSERT(path >= 0);
+    ASSERT(nand_evaluate(g, s_out, GATES) == path);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  for (int i = 0; i < GATES; ++i) {
+    nand_delete(g[i]);
+    nand_delete(h[i]);
+  }
+  return PASS;
+}
+
+static int circuit(void) {
+  enum { GATES = 300, SIGNALS = 6, OUTPUTS = 30 };
+  nand_t *g[GATES];
+  uint32_t h[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  // Ten sam losowy układ ze wskaźników i w zwartej reprezentacji.
+  nand_circuit_t *c = nand_circuit_new();
+  ASSERT(c);
+  srand(17);
+  for (int i = 0; i < GATES; ++i) {
+    unsigned n = rand() % 4;
+    g[i] = nand_new(n);
+    ssize_t handle = nand_circuit_add(c, n);
+    ASSERT(g[i] && handle == i);
+    h[i] = handle;
+    for (unsigned k = 0; k < n; ++k) {
+      if (i == 0 || rand() % 3 == 0) {
+        int j = rand() % SIGNALS;
+        TEST_PASS(nand_connect_signal(s_in + j, g[i], k));
+        TEST_PASS(nand_circuit_connect_signal(c, s_in + j, h[i], k));
+      } else {
+        int j = rand() % i;
+        TEST_PASS(nand_connect_nand(g[j], g[i], k));
+        TEST_PASS(nand_circuit_connect_nand(c, h[j], h[i], k));
+      }
+    }
+  }
+
+  // Przełączanie portów między bramkami i sygnałami.
+  for (int r = 0; r < GATES; ++r) {
+    int i = 1 + rand() % (GATES - 1);
+    unsigned n = rand() % 4;
+    errno = 0;
+    if (nand_input(g[i], n) == NULL && errno == EINVAL)
+      continue;
+    if (rand() % 2) {
+      int j = rand() % i;
+      TEST_PASS(nand_connect_nand(g[j], g[i], n));
+      TEST_PASS(nand_circuit_connect_nand(c, h[j], h[i], n));
+    } else {
+      TEST_PASS(nand_connect_signal(s_in, g[i], n));
+      TEST_PASS(nand_circuit_connect_signal(c, s_in, h[i], n));
+    }
+  }
+  for (int i = 0; i < GATES; ++i)
+    ASSERT(nand_circuit_fan_out(c, h[i]) == nand_fan_out(g[i]));
+
+  nand_t **g_out = g + GATES - OUTPUTS;
+  uint32_t *h_out = h + GATES - OUTPUTS;
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = (v >> j) & 1;
+    ssize_t path = nand_evaluate(g_out, s_ref, OUTPUTS);
+    ASSERT(path >= 0);
+    ASSERT(nand_circuit_evaluate(c, h_out, s_out, OUTPUTS) == path);
+    ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+  }
+
+  // Te same błędy co przy nand_evaluate.
+  uint32_t wrong = GATES;
+  errno = 0;
+  ASSERT(nand_circuit_evaluate(c, &wrong, s_out, 1) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_circuit_connect_nand(c, h[0], h[0], 7) == -1 && errno == EINVAL);
+  ssize_t loop = nand_circuit_add(c, 2);
+  ASSERT(loop == GATES);
+  h[0] = loop;
+  errno = 0;
+  ASSERT(nand_circuit_evaluate(c, h, s_out, 1) == -1 && errno == ECANCELED);
+  TEST_PASS(nand_circuit_connect_nand(c, h[0], h[0], 0));
+  TEST_PASS(nand_circuit_connect_signal(c, s_in, h[0], 1));
+  errno = 0;
+  ASSERT(nand_circuit_evaluate(c, h, s_out, 1) == -1 && errno == ECANCELED);
+  ASSERT(nand_circuit_evaluate(c, h_out, s_out, OUTPUTS) >= 0);
+  ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+
+  nand_circuit_delete(c);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int parallel(void) {
+  enum { GATES = 2000, SIGNALS = 6, OUTPUTS = 500 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  srand(23);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+
+  nand_t **out = g + GATES - OUTPUTS;
+  for (int v = 0; v < 1 << SIGNALS; v += 5) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = (v >> j) & 1;
+    ssize_t path = nand_evaluate(out, s_ref, OUTPUTS);
+    ASSERT(path >= 0);
+    for (unsigned threads = 0; threads <= 8; threads += 1 + threads) {
+      ASSERT(nand_evaluate_parallel(out, s_out, OUTPUTS, threads) == path);
+      ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+    }
+  }
+
+  // Cykl przez bramki liczone przez różne wątki i pusty port.
+  nand_t *h[2];
+  h[0] = nand_new(2);
+  h[1] = nand_new(1);
+  assert(h[0] && h[1]);
+  TEST_PASS(nand_connect_nand(out[0], h[0], 0));
+  TEST_PASS(nand_connect_nand(h[1], h[0], 1));
+  TEST_PASS(nand_connect_nand(h[0], h[1], 0));
+  for (unsigned threads = 1; threads <= 8; threads *= 2) {
+    errno = 0;
+    ASSERT(nand_evaluate_parallel(h, s_out, 2, threads) == -1 && errno == ECANCELED);
+  }
+  nand_delete(h[1]);
+  errno = 0;
+  ASSERT(nand_evaluate_parallel(h, s_out, 1, 4) == -1 && errno == ECANCELED);
+  errno = 0;
+  ASSERT(nand_evaluate_parallel(NULL, s_out, 1, 4) == -1 && errno == EINVAL);
+
+  // Po błędach zwykłe obliczenie daje te same wyniki.
+  ASSERT(nand_evaluate_parallel(out, s_out, OUTPUTS, 3) == nand_evaluate(out, s_ref, OUTPUTS));
+  ASSERT(memcmp(s_out, s_ref, sizeof s_out) == 0);
+
+  nand_delete(h[0]);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int deep(void) {
+  size_t const n = 1000000;
+  nand_t **g = malloc(n * sizeof (nand_t *));
+  bool s_in = true, s_out[2];
+  assert(g);
+
+  for (size_t i = 0; i < n; ++i) {
+    g[i] = nand_new(1);
+    assert(g[i]);
+    if (i == 0)
+      TEST_PASS(nand_connect_signal(&s_in, g[i], 0));
+    else
+      TEST_PASS(nand_connect_nand(g[i - 1], g[i], 0));
+  }
+
+  nand_t *out[2] = {g[n - 1], g[n / 2]};
+  ASSERT(nand_evaluate(out, s_out, 2) == (ssize_t)n);
+  ASSERT(s_out[0] == true && s_out[1] == false);
+  ASSERT(nand_evaluate_cached(out, s_out, 2) == (ssize_t)n);
+  ASSERT(s_out[0] == true && s_out[1] == false);
+
+  s_in = false;
+  nand_signal_changed(&s_in);
+  ASSERT(nand_evaluate_cached(out, s_out, 2) == (ssize_t)n);
+  ASSERT(s_out[0] == false && s_out[1] == true);
+
+  TEST_PASS(nand_connect_nand(g[n - 1], g[0], 0));
+  TEST_ECANCELED(nand_evaluate(out, s_out, 2));
+  TEST_ECANCELED(nand_evaluate_cached(out, s_out, 2));
+
+  for (size_t i = 0; i < n; ++i)
+    nand_delete(g[i]);
+  free(g);
+  return PASS;
+}
+
+// Wartość bramki rodzaju kind o n wejściach v, liczona wprost z definicji.
+static bool kind_value(int kind, unsigned n, uint64_t table, bool const *v) {
+  unsigned count = 0, bits = 0;
+  for (unsigned k = 0; k < n; ++k) {
+    count += v[k];
+    bits |= (unsigned)v[k] << k;
+  }
+  switch (kind) {
+    case NAND_KIND_AND: return count == n;
+    case NAND_KIND_OR: return count > 0;
+    case NAND_KIND_XOR: return count & 1;
+    case NAND_KIND_MUX: return v[0] ? v[2] : v[1];
+    case NAND_KIND_LUT: return table >> bits & 1;
+    default: return count < n;
+  }
+}
+
+static int kinds(void) {
+  enum { GATES = 400, SIGNALS = 6, OUTPUTS = 100, WORDS = 1 };
+  nand_t *g[GATES];
+  int kind[GATES], input[GATES][6];
+  unsigned ports[GATES];
+  uint64_t table[GATES];
+  bool s[SIGNALS], s_out[GATES], value[GATES], flipped[GATES];
+
+  // Losowy układ bramek wszystkich rodzajów; input < 0 to sygnał -1 - input.
+  // Usunięte przez optymalizację bramki nie są znane, więc cały układ leży w puli.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(29);
+  for (int i = 0; i < GATES; ++i) {
+    kind[i] = rand() % 6;
+    ports[i] = kind[i] == NAND_KIND_MUX ? 3 : rand() % 7;
+    table[i] = (uint64_t)rand() << 33 ^ (uint64_t)rand() << 11 ^ (uint64_t)rand();
+    g[i] = nand_new_kind(p, kind[i], ports[i], table[i]);
+    ASSERT(g[i] && nand_kind(g[i]) == kind[i]);
+    for (unsigned k = 0; k < ports[i]; ++k) {
+      input[i][k] = i < 4 || rand() % 4 == 0 ? -1 - rand() % SIGNALS : rand() % i;
+      if (input[i][k] < 0)
+        TEST_PASS(nand_connect_signal(s - 1 - input[i][k], g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[input[i][k]], g[i], k));
+    }
+  }
+
+  // Wszystkie sposoby obliczania dają wartości z definicji.
+  nand_t **out = g + GATES - OUTPUTS;
+  nand_compiled_t *c = nand_compile(out, OUTPUTS);
+  ASSERT(c);
+  size_t signals = nand_compiled_number_of_signals(c);
+  uint64_t in[SIGNALS][WORDS], lanes_out[OUTPUTS][WORDS];
+  for (size_t j = 0; j < signals; ++j)
+    for (int v = 0; v < 1 << SIGNALS; ++v)
+      if (v >> (nand_compiled_signal(c, j) - s) & 1)
+        in[j][v / 64] |= (uint64_t)1 << v % 64;
+      else
+        in[j][v / 64] &= ~((uint64_t)1 << v % 64);
+  ASSERT(nand_compiled_evaluate_lanes(c, in[0], lanes_out[0], WORDS) >= 0);
+
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s[j] = v >> j & 1;
+    for (int i = 0; i < GATES; ++i) {
+      bool x[6];
+      for (unsigned k = 0; k < ports[i]; ++k)
+        x[k] = input[i][k] < 0 ? s[-1 - input[i][k]] : value[input[i][k]];
+      value[i] = kind_value(kind[i], ports[i], table[i], x);
+    }
+    bool *ref = value + GATES - OUTPUTS;
+    ASSERT(nand_evaluate(g, s_out, GATES) >= 0);
+    ASSERT(memcmp(s_out, value, GATES) == 0);
+    for (int j = 0; j < SIGNALS; ++j)
+      nand_signal_changed(s + j);
+    ASSERT(nand_evaluate_cached(out, s_out, OUTPUTS) >= 0);
+    ASSERT(memcmp(s_out, ref, OUTPUTS) == 0);
+    ASSERT(nand_evaluate_parallel(out, s_out, OUTPUTS, 3) >= 0);
+    ASSERT(memcmp(s_out, ref, OUTPUTS) == 0);
+    ASSERT(nand_compiled_evaluate(c, s_out) >= 0);
+    ASSERT(memcmp(s_out, ref, OUTPUTS) == 0);
+    for (int i = 0; i < OUTPUTS; ++i)
+      ASSERT((lanes_out[i][v / 64] >> v % 64 & 1) == ref[i]);
+  }
+  nand_compiled_delete(c);
+
+  // Zmiany pojedynczych sygnałów.
+  ASSERT(nand_evaluate_cached(g, value, GATES) >= 0);
+  for (int step = 0; step < 50; ++step) {
+    int j = rand() % SIGNALS;
+    ssize_t n = nand_signal_set(s + j, !s[j], g, flipped, GATES);
+    ASSERT(nand_evaluate(g, s_out, GATES) >= 0);
+    ssize_t count = 0;
+    for (int i = 0; i < GATES; ++i) {
+      ASSERT(flipped[i] == (s_out[i] != value[i]));
+      count += flipped[i];
+    }
+    ASSERT(n == count);
+    memcpy(value, s_out, GATES);
+  }
+
+  // Optymalizacja zostawia bramki innych rodzajów i nie zmienia funkcji.
+  bool s_ref[1 << SIGNALS][OUTPUTS];
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s[j] = v >> j & 1;
+    ASSERT(nand_evaluate(out, s_ref[v], OUTPUTS) >= 0);
+  }
+  ASSERT(nand_optimize(out, OUTPUTS) >= 0);
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s[j] = v >> j & 1;
+    ASSERT(nand_evaluate(out, s_out, OUTPUTS) >= 0);
+    ASSERT(memcmp(s_out, s_ref[v], OUTPUTS) == 0);
+  }
+  nand_pool_delete(p);
+
+  // Sumator pełny z dwóch tablic: suma 0x96 i przeniesienie 0xE8.
+  bool abc[3];
+  nand_t *add[2] = {nand_new_kind(NULL, NAND_KIND_LUT, 3, 0x96),
+                    nand_new_kind(NULL, NAND_KIND_LUT, 3, 0xE8)};
+  ASSERT(add[0] && add[1]);
+  for (unsigned k = 0; k < 3; ++k) {
+    TEST_PASS(nand_connect_signal(abc + k, add[0], k));
+    TEST_PASS(nand_connect_signal(abc + k, add[1], k));
+  }
+  ASSERT(nand_input(add[1], 2) == abc + 2 && nand_fan_out(add[0]) == 0);
+  for (int v = 0; v < 8; ++v) {
+    for (int k = 0; k < 3; ++k)
+      abc[k] = v >> k & 1;
+    int sum = (v & 1) + (v >> 1 & 1) + (v >> 2);
+    ASSERT(nand_evaluate(add, s_out, 2) == 1);
+    ASSERT(s_out[0] == (sum & 1) && s_out[1] == (sum >> 1));
+  }
+  nand_delete(add[0]);
+  nand_delete(add[1]);
+
+  // Niepoprawne rodzaje i liczby wejść.
+  errno = 0;
+  ASSERT(nand_new_kind(NULL, NAND_KIND_MUX, 2, 0) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_new_kind(NULL, NAND_KIND_LUT, 7, 0) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_new_kind(NULL, (nand_kind_t)7, 1, 0) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_kind(NULL) == -1 && errno == EINVAL);
+  nand_t *h = nand_new(1);
+  ASSERT(h && nand_kind(h) == NAND_KIND_NAND);
+  nand_delete(h);
+  return PASS;
+}
+
+// Sumator pełny z 9 bramek NAND w module o wejściach a, b, c i wyjściach suma, przeniesienie.
+static nand_module_t *adder_module(void) {
+  nand_module_t *m = nand_module_new(3, 2);
+  if (!m)
+    return NULL;
+  ssize_t g[9];
+  for (int i = 0; i < 9; ++i)
+    if ((g[i] = nand_module_add(m, 2)) < 0)
+      return NULL;
+  // t1 = a|b, x = a ^ b, t4 = x|c, suma = x ^ c, przeniesienie = t1|t4.
+  if (nand_module_connect_input(m, 0, g[0], 0) || nand_module_connect_input(m, 1, g[0], 1) ||
+      nand_module_connect_input(m, 0, g[1], 0) || nand_module_connect(m, g[0], g[1], 1) ||
+      nand_module_connect_input(m, 1, g[2], 0) || nand_module_connect(m, g[0], g[2], 1) ||
+      nand_module_connect(m, g[1], g[3], 0) || nand_module_connect(m, g[2], g[3], 1) ||
+      nand_module_connect(m, g[3], g[4], 0) || nand_module_connect_input(m, 2, g[4], 1) ||
+      nand_module_connect(m, g[3], g[5], 0) || nand_module_connect(m, g[4], g[5], 1) ||
+      nand_module_connect_input(m, 2, g[6], 0) || nand_module_connect(m, g[4], g[6], 1) ||
+      nand_module_connect(m, g[5], g[7], 0) || nand_module_connect(m, g[6], g[7], 1) ||
+      nand_module_connect(m, g[0], g[8], 0) || nand_module_connect(m, g[4], g[8], 1) ||
+      nand_module_set_output(m, 0, g[7]) || nand_module_set_output(m, 1, g[8]))
+    return NULL;
+  return m;
+}
+
+// Sumator bits-bitowy z instancji sub (sumatora bits / parts bitów) w module o wejściach
+// a_0, ..., b_0, ..., przeniesienie i wyjściach suma_0, ..., przeniesienie.
+static nand_module_t *ripple_module(nand_module_t *sub, unsigned bits, unsigned parts) {
+  unsigned w = bits / parts;
+  nand_module_t *m = nand_module_new(2 * bits + 1, bits + 1);
+  if (!m)
+    return NULL;
+  ssize_t previous = -1;
+  for (unsigned i = 0; i < parts; ++i) {
+    ssize_t v = nand_module_instance(m, sub);
+    if (v < 0)
+      return NULL;
+    for (unsigned k = 0; k < w; ++k)
+      if (nand_module_connect_input(m, i * w + k, v, k) ||
+          nand_module_connect_input(m, bits + i * w + k, v, w + k) ||
+          nand_module_set_output(m, i * w + k, v + k))
+        return NULL;
+    if (previous < 0 ? nand_module_connect_input(m, 2 * bits, v, 2 * w)
+                     : nand_module_connect(m, previous + w, v, 2 * w))
+      return NULL;
+    previous = v;
+  }
+  if (nand_module_set_output(m, bits, previous + w))
+    return NULL;
+  return m;
+}
+
+static int modules(void) {
+  // Hierarchia: sumator pełny, sumator 8-bitowy z 8 instancji i 32-bitowy z 4 instancji.
+  nand_module_t *full = adder_module();
+  ASSERT(full);
+  nand_module_t *inner = nand_module_new(3, 2);
+  ASSERT(inner);
+  ssize_t v = nand_module_instance(inner, full);
+  ASSERT(v == 0);
+  for (unsigned k = 0; k < 3; ++k)
+    TEST_PASS(nand_module_connect_input(inner, k, v, k));
+  TEST_PASS(nand_module_set_output(inner, 0, v));
+  TEST_PASS(nand_module_set_output(inner, 1, v + 1));
+  nand_module_t *byte = ripple_module(inner, 8, 8);
+  ASSERT(byte);
+  nand_module_t *word = ripple_module(byte, 32, 4);
+  ASSERT(word);
+
+  bool in[65], out[33];
+  srand(31);
+  for (int step = 0; step < 200; ++step) {
+    uint64_t a = (uint64_t)rand() << 1 ^ rand(), b = (uint64_t)rand() << 1 ^ rand();
+    a &= 0xFFFFFFFF, b &= 0xFFFFFFFF;
+    bool carry = step % 2;
+    for (int i = 0; i < 32; ++i) {
+      in[i] = a >> i & 1;
+      in[32 + i] = b >> i & 1;
+    }
+    in[64] = carry;
+    // Najdłuższa ścieżka jak w spłaszczonym układzie: 6 bramek w pierwszym
+    // sumatorze pełnym i po 2 na przeniesienie w każdym następnym.
+    ASSERT(nand_module_evaluate(word, in, out) == 6 + 2 * 31);
+    uint64_t sum = a + b + carry;
+    for (int i = 0; i <= 32; ++i)
+      ASSERT(out[i] == (sum >> i & 1));
+  }
+
+  // Zmiana definicji zmienia wszystkie instancje: suma zamieniona z przeniesieniem.
+  TEST_PASS(nand_module_set_output(inner, 0, v + 1));
+  TEST_PASS(nand_module_set_output(inner, 1, v));
+  // Dla a = b = 255 każdy sumator daje przeniesienie 1, a dalej idzie suma 0.
+  for (int i = 0; i < 17; ++i)
+    in[i] = i < 16;
+  ASSERT(nand_module_evaluate(byte, in, out) >= 0);
+  for (int i = 0; i < 9; ++i)
+    ASSERT(out[i] == (i < 8));
+  TEST_PASS(nand_module_set_output(inner, 0, v));
+  TEST_PASS(nand_module_set_output(inner, 1, v + 1));
+
+  // Cykl przez instancję, pusty port i nieustawione wyjście.
+  nand_module_t *bad = nand_module_new(1, 1);
+  ASSERT(bad);
+  ssize_t u = nand_module_instance(bad, full);
+  ASSERT(u >= 0);
+  TEST_PASS(nand_module_set_output(bad, 0, u));
+  TEST_ECANCELED(nand_module_evaluate(bad, in, out));
+  TEST_PASS(nand_module_connect_input(bad, 0, u, 0));
+  TEST_PASS(nand_module_connect_input(bad, 0, u, 1));
+  TEST_PASS(nand_module_connect(bad, u + 1, u, 2));
+  TEST_ECANCELED(nand_module_evaluate(bad, in, out));
+  ssize_t g = nand_module_add(bad, 0);
+  ASSERT(g >= 0);
+  TEST_PASS(nand_module_connect(bad, g, u, 2));
+  in[0] = true;
+  ASSERT(nand_module_evaluate(bad, in, out) == 6 && out[0] == false);
+  nand_module_t *unset = nand_module_new(0, 2);
+  ASSERT(unset);
+  TEST_PASS(nand_module_set_output(unset, 1, nand_module_add(unset, 0)));
+  TEST_ECANCELED(nand_module_evaluate(unset, NULL, out));
+
+  // Niepoprawne argumenty i hierarchia z cyklem.
+  errno = 0;
+  ASSERT(nand_module_instance(full, word) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_instance(full, full) == -1 && errno == EINVAL);
+  errno = 0;
+  nand_module_t *empty = nand_module_new(0, 0);
+  ASSERT(empty);
+  ASSERT(nand_module_instance(full, empty) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_evaluate(empty, NULL, out) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_connect(bad, g, g, 0) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_connect(bad, u + 1, u + 1, 0) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_connect_input(bad, 1, u, 0) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_set_output(bad, 1, u) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_evaluate(full, NULL, out) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_module_add(NULL, 1) == -1 && errno == EINVAL);
+
+  nand_module_delete(empty);
+  nand_module_delete(unset);
+  nand_module_delete(bad);
+  nand_module_delete(word);
+  nand_module_delete(byte);
+  nand_module_delete(inner);
+  nand_module_delete(full);
+  return PASS;
+}
+
+// Stan wątku czytającego w teście contexts.
+typedef struct {
+  nand_t **out;
+  int outputs;
+  bool const *ref;
+  ssize_t path;
+  int steps;
+  int result;
+} reader_t;
+
+// Wątek czytający: wynik każdego obliczenia w swoim kontekście musi być poprawny.
+static void *reader(void *arg) {
+  reader_t *r = arg;
+  bool s_out[64];
+  nand_context_t *c = nand_context_new();
+  r->result = c ? PASS : FAIL;
+  for (int step = 0; step < r->steps && r->result == PASS; ++step)
+    if (nand_evaluate_in(c, r->out, s_out, r->outputs) != r->path ||
+        memcmp(s_out, r->ref, r->outputs) != 0)
+      r->result = FAIL;
+  nand_context_delete(c);
+  return NULL;
+}
+
+static int contexts(void) {
+  enum { GATES = 1000, SIGNALS = 6, OUTPUTS = 64, READERS = 4 };
+  nand_t *g[GATES];
+  bool s_in[SIGNALS], s_out[OUTPUTS], s_ref[OUTPUTS];
+
+  srand(37);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+  nand_t *lut = nand_new_kind(NULL, NAND_KIND_LUT, 3, 0x96);
+  ASSERT(lut);
+  for (unsigned k = 0; k < 3; ++k)
+    TEST_PASS(nand_connect_nand(g[GATES - 1 - k], lut, k));
+
+  // Te same wyniki i długości ścieżek co nand_evaluate, także dla rodzajów bramek.
+  nand_context_t *c = nand_context_new();
+  ASSERT(c);
+  nand_t **out = g + GATES - OUTPUTS;
+  for (int v = 0; v < 1 << SIGNALS; ++v) {
+    for (int j = 0; j < SIGNALS; ++j)
+      s_in[j] = v >> j & 1;
+    ssize_t path = nand_evaluate(out, s_ref, OUTPUTS);
+    ASSERT(path >= 0);
+    ASSERT(nand_evaluate_in(c, out, s_out, OUTPUTS) == path);
+    ASSERT(memcmp(s_out, s_ref, OUTPUTS) == 0);
+    ASSERT(nand_evaluate_in(c, &lut, s_out, 1) == nand_evaluate(&lut, s_ref, 1));
+    ASSERT(s_out[0] == s_ref[0]);
+  }
+
+  // Czytelnicy w wielu wątkach, a w tym czasie pisarz przełącza wejścia bramki
+  // między dwiema bramkami o tej samej funkcji, tworzy i usuwa bramki.
+  nand_t *twin[2] = {nand_new(2), nand_new(2)}, *reading = nand_new(2);
+  ASSERT(twin[0] && twin[1] && reading);
+  for (int t = 0; t < 2; ++t) {
+    TEST_PASS(nand_connect_signal(s_in + 0, twin[t], 0));
+    TEST_PASS(nand_connect_nand(g[10], twin[t], 1));
+  }
+  TEST_PASS(nand_connect_nand(twin[0], reading, 0));
+  TEST_PASS(nand_connect_nand(twin[0], reading, 1));
+  nand_t *read[OUTPUTS];
+  memcpy(read, out, sizeof read);
+  read[0] = reading;
+  ssize_t path = nand_evaluate(read, s_ref, OUTPUTS);
+  ASSERT(path >= 0);
+
+  pthread_t threads[READERS];
+  reader_t readers[READERS];
+  for (int i = 0; i < READERS; ++i) {
+    readers[i] = (reader_t){read, OUTPUTS, s_ref, path, 300, FAIL};
+    ASSERT(pthread_create(threads + i, NULL, reader, readers + i) == 0);
+  }
+  for (int step = 0; step < 300; ++step) {
+    TEST_PASS(nand_connect_nand(twin[step % 2], reading, step / 2 % 2));
+    nand_t *extra = nand_new(1);
+    ASSERT(extra);
+    TEST_PASS(nand_connect_nand(reading, extra, 0));
+    nand_delete(extra);
+  }
+  for (int i = 0; i < READERS; ++i) {
+    ASSERT(pthread_join(threads[i], NULL) == 0);
+    ASSERT(readers[i].result == PASS);
+  }
+
+  // Błędy: cykl, pusty port i niepoprawne argumenty.
+  nand_t *h = nand_new(2);
+  ASSERT(h);
+  TEST_PASS(nand_connect_nand(h, h, 0));
+  TEST_ECANCELED(nand_evaluate_in(c, &h, s_out, 1));
+  TEST_PASS(nand_connect_signal(s_in, h, 0));
+  TEST_ECANCELED(nand_evaluate_in(c, &h, s_out, 1));
+  TEST_PASS(nand_connect_signal(s_in, h, 1));
+  ASSERT(nand_evaluate_in(c, &h, s_out, 1) == 1 && s_out[0] == !s_in[0]);
+  errno = 0;
+  ASSERT(nand_evaluate_in(NULL, &h, s_out, 1) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_evaluate_in(c, &h, s_out, 0) == -1 && errno == EINVAL);
+  nand_t *none = NULL;
+  errno = 0;
+  ASSERT(nand_evaluate_in(c, &none, s_out, 1) == -1 && errno == EINVAL);
+
+  nand_context_delete(c);
+  nand_delete(h);
+  nand_delete(lut);
+  nand_delete(twin[0]);
+  nand_delete(twin[1]);
+  nand_delete(reading);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+static int faults(void) {
+  enum { GATES = 300, SIGNALS = 10, OUTPUTS = 30, WORDS = 19, FIRST = 8 };
+  bool s_in[SIGNALS];
+  static uint64_t in[SIGNALS][WORDS], changed[SIGNALS][WORDS];
+  static uint64_t head[SIGNALS][FIRST], tail[SIGNALS][WORDS - FIRST];
+  static uint64_t out[OUTPUTS][WORDS], ref[OUTPUTS][WORDS];
+
+  // Jedna bramka NAND i cztery wzorce: a = p & 1, b = p >> 1 & 1.
+  nand_t *h = nand_new(2);
+  ASSERT(h);
+  TEST_PASS(nand_connect_signal(s_in + 0, h, 0));
+  TEST_PASS(nand_connect_signal(s_in + 1, h, 1));
+  nand_compiled_t *c = nand_compile(&h, 1);
+  ASSERT(c && nand_compiled_number_of_signals(c) == 2);
+  uint32_t a = nand_compiled_signal(c, 0) == s_in ? 0 : 1, b = 1 - a;
+  uint64_t patterns[2];
+  patterns[a] = 0xA;
+  patterns[b] = 0xC;
+  nand_fault_t *list;
+  ASSERT(nand_fault_list(c, &list) == 6);
+  ASSERT(nand_fault_simulate(c, patterns, 1, list, 6, 1) == 6);
+  uint64_t expected[3][2] = {{3, 2}, {3, 1}, {0, 3}};
+  for (int i = 0; i < 6; ++i) {
+    uint32_t node = list[i].node;
+    ASSERT(node == (uint32_t)i / 2 && list[i].value == (i & 1) && list[i].detected);
+    ASSERT(list[i].pattern == expected[node == a ? 0 : node == b ? 1 : 2][i & 1]);
+  }
+  free(list);
+  nand_compiled_delete(c);
+  nand_delete(h);
+
+  nand_t *g[GATES];
+  srand(41);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+  c = nand_compile(g + GATES - OUTPUTS, OUTPUTS);
+  ASSERT(c);
+  size_t signals = nand_compiled_number_of_signals(c);
+  for (size_t i = 0; i < signals; ++i)
+    for (int w = 0; w < WORDS; ++w)
+      in[i][w] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  ssize_t n = nand_fault_list(c, &list);
+  ASSERT(n > 0 && (size_t)n > 2 * signals);
+  nand_fault_t *split = malloc(2 * n * sizeof *split), *threaded = split + n;
+  ASSERT(split);
+  memcpy(split, list, n * sizeof *split);
+  memcpy(threaded, list, n * sizeof *split);
+  ssize_t detected = nand_fault_simulate(c, in[0], WORDS, list, n, 1);
+  ASSERT(detected > 0 && detected <= n);
+  ASSERT(nand_fault_simulate(c, in[0], WORDS, threaded, n, 3) == detected);
+  ASSERT(memcmp(list, threaded, n * sizeof *list) == 0);
+
+  // Usterki sygnałów porównujemy z obliczeniem układu o zmienionych wejściach.
+  ASSERT(nand_compiled_evaluate_lanes(c, in[0], ref[0], WORDS) >= 0);
+  for (ssize_t f = 0; f < 2 * (ssize_t)signals; ++f) {
+    memcpy(changed, in, sizeof changed);
+    for (int w = 0; w < WORDS; ++w)
+      changed[list[f].node][w] = list[f].value ? ~(uint64_t)0 : 0;
+    ASSERT(nand_compiled_evaluate_lanes(c, changed[0], out[0], WORDS) >= 0);
+    uint64_t first = 64 * WORDS;
+    for (int j = 0; j < OUTPUTS; ++j)
+      for (int w = WORDS - 1; w >= 0; --w)
+        if (out[j][w] != ref[j][w] && 64 * (uint64_t)w + __builtin_ctzll(out[j][w] ^ ref[j][w]) < first)
+          first = 64 * (uint64_t)w + __builtin_ctzll(out[j][w] ^ ref[j][w]);
+    ASSERT(list[f].detected == (first < 64 * WORDS));
+    ASSERT(!list[f].detected || list[f].pattern == first);
+  }
+
+  // Wzorce podane w dwóch wywołaniach, wykryte usterki są pomijane w drugim.
+  for (size_t i = 0; i < signals; ++i) {
+    memcpy(head[i], in[i], sizeof head[i]);
+    memcpy(tail[i], in[i] + FIRST, sizeof tail[i]);
+  }
+  ssize_t early = nand_fault_simulate(c, head[0], FIRST, split, n, 2);
+  ASSERT(early >= 0 && early <= detected);
+  memcpy(threaded, split, n * sizeof *split);
+  ASSERT(nand_fault_simulate(c, tail[0], WORDS - FIRST, split, n, 2) == detected);
+  for (ssize_t f = 0; f < n; ++f) {
+    ASSERT(split[f].detected == list[f].detected);
+    ASSERT(!list[f].detected ||
+           split[f].pattern + (threaded[f].detected ? 0 : 64 * FIRST) == list[f].pattern);
+  }
+
+  errno = 0;
+  ASSERT(nand_fault_simulate(NULL, in[0], WORDS, list, n, 1) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_fault_simulate(c, in[0], 0, list, n, 1) == -1 && errno == EINVAL);
+  list[0].node = (uint32_t)n;
+  errno = 0;
+  ASSERT(nand_fault_simulate(c, in[0], WORDS, list, n, 1) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_fault_list(NULL, &list) == -1 && errno == EINVAL);
+
+  free(split);
+  free(list);
+  nand_compiled_delete(c);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+// Ustawia sygnały kontrprzykładu i sprawdza, że bramki pary rzeczywiście się różnią.
+static int check_counterexample(nand_t **g1, nand_t **g2, nand_counterexample_t *x) {
+  bool v1, v2;
+  for (size_t i = 0; i < x->number_of_signals; ++i)
+    *(bool *)x->signals[i] = x->values[i];
+  ASSERT(nand_evaluate(g1 + x->output, &v1, 1) >= 0);
+  ASSERT(nand_evaluate(g2 + x->output, &v2, 1) >= 0);
+  ASSERT(v1 != v2);
+  free(x->signals);
+  free(x->values);
+  return PASS;
+}
+
+static int equivalence(void) {
+  enum { GATES = 300, SIGNALS = 10, OUTPUTS = 30, WIDE = 40 };
+  nand_t *g[GATES], *h[GATES];
+  bool s_in[WIDE] = {false};
+  nand_counterexample_t x;
+
+  // Ten sam losowy układ zbudowany dwa razy, druga kopia (w puli, bo optymalizacja
+  // usuwa bramki) jest zoptymalizowana.
+  nand_pool_t *p = nand_pool_new();
+  ASSERT(p);
+  srand(43);
+  ASSERT(random_circuit(NULL, g, GATES, s_in, SIGNALS) == PASS);
+  srand(43);
+  ASSERT(random_circuit(p, h, GATES, s_in, SIGNALS) == PASS);
+  nand_t **g_out = g + GATES - OUTPUTS, **h_out = h + GATES - OUTPUTS;
+  ASSERT(nand_equivalent(g_out, g_out, OUTPUTS, 1, &x) == 1);
+  ASSERT(nand_equivalent(g_out, h_out, OUTPUTS, 1, &x) == 1);
+  ASSERT(nand_optimize(h_out, OUTPUTS) > 0);
+  ASSERT(nand_equivalent(g_out, h_out, OUTPUTS, 2, &x) == 1);
+  ASSERT(nand_equivalent(g_out, h_out, OUTPUTS, 2, NULL) == 1);
+
+  // Zanegowane wyjście różni się dla każdego wzorca.
+  nand_t *inverted = nand_new(1);
+  ASSERT(inverted);
+  TEST_PASS(nand_connect_nand(g_out[OUTPUTS - 1], inverted, 0));
+  nand_t *swapped[OUTPUTS];
+  memcpy(swapped, h_out, sizeof swapped);
+  swapped[OUTPUTS - 1] = inverted;
+  ASSERT(nand_equivalent(g_out, swapped, OUTPUTS, 1, &x) == 0);
+  ASSERT(x.output == OUTPUTS - 1 && check_counterexample(g_out, swapped, &x) == PASS);
+
+  // Bramka różna od stałej prawdy tylko dla wzorca samych jedynek, też z wieloma
+  // wątkami, i pochłanianie s0 & (s0 | s1) = s0, które nie wynika ze struktury.
+  nand_t *all = nand_new(SIGNALS), *zero = nand_new(0), *one = nand_new(1);
+  nand_t *not0 = nand_new(1), *not1 = nand_new(1), *or01 = nand_new(2), *absorbed = nand_new(2);
+  ASSERT(all && zero && one && not0 && not1 && or01 && absorbed);
+  for (unsigned k = 0; k < SIGNALS; ++k)
+    TEST_PASS(nand_connect_signal(s_in + k, all, k));
+  TEST_PASS(nand_connect_nand(zero, one, 0));
+  TEST_PASS(nand_connect_signal(s_in + 0, not0, 0));
+  TEST_PASS(nand_connect_signal(s_in + 1, not1, 0));
+  TEST_PASS(nand_connect_nand(not0, or01, 0));
+  TEST_PASS(nand_connect_nand(not1, or01, 1));
+  TEST_PASS(nand_connect_signal(s_in + 0, absorbed, 0));
+  TEST_PASS(nand_connect_nand(or01, absorbed, 1));
+  for (unsigned threads = 1; threads <= 4; threads *= 2) {
+    ASSERT(nand_equivalent(&all, &one, 1, threads, &x) == 0);
+    for (size_t i = 0; i < x.number_of_signals; ++i)
+      ASSERT(x.values[i]);
+    ASSERT(check_counterexample(&all, &one, &x) == PASS);
+  }
+  ASSERT(nand_equivalent(&absorbed, &not0, 1, 1, &x) == 1);
+  ASSERT(nand_equivalent(&not0, &absorbed, 1, 1, &x) == 1);
+
+  // Przy 40 sygnałach równości nie da się sprawdzić wyczerpująco.
+  nand_t *wide = nand_new(WIDE), *halves[2] = {nand_new(WIDE / 2), nand_new(WIDE / 2)};
+  nand_t *inverters[2] = {nand_new(1), nand_new(1)}, *joined = nand_new(2);
+  ASSERT(wide && halves[0] && halves[1] && inverters[0] && inverters[1] && joined);
+  for (unsigned k = 0; k < WIDE; ++k) {
+    TEST_PASS(nand_connect_signal(s_in + k, wide, k));
+    TEST_PASS(nand_connect_signal(s_in + k, halves[k / (WIDE / 2)], k % (WIDE / 2)));
+  }
+  for (unsigned k = 0; k < 2; ++k) {
+    TEST_PASS(nand_connect_nand(halves[k], inverters[k], 0));
+    TEST_PASS(nand_connect_nand(inverters[k], joined, k));
+  }
+  errno = 0;
+  ASSERT(nand_equivalent(&wide, &joined, 1, 1, &x) == -1 && errno == E2BIG);
+  ASSERT(nand_equivalent(&wide, &inverters[0], 1, 1, &x) == 0);
+  ASSERT(check_counterexample(&wide, inverters, &x) == PASS);
+
+  errno = 0;
+  ASSERT(nand_equivalent(NULL, h_out, OUTPUTS, 1, &x) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_equivalent(g_out, h_out, 0, 1, &x) == -1 && errno == EINVAL);
+  nand_t *empty = nand_new(1);
+  ASSERT(empty);
+  TEST_ECANCELED(nand_equivalent(&empty, &one, 1, 1, &x));
+
+  nand_t *extra[] = {inverted, all, zero, one, not0, not1, or01, absorbed, wide, halves[0],
+                     halves[1], inverters[0], inverters[1], joined, empty};
+  for (size_t i = 0; i < sizeof extra / sizeof extra[0]; ++i)
+    nand_delete(extra[i]);
+  nand_pool_delete(p);
+  for (int i = 0; i < GATES; ++i)
+    nand_delete(g[i]);
+  return PASS;
+}
+
+// Losowy układ sekwencyjny w puli p: FLOPS przerzutników f i GATES bramek g. Wejście
+// bramki to sygnał, przerzutnik albo wcześniejsza bramka, a wejście przerzutnika to
+// sygnał albo dowolna bramka, więc układ ma sprzężenia zwrotne przez przerzutniki.
+// driver[i] < 0 to sygnał -1 - driver[i] na wejściu i-tego przerzutnika.
+enum { SEQ_GATES = 300, SEQ_FLOPS = 40, SEQ_SIGNALS = 4 };
+
+static int random_sequential(nand_pool_t *p, unsigned seed, nand_t **g, nand_t **f,
+                             int *driver, bool *s) {
+  srand(seed);
+  for (int i = 0; i < SEQ_FLOPS; ++i) {
+    f[i] = nand_new_kind(p, NAND_KIND_DFF, 1, rand() % 2);
+    ASSERT(f[i] && nand_kind(f[i]) == NAND_KIND_DFF);
+  }
+  for (int i = 0; i < SEQ_GATES; ++i) {
+    unsigned n = 1 + rand() % 3;
+    g[i] = nand_new_in(p, n);
+    ASSERT(g[i]);
+    for (unsigned k = 0; k < n; ++k) {
+      int r = rand() % 3;
+      if (r == 0 || i == 0)
+        TEST_PASS(nand_connect_signal(s + rand() % SEQ_SIGNALS, g[i], k));
+      else if (r == 1)
+        TEST_PASS(nand_connect_nand(f[rand() % SEQ_FLOPS], g[i], k));
+      else
+        TEST_PASS(nand_connect_nand(g[rand() % i], g[i], k));
+    }
+  }
+  for (int i = 0; i < SEQ_FLOPS; ++i) {
+    driver[i] = rand() % 8 == 0 ? -1 - rand() % SEQ_SIGNALS : rand() % SEQ_GATES;
+    if (driver[i] < 0)
+      TEST_PASS(nand_connect_signal(s - 1 - driver[i], f[i], 0));
+    else
+      TEST_PASS(nand_connect_nand_checked(g[driver[i]], f[i], 0));
+  }
+  return PASS;
+}
+
+static int flip_flops(void) {
+  enum { BITS = 4, CHAIN = 3, CYCLES = 100 };
+  bool s_out[SEQ_GATES], values[SEQ_GATES];
+
+  // Licznik modulo 16 od 1: bit k zmienia się, gdy wszystkie niższe bity są jedynkami.
+  // Sprzężenie zwrotne przez przerzutnik nie jest cyklem.
+  nand_t *q[BITS], *carry[BITS], *d[BITS];
+  for (int k = 0; k < BITS; ++k) {
+    q[k] = nand_new_kind(NULL, NAND_KIND_DFF, 1, k == 0);
+    carry[k] = nand_new_kind(NULL, NAND_KIND_AND, k, 0);
+    d[k] = nand_new_kind(NULL, NAND_KIND_XOR, 2, 0);
+    ASSERT(q[k] && carry[k] && d[k]);
+    ASSERT(nand_depth(q[k]) == 0);
+  }
+  for (int k = 0; k < BITS; ++k) {
+    for (int j = 0; j < k; ++j)
+      TEST_PASS(nand_connect_nand_checked(q[j], carry[k], j));
+    TEST_PASS(nand_connect_nand_checked(q[k], d[k], 0));
+    TEST_PASS(nand_connect_nand_checked(carry[k], d[k], 1));
+    TEST_PASS(nand_connect_nand_checked(d[k], q[k], 0));
+  }
+  ASSERT(nand_depth(q[BITS - 1]) == 0 && nand_depth(d[BITS - 1]) == 2);
+  nand_compiled_t *c = nand_compile(q, BITS);
+  ASSERT(c);
+  ASSERT(nand_evaluate_cached(q, s_out, BITS) == 0);
+  unsigned expected = 1;
+  for (size_t cycles = 0; cycles < 20; ++cycles) {
+    bool s_cached[BITS], s_compiled[BITS];
+    ASSERT(nand_evaluate(q, s_out, BITS) == 0);
+    ASSERT(nand_evaluate_cached(q, s_cached, BITS) == 0);
+    ASSERT(nand_compiled_evaluate(c, s_compiled) >= 0);
+    for (int k = 0; k < BITS; ++k)
+      ASSERT(s_out[k] == (expected >> k & 1) && s_cached[k] == s_out[k] &&
+             s_compiled[k] == s_out[k]);
+    TEST_PASS(nand_step(c, cycles));
+    expected = (expected + cycles) % (1 << BITS);
+  }
+  nand_compiled_delete(c);
+
+  // Rejestr przesuwny: wszystkie przerzutniki zmieniają stan jednocześnie.
+  bool in = true;
+  nand_t *chain[CHAIN];
+  for (int k = 0; k < CHAIN; ++k) {
+    chain[k] = nand_new_kind(NULL, NAND_KIND_DFF, 1, 0);
+    ASSERT(chain[k]);
+    if (k == 0)
+      TEST_PASS(nand_connect_signal(&in, chain[k], 0));
+    else
+      TEST_PASS(nand_connect_nand(chain[k - 1], chain[k], 0));
+  }
+  c = nand_compile(chain + CHAIN - 1, 1);
+  ASSERT(c && nand_compiled_number_of_signals(c) == CHAIN + 1);
+  TEST_PASS(nand_step(c, 1));
+  in = false;
+  ASSERT(nand_evaluate(chain, s_out, CHAIN) == 0);
+  ASSERT(s_out[0] && !s_out[1] && !s_out[2]);
+  TEST_PASS(nand_step(c, 2));
+  ASSERT(nand_evaluate(chain, s_out, CHAIN) == 0);
+  ASSERT(!s_out[0] && !s_out[1] && s_out[2]);
+
+  // Plik nie przechowuje przerzutników, więc wyjście będące przerzutnikiem nie jest
+  // zapisywane, a przerzutnik wewnątrz układu staje się w pliku sygnałem.
+  char const *path = "/tmp/nand_example.flip_flops";
+  remove(path);
+  errno = 0;
+  ASSERT(nand_compiled_save(c, path) == -1 && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_save(chain + CHAIN - 1, 1, path) == -1 && errno == EINVAL);
+  ASSERT(fopen(path, "rb") == NULL);
+  nand_compiled_delete(c);
+
+  nand_t *reader = nand_new(1), **h;
+  bool slots[CHAIN + 1], v_loaded, v_rebuilt;
+  ASSERT(reader);
+  TEST_PASS(nand_connect_nand(chain[CHAIN - 1], reader, 0));
+  TEST_PASS(nand_save(&reader, 1, path));
+  c = nand_compile(&reader, 1);
+  ASSERT(c && nand_compiled_number_of_signals(c) == CHAIN + 1);
+  nand_compiled_t *loaded = nand_compiled_load(path, slots, CHAIN + 1);
+  nand_pool_t *p_loaded = nand_pool_new();
+  ASSERT(loaded && p_loaded && nand_load(path, p_loaded, slots, CHAIN + 1, &h) == 1);
+  for (int cycle = 0; cycle < 2 * CHAIN; ++cycle) {
+    in = cycle % 2;
+    for (int j = 0; j < CHAIN + 1; ++j)
+      slots[j] = *nand_compiled_signal(c, j);
+    ASSERT(nand_evaluate(&reader, s_out, 1) == 1);
+    ASSERT(nand_compiled_evaluate(loaded, &v_loaded) == 1 && v_loaded == s_out[0]);
+    ASSERT(nand_evaluate(h, &v_rebuilt, 1) == 1 && v_rebuilt == s_out[0]);
+    TEST_PASS(nand_step(c, 1));
+  }
+  remove(path);
+  free(h);
+  nand_pool_delete(p_loaded);
+  nand_compiled_delete(loaded);
+  nand_compiled_delete(c);
+  nand_delete(reader);
+
+  // Losowy układ: każdy cykl nand_step zgadza się z wartościami wejść przerzutników
+  // obliczonymi przez nand_evaluate, także po zmianach sygnałów.
+  nand_pool_t *p = nand_pool_new(), *p_copy = nand_pool_new();
+  nand_t *g[SEQ_GATES], *f[SEQ_FLOPS], *g_copy[SEQ_GATES], *f_copy[SEQ_FLOPS];
+  int driver[SEQ_FLOPS];
+  bool s[SEQ_SIGNALS] = {false}, next[SEQ_FLOPS], state[SEQ_FLOPS];
+  ASSERT(p && p_copy);
+  ASSERT(random_sequential(p, 37, g, f, driver, s) == PASS);
+  ASSERT(random_sequential(p_copy, 37, g_copy, f_copy, driver, s) == PASS);
+  c = nand_compile(f, SEQ_FLOPS);
+  ASSERT(c);
+  nand_context_t *context = nand_context_new();
+  ASSERT(context);
+  for (int cycle = 0; cycle < CYCLES; ++cycle) {
+    if (cycle % 10 == 0) {
+      s[cycle / 10 % SEQ_SIGNALS] ^= true;
+      nand_signal_changed(s + cycle / 10 % SEQ_SIGNALS);
+    }
+    ASSERT(nand_evaluate(g, s_out, SEQ_GATES) >= 0);
+    for (int i = 0; i < SEQ_FLOPS; ++i)
+      next[i] = driver[i] < 0 ? s[-1 - driver[i]] : s_out[driver[i]];
+    TEST_PASS(nand_step(c, 1));
+    ASSERT(nand_evaluate(f, state, SEQ_FLOPS) == 0);
+    ASSERT(memcmp(state, next, SEQ_FLOPS) == 0);
+    ASSERT(nand_evaluate_cached(f, state, SEQ_FLOPS) == 0);
+    ASSERT(memcmp(state, next, SEQ_FLOPS) == 0);
+    ASSERT(nand_evaluate(g, s_out, SEQ_GATES) >= 0);
+    ASSERT(nand_evaluate_cached(g, values, SEQ_GATES) >= 0);
+    ASSERT(memcmp(values, s_out, SEQ_GATES) == 0);
+    ASSERT(nand_evaluate_in(context, g, values, SEQ_GATES) >= 0);
+    ASSERT(memcmp(values, s_out, SEQ_GATES) == 0);
+  }
+  nand_context_delete(context);
+  nand_compiled_delete(c);
+
+  // Kopia układu zoptymalizowana i przeliczona jednym wywołaniem dochodzi do tego
+  // samego stanu co nowy układ przeliczany cykl po cyklu.
+  ASSERT(nand_optimize(f_copy, SEQ_FLOPS) >= 0);
+  c = nand_compile(f_copy, SEQ_FLOPS);
+  ASSERT(c);
+  TEST_PASS(nand_step(c, CYCLES));
+  nand_compiled_delete(c);
+  nand_pool_delete(p);
+  p = nand_pool_new();
+  ASSERT(p);
+  ASSERT(random_sequential(p, 37, g, f, driver, s) == PASS);
+  c = nand_compile(f, SEQ_FLOPS);
+  ASSERT(c);
+  for (int cycle = 0; cycle < CYCLES; ++cycle)
+    TEST_PASS(nand_step(c, 1));
+  nand_compiled_delete(c);
+  ASSERT(nand_evaluate(f, state, SEQ_FLOPS) == 0);
+  ASSERT(nand_evaluate(f_copy, next, SEQ_FLOPS) == 0);
+  ASSERT(memcmp(state, next, SEQ_FLOPS) == 0);
+  nand_pool_delete(p);
+  nand_pool_delete(p_copy);
+
+  // Przerzutnik z pustym wejściem podaje swój stan, ale nie da się go skompilować.
+  nand_t *empty = nand_new_kind(NULL, NAND_KIND_DFF, 1, 1);
+  ASSERT(empty && nand_evaluate(&empty, s_out, 1) == 0 && s_out[0]);
+  errno = 0;
+  ASSERT(nand_compile(&empty, 1) == NULL && errno == ECANCELED);
+  errno = 0;
+  ASSERT(nand_new_kind(NULL, NAND_KIND_DFF, 2, 0) == NULL && errno == EINVAL);
+  errno = 0;
+  ASSERT(nand_step(NULL, 1) == -1 && errno == EINVAL);
+
+  nand_delete(empty);
+  for (int k = 0; k < BITS; ++k) {
+    nand_delete(q[k]);
+    nand_delete(carry[k]);
+    nand_delete(d[k]);
+  }
+  for (int k = 0; k < CHAIN; ++k)
+    nand_delete(chain[k]);
+  return PASS;
+}
+
 // Testuje reakcję implementacji na niepowodzenie alokacji pamięci.
 static unsigned long alloc_fail_test(void) {
   unsigned long visited = 0;
@@ -201,6 +2196,194 @@ static unsigned long alloc_fail_test(void) {
 }
 
 // Testuje reakcję implementacji na niepowodzenie alokacji pamięci.
+static unsigned long pool_alloc_fail_test(void) {
+  unsigned long visited = 0;
+  nand_pool_t *p;
+  nand_t *nand1, *nand2;
+  int result;
+  bool s_in[1], s_out[1];
+
+  errno = 0;
+  if ((p = nand_pool_new()) != NULL)
+    visited |= V(1, 0);
+  else if (errno == ENOMEM && (p = nand_pool_new()) != NULL)
+    visited |= V(2, 0);
+  else
+    return visited |= V(4, 0);
+
+  errno = 0;
+  if ((nand1 = nand_new_in(p, 2)) != NULL)
+    visited |= V(1, 1);
+  else if (errno == ENOMEM && (nand1 = nand_new_in(p, 2)) != NULL)
+    visited |= V(2, 1);
+  else
+    return visited |= V(4, 1);
+
+  errno = 0;
+  if ((nand2 = nand_new_in(p, 1)) != NULL)
+    visited |= V(1, 2);
+  else if (errno == ENOMEM && (nand2 = nand_new_in(p, 1)) != NULL)
+    visited |= V(2, 2);
+  else
+    return visited |= V(4, 2);
+
+  errno = 0;
+  if ((result = nand_connect_nand(nand2, nand1, 0)) == 0)
+    visited |= V(1, 3);
+  else if (result == -1 && errno == ENOMEM && nand_connect_nand(nand2, nand1, 0) == 0)
+    visited |= V(2, 3);
+  else
+    return visited |= V(4, 3);
+
+  errno = 0;
+  if ((result = nand_connect_signal(s_in, nand2, 0)) == 0)
+    visited |= V(1, 4);
+  else if (result == -1 && errno == ENOMEM && nand_connect_signal(s_in, nand2, 0) == 0)
+    visited |= V(2, 4);
+  else
+    return visited |= V(4, 4);
+
+  errno = 0;
+  if ((result = nand_connect_signal(s_in, nand1, 1)) == 0)
+    visited |= V(1, 5);
+  else if (result == -1 && errno == ENOMEM && nand_connect_signal(s_in, nand1, 1) == 0)
+    visited |= V(2, 5);
+  else
+    return visited |= V(4, 5);
+
+  s_in[0] = false;
+  if (nand_evaluate(&nand1, s_out, 1) == 2 && s_out[0] == true)
+    visited |= V(1, 6);
+  else
+    return visited |= V(4, 6);
+
+  // Pula zwalnia pamięć bramek, które nie zostały usunięte.
+  nand_delete(nand2);
+  nand_pool_delete(p);
+
+  return visited;
+}
+
+static unsigned long many_alloc_fail_test(void) {
+  unsigned long visited = 0;
+  nand_t *g[3];
+  unsigned n[3] = {2, 2, 1};
+  bool s_in[2], s_out[1];
+  int result;
+
+  errno = 0;
+  if ((result = nand_new_many(NULL, g, 3, n)) == 0)
+    visited |= V(1, 0);
+  else if (result == -1 && errno == ENOMEM && nand_new_many(NULL, g, 3, n) == 0)
+    visited |= V(2, 0);
+  else
+    return visited |= V(4, 0);
+
+  nand_edge_t first[] = {
+    {NULL, &s_in[0], g[2], 0},
+    {g[2], NULL, g[1], 0},
+    {NULL, &s_in[1], g[1], 1},
+  };
+  errno = 0;
+  if ((result = nand_connect_many(first, 3)) == 0)
+    visited |= V(1, 1);
+  else if (result == -1 && errno == ENOMEM && nand_fan_out(g[2]) == 0 &&
+           nand_input(g[1], 1) == NULL && nand_connect_many(first, 3) == 0)
+    visited |= V(2, 1);
+  else
+    return visited |= V(4, 1);
+
+  // Przełączenie portu z sygnału na bramkę i nowe połączenia.
+  nand_edge_t second[] = {
+    {g[1], NULL, g[0], 0},
+    {g[2], NULL, g[0], 1},
+    {g[2], NULL, g[1], 1},
+  };
+  errno = 0;
+  if ((result = nand_connect_many(second, 3)) == 0)
+    visited |= V(1, 2);
+  else if (result == -1 && errno == ENOMEM && nand_fan_out(g[2]) == 1 &&
+           nand_input(g[1], 1) == &s_in[1] && nand_connect_many(second, 3) == 0)
+    visited |= V(2, 2);
+  else
+    return visited |= V(4, 2);
+
+  s_in[0] = true;
+  if (nand_evaluate(g, s_out, 1) == 3 && s_out[0] == true && nand_fan_out(g[2]) == 3)
+    visited |= V(1, 3);
+  else
+    return visited |= V(4, 3);
+
+  nand_delete(g[0]);
+  nand_delete(g[1]);
+  nand_delete(g[2]);
+
+  return visited;
+}
+
+static unsigned long circuit_alloc_fail_test(void) {
+  unsigned long visited = 0;
+  nand_circuit_t *c;
+  ssize_t g[2];
+  uint32_t out;
+  int result;
+  bool s_in[1], s_out[1];
+
+  errno = 0;
+  if ((c = nand_circuit_new()) != NULL)
+    visited |= V(1, 0);
+  else if (errno == ENOMEM && (c = nand_circuit_new()) != NULL)
+    visited |= V(2, 0);
+  else
+    return visited |= V(4, 0);
+
+  for (int i = 0; i < 2; ++i) {
+    errno = 0;
+    if ((g[i] = nand_circuit_add(c, 2 - i)) == i)
+      visited |= V(1, 1 + i);
+    else if (g[i] == -1 && errno == ENOMEM && (g[i] = nand_circuit_add(c, 2 - i)) == i)
+      visited |= V(2, 1 + i);
+    else
+      return visited |= V(4, 1 + i);
+  }
+
+  errno = 0;
+  if ((result = nand_circuit_connect_nand(c, g[1], g[0], 0)) == 0)
+    visited |= V(1, 3);
+  else if (result == -1 && errno == ENOMEM && nand_circuit_fan_out(c, g[1]) == 0 &&
+           nand_circuit_connect_nand(c, g[1], g[0], 0) == 0)
+    visited |= V(2, 3);
+  else
+    return visited |= V(4, 3);
+
+  errno = 0;
+  if ((result = nand_circuit_connect_signal(c, s_in, g[1], 0)) == 0)
+    visited |= V(1, 4);
+  else if (result == -1 && errno == ENOMEM && nand_circuit_connect_signal(c, s_in, g[1], 0) == 0)
+    visited |= V(2, 4);
+  else
+    return visited |= V(4, 4);
+
+  errno = 0;
+  if ((result = nand_circuit_connect_signal(c, s_in, g[0], 1)) == 0)
+    visited |= V(1, 5);
+  else if (result == -1 && errno == ENOMEM && nand_circuit_connect_signal(c, s_in, g[0], 1) == 0)
+    visited |= V(2, 5);
+  else
+    return visited |= V(4, 5);
+
+  s_in[0] = false;
+  out = g[0];
+  if (nand_circuit_evaluate(c, &out, s_out, 1) == 2 && s_out[0] == true)
+    visited |= V(1, 6);
+  else
+    return visited |= V(4, 6);
+
+  nand_circuit_delete(c);
+
+  return visited;
+}
+
 static int memory_test(unsigned long (* test_function)(void)) {
   memory_test_data_t *mtd = get_memory_test_data();
 
@@ -238,6 +2421,18 @@ static int memory(void) {
   return memory_test(alloc_fail_test);
 }
 
+static int pool_memory(void) {
+  return memory_test(pool_alloc_fail_test);
+}
+
+static int many_memory(void) {
+  return memory_test(many_alloc_fail_test);
+}
+
+static int circuit_memory(void) {
+  return memory_test(circuit_alloc_fail_test);
+}
+
 /** URUCHAMIANIE TESTÓW **/
 
 typedef struct {
@@ -251,6 +2446,34 @@ static const test_list_t test_list[] = {
   TEST(example),
   TEST(simple),
   TEST(memory),
+  TEST(cached),
+  TEST(deep),
+  TEST(compiled),
+  TEST(lanes),
+  TEST(pool),
+  TEST(pool_memory),
+  TEST(reconnect),
+  TEST(fan_out),
+  TEST(many),
+  TEST(many_memory),
+  TEST(circuit),
+  TEST(circuit_memory),
+  TEST(parallel),
+  TEST(epoch),
+  TEST(signal_set),
+  TEST(checked),
+  TEST(file),
+  TEST(import_formats),
+  TEST(optimize),
+  TEST(depth),
+  TEST(stats),
+  TEST(jit),
+  TEST(kinds),
+  TEST(modules),
+  TEST(contexts),
+  TEST(faults),
+  TEST(equivalence),
+  TEST(flip_flops),
 };
 
 static int do_test(int (*function)(void)) {
@@ -0,0 +1,462 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <pthread.h> // For pthread_create, pthread_join.
+#include <stdint.h> // For uint32_t, uint64_t.
+#include <stdlib.h> // For malloc, calloc, free.
+#include <string.h> // For memcpy, memset.
+#include <unistd.h> // For sysconf.
+
+// Number of 64-bit words of patterns simulated together.
+#define FAULT_WORDS 4
+
+// Number of faults taken at once by a thread.
+#define FAULTS_PER_TAKE 64
+
+/**@brief Block of FAULT_WORDS words of one node, bit p of the block is its value
+ * under the pattern p of the block.
+ */
+typedef uint64_t block_t __attribute__((vector_size(FAULT_WORDS * sizeof(uint64_t))));
+
+typedef struct fault_worker fault_worker_t;
+
+/**@brief State of nand_fault_simulate shared by all threads.
+ * c                 - the simulated system.
+ * fan_out_offsets   - array of length number of nodes + 1. Gates reading the node v
+ *                     are fan_out[fan_out_offsets[v]], ..., fan_out[fan_out_offsets[v + 1] - 1].
+ * fan_out           - numbers of the gates (from 0) reading all nodes.
+ * is_output         - true for the nodes which are outputs of c.
+ * good              - values of all nodes of the fault-free system in the current block.
+ * valid             - lanes of the current block which are given patterns.
+ * first_pattern     - number of the pattern in the lane 0 of the current block.
+ * faults            - the simulated faults.
+ * remaining         - indexes of the faults not detected yet.
+ * number_remaining  - length of remaining.
+ * next_fault        - first index of remaining not taken by any thread yet.
+ * number_of_threads - number of workers.
+ * workers           - array of workers.
+ */
+typedef struct {
+    nand_compiled_t const* c;
+    uint32_t* fan_out_offsets;
+    uint32_t* fan_out;
+    bool* is_output;
+    block_t* good;
+    block_t valid;
+    uint64_t first_pattern;
+    nand_fault_t* faults;
+    size_t* remaining;
+    size_t number_remaining;
+    size_t next_fault;
+    unsigned int number_of_threads;
+    fault_worker_t* workers;
+} simulation_t;
+
+/**@brief Thread of nand_fault_simulate. Values of the faulty system are kept only for
+ * the nodes which differ from the fault-free one, which are marked by the current
+ * stamp in changed. Gates waiting for evaluation are marked in the bitmap pending.
+ * A gate comes after all gates connected to its ports, so the gates are evaluated in
+ * a single sweep of the bitmap, in which marks are only added ahead.
+ * simulation - the shared state.
+ * faulty     - values of the nodes of the faulty system, aligned part of faulty_memory.
+ * changed    - stamp of the last fault which changed the node.
+ * stamp      - stamp of the simulated fault.
+ * pending    - bit i of the word i / 64 is set if the gate i waits for evaluation.
+ * last_word  - the last word of pending which may have a bit set.
+ * thread     - the thread running the worker.
+ * started    - true if thread was created.
+ */
+struct fault_worker {
+    simulation_t* simulation;
+    block_t* faulty;
+    void* faulty_memory;
+    uint32_t* changed;
+    uint32_t stamp;
+    uint64_t* pending;
+    size_t last_word;
+    pthread_t thread;
+    bool started;
+};
+
+// Returns the first address aligned for blocks in memory allocated with one spare block.
+static block_t* aligned_blocks(void* memory) {
+    uintptr_t address = (uintptr_t)memory;
+    return (block_t*)((address + sizeof(block_t) - 1) & ~(uintptr_t)(sizeof(block_t) - 1));
+}
+
+// Blocks are passed by pointers, vectors wider than the registers of the target
+// have no stable calling convention.
+static bool is_zero(block_t const* b) {
+    uint64_t any = 0;
+
+    for (int w = 0; w < FAULT_WORDS; w++) {
+        any |= (*b)[w];
+    }
+
+    return any == 0;
+}
+
+// Returns the lowest lane set in b, which is not zero.
+static unsigned int lowest_lane(block_t const* b) {
+    int w = 0;
+
+    while ((*b)[w] == 0) {
+        w++;
+    }
+
+    return 64 * w + (unsigned int)__builtin_ctzll((*b)[w]);
+}
+
+// Clears the lanes of b from lane on.
+static void clear_from(block_t* b, unsigned int lane) {
+    for (int w = 0; w < FAULT_WORDS; w++) {
+        unsigned int first = 64 * w;
+        (*b)[w] &= lane >= first + 64 ? ~(uint64_t)0 :
+                   lane <= first ? 0 : ((uint64_t)1 << (lane - first)) - 1;
+    }
+}
+
+// Marks the gates reading the node v as pending in w.
+static void queue_fan_out(fault_worker_t* w, uint32_t v) {
+    simulation_t const* s = w->simulation;
+
+    for (uint32_t k = s->fan_out_offsets[v]; k < s->fan_out_offsets[v + 1]; k++) {
+        uint32_t gate = s->fan_out[k];
+
+        w->pending[gate / 64] |= (uint64_t)1 << (gate % 64);
+        w->last_word = max((size_t)gate / 64, w->last_word);
+    }
+}
+
+/**@brief Evaluates the gate of the faulty system of w, in the lanes of limit. If it
+ * differs from the fault-free system, its readers become pending, and if it is an
+ * output, the fault f is detected and the lanes from the detecting one on are removed
+ * from limit.
+ */
+static void evaluate_faulty(fault_worker_t* w, nand_fault_t* f, uint32_t gate,
+                            block_t* limit) {
+    simulation_t const* s = w->simulation;
+    nand_compiled_t const* c = s->c;
+    uint32_t node = (uint32_t)c->number_of_signals + gate;
+    block_t all_true;
+
+    memset(&all_true, 0xff, sizeof(all_true));
+
+    for (uint32_t k = c->input_offsets[gate]; k < c->input_offsets[gate + 1]; k++) {
+        uint32_t input = c->inputs[k];
+        all_true &= w->changed[input] == w->stamp ? w->faulty[input] : s->good[input];
+    }
+
+    block_t difference = (~all_true ^ s->good[node]) & *limit;
+
+    if (is_zero(&difference)) {
+        return;
+    }
+
+    w->faulty[node] = ~all_true;
+    w->changed[node] = w->stamp;
+
+    if (s->is_output[node]) {
+        unsigned int lane = lowest_lane(&difference);
+
+        f->detected = true;
+        f->pattern = s->first_pattern + lane;
+        clear_from(limit, lane);
+    }
+
+    queue_fan_out(w, node);
+}
+
+/**@brief Simulates the fault f in the current block. Only the fan-out cone of its node
+ * is evaluated, and only as long as it differs from the fault-free system in the lanes
+ * of limit. An output which differs in some lane detects the fault, and then only the
+ * lower lanes are of interest, so the first detecting pattern is found.
+ */
+static void simulate_fault(fault_worker_t* w, nand_fault_t* f) {
+    simulation_t const* s = w->simulation;
+    nand_compiled_t const* c = s->c;
+    block_t limit = s->valid;
+    block_t stuck;
+
+    memset(&stuck, f->value ? 0xff : 0, sizeof(stuck));
+
+    block_t difference = (stuck ^ s->good[f->node]) & limit;
+
+    if (is_zero(&difference)) { // The fault is not activated.
+        return;
+    }
+    if (++w->stamp == 0) {
+        memset(w->changed, 0, (c->number_of_signals + c->number_of_gates) * sizeof(uint32_t));
+        w->stamp = 1;
+    }
+
+    w->faulty[f->node] = stuck;
+    w->changed[f->node] = w->stamp;
+
+    if (s->is_output[f->node]) {
+        unsigned int lane = lowest_lane(&difference);
+
+        f->detected = true;
+        f->pattern = s->first_pattern + lane;
+        clear_from(&limit, lane);
+    }
+
+    // Readers of a gate come after it, so the sweep starts at the word of the fault.
+    size_t word = f->node < c->number_of_signals ? 0 : (f->node - c->number_of_signals) / 64;
+
+    w->last_word = word;
+    queue_fan_out(w, f->node);
+
+    for (; word <= w->last_word; word++) {
+        if (is_zero(&limit)) { // Nothing to find, the remaining marks are cleared.
+            memset(w->pending + word, 0, (w->last_word - word + 1) * sizeof(uint64_t));
+            break;
+        }
+
+        while (w->pending[word] != 0 && !is_zero(&limit)) {
+            uint32_t gate = 64 * (uint32_t)word + (uint32_t)__builtin_ctzll(w->pending[word]);
+
+            w->pending[word] &= w->pending[word] - 1;
+            evaluate_faulty(w, f, gate, &limit);
+        }
+    }
+}
+
+// Simulates portions of the remaining faults until there are none.
+static void* fault_worker(void* arg) {
+    fault_worker_t* w = (fault_worker_t*)arg;
+    simulation_t* s = w->simulation;
+
+    for (;;) {
+        size_t first = __atomic_fetch_add(&s->next_fault, FAULTS_PER_TAKE, __ATOMIC_RELAXED);
+
+        if (first >= s->number_remaining) {
+            return NULL;
+        }
+
+        size_t last = first + FAULTS_PER_TAKE < s->number_remaining ?
+                      first + FAULTS_PER_TAKE : s->number_remaining;
+
+        for (size_t i = first; i < last; i++) {
+            simulate_fault(w, s->faults + s->remaining[i]);
+        }
+    }
+}
+
+/**@brief Runs all workers: the first one in the calling thread, the others in new
+ * threads. Workers whose threads cannot be created run in the calling thread.
+ */
+static void run_fault_workers(simulation_t* s) {
+    for (unsigned int i = 1; i < s->number_of_threads; i++) {
+        fault_worker_t* w = s->workers + i;
+        w->started = pthread_create(&w->thread, NULL, fault_worker, w) == 0;
+    }
+
+    fault_worker(s->workers);
+
+    for (unsigned int i = 1; i < s->number_of_threads; i++) {
+        fault_worker_t* w = s->workers + i;
+
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+        }
+        else {
+            fault_worker(w);
+        }
+    }
+}
+
+// Evaluates the fault-free system of s under the patterns of the block starting at
+// the word first of in.
+static void simulate_good(simulation_t* s, uint64_t const* in, size_t words, size_t first) {
+    nand_compiled_t const* c = s->c;
+    size_t length = words - first < FAULT_WORDS ? words - first : FAULT_WORDS;
+    block_t* gate_values = s->good + c->number_of_signals;
+
+    for (size_t i = 0; i < c->number_of_signals; i++) {
+        memset(s->good + i, 0, sizeof(block_t));
+        memcpy(s->good + i, in + i * words + first, length * sizeof(uint64_t));
+    }
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        block_t all_true;
+
+        memset(&all_true, 0xff, sizeof(all_true));
+
+        for (uint32_t k = c->input_offsets[i]; k < c->input_offsets[i + 1]; k++) {
+            all_true &= s->good[c->inputs[k]];
+        }
+
+        gate_values[i] = ~all_true;
+    }
+
+    memset(&s->valid, 0xff, sizeof(block_t));
+    clear_from(&s->valid, 64 * (unsigned int)length);
+    s->first_pattern = 64 * (uint64_t)first;
+}
+
+/**@brief Builds the arrays fan_out_offsets, fan_out and is_output of s, by counting
+ * the readers of every node first.
+ */
+static void build_fan_out(simulation_t* s) {
+    nand_compiled_t const* c = s->c;
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+    uint32_t* offsets = s->fan_out_offsets;
+
+    memset(offsets, 0, (number_of_nodes + 1) * sizeof(uint32_t));
+
+    for (size_t k = 0; k < c->input_offsets[c->number_of_gates]; k++) {
+        offsets[c->inputs[k] + 1]++;
+    }
+    for (size_t v = 0; v < number_of_nodes; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    // Offsets are moved by one node while filling, and end up in their places.
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        for (uint32_t k = c->input_offsets[i]; k < c->input_offsets[i + 1]; k++) {
+            s->fan_out[offsets[c->inputs[k]]++] = (uint32_t)i;
+        }
+    }
+    for (size_t v = number_of_nodes; v > 0; v--) {
+        offsets[v] = offsets[v - 1];
+    }
+
+    offsets[0] = 0;
+
+    for (size_t i = 0; i < c->number_of_outputs; i++) {
+        s->is_output[c->outputs[i]] = true;
+    }
+}
+
+ssize_t nand_fault_list(nand_compiled_t const *c, nand_fault_t **faults) {
+    if (!c || !faults) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+    nand_fault_t* list = (nand_fault_t*)calloc(max(2 * number_of_nodes, 1), sizeof(nand_fault_t));
+
+    if (!list) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t v = 0; v < number_of_nodes; v++) {
+        list[2 * v].node = (uint32_t)v;
+        list[2 * v + 1].node = (uint32_t)v;
+        list[2 * v + 1].value = true;
+    }
+
+    *faults = list;
+    return (ssize_t)(2 * number_of_nodes);
+}
+
+ssize_t nand_fault_simulate(nand_compiled_t const *c, uint64_t const *in, size_t words,
+                            nand_fault_t *faults, size_t n, unsigned threads) {
+    if (!c || !in || words == 0 || (!faults && n > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+
+    for (size_t i = 0; i < n; i++) {
+        if (faults[i].node >= number_of_nodes) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+
+    simulation_t s = {0};
+    void* good_memory = malloc((number_of_nodes + 1) * sizeof(block_t));
+    int error = ENOMEM;
+
+    s.c = c;
+    s.faults = faults;
+    s.number_of_threads = threads;
+    s.fan_out_offsets = (uint32_t*)malloc((number_of_nodes + 1) * sizeof(uint32_t));
+    s.fan_out = (uint32_t*)malloc(max(c->input_offsets[c->number_of_gates], 1) * sizeof(uint32_t));
+    s.is_output = (bool*)calloc(max(number_of_nodes, 1), sizeof(bool));
+    s.remaining = (size_t*)malloc(max(n, 1) * sizeof(size_t));
+    s.workers = (fault_worker_t*)calloc(threads, sizeof(fault_worker_t));
+    s.good = aligned_blocks(good_memory);
+
+    if (!good_memory || !s.fan_out_offsets || !s.fan_out || !s.is_output || !s.remaining ||
+        !s.workers) {
+        goto cleanup;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        fault_worker_t* w = s.workers + i;
+
+        w->simulation = &s;
+        w->faulty_memory = malloc((number_of_nodes + 1) * sizeof(block_t));
+        w->faulty = aligned_blocks(w->faulty_memory);
+        w->changed = (uint32_t*)calloc(max(number_of_nodes, 1), sizeof(uint32_t));
+        w->pending = (uint64_t*)calloc(c->number_of_gates / 64 + 1, sizeof(uint64_t));
+
+        if (!w->faulty_memory || !w->changed || !w->pending) {
+            goto cleanup;
+        }
+    }
+
+    build_fan_out(&s);
+
+    // Faults detected earlier are dropped before the first block.
+    for (size_t i = 0; i < n; i++) {
+        if (!faults[i].detected) {
+            s.remaining[s.number_remaining++] = i;
+        }
+    }
+
+    for (size_t first = 0; first < words && s.number_remaining > 0; first += FAULT_WORDS) {
+        simulate_good(&s, in, words, first);
+        s.next_fault = 0;
+        run_fault_workers(&s);
+
+        // Detected faults are dropped, the remaining ones keep their order.
+        size_t kept = 0;
+
+        for (size_t i = 0; i < s.number_remaining; i++) {
+            if (!faults[s.remaining[i]].detected) {
+                s.remaining[kept++] = s.remaining[i];
+            }
+        }
+
+        s.number_remaining = kept;
+    }
+
+    error = 0;
+
+cleanup:
+    for (unsigned int i = 0; s.workers && i < threads; i++) {
+        free(s.workers[i].faulty_memory);
+        free(s.workers[i].changed);
+        free(s.workers[i].pending);
+    }
+
+    free(s.workers);
+    free(s.remaining);
+    free(s.is_output);
+    free(s.fan_out);
+    free(s.fan_out_offsets);
+    free(good_memory);
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    ssize_t detected = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        detected += faults[i].detected;
+    }
+
+    return detected;
+}
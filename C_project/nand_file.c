@@ -0,0 +1,393 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <fcntl.h> // For open.
+#include <stdint.h> // For uint32_t, uint64_t.
+#include <stdio.h> // For fopen, fwrite, fclose.
+#include <stdlib.h> // For malloc, free.
+#include <string.h> // For memcmp, memcpy.
+#include <sys/mman.h> // For mmap, munmap.
+#include <sys/stat.h> // For fstat.
+#include <unistd.h> // For close.
+
+#define FILE_MAGIC "NANDNET"
+#define FILE_VERSION 1
+#define FILE_BYTE_ORDER 0x01020304u
+
+/**@brief Header of the netlist file. It is followed by the arrays input_offsets,
+ * inputs, levels and outputs of the compiled system, each of them starting at
+ * a multiple of 8 bytes. Numbers are written in the byte order of the machine,
+ * byte_order lets a machine with another order reject the file. Signals are not
+ * saved: the i-th signal of the system is the i-th slot given to the loader.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t number_of_signals;
+    uint64_t number_of_gates;
+    uint64_t number_of_inputs;
+    uint64_t number_of_outputs;
+    uint64_t longest_path;
+} file_header_t;
+
+/**@brief Mapped and checked netlist file.
+ * header        - the header at the beginning of the mapping.
+ * input_offsets - arrays of the file, as in nand_compiled_t.
+ * inputs
+ * levels
+ * outputs
+ * mapping       - the mapped file.
+ * size          - length of the file.
+ */
+typedef struct {
+    file_header_t const* header;
+    uint32_t const* input_offsets;
+    uint32_t const* inputs;
+    uint32_t const* levels;
+    uint32_t const* outputs;
+    void* mapping;
+    size_t size;
+} netlist_t;
+
+// Rounds the size of an array up to a multiple of 8 bytes.
+static uint64_t aligned(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+// Writes the array and zeros up to a multiple of 8 bytes. Returns false on error.
+static bool write_array(FILE* file, void const* array, size_t size) {
+    static const char zeros[8] = {0};
+    size_t padding = (size_t)aligned(size) - size;
+
+    return fwrite(array, 1, size, file) == size && fwrite(zeros, 1, padding, file) == padding;
+}
+
+int nand_compiled_save(nand_compiled_t const *c, char const *path) {
+    if (!c || !path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // An output which is a signal (the state of a flip-flop) cannot be loaded, as
+    // the file does not keep the flip-flops.
+    for (size_t i = 0; i < c->number_of_outputs; i++) {
+        if (c->outputs[i] < c->number_of_signals) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    file_header_t header = {
+        .magic = FILE_MAGIC,
+        .version = FILE_VERSION,
+        .byte_order = FILE_BYTE_ORDER,
+        .number_of_signals = c->number_of_signals,
+        .number_of_gates = c->number_of_gates,
+        .number_of_inputs = c->input_offsets[c->number_of_gates],
+        .number_of_outputs = c->number_of_outputs,
+        .longest_path = (uint64_t)c->longest_path,
+    };
+    FILE* file = fopen(path, "wb");
+
+    if (!file) {
+        return -1;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        write_array(file, c->input_offsets, (c->number_of_gates + 1) * sizeof(uint32_t)) &&
+        write_array(file, c->inputs, header.number_of_inputs * sizeof(uint32_t)) &&
+        write_array(file, c->levels, c->number_of_gates * sizeof(uint32_t)) &&
+        write_array(file, c->outputs, c->number_of_outputs * sizeof(uint32_t));
+    int error = written ? 0 : (errno ? errno : EIO);
+
+    if (fclose(file) != 0 && !error) {
+        error = errno;
+    }
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**@brief Checks that the arrays describe a system which may be evaluated in a single
+ * pass: every gate reads only signals and earlier gates, and its level is computed
+ * from the levels of its inputs like in nand_compile.
+ */
+static bool correct_netlist(netlist_t const* n) {
+    file_header_t const* h = n->header;
+    uint64_t longest_path = 0;
+
+    if (n->input_offsets[0] != 0 || n->input_offsets[h->number_of_gates] != h->number_of_inputs) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < h->number_of_gates; i++) {
+        uint32_t first = n->input_offsets[i];
+        uint32_t last = n->input_offsets[i + 1];
+        uint32_t level = 0;
+
+        if (first > last || last > h->number_of_inputs) {
+            return false;
+        }
+
+        for (uint32_t k = first; k < last; k++) {
+            uint32_t node = n->inputs[k];
+
+            if (node < h->number_of_signals) {
+                level = max(1, level);
+            }
+            else if (node - h->number_of_signals < i) {
+                level = max(n->levels[node - h->number_of_signals] + 1, level);
+            }
+            else {
+                return false;
+            }
+        }
+
+        if (n->levels[i] != level) {
+            return false;
+        }
+
+        longest_path = max(level, longest_path);
+    }
+
+    for (uint64_t i = 0; i < h->number_of_outputs; i++) {
+        if (n->outputs[i] < h->number_of_signals ||
+            n->outputs[i] - h->number_of_signals >= h->number_of_gates) {
+            return false;
+        }
+    }
+
+    return longest_path == h->longest_path;
+}
+
+/**@brief Maps the file at path read-only and checks it. Returns false with errno
+ * set if the file cannot be mapped, or to EINVAL if it is not a correct netlist or
+ * needs more than length_of_s signals.
+ */
+static bool map_netlist(char const* path, netlist_t* n, size_t length_of_s) {
+    struct stat status;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    if ((uint64_t)status.st_size < sizeof(file_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    n->size = (size_t)status.st_size;
+    n->mapping = mmap(NULL, n->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    int error = errno;
+    close(fd);
+
+    if (n->mapping == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+
+    file_header_t const* h = (file_header_t const*)n->mapping;
+    n->header = h;
+
+    // Numbers of nodes and inputs have to fit in 32 bits, as in nand_compile.
+    bool correct = memcmp(h->magic, FILE_MAGIC, sizeof(h->magic)) == 0 &&
+        h->version == FILE_VERSION && h->byte_order == FILE_BYTE_ORDER &&
+        h->number_of_signals <= UINT32_MAX && h->number_of_gates <= UINT32_MAX &&
+        h->number_of_signals + h->number_of_gates <= UINT32_MAX &&
+        h->number_of_inputs <= UINT32_MAX && h->number_of_outputs <= UINT32_MAX &&
+        h->number_of_signals <= length_of_s;
+
+    if (correct) {
+        uint64_t offsets_size = aligned((h->number_of_gates + 1) * sizeof(uint32_t));
+        uint64_t inputs_size = aligned(h->number_of_inputs * sizeof(uint32_t));
+        uint64_t levels_size = aligned(h->number_of_gates * sizeof(uint32_t));
+        uint64_t outputs_size = aligned(h->number_of_outputs * sizeof(uint32_t));
+        char const* arrays = (char const*)(h + 1);
+
+        correct = sizeof(*h) + offsets_size + inputs_size + levels_size + outputs_size == n->size;
+        n->input_offsets = (uint32_t const*)arrays;
+        n->inputs = (uint32_t const*)(arrays + offsets_size);
+        n->levels = (uint32_t const*)(arrays + offsets_size + inputs_size);
+        n->outputs = (uint32_t const*)(arrays + offsets_size + inputs_size + levels_size);
+    }
+
+    if (!correct || !correct_netlist(n)) {
+        munmap(n->mapping, n->size);
+        errno = EINVAL;
+        return false;
+    }
+
+    return true;
+}
+
+nand_compiled_t* nand_compiled_load(char const *path, bool const *s, size_t length_of_s) {
+    if (!path || !s) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    netlist_t n;
+
+    if (!map_netlist(path, &n, length_of_s)) {
+        return NULL;
+    }
+
+    // Only signals and values are allocated, the other arrays stay in the file.
+    size_t number_of_signals = (size_t)n.header->number_of_signals;
+    size_t number_of_gates = (size_t)n.header->number_of_gates;
+    size_t signals_size = (size_t)aligned(number_of_signals * sizeof(const bool*));
+    nand_compiled_t* c = (nand_compiled_t*)malloc(sizeof(nand_compiled_t));
+    char* memory = (char*)malloc(signals_size + number_of_signals + number_of_gates + 1);
+
+    if (!c || !memory) {
+        free(c);
+        free(memory);
+        munmap(n.mapping, n.size);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    c->number_of_signals = number_of_signals;
+    c->number_of_gates = number_of_gates;
+    c->number_of_outputs = (size_t)n.header->number_of_outputs;
+    c->signals = (const bool**)memory;
+    c->input_offsets = (uint32_t*)n.input_offsets;
+    c->inputs = (uint32_t*)n.inputs;
+    c->levels = (uint32_t*)n.levels;
+    c->outputs = (uint32_t*)n.outputs;
+    c->values = (uint8_t*)(memory + signals_size);
+    c->longest_path = (ssize_t)n.header->longest_path;
+    c->memory = memory;
+    c->mapping = n.mapping;
+    c->mapping_size = n.size;
+    c->lane_values = NULL;
+    c->lane_memory = NULL;
+    c->registers = NULL;
+    c->number_of_registers = 0;
+    c->step = NULL;
+
+    for (size_t i = 0; i < number_of_signals; i++) {
+        c->signals[i] = s + i;
+    }
+
+    return c;
+}
+
+int nand_save(nand_t **g, size_t m, char const *path) {
+    if (!path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nand_compiled_t* c = nand_compile(g, m);
+
+    if (!c) {
+        return -1;
+    }
+
+    int result = nand_compiled_save(c, path);
+    int error = errno;
+
+    nand_compiled_delete(c);
+    errno = error;
+    return result;
+}
+
+ssize_t nand_load(char const *path, nand_pool_t *p, bool const *s, size_t length_of_s,
+                  nand_t ***g) {
+    if (!path || !p || !s || !g) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    netlist_t n;
+
+    if (!map_netlist(path, &n, length_of_s)) {
+        return -1;
+    }
+
+    size_t number_of_signals = (size_t)n.header->number_of_signals;
+    size_t number_of_gates = (size_t)n.header->number_of_gates;
+    size_t number_of_inputs = (size_t)n.header->number_of_inputs;
+    size_t number_of_outputs = (size_t)n.header->number_of_outputs;
+    unsigned* ports = (unsigned*)malloc(number_of_gates * sizeof(unsigned) + 1);
+    nand_t** gates = (nand_t**)malloc(number_of_gates * sizeof(nand_t*) + 1);
+    nand_edge_t* edges = (nand_edge_t*)malloc(number_of_inputs * sizeof(nand_edge_t) + 1);
+    nand_t** outputs = (nand_t**)malloc(number_of_outputs * sizeof(nand_t*) + 1);
+    bool created = false;
+    int error = ENOMEM;
+
+    if (!ports || !gates || !edges || !outputs) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < number_of_gates; i++) {
+        ports[i] = n.input_offsets[i + 1] - n.input_offsets[i];
+    }
+
+    // Gates are created in the order of levels, so all connections follow
+    // the topological order from the start.
+    if (nand_new_many(p, gates, number_of_gates, ports) != 0) {
+        goto cleanup;
+    }
+
+    created = true;
+
+    for (size_t i = 0; i < number_of_gates; i++) {
+        for (uint32_t k = n.input_offsets[i]; k < n.input_offsets[i + 1]; k++) {
+            uint32_t node = n.inputs[k];
+            nand_edge_t* edge = edges + k;
+
+            edge->g_out = node < number_of_signals ? NULL : gates[node - number_of_signals];
+            edge->s = node < number_of_signals ? s + node : NULL;
+            edge->g_in = gates[i];
+            edge->k = k - n.input_offsets[i];
+        }
+    }
+
+    if (nand_connect_many(edges, number_of_inputs) != 0) {
+        error = errno;
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < number_of_outputs; i++) {
+        outputs[i] = gates[n.outputs[i] - number_of_signals];
+    }
+
+    error = 0;
+
+cleanup:
+    if (error && created) {
+        for (size_t i = 0; i < number_of_gates; i++) {
+            nand_delete(gates[i]);
+        }
+    }
+    if (error) {
+        free(outputs);
+    }
+
+    free(ports);
+    free(gates);
+    free(edges);
+    munmap(n.mapping, n.size);
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    *g = outputs;
+    return (ssize_t)number_of_outputs;
+}
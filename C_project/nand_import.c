@@ -0,0 +1,1258 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uint32_t, uint64_t.
+#include <stdio.h> // For FILE, fread, ferror.
+#include <stdlib.h> // For malloc, realloc, free.
+#include <string.h> // For memcmp, memcpy.
+
+// Kinds of references to nodes, kept in the two highest bits of a reference.
+#define REFERENCE_GATE    0x00000000u // The gate of the given number.
+#define REFERENCE_SIGNAL  0x40000000u // The boolean signal of the given number.
+#define REFERENCE_NET     0x80000000u // The net of the given number.
+#define REFERENCE_NOT_NET 0xC0000000u // Negation of the net of the given number.
+#define REFERENCE_KIND    0xC0000000u
+#define REFERENCE_INDEX   0x3FFFFFFFu
+
+// Driver of a net which is not defined yet, and an inverter which is not created yet.
+#define NO_NODE UINT32_MAX
+
+// Length of the buffer of the reader.
+#define READER_BUFFER 65536
+
+// Number of recently used names of BLIF looked up before the hash table
+// (a power of 2).
+#define RECENT_NAMES 4096
+
+/**@brief Net of the imported netlist, i.e. a named wire. Nets may be used before
+ * they are defined, so gates refer to nets and the references are resolved when
+ * the whole netlist is read.
+ * driver   - reference to the gate or signal giving the value of the net, or NO_NODE.
+ * inverter - number of the gate negating driver, or NO_NODE if it is not needed yet.
+ * inverted - true if driver gives the negation of the net (e.g. an AND of AIGER is
+ *            the negation of a NAND gate).
+ */
+typedef struct {
+    uint32_t driver;
+    uint32_t inverter;
+    bool inverted;
+} net_t;
+
+/**@brief Netlist read so far. Gates are kept like in nand_compiled_t, but in the
+ * order of creation and with references instead of node numbers.
+ * input_offsets - array of length number_of_gates + 1 (at least 1).
+ * inputs        - references connected to the ports of all gates.
+ * nets          - array of number_of_nets nets.
+ * outputs       - references to the outputs of the netlist.
+ * number_of_signals - number of inputs of the netlist, i.e. boolean signals.
+ * length_of_s       - length of the array of signals given by the caller, the limit
+ *                     of number_of_signals.
+ */
+typedef struct {
+    uint32_t* input_offsets;
+    size_t number_of_gates;
+    size_t capacity_of_gates;
+    uint32_t* inputs;
+    size_t number_of_inputs;
+    size_t capacity_of_inputs;
+    net_t* nets;
+    size_t number_of_nets;
+    size_t capacity_of_nets;
+    uint32_t* outputs;
+    size_t number_of_outputs;
+    size_t capacity_of_outputs;
+    size_t number_of_signals;
+    size_t length_of_s;
+} builder_t;
+
+/**@brief Buffered reader of the imported file, so that only READER_BUFFER bytes of
+ * the text are kept in memory.
+ */
+typedef struct {
+    FILE* file;
+    size_t position;
+    size_t length;
+    unsigned char buffer[READER_BUFFER];
+} reader_t;
+
+static int next_char(reader_t* r) {
+    if (r->position == r->length) {
+        r->length = fread(r->buffer, 1, READER_BUFFER, r->file);
+        r->position = 0;
+
+        if (r->length == 0) {
+            return EOF;
+        }
+    }
+
+    return r->buffer[r->position++];
+}
+
+static int peek_char(reader_t* r) {
+    int c = next_char(r);
+
+    if (c != EOF) {
+        r->position--;
+    }
+
+    return c;
+}
+
+/**@brief Makes room for needed elements of the given size in the array.
+ * Returns false if there is no memory.
+ */
+static bool reserve(void** array, size_t* capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity ? *capacity : 64;
+
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    void* new_array = realloc(*array, new_capacity * size);
+
+    if (!new_array) {
+        return false;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Starts a new gate. Returns false with errno set if it cannot be created.
+static bool begin_gate(builder_t* b) {
+    if (b->number_of_gates >= REFERENCE_INDEX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!reserve((void**)&b->input_offsets, &b->capacity_of_gates,
+                 b->number_of_gates + 2, sizeof(uint32_t))) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    b->input_offsets[b->number_of_gates] = (uint32_t)b->number_of_inputs;
+    return true;
+}
+
+// Connects the next port of the started gate. Returns false with errno set on error.
+static bool add_input(builder_t* b, uint32_t reference) {
+    if (b->number_of_inputs >= UINT32_MAX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!reserve((void**)&b->inputs, &b->capacity_of_inputs,
+                 b->number_of_inputs + 1, sizeof(uint32_t))) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    b->inputs[b->number_of_inputs++] = reference;
+    return true;
+}
+
+// Finishes the started gate and returns the reference to it.
+static uint32_t end_gate(builder_t* b) {
+    b->input_offsets[b->number_of_gates + 1] = (uint32_t)b->number_of_inputs;
+    return REFERENCE_GATE | (uint32_t)b->number_of_gates++;
+}
+
+// Makes room for number nets, all undefined. Returns false with errno set on error.
+static bool add_nets(builder_t* b, size_t number) {
+    if (number > REFERENCE_INDEX - b->number_of_nets) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!reserve((void**)&b->nets, &b->capacity_of_nets,
+                 b->number_of_nets + number, sizeof(net_t))) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (size_t i = 0; i < number; i++) {
+        net_t* net = b->nets + b->number_of_nets++;
+        net->driver = NO_NODE;
+        net->inverter = NO_NODE;
+        net->inverted = false;
+    }
+
+    return true;
+}
+
+/**@brief Defines the net as the value (or negation, if inverted) of driver.
+ * Returns false with errno set to EINVAL if the net is already defined.
+ */
+static bool define_net(builder_t* b, uint32_t net, uint32_t driver, bool inverted) {
+    if (b->nets[net].driver != NO_NODE) {
+        errno = EINVAL;
+        return false;
+    }
+
+    b->nets[net].driver = driver;
+    b->nets[net].inverted = inverted;
+    return true;
+}
+
+// Defines the net as the next boolean signal. Returns false with errno set on error,
+// EINVAL if the array of signals of the caller is too short.
+static bool define_signal(builder_t* b, uint32_t net) {
+    if (b->number_of_signals >= b->length_of_s) {
+        errno = EINVAL;
+        return false;
+    }
+    if (b->number_of_signals >= REFERENCE_INDEX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    return define_net(b, net, REFERENCE_SIGNAL | (uint32_t)b->number_of_signals++, false);
+}
+
+static bool add_output(builder_t* b, uint32_t reference) {
+    if (!reserve((void**)&b->outputs, &b->capacity_of_outputs,
+                 b->number_of_outputs + 1, sizeof(uint32_t))) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    b->outputs[b->number_of_outputs++] = reference;
+    return true;
+}
+
+/**@brief Changes a reference to a net into a reference to a gate or a signal,
+ * creating the inverter of the net if the negation is needed for the first time.
+ * Returns NO_NODE with errno set if the net is not defined or there is no memory.
+ */
+static uint32_t resolve(builder_t* b, uint32_t reference) {
+    uint32_t kind = reference & REFERENCE_KIND;
+
+    if (kind == REFERENCE_GATE || kind == REFERENCE_SIGNAL) {
+        return reference;
+    }
+
+    net_t* net = b->nets + (reference & REFERENCE_INDEX);
+
+    if (net->driver == NO_NODE) {
+        errno = EINVAL;
+        return NO_NODE;
+    }
+    if (net->inverted == (kind == REFERENCE_NOT_NET)) {
+        return net->driver;
+    }
+    if (net->inverter == NO_NODE) {
+        uint32_t driver = net->driver;
+
+        if (!begin_gate(b) || !add_input(b, driver)) {
+            return NO_NODE;
+        }
+
+        net->inverter = end_gate(b);
+    }
+
+    return net->inverter;
+}
+
+/**@brief Returns the reference resolved at once if it is a net which is already
+ * defined, and the reference itself otherwise. Gates of a netlist read in topological
+ * order are thus created in topological order, inverters included.
+ * Returns NO_NODE with errno set if there is no memory.
+ */
+static uint32_t resolve_defined(builder_t* b, uint32_t reference) {
+    if ((reference & REFERENCE_NET) && b->nets[reference & REFERENCE_INDEX].driver == NO_NODE) {
+        return reference;
+    }
+
+    return resolve(b, reference);
+}
+
+// Position of the i-th created gate in the compiled system (positions is NULL
+// if the order of creation is kept).
+static inline uint32_t position(uint32_t const* positions, size_t i) {
+    return positions ? positions[i] : (uint32_t)i;
+}
+
+/**@brief Computes levels of the gates by depth first search, as gates may use gates
+ * created later. Returns ECANCELED if there is a cycle, ENOMEM or 0.
+ */
+static int search_levels(builder_t const* b, uint32_t* levels) {
+    size_t number_of_gates = b->number_of_gates;
+    uint32_t const* offsets = b->input_offsets;
+    uint32_t const* inputs = b->inputs;
+    uint32_t* next_input = (uint32_t*)malloc(number_of_gates * sizeof(uint32_t) + 1);
+    uint32_t* stack = (uint32_t*)malloc(number_of_gates * sizeof(uint32_t) + 1);
+    int error = ENOMEM;
+
+    if (!next_input || !stack) {
+        goto cleanup;
+    }
+
+    // next_input is UINT32_MAX for gates not visited yet and the number of the
+    // next input to process for gates on the stack. Finished gates have
+    // next_input equal to the end of their inputs.
+    for (size_t i = 0; i < number_of_gates; i++) {
+        next_input[i] = UINT32_MAX;
+    }
+
+    for (size_t root = 0; root < number_of_gates; root++) {
+        size_t top = 0;
+
+        if (next_input[root] != UINT32_MAX) {
+            continue;
+        }
+
+        next_input[root] = offsets[root];
+        levels[root] = 0;
+        stack[top++] = (uint32_t)root;
+
+        while (top > 0) {
+            uint32_t g = stack[top - 1];
+            uint32_t k = next_input[g];
+            uint32_t level = levels[g];
+
+            for (; k < offsets[g + 1]; k++) {
+                uint32_t reference = inputs[k];
+                uint32_t input = reference & REFERENCE_INDEX;
+
+                if ((reference & REFERENCE_KIND) == REFERENCE_SIGNAL) {
+                    level = max(1, level);
+                }
+                else if (next_input[input] == UINT32_MAX) {
+                    break;
+                }
+                else if (next_input[input] < offsets[input + 1]) { // On the stack.
+                    error = ECANCELED;
+                    goto cleanup;
+                }
+                else {
+                    level = max(levels[input] + 1, level);
+                }
+            }
+
+            next_input[g] = k;
+            levels[g] = level;
+
+            if (k < offsets[g + 1]) {
+                uint32_t input = inputs[k] & REFERENCE_INDEX;
+
+                next_input[input] = offsets[input];
+                levels[input] = 0;
+                stack[top++] = input;
+                continue;
+            }
+
+            top--;
+        }
+    }
+
+    error = 0;
+
+cleanup:
+    free(next_input);
+    free(stack);
+    return error;
+}
+
+/**@brief Makes the compiled system of the read netlist: resolves all references and
+ * computes levels of the gates. Gates created in topological order keep it, which is
+ * the case of netlists defining every net before its use. Otherwise the gates are
+ * sorted by levels like in nand_compile. The i-th signal of the system is s[i].
+ * Returns NULL with errno set to EINVAL (undefined net), ECANCELED (cycle),
+ * EOVERFLOW or ENOMEM.
+ */
+static nand_compiled_t* finish(builder_t* b, bool const* s) {
+    // Inverters created while resolving are appended and resolved in turn.
+    for (size_t k = 0; k < b->number_of_inputs; k++) {
+        uint32_t reference = resolve(b, b->inputs[k]);
+
+        if (reference == NO_NODE) {
+            return NULL;
+        }
+
+        b->inputs[k] = reference;
+    }
+
+    // Outputs have to be gates, so a signal is given out through two inverters.
+    for (size_t i = 0; i < b->number_of_outputs; i++) {
+        uint32_t reference = resolve(b, b->outputs[i]);
+
+        if (reference != NO_NODE && (reference & REFERENCE_KIND) == REFERENCE_SIGNAL) {
+            uint32_t inverter = resolve(b, b->outputs[i] ^ (REFERENCE_NET ^ REFERENCE_NOT_NET));
+
+            reference = NO_NODE;
+
+            if (inverter != NO_NODE && begin_gate(b) && add_input(b, inverter)) {
+                reference = end_gate(b);
+            }
+        }
+        if (reference == NO_NODE) {
+            return NULL;
+        }
+
+        b->outputs[i] = reference;
+    }
+
+    size_t number_of_gates = b->number_of_gates;
+    size_t number_of_signals = b->number_of_signals;
+    uint32_t const* offsets = b->input_offsets;
+    uint32_t const* inputs = b->inputs;
+    nand_compiled_t* c = NULL;
+    uint32_t* positions = NULL;
+    uint32_t* first_of_level = NULL;
+    int error = ENOMEM;
+
+    if (number_of_signals + number_of_gates > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+
+    uint32_t* levels = (uint32_t*)malloc(number_of_gates * sizeof(uint32_t) + 1);
+
+    if (!levels) {
+        goto cleanup;
+    }
+
+    // Single pass while the gates use only gates created earlier (references
+    // to gates are their numbers).
+    size_t ordered = 0;
+
+    for (; ordered < number_of_gates; ordered++) {
+        uint32_t level = 0;
+        uint32_t k = offsets[ordered];
+
+        for (; k < offsets[ordered + 1]; k++) {
+            uint32_t reference = inputs[k];
+
+            if ((reference & REFERENCE_KIND) == REFERENCE_SIGNAL) {
+                level = max(1, level);
+            }
+            else if (reference < ordered) {
+                level = max(levels[reference] + 1, level);
+            }
+            else {
+                break;
+            }
+        }
+
+        if (k < offsets[ordered + 1]) {
+            break;
+        }
+
+        levels[ordered] = level;
+    }
+
+    if (ordered < number_of_gates) {
+        if ((error = search_levels(b, levels)) != 0) {
+            goto cleanup;
+        }
+
+        error = ENOMEM;
+        positions = (uint32_t*)malloc(number_of_gates * sizeof(uint32_t) + 1);
+        first_of_level = (uint32_t*)calloc(number_of_gates + 2, sizeof(uint32_t));
+
+        if (!positions || !first_of_level) {
+            goto cleanup;
+        }
+
+        // Counting sort by levels.
+        for (size_t i = 0; i < number_of_gates; i++) {
+            first_of_level[levels[i] + 1]++;
+        }
+        for (size_t level = 1; level <= number_of_gates; level++) {
+            first_of_level[level] += first_of_level[level - 1];
+        }
+        for (size_t i = 0; i < number_of_gates; i++) {
+            positions[i] = first_of_level[levels[i]]++;
+        }
+    }
+
+    c = nand_allocate_compiled(number_of_signals, number_of_gates,
+                               b->number_of_inputs, b->number_of_outputs);
+
+    if (!c) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < number_of_signals; i++) {
+        c->signals[i] = s + i;
+    }
+
+    c->input_offsets[0] = 0;
+
+    for (size_t i = 0; i < number_of_gates; i++) {
+        c->input_offsets[position(positions, i) + 1] = offsets[i + 1] - offsets[i];
+        c->levels[position(positions, i)] = levels[i];
+        c->longest_path = max((ssize_t)levels[i], c->longest_path);
+    }
+    for (size_t i = 0; i < number_of_gates; i++) {
+        c->input_offsets[i + 1] += c->input_offsets[i];
+    }
+    for (size_t i = 0; i < number_of_gates; i++) {
+        uint32_t* compiled_inputs = c->inputs + c->input_offsets[position(positions, i)];
+
+        for (uint32_t k = offsets[i]; k < offsets[i + 1]; k++) {
+            uint32_t reference = inputs[k];
+            uint32_t index = reference & REFERENCE_INDEX;
+
+            if ((reference & REFERENCE_KIND) == REFERENCE_SIGNAL) {
+                compiled_inputs[k - offsets[i]] = index;
+            }
+            else {
+                compiled_inputs[k - offsets[i]] = (uint32_t)number_of_signals + position(positions, index);
+            }
+        }
+    }
+    for (size_t i = 0; i < b->number_of_outputs; i++) {
+        c->outputs[i] = (uint32_t)number_of_signals +
+                        position(positions, b->outputs[i] & REFERENCE_INDEX);
+    }
+
+    error = 0;
+
+cleanup:
+    free(levels);
+    free(positions);
+    free(first_of_level);
+
+    if (error) {
+        nand_compiled_delete(c);
+        errno = error;
+        return NULL;
+    }
+
+    return c;
+}
+
+static void free_builder(builder_t* b) {
+    free(b->input_offsets);
+    free(b->inputs);
+    free(b->nets);
+    free(b->outputs);
+}
+
+/**@brief Reads a decimal number, skipping spaces and tabs (and also new lines
+ * if lines is true). Returns false if there is no number, leaving the character
+ * found instead of it unread.
+ */
+static bool read_number(reader_t* r, uint64_t* x, bool lines) {
+    int c = peek_char(r);
+
+    while (c == ' ' || c == '\t' || (lines && (c == '\n' || c == '\r'))) {
+        next_char(r);
+        c = peek_char(r);
+    }
+    if (c < '0' || c > '9') {
+        return false;
+    }
+
+    *x = 0;
+
+    while (c >= '0' && c <= '9') {
+        if (*x > (UINT64_MAX - 9) / 10) {
+            return false;
+        }
+
+        *x = 10 * *x + (uint64_t)(c - '0');
+        next_char(r);
+        c = peek_char(r);
+    }
+
+    return true;
+}
+
+// Skips the rest of the line. Returns false if there are other characters than spaces.
+static bool end_of_line(reader_t* r) {
+    int c = next_char(r);
+
+    while (c == ' ' || c == '\t' || c == '\r') {
+        c = next_char(r);
+    }
+
+    return c == '\n' || c == EOF;
+}
+
+// Reads a number of the binary AIGER format: 7 bits per byte, the highest bit
+// marks the bytes which are not the last one.
+static bool read_delta(reader_t* r, uint64_t* x) {
+    unsigned int shift = 0;
+    int c;
+
+    *x = 0;
+
+    do {
+        c = next_char(r);
+
+        if (c == EOF || shift > 63) {
+            return false;
+        }
+
+        *x |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return true;
+}
+
+// Returns the reference to the literal of AIGER: net lit / 2, negated if lit is odd.
+static inline uint32_t literal(uint64_t lit) {
+    return (lit & 1 ? REFERENCE_NOT_NET : REFERENCE_NET) | (uint32_t)(lit >> 1);
+}
+
+/**@brief Reads the AIGER netlist (header already read). Every variable is a net, the
+ * variable 0 is the constant false given by a gate without ports and every AND is
+ * the negation of a NAND gate.
+ */
+static bool read_aiger(reader_t* r, builder_t* b, bool binary) {
+    uint64_t header[5];
+    uint64_t extra;
+
+    for (int i = 0; i < 5; i++) {
+        if (!read_number(r, header + i, false)) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+
+    // Bad states, constraints, justice and fairness properties are not supported.
+    while (read_number(r, &extra, false)) {
+        if (extra != 0) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+
+    uint64_t maximal_variable = header[0];
+    uint64_t number_of_inputs = header[1];
+    uint64_t number_of_latches = header[2];
+    uint64_t number_of_outputs = header[3];
+    uint64_t number_of_ands = header[4];
+
+    // Latches are not supported. Too many inputs are rejected before any net is
+    // allocated.
+    if (!end_of_line(r) || number_of_latches != 0 || number_of_inputs > b->length_of_s ||
+        number_of_inputs + number_of_ands > maximal_variable ||
+        (binary && number_of_inputs + number_of_ands != maximal_variable)) {
+        errno = EINVAL;
+        return false;
+    }
+    if (maximal_variable >= REFERENCE_INDEX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!add_nets(b, maximal_variable + 1) || !begin_gate(b) ||
+        !define_net(b, 0, end_gate(b), false)) {
+        return false;
+    }
+
+    uint64_t lit;
+
+    for (uint64_t i = 0; i < number_of_inputs; i++) {
+        if (binary) {
+            lit = 2 * (i + 1);
+        }
+        else if (!read_number(r, &lit, true) || lit & 1 || lit < 2 || lit / 2 > maximal_variable) {
+            errno = EINVAL;
+            return false;
+        }
+        if (!define_signal(b, (uint32_t)(lit / 2))) {
+            return false;
+        }
+    }
+
+    for (uint64_t i = 0; i < number_of_outputs; i++) {
+        if (!read_number(r, &lit, true) || lit / 2 > maximal_variable) {
+            errno = EINVAL;
+            return false;
+        }
+        if (!add_output(b, literal(lit))) {
+            return false;
+        }
+    }
+
+    // The newline of the header is already read if there are no outputs.
+    if (binary && number_of_outputs > 0 && !end_of_line(r)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    for (uint64_t i = 0; i < number_of_ands; i++) {
+        uint64_t lhs;
+        uint64_t rhs0;
+        uint64_t rhs1;
+
+        if (binary) {
+            uint64_t delta0;
+            uint64_t delta1;
+
+            lhs = 2 * (number_of_inputs + i + 1);
+
+            if (!read_delta(r, &delta0) || !read_delta(r, &delta1) ||
+                delta0 > lhs || delta1 > lhs - delta0) {
+                errno = EINVAL;
+                return false;
+            }
+
+            rhs0 = lhs - delta0;
+            rhs1 = rhs0 - delta1;
+        }
+        else if (!read_number(r, &lhs, true) || !read_number(r, &rhs0, false) ||
+                 !read_number(r, &rhs1, false) || lhs & 1 || lhs < 2 ||
+                 lhs / 2 > maximal_variable || rhs0 / 2 > maximal_variable ||
+                 rhs1 / 2 > maximal_variable) {
+            errno = EINVAL;
+            return false;
+        }
+
+        uint32_t input0 = resolve_defined(b, literal(rhs0));
+        uint32_t input1 = resolve_defined(b, literal(rhs1));
+
+        if (input0 == NO_NODE || input1 == NO_NODE || !begin_gate(b) ||
+            !add_input(b, input0) || !add_input(b, input1) ||
+            !define_net(b, (uint32_t)(lhs / 2), end_gate(b), true)) {
+            return false;
+        }
+    }
+
+    // The symbol table and comments which may follow are not read.
+    return true;
+}
+
+nand_compiled_t* nand_import_aiger(FILE *f, bool const *s, size_t length_of_s) {
+    if (!f || !s) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    reader_t* r = (reader_t*)malloc(sizeof(reader_t));
+    builder_t b = {.length_of_s = length_of_s};
+    nand_compiled_t* c = NULL;
+    char format[4] = {0};
+
+    if (!r) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    r->file = f;
+    r->position = 0;
+    r->length = 0;
+
+    for (int i = 0; i < 3; i++) {
+        int ch = next_char(r);
+        format[i] = ch == EOF ? 0 : (char)ch;
+    }
+
+    bool binary = memcmp(format, "aig", 3) == 0;
+
+    if (!binary && memcmp(format, "aag", 3) != 0) {
+        errno = EINVAL;
+    }
+    else if (read_aiger(r, &b, binary)) {
+        if (ferror(f)) {
+            errno = EIO;
+        }
+        else {
+            c = finish(&b, s);
+        }
+    }
+    else if (ferror(f)) {
+        errno = EIO;
+    }
+
+    int error = errno;
+
+    free_builder(&b);
+    free(r);
+    errno = error;
+    return c;
+}
+
+/**@brief Names of the nets of BLIF, in a hash table with linear probing.
+ * text      - all names, each ended with 0.
+ * starts    - position of the name of every net in text.
+ * slots     - numbers of nets plus 1, 0 marks a free slot.
+ * recent    - numbers of nets plus 1 of recently used names, indexed by their hashes.
+ *             Netlists mostly use nets defined shortly before, whose names are still
+ *             in the cache of the processor, unlike the slots of a large table.
+ */
+typedef struct {
+    char* text;
+    size_t length_of_text;
+    size_t capacity_of_text;
+    size_t* starts;
+    size_t capacity_of_starts;
+    uint32_t* slots;
+    size_t capacity_of_slots;
+    uint32_t recent[RECENT_NAMES];
+} names_t;
+
+// Hash function of the names (FNV-1a).
+static size_t name_hash(char const* name, size_t length) {
+    uint64_t x = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        x = (x ^ (unsigned char)name[i]) * 0x100000001b3ULL;
+    }
+
+    return (size_t)(x ^ (x >> 32));
+}
+
+// Returns true if the net numbered net - 1 has the given name.
+static bool has_name(names_t const* names, uint32_t net, char const* name, size_t length) {
+    char const* other = names->text + names->starts[net - 1];
+    return memcmp(other, name, length) == 0 && other[length] == 0;
+}
+
+// Returns the slot of the name of the given hash (a free slot if it is not there).
+static size_t name_slot(names_t const* names, size_t hash, char const* name, size_t length) {
+    size_t mask = names->capacity_of_slots - 1;
+    size_t i = hash & mask;
+
+    while (names->slots[i] && !has_name(names, names->slots[i], name, length)) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**@brief Returns the number of the net of the given name, adding a new net if
+ * there is none. Returns NO_NODE with errno set on error.
+ */
+static uint32_t net_of_name(builder_t* b, names_t* names, char const* name, size_t length) {
+    size_t hash = name_hash(name, length);
+    uint32_t* recent = names->recent + (hash & (RECENT_NAMES - 1));
+
+    if (*recent && has_name(names, *recent, name, length)) {
+        return *recent - 1;
+    }
+    if (2 * (b->number_of_nets + 1) > names->capacity_of_slots) {
+        size_t new_capacity = names->capacity_of_slots ? 2 * names->capacity_of_slots : 1024;
+        uint32_t* new_slots = (uint32_t*)calloc(new_capacity, sizeof(uint32_t));
+
+        if (!new_slots) {
+            errno = ENOMEM;
+            return NO_NODE;
+        }
+
+        uint32_t* old_slots = names->slots;
+        size_t old_capacity = names->capacity_of_slots;
+
+        names->slots = new_slots;
+        names->capacity_of_slots = new_capacity;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i]) {
+                char const* other = names->text + names->starts[old_slots[i] - 1];
+                size_t length_of_other = strlen(other);
+                size_t hash_of_other = name_hash(other, length_of_other);
+
+                new_slots[name_slot(names, hash_of_other, other, length_of_other)] = old_slots[i];
+            }
+        }
+
+        free(old_slots);
+    }
+
+    size_t slot = name_slot(names, hash, name, length);
+
+    if (names->slots[slot]) {
+        *recent = names->slots[slot];
+        return names->slots[slot] - 1;
+    }
+
+    uint32_t net = (uint32_t)b->number_of_nets;
+
+    if (!reserve((void**)&names->text, &names->capacity_of_text,
+                 names->length_of_text + length + 1, 1) ||
+        !reserve((void**)&names->starts, &names->capacity_of_starts, net + 1, sizeof(size_t))) {
+        errno = ENOMEM;
+        return NO_NODE;
+    }
+    if (!add_nets(b, 1)) {
+        return NO_NODE;
+    }
+
+    names->starts[net] = names->length_of_text;
+    memcpy(names->text + names->length_of_text, name, length);
+    names->text[names->length_of_text + length] = 0;
+    names->length_of_text += length + 1;
+    names->slots[slot] = net + 1;
+    *recent = net + 1;
+    return net;
+}
+
+// Tokens of BLIF.
+typedef enum { TOKEN_WORD, TOKEN_NEWLINE, TOKEN_END, TOKEN_ERROR } token_t;
+
+/**@brief Reads the next word of BLIF into the growing buffer word, skipping
+ * comments and lines continued with a backslash.
+ */
+static token_t next_token(reader_t* r, char** word, size_t* length, size_t* capacity) {
+    int c = next_char(r);
+
+    for (;;) {
+        while (c == ' ' || c == '\t' || c == '\r') {
+            c = next_char(r);
+        }
+
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = next_char(r);
+            }
+        }
+        if (c == '\\' && (peek_char(r) == '\n' || peek_char(r) == '\r')) {
+            while (c != '\n' && c != EOF) {
+                c = next_char(r);
+            }
+
+            c = next_char(r);
+            continue;
+        }
+
+        break;
+    }
+
+    if (c == EOF) {
+        return TOKEN_END;
+    }
+    if (c == '\n') {
+        return TOKEN_NEWLINE;
+    }
+
+    *length = 0;
+
+    for (;;) {
+        if (!reserve((void**)word, capacity, *length + 2, 1)) {
+            errno = ENOMEM;
+            return TOKEN_ERROR;
+        }
+
+        (*word)[(*length)++] = (char)c;
+        c = peek_char(r);
+
+        if (c == EOF || c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#') {
+            break;
+        }
+
+        next_char(r);
+    }
+
+    (*word)[*length] = 0;
+    return TOKEN_WORD;
+}
+
+/**@brief State of the BLIF parser.
+ * word, length, capacity - the last read word.
+ * pending                - token read but not used yet, or TOKEN_ERROR if there is none.
+ * names                  - names of the nets.
+ * fanins                 - nets of the current .names command (output last).
+ * cubes                  - references to the negated cubes of the current cover.
+ */
+typedef struct {
+    reader_t* reader;
+    builder_t* builder;
+    char* word;
+    size_t length;
+    size_t capacity;
+    token_t pending;
+    names_t names;
+    uint32_t* fanins;
+    size_t number_of_fanins;
+    size_t capacity_of_fanins;
+    uint32_t* cubes;
+    size_t number_of_cubes;
+    size_t capacity_of_cubes;
+} blif_t;
+
+static token_t token(blif_t* p) {
+    if (p->pending != TOKEN_ERROR) {
+        token_t t = p->pending;
+        p->pending = TOKEN_ERROR;
+        return t;
+    }
+
+    return next_token(p->reader, &p->word, &p->length, &p->capacity);
+}
+
+// Reads nets named up to the end of the line into fanins.
+static bool read_names(blif_t* p) {
+    token_t t;
+
+    p->number_of_fanins = 0;
+
+    while ((t = token(p)) == TOKEN_WORD) {
+        uint32_t net = net_of_name(p->builder, &p->names, p->word, p->length);
+
+        if (net == NO_NODE) {
+            return false;
+        }
+        if (!reserve((void**)&p->fanins, &p->capacity_of_fanins,
+                     p->number_of_fanins + 1, sizeof(uint32_t))) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        p->fanins[p->number_of_fanins++] = net;
+    }
+
+    return t != TOKEN_ERROR;
+}
+
+/**@brief Reads the input plane of a cube in the word and returns the reference to
+ * the negation of the cube: a NAND gate of its literals, or the negated literal itself
+ * if there is only one. Returns NO_NODE with errno set on error.
+ */
+static uint32_t read_cube(blif_t* p, size_t number_of_inputs) {
+    builder_t* b = p->builder;
+    size_t number_of_literals = 0;
+    size_t last = 0;
+
+    if (p->length != number_of_inputs) {
+        errno = EINVAL;
+        return NO_NODE;
+    }
+
+    for (size_t i = 0; i < number_of_inputs; i++) {
+        if (p->word[i] != '0' && p->word[i] != '1' && p->word[i] != '-') {
+            errno = EINVAL;
+            return NO_NODE;
+        }
+        if (p->word[i] != '-') {
+            number_of_literals++;
+            last = i;
+        }
+    }
+
+    if (number_of_literals == 1) {
+        return resolve_defined(b, (p->word[last] == '1' ? REFERENCE_NOT_NET : REFERENCE_NET) |
+                                  p->fanins[last]);
+    }
+
+    // Inverters needed by the literals are created before the gate, so resolving
+    // the literals again below creates nothing.
+    for (size_t i = 0; i < number_of_inputs; i++) {
+        if (p->word[i] != '-' &&
+            resolve_defined(b, (p->word[i] == '1' ? REFERENCE_NET : REFERENCE_NOT_NET) |
+                               p->fanins[i]) == NO_NODE) {
+            return NO_NODE;
+        }
+    }
+
+    // The cube without literals is true, and a gate without ports is false.
+    if (!begin_gate(b)) {
+        return NO_NODE;
+    }
+
+    for (size_t i = 0; i < number_of_inputs; i++) {
+        if (p->word[i] != '-' &&
+            !add_input(b, resolve_defined(b, (p->word[i] == '1' ? REFERENCE_NET : REFERENCE_NOT_NET) |
+                                             p->fanins[i]))) {
+            return NO_NODE;
+        }
+    }
+
+    return end_gate(b);
+}
+
+/**@brief Reads the cover of the .names command, i.e. the sum of cubes. The output is
+ * a NAND gate of the negated cubes, or its negation if the cover lists the off-set
+ * (output bit 0). A cover without cubes is false.
+ */
+static bool read_cover(blif_t* p) {
+    builder_t* b = p->builder;
+    size_t number_of_inputs = p->number_of_fanins - 1;
+    uint32_t output = p->fanins[number_of_inputs];
+    int output_bit = -1;
+    token_t t;
+
+    p->number_of_cubes = 0;
+
+    while ((t = token(p)) != TOKEN_END) {
+        if (t == TOKEN_ERROR) {
+            return false;
+        }
+        if (t == TOKEN_NEWLINE) {
+            continue;
+        }
+        if (p->word[0] == '.') {
+            p->pending = TOKEN_WORD;
+            break;
+        }
+
+        // A line of the cover is the input plane and the output bit, or only
+        // the bit if there are no inputs.
+        uint32_t cube = NO_NODE;
+
+        if (number_of_inputs > 0) {
+            cube = read_cube(p, number_of_inputs);
+        }
+        else if (begin_gate(b)) { // The negation of the empty cube.
+            cube = end_gate(b);
+        }
+
+        if (cube != NO_NODE && number_of_inputs > 0 && (t = token(p)) != TOKEN_WORD) {
+            errno = t == TOKEN_ERROR ? errno : EINVAL;
+            return false;
+        }
+        if (cube == NO_NODE) {
+            return false;
+        }
+        if (!reserve((void**)&p->cubes, &p->capacity_of_cubes,
+                     p->number_of_cubes + 1, sizeof(uint32_t))) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        p->cubes[p->number_of_cubes++] = cube;
+
+        int bit = p->length == 1 && (p->word[0] == '0' || p->word[0] == '1') ? p->word[0] - '0' : -1;
+
+        if (bit < 0 || (output_bit >= 0 && bit != output_bit)) {
+            errno = EINVAL;
+            return false;
+        }
+
+        output_bit = bit;
+
+        if ((t = token(p)) == TOKEN_WORD) {
+            errno = EINVAL;
+            return false;
+        }
+        if (t == TOKEN_ERROR) {
+            return false;
+        }
+        if (t == TOKEN_END) {
+            break;
+        }
+    }
+
+    if (!begin_gate(b)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < p->number_of_cubes; i++) {
+        if (!add_input(b, p->cubes[i])) {
+            return false;
+        }
+    }
+
+    return define_net(b, output, end_gate(b), output_bit == 0);
+}
+
+static bool read_blif(blif_t* p) {
+    builder_t* b = p->builder;
+    token_t t;
+
+    while ((t = token(p)) != TOKEN_END) {
+        if (t == TOKEN_ERROR) {
+            return false;
+        }
+        if (t == TOKEN_NEWLINE) {
+            continue;
+        }
+        if (strcmp(p->word, ".model") == 0) {
+            while ((t = token(p)) == TOKEN_WORD) {
+            }
+        }
+        else if (strcmp(p->word, ".inputs") == 0) {
+            if (!read_names(p)) {
+                return false;
+            }
+
+            for (size_t i = 0; i < p->number_of_fanins; i++) {
+                if (!define_signal(b, p->fanins[i])) {
+                    return false;
+                }
+            }
+        }
+        else if (strcmp(p->word, ".outputs") == 0) {
+            if (!read_names(p)) {
+                return false;
+            }
+
+            for (size_t i = 0; i < p->number_of_fanins; i++) {
+                if (!add_output(b, REFERENCE_NET | p->fanins[i])) {
+                    return false;
+                }
+            }
+        }
+        else if (strcmp(p->word, ".names") == 0) {
+            if (!read_names(p)) {
+                return false;
+            }
+            if (p->number_of_fanins == 0) {
+                errno = EINVAL;
+                return false;
+            }
+            if (!read_cover(p)) {
+                return false;
+            }
+        }
+        else if (strcmp(p->word, ".end") == 0) {
+            return true;
+        }
+        else {
+            // Latches, subcircuits, library gates and unknown commands.
+            errno = EINVAL;
+            return false;
+        }
+
+        if (t == TOKEN_ERROR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+nand_compiled_t* nand_import_blif(FILE *f, bool const *s, size_t length_of_s) {
+    if (!f || !s) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    builder_t b = {.length_of_s = length_of_s};
+    blif_t p = {0};
+    nand_compiled_t* c = NULL;
+
+    p.reader = (reader_t*)malloc(sizeof(reader_t));
+    p.builder = &b;
+    p.pending = TOKEN_ERROR;
+
+    if (!p.reader) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    p.reader->file = f;
+    p.reader->position = 0;
+    p.reader->length = 0;
+
+    if (read_blif(&p)) {
+        if (ferror(f)) {
+            errno = EIO;
+        }
+        else {
+            c = finish(&b, s);
+        }
+    }
+    else if (ferror(f)) {
+        errno = EIO;
+    }
+
+    int error = errno;
+
+    free_builder(&b);
+    free(p.reader);
+    free(p.word);
+    free(p.names.text);
+    free(p.names.starts);
+    free(p.names.slots);
+    free(p.fanins);
+    free(p.cubes);
+    errno = error;
+    return c;
+}
@@ -0,0 +1,519 @@
+#ifndef NAND_INTERNAL_H
+#define NAND_INTERNAL_H
+
+// Structures of logical gates shared by the modules of the library.
+// This header is not a part of the library interface.
+
+#include "nand.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Macro for counting maximum value.
+#define max(x, y) (((x) >= (y)) ? (x) : (y))
+
+// Number of cables kept inside the gate structure. Gates with more cables
+// keep them in a separately allocated array.
+#define INLINE_CABLES 2
+
+// Value of the variable depth of a gate which has to be computed again.
+#define DEPTH_STALE (-2)
+
+// Counting of the work of the library, see nand_stats_t. Without NAND_STATS the
+// counters are not kept and these macros compile to nothing.
+#ifdef NAND_STATS
+extern nand_stats_t nand_stats_counters;
+#define STATS_ADD(counter, value) (nand_stats_counters.counter += (value))
+#define STATS_MAX(counter, value) \
+    (nand_stats_counters.counter = max(nand_stats_counters.counter, (uint64_t)(value)))
+#else
+#define STATS_ADD(counter, value) ((void)0)
+#define STATS_MAX(counter, value) ((void)0)
+#endif
+
+// Bit of the variable owner of a gate computed by nand_evaluate_parallel.
+#define OWNER_DONE 0x80000000u
+
+struct Port;
+
+/** @brief Structure which represents a single cable of logical gate.
+ * port_number         - unsigned number representing the port
+ *                       number of the gate which is linked by this cable.
+ * linked_logical_gate - the address of the gate which is linked by this
+ *                       cable.
+ */
+typedef struct Cable {
+    unsigned port_number;
+    nand_t* linked_logical_gate;
+} cable_t;
+
+
+/**@brief This structure represents single logical gate.
+ * ports                  - array of Port structure. Its length is represented
+ *                          by the variable number_of_ports.
+ * cables                 - array of Cable structure representing all nand-nand
+ *                          connections. Its length is represented by the variable
+ *                          length_of_cables. It is inline_cables as long as
+ *                          INLINE_CABLES cables are enough.
+ * number_of_ports        - unsigned integer representing the number of the gates input.
+ * length_of_cables_array - unsigned integer representing the length of cables.
+ * number_of_cables       - unsigned integer representing the true number of cables
+ *                          in the logical gate. Because struct Cable* cables acts in the same
+ *                          manner as vector in C++ we have number_of_cables <= length_of_cables_array.
+ * next_port              - technical variable of the walkthrough of the system. While the gate
+ *                          lies on the work stack it is the number of the first port which was
+ *                          not processed yet.
+  * my_longest_path       - ssize_t variable representing the longest path from this gate to the
+  *                         boolean signal or to the gate without ports. It is set to 0 when the
+  *                         gate is visited.
+ * epoch                  - number of the last walkthrough of the system which visited this gate.
+ *                          The gate is visited by the current walkthrough iff epoch is equal to its
+ *                          number, so a new walkthrough needs no cleanup of the old marks. Variables
+ *                          updated, any_false and my_longest_path are meaningful only for visited gates.
+ * updated                - boolean technical variable supporting DFS and cycle detection in nand_evaluate.
+ * gate_output_signal     - boolean variable describing the gate output during the nand_evaluate function.
+ * any_false              - technical boolean variable which is true if some of the ports of this gate
+ *                          keeps signal false and is false otherwise. This variable facilities rapid
+ *                          computations of gate_output_signal.
+ * kind                   - nand_kind_t of the gate. Gates of the kind NAND_KIND_LUT keep their
+ *                          table right after their ports (see lut_table), gates of the kind
+ *                          NAND_KIND_DFF keep their state there (see flip_flop_state).
+ * cached_longest_path    - my_longest_path remembered by nand_evaluate_cached. Meaningful only
+ *                          if cache_valid is true.
+ * cached_output_signal   - gate_output_signal remembered by nand_evaluate_cached. Meaningful only
+ *                          if cache_valid is true.
+ * cache_valid            - true if cached values are up to date. Whenever it is true, it is also
+ *                          true for every gate connected to the ports of this gate, hence
+ *                          invalidation may stop at the first gate which is already invalid.
+ * index                  - position of the gate on the list made by nand_topological_order,
+ *                          or the number of edges leaving the gate counted by nand_connect_many.
+ *                          Meaningful only until the next such list or count is made.
+ * rank                   - position of the gate in the topological order kept by nand_connect_nand,
+ *                          nand_connect_nand_checked and nand_connect_many. Ranks of the gates are
+ *                          distinct and every nand-nand connection goes from a lower rank to a higher
+ *                          one, except the connections which close a cycle (their gates are
+ *                          unordered) and the connections to flip-flops.
+ * unordered              - true if the gate is on the list of gates which may read a gate through
+ *                          a connection left out of the order (see nand.c).
+ * depth                  - longest path of the gate, i.e. the value nand_evaluate returns for
+ *                          this gate alone, or -1 if that evaluation fails because of an empty
+ *                          port, or DEPTH_STALE if it is not known since the last change of the
+ *                          connections. Whenever it is DEPTH_STALE, it is also DEPTH_STALE for
+ *                          every gate reading this gate, like cache_valid.
+ * owner                  - number of the thread of nand_evaluate_parallel which computes this
+ *                          gate together with the bit OWNER_DONE if it is computed, or 0. It is 0
+ *                          outside of nand_evaluate_parallel.
+ * pool                   - pool keeping the memory of this gate, its ports and cables, or NULL
+ *                          if they are allocated separately by malloc.
+ * inline_cables          - room for the first INLINE_CABLES cables, so that gates with small
+ *                          fan-out need no cables array.
+ */
+typedef struct nand {
+    // Variables read by the walkthroughs of the system come first, so that
+    // they share a cache line.
+    struct Port* ports;
+    unsigned int number_of_ports;
+    unsigned int next_port;
+    ssize_t my_longest_path;
+    unsigned long epoch;
+    bool gate_output_signal;
+    bool updated;
+    bool any_false;
+    bool cached_output_signal;
+    bool cache_valid;
+    uint8_t kind;
+    bool unordered;
+    ssize_t cached_longest_path;
+    struct Cable* cables;
+    unsigned int length_of_cables_array;
+    unsigned int number_of_cables;
+    unsigned int index;
+    unsigned int owner;
+    unsigned long rank;
+    ssize_t depth;
+    struct nand_pool* pool;
+    cable_t inline_cables[INLINE_CABLES];
+} nand_t;
+
+/** @brief Structure which represents ports of the logical gate.
+ * direct_signal  - if the signal is shared from a boolean signal
+ *                  it will keep its address. Is whether the signal
+ *                  is shared from another gate or there is no signal.
+ * sharing_gate   - if an input signal is shared from another gate it
+ *                  will hold its address. Is NULL whether there is no
+ *                  income signal or signal is shared directly from a
+ *                  boolean signal.
+ * cable_index    - index of the cable leading to this port in the cables
+ *                  array of sharing_gate or of the registered signal
+ *                  direct_signal.
+ */
+typedef struct Port {
+    const bool* direct_signal;
+    nand_t* sharing_gate;
+    unsigned int cable_index;
+} port_t;
+
+// Maximal number of ports of a gate of the kind NAND_KIND_LUT.
+#define LUT_PORTS 6
+
+// Size of the memory of the ports of a gate, including the table of a LUT or the
+// state of a flip-flop.
+static inline size_t ports_size(uint8_t kind, unsigned int n) {
+    return n * sizeof(port_t) + (kind >= NAND_KIND_LUT ? sizeof(uint64_t) : 0);
+}
+
+// Table of a gate of the kind NAND_KIND_LUT, kept after its ports.
+static inline uint64_t* lut_table(nand_t const* g) {
+    return (uint64_t*)(g->ports + g->number_of_ports);
+}
+
+// State of a gate of the kind NAND_KIND_DFF, kept after its port. Compiled systems
+// read it like a boolean signal.
+static inline bool* flip_flop_state(nand_t const* g) {
+    return (bool*)(g->ports + g->number_of_ports);
+}
+
+// Number of ports of g read by the walkthroughs of the system. The port of a
+// flip-flop is read only at the clock edge, so a flip-flop is a source like a
+// signal and cycles through it are not cycles of the walkthroughs.
+static inline unsigned int evaluated_ports(nand_t const* g) {
+    return g->kind == NAND_KIND_DFF ? 0 : g->number_of_ports;
+}
+
+/**@brief Computes the output of g from the number count of its ports which are true
+ * and the bits of the values of its first 64 ports (bit k for the port k).
+ */
+bool nand_kind_value(nand_t const* g, unsigned int count, uint64_t bits);
+
+/**@brief Sets the state of the flip-flop g to value. Cached values of the gates
+ * reading g become invalid if the state changes. The caller is the writer.
+ */
+void nand_flip_flop_set(nand_t* g, bool value);
+
+/**@brief Computes the output of g, a gate of any kind other than NAND_KIND_NAND,
+ * from the values of its ports. Values of gates are cached_output_signal if cached
+ * is true and gate_output_signal otherwise, all ports have to be connected.
+ */
+bool nand_kind_output(nand_t const* g, bool cached);
+
+/**@brief Flip-flop of a compiled system.
+ * flip_flop - the gate, which keeps the state between the calls of nand_step.
+ * state     - node of the signal giving the state of the flip-flop.
+ * input     - node connected to the port of the flip-flop.
+ */
+typedef struct {
+    nand_t* flip_flop;
+    uint32_t state;
+    uint32_t input;
+} compiled_register_t;
+
+/**@brief This structure represents a compiled system of logical gates, i.e. a flat
+ * copy of the system "back" from some gates and from the ports of the flip-flops met
+ * on the way, which are signals of the copy. Nodes of the copy are numbered: boolean
+ * signals come first and gates follow them in a topological order (nand_compile sorts
+ * them by levels). Every array is a part of the single allocated block memory, except
+ * a system loaded by nand_compiled_load, whose arrays input_offsets, inputs, levels
+ * and outputs lie in the mapped file.
+ * number_of_signals - number of distinct boolean signals read by the gates.
+ * number_of_gates   - number of gates.
+ * number_of_outputs - number of compiled gates given to nand_compile.
+ * signals           - addresses of the boolean signals, read by every evaluation.
+ * input_offsets     - array of length number_of_gates + 1. Nodes connected to the ports
+ *                     of the i-th gate are inputs[input_offsets[i]], ...,
+ *                     inputs[input_offsets[i + 1] - 1].
+ * inputs            - node numbers connected to the ports of all gates.
+ * levels            - level of every gate, i.e. its longest path to a boolean signal or
+ *                     to a gate without ports. Every gate comes after all gates connected
+ *                     to its ports.
+ * outputs           - node numbers of the gates given to nand_compile, in the same order.
+ * values            - technical array of values of all nodes used by the evaluation.
+ * longest_path      - the longest path of the whole compiled system.
+ * memory            - allocated block keeping all arrays (only signals and values for
+ *                     a loaded system).
+ * mapping           - mapped file of a loaded system, or NULL.
+ * mapping_size      - length of the mapped file.
+ * lane_values       - technical array of blocks of values of all nodes used by
+ *                     nand_compiled_evaluate_lanes, allocated at its first call.
+ * lane_memory       - allocated memory of lane_values (lane_values is aligned).
+ * registers         - the number_of_registers flip-flops of the system, allocated
+ *                     separately, or NULL if it has none. Their states are signals.
+ * step              - program of nand_step, made at its first call, or NULL.
+ */
+struct nand_compiled {
+    size_t number_of_signals;
+    size_t number_of_gates;
+    size_t number_of_outputs;
+    const bool** signals;
+    uint32_t* input_offsets;
+    uint32_t* inputs;
+    uint32_t* levels;
+    uint32_t* outputs;
+    uint8_t* values;
+    ssize_t longest_path;
+    void* memory;
+    void* mapping;
+    size_t mapping_size;
+    void* lane_values;
+    void* lane_memory;
+    compiled_register_t* registers;
+    size_t number_of_registers;
+    struct compiled_step* step;
+};
+
+/** @brief Structure which represents a boolean signal connected to at least
+ * one port. Signals are kept in a hash table so that nand_signal_changed can
+ * find all ports reading the given signal.
+ * address                - address of the boolean signal. NULL marks a free
+ *                          slot of the hash table.
+ * cables                 - array of cables to all ports reading this signal.
+ * length_of_cables_array - length of the cables array.
+ * number_of_cables       - true number of cables.
+ */
+typedef struct Signal {
+    const bool* address;
+    cable_t* cables;
+    unsigned int length_of_cables_array;
+    unsigned int number_of_cables;
+} signal_t;
+
+/** @brief Hash table (with linear probing) of connected signals.
+ * slots             - array of length capacity. Freed when the table
+ *                     becomes empty.
+ * capacity          - zero or a power of two.
+ * number_of_signals - number of occupied slots.
+ */
+typedef struct {
+    signal_t* slots;
+    size_t capacity;
+    size_t number_of_signals;
+} signal_table_t;
+
+// Number of size classes of blocks of a pool.
+#define NUMBER_OF_SIZE_CLASSES 64
+
+/** @brief Structure which represents a pool of memory for gates. Blocks of memory
+ * are cut from slabs. Small blocks have sizes rounded up to multiples of 16 bytes,
+ * bigger ones to powers of two, and every such size class has its own list of free
+ * blocks. Gates of a pool may be connected only with gates of the same pool, and
+ * signals read by them are registered in the own signal table of the pool, thus
+ * the whole pool is destroyed by freeing its slabs.
+ * free_lists      - lists of free blocks of every size class, linked through the
+ *                   first word of the block.
+ * slabs           - list of all slabs, linked through their first word.
+ * slab_next       - first free byte of the newest slab.
+ * slab_end        - end of the newest slab.
+ * signal_table    - signals connected to the gates of the pool.
+ * number_of_gates - number of existing gates of the pool.
+ * previous, next  - neighbours on the list of all pools.
+ */
+struct nand_pool {
+    void* free_lists[NUMBER_OF_SIZE_CLASSES];
+    void* slabs;
+    char* slab_next;
+    char* slab_end;
+    signal_table_t signal_table;
+    size_t number_of_gates;
+    struct nand_pool* previous;
+    struct nand_pool* next;
+};
+
+// Value of a port of a circuit which is not connected.
+#define EMPTY_PORT UINT32_MAX
+
+// Lowest bit of a port of a circuit which is connected to a boolean signal.
+#define SIGNAL_PORT 1u
+
+/** @brief Fan-out of a gate of a circuit.
+ * cables                 - global numbers of the ports reading the gate.
+ * number_of_cables       - number of cables.
+ * length_of_cables_array - length of the cables array.
+ */
+typedef struct {
+    uint32_t* cables;
+    uint32_t number_of_cables;
+    uint32_t length_of_cables_array;
+} circuit_fan_out_t;
+
+/** @brief Frame of the walkthrough of a circuit: the gate and its first port which
+ * was not processed yet.
+ */
+typedef struct {
+    uint32_t gate;
+    uint32_t next_port;
+} circuit_frame_t;
+
+/**@brief This structure represents a system of logical gates kept in flat arrays and
+ * referred to by 32-bit numbers instead of pointers. Ports of all gates are numbered
+ * one after another and a port keeps a tagged 32-bit value: EMPTY_PORT, 2 * g for the
+ * gate g or 2 * i + SIGNAL_PORT for the i-th signal. A cable is the global number of
+ * the port it leads to, thus an edge takes 12 bytes (driver and cable index of the port,
+ * and the cable) instead of 40 bytes of port_t and cable_t. Topology is kept apart from
+ * the technical variables of the evaluation, which are dense bit arrays. Gates cannot be
+ * deleted one by one, only the whole circuit.
+ * number_of_gates   - number of gates.
+ * capacity          - length of the arrays of gates (a multiple of 64).
+ * first_port        - array of length capacity + 1. Ports of the gate g are
+ *                     first_port[g], ..., first_port[g + 1] - 1.
+ * fan_out           - cables of every gate.
+ * number_of_ports   - number of ports of all gates.
+ * capacity_of_ports - length of the arrays of ports.
+ * drivers           - tagged value of every port.
+ * cable_index       - index of the cable leading to every port connected to a gate
+ *                     in the fan_out of this gate.
+ * signals           - addresses of the signals numbered by signal_numbers.
+ * signal_numbers    - hash table numbering the signals connected to the ports.
+ * visited, updated  - bit arrays of the walkthrough, set like the variables of nand_t.
+ * values            - bit array of outputs of the updated gates. While the gate is on
+ *                     the work stack it keeps any_false.
+ * longest_path      - longest path of every updated gate.
+ * stack             - work stack of length capacity.
+ * touched           - gates visited by the current evaluation, cleared at its end.
+ */
+struct nand_circuit {
+    size_t number_of_gates;
+    size_t capacity;
+    uint32_t* first_port;
+    circuit_fan_out_t* fan_out;
+    size_t number_of_ports;
+    size_t capacity_of_ports;
+    uint32_t* drivers;
+    uint32_t* cable_index;
+    const bool** signals;
+    struct {
+        const bool** addresses;
+        uint32_t* numbers;
+        size_t capacity;
+        size_t count;
+    } signal_numbers;
+    uint64_t* visited;
+    uint64_t* updated;
+    uint64_t* values;
+    uint32_t* longest_path;
+    circuit_frame_t* stack;
+    uint32_t* touched;
+};
+
+/** @brief Gate or instance of a module.
+ * sub        - the module of the instance, NULL for a NAND gate.
+ * first_port - number of its first port in the array drivers of the module. Its
+ *              ports end where the ports of the next element begin.
+ * first_node - its first node. A gate is one node and an instance has one node for
+ *              every output of sub, so the node of an instance is its first output.
+ */
+typedef struct {
+    struct nand_module* sub;
+    uint32_t first_port;
+    uint32_t first_node;
+} module_element_t;
+
+/**@brief This structure represents a module: a system of NAND gates and instances of
+ * other modules, with numbered inputs and outputs. The topology of a module is kept
+ * once and every instance costs only its element and its ports in the module which
+ * contains it, so the system is never flattened. Ports keep tagged values like in
+ * nand_circuit: EMPTY_PORT, 2 * v for the node v or 2 * i + SIGNAL_PORT for the
+ * i-th input of the module. Modules are deleted only as a whole.
+ * number_of_inputs     - number of inputs, fixed at creation.
+ * number_of_outputs    - number of outputs, fixed at creation.
+ * outputs              - node of every output, EMPTY_PORT if it is not set.
+ * elements             - gates and instances in the order of creation, an array of
+ *                        length capacity_of_elements + 1 (the last one only keeps
+ *                        the end of the ports).
+ * drivers              - tagged value of every port.
+ * owners               - element of every node.
+ * order                - elements "back" from the outputs in topological order, valid
+ *                        if ordered is true. Changes of the module clear ordered.
+ * subs                 - distinct modules instanced by this module.
+ * frame_size           - number of values needed by the evaluation of the module: its
+ *                        nodes and, for the largest instance, the inputs and the frame
+ *                        of its module. Computed in the walkthrough number epoch.
+ * values, paths        - values and longest paths of the nodes of the evaluation,
+ *                        of length capacity_of_frame.
+ */
+struct nand_module {
+    unsigned int number_of_inputs;
+    unsigned int number_of_outputs;
+    uint32_t* outputs;
+    module_element_t* elements;
+    size_t number_of_elements;
+    size_t capacity_of_elements;
+    uint32_t* drivers;
+    size_t number_of_ports;
+    size_t capacity_of_ports;
+    uint32_t* owners;
+    size_t number_of_nodes;
+    size_t capacity_of_nodes;
+    uint32_t* order;
+    size_t length_of_order;
+    bool ordered;
+    struct nand_module** subs;
+    size_t number_of_subs;
+    size_t capacity_of_subs;
+    size_t frame_size;
+    uint64_t epoch;
+    bool* values;
+    uint64_t* paths;
+    size_t capacity_of_frame;
+};
+
+/**@brief Allocates size bytes from the pool, or by malloc if pool is NULL.
+ * Returns NULL if there is no memory.
+ */
+void* nand_allocate(nand_pool_t* pool, size_t size);
+
+/**@brief Returns a block of size bytes allocated by nand_allocate(pool, size).
+ */
+void nand_release(nand_pool_t* pool, void* block, size_t size);
+
+/**@brief Changes the size of a block allocated by nand_allocate(pool, old_size)
+ * to new_size bytes, keeping its content like realloc. The block stays in place
+ * if possible. Returns NULL (leaving the old block) if there is no memory.
+ */
+void* nand_reallocate(nand_pool_t* pool, void* block, size_t old_size, size_t new_size);
+
+/**@brief Returns the first pool on the list of all existing pools.
+ */
+nand_pool_t* nand_pool_list(void);
+
+/**@brief Forgets count gates which were destroyed without nand_delete, together with
+ * their pool.
+ */
+void nand_forget_gates(size_t count);
+
+/**@brief Removes the gates of the pool, which is being deleted, from the list of gates
+ * with connections left out of the topological order.
+ */
+void nand_forget_unordered(nand_pool_t const* pool);
+
+/**@brief Makes the calling thread the writer of the system of gates, waiting until
+ * readers in evaluation contexts leave it and other writers are done. Calls may be
+ * nested in one thread: only the outermost pair of calls locks and unlocks.
+ * Functions changing connections of gates, creating or deleting them are writers.
+ */
+void nand_write_lock(void);
+
+/**@brief Ends the part of the calling thread started by nand_write_lock.
+ */
+void nand_write_unlock(void);
+
+/**@brief Lists the gates of the system "back" from the gates g[0], ..., g[m - 1] in
+ * topological order, i.e. every gate comes after all gates connected to its ports.
+ * A flip-flop is listed like a gate without ports, and the system "back" from the
+ * gate connected to its port is listed after it. Every listed gate keeps its position
+ * on the list in the variable index.
+ * @param g     - array of m gates.
+ * @param m     - length of the array g.
+ * @param order - on success set to the allocated list, which has to be freed by the caller.
+ * @return the number of listed gates or -1 with errno set to EINVAL (some g[i] is NULL),
+ *         ECANCELED (cycle or empty port, also of a flip-flop) or ENOMEM.
+ */
+ssize_t nand_topological_order(nand_t **g, size_t m, nand_t ***order);
+
+/**@brief Allocates a compiled system with all its arrays in one block, except the
+ * lane values. Arrays are not filled, longest_path is 0. Returns NULL if there is
+ * no memory.
+ */
+nand_compiled_t* nand_allocate_compiled(size_t number_of_signals, size_t number_of_gates,
+                                        size_t number_of_inputs, size_t number_of_outputs);
+
+#endif
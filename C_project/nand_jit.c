@@ -0,0 +1,314 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <dlfcn.h> // For dlopen, dlsym, dlclose.
+#include <errno.h> // For errno and its values.
+#include <limits.h> // For PATH_MAX.
+#include <spawn.h> // For posix_spawnp.
+#include <stdio.h> // For fopen, fprintf, fclose.
+#include <stdlib.h> // For malloc, aligned_alloc, free, getenv, mkdtemp.
+#include <string.h> // For strlen.
+#include <sys/wait.h> // For waitpid.
+#include <unistd.h> // For unlink, rmdir.
+
+extern char** environ;
+
+// Compiler used if the environment variable NAND_JIT_CC is not set.
+#define DEFAULT_COMPILER "cc"
+
+// Number of gates in one generated function.
+#define CHUNK_GATES 128
+
+// Number of 64-bit words computed together by the generated code.
+#define BLOCK_WORDS 4
+
+// Slot of a node which is not kept in the array of the generated code.
+#define NO_SLOT UINT32_MAX
+
+// Name of the generated function in the compiled library.
+#define FUNCTION_NAME "nand_jit_evaluate"
+
+// Name of the pointer to the slots in the compiled library, set by nand_jit.
+#define SLOTS_NAME "nand_jit_slots"
+
+/**@brief Native code of a compiled system.
+ * library  - handle of the shared library with the generated function.
+ * function - the generated function.
+ * slots    - array of the slots of the nodes used by the generated function, made
+ *            once here, so that the function never allocates memory.
+ */
+struct nand_jit {
+    void* library;
+    nand_jit_function_t function;
+    void* slots;
+};
+
+/**@brief Writes the C source of the function evaluating c. Gates are split into
+ * functions of CHUNK_GATES gates, because compilers need time growing faster than
+ * linearly with the size of a function. Inside a chunk every node is a local block
+ * of BLOCK_WORDS words, so the compiler keeps it in registers as long as it can.
+ * Only signals, outputs and gates read by later chunks get slots in the array v,
+ * and the topology of the system exists only in the code. The array v is made by
+ * nand_jit, which learns its size in bytes from size_of_slots. The arrays slots and
+ * loaded of length number_of_signals + number_of_gates are technical.
+ * Returns false if writing fails.
+ */
+static bool write_source(nand_compiled_t const* c, uint32_t* slots, uint32_t* loaded,
+                         FILE* f, size_t* size_of_slots) {
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+    uint32_t number_of_slots = (uint32_t)c->number_of_signals;
+
+    for (size_t i = 0; i < number_of_nodes; i++) {
+        slots[i] = i < c->number_of_signals ? (uint32_t)i : NO_SLOT;
+        loaded[i] = 0;
+    }
+    // Nodes which need slots are marked first and numbered in their order, so
+    // that the stores of a chunk go to consecutive slots.
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        for (uint32_t k = c->input_offsets[i]; k < c->input_offsets[i + 1]; k++) {
+            uint32_t node = c->inputs[k];
+
+            if (node >= c->number_of_signals &&
+                (node - c->number_of_signals) / CHUNK_GATES != i / CHUNK_GATES) {
+                slots[node] = 0;
+            }
+        }
+    }
+    for (size_t i = 0; i < c->number_of_outputs; i++) {
+        if (c->outputs[i] >= c->number_of_signals) {
+            slots[c->outputs[i]] = 0;
+        }
+    }
+    for (size_t i = c->number_of_signals; i < number_of_nodes; i++) {
+        if (slots[i] == 0) {
+            slots[i] = number_of_slots++;
+        }
+    }
+
+    fprintf(f, "#include <stddef.h>\n#include <stdint.h>\n"
+               "#include <string.h>\n\n#define WORDS %d\n"
+               "typedef uint64_t block_t __attribute__((vector_size(WORDS * 8)));\n",
+            BLOCK_WORDS);
+
+    for (size_t first = 0; first < c->number_of_gates; first += CHUNK_GATES) {
+        size_t chunk = first / CHUNK_GATES;
+        size_t last = first + CHUNK_GATES < c->number_of_gates ? first + CHUNK_GATES :
+                                                                  c->number_of_gates;
+
+        fprintf(f, "\n__attribute__((noinline)) static void chunk%zu(block_t *v) {\n", chunk);
+
+        for (size_t i = first; i < last; i++) {
+            size_t node = c->number_of_signals + i;
+            uint32_t begin = c->input_offsets[i];
+            uint32_t end = c->input_offsets[i + 1];
+
+            // Nodes of earlier chunks are loaded from their slots before the first use.
+            for (uint32_t k = begin; k < end; k++) {
+                uint32_t input = c->inputs[k];
+
+                if (input < c->number_of_signals + first && loaded[input] != chunk + 1) {
+                    loaded[input] = (uint32_t)chunk + 1;
+                    fprintf(f, "  const block_t t%u = v[%u];\n", input, slots[input]);
+                }
+            }
+
+            fprintf(f, "  const block_t t%zu = ", node);
+
+            // A gate without ports is false.
+            if (begin == end) {
+                fputs("{0};\n", f);
+            }
+            else {
+                for (uint32_t k = begin; k < end; k++) {
+                    fprintf(f, "%st%u", k == begin ? "~(" : " & ", c->inputs[k]);
+                }
+
+                fputs(");\n", f);
+            }
+            if (slots[node] != NO_SLOT) {
+                fprintf(f, "  v[%u] = t%zu;\n", slots[node], node);
+            }
+        }
+
+        fputs("}\n", f);
+    }
+
+    *size_of_slots = ((size_t)number_of_slots + 1) * BLOCK_WORDS * sizeof(uint64_t);
+    fputs("\nblock_t *" SLOTS_NAME ";\n\nstatic const uint32_t outputs[] = {", f);
+
+    for (size_t i = 0; i < c->number_of_outputs; i++) {
+        fprintf(f, "%s%u", i > 0 ? ", " : "", slots[c->outputs[i]]);
+    }
+
+    // Blocks of signals are filled with zeros after the last word.
+    fprintf(f, "%s};\n\nvoid " FUNCTION_NAME "(const uint64_t *in, uint64_t *out, size_t words) {\n"
+               "  block_t *v = " SLOTS_NAME ";\n"
+               "  for (size_t w = 0; w < words; w += WORDS) {\n"
+               "    size_t n = words - w < WORDS ? words - w : WORDS;\n"
+               "    for (size_t i = 0; i < %zu; i++) {\n"
+               "      memset(v + i, 0, sizeof(block_t));\n"
+               "      memcpy(v + i, in + i * words + w, n * 8);\n"
+               "    }\n",
+            c->number_of_outputs == 0 ? "0" : "", c->number_of_signals);
+
+    for (size_t i = 0; i < c->number_of_gates; i += CHUNK_GATES) {
+        fprintf(f, "    chunk%zu(v);\n", i / CHUNK_GATES);
+    }
+
+    fprintf(f, "    for (size_t i = 0; i < %zu; i++) {\n"
+               "      memcpy(out + i * words + w, v + outputs[i], n * 8);\n"
+               "    }\n  }\n}\n", c->number_of_outputs);
+    return !ferror(f);
+}
+
+/**@brief Runs the compiler making the shared library so_path of the source c_path.
+ * Returns 0, or an error number: the one of posix_spawnp if the compiler cannot be
+ * started, EIO if it fails.
+ */
+static int run_compiler(char const* c_path, char const* so_path) {
+    char const* compiler = getenv("NAND_JIT_CC");
+    char* argv[] = {(char*)(compiler && *compiler ? compiler : DEFAULT_COMPILER),
+                    "-O2", "-march=native", "-shared", "-fPIC", "-w", "-o", (char*)so_path, (char*)c_path, NULL};
+    pid_t child;
+    int status;
+    int error = posix_spawnp(&child, argv[0], NULL, NULL, argv, environ);
+
+    if (error != 0) {
+        return error;
+    }
+    if (waitpid(child, &status, 0) != child) {
+        return errno;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : EIO;
+}
+
+nand_jit_t* nand_jit(nand_compiled_t const *c) {
+    if (!c) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    char const* directory = getenv("TMPDIR");
+
+    if (!directory || !*directory) {
+        directory = "/tmp";
+    }
+
+    // The source and the library are made in a private directory made by mkdtemp,
+    // so no other user can put or replace a file under their names.
+    char base[PATH_MAX], c_path[PATH_MAX + 8], so_path[PATH_MAX + 8];
+
+    if (strlen(directory) + sizeof("/nand_jit_XXXXXX") > sizeof(base)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    nand_jit_t* jit = (nand_jit_t*)malloc(sizeof(nand_jit_t));
+
+    if (!jit) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    int error = 0;
+    bool made = false;
+
+    jit->slots = NULL;
+    snprintf(base, sizeof(base), "%s/nand_jit_XXXXXX", directory);
+
+    if (!mkdtemp(base)) {
+        error = errno;
+        goto cleanup;
+    }
+
+    made = true;
+    snprintf(c_path, sizeof(c_path), "%s/jit.c", base);
+    snprintf(so_path, sizeof(so_path), "%s/jit.so", base);
+
+    FILE* f = fopen(c_path, "wx");
+
+    if (!f) {
+        error = errno;
+        goto cleanup;
+    }
+
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+    size_t size_of_slots = 0;
+    uint32_t* slots = (uint32_t*)malloc(2 * (number_of_nodes + 1) * sizeof(uint32_t));
+    bool allocated = slots != NULL;
+    bool written = allocated && write_source(c, slots, slots + number_of_nodes + 1, f,
+                                             &size_of_slots);
+
+    free(slots);
+
+    if (fclose(f) != 0 || !written) {
+        error = allocated ? EIO : ENOMEM;
+        goto cleanup;
+    }
+
+    jit->slots = aligned_alloc(BLOCK_WORDS * sizeof(uint64_t), size_of_slots);
+
+    if (!jit->slots) {
+        error = ENOMEM;
+        goto cleanup;
+    }
+
+    error = run_compiler(c_path, so_path);
+
+    if (error != 0) {
+        goto cleanup;
+    }
+
+    // The library stays mapped after its file is removed.
+    jit->library = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    jit->function = jit->library ?
+        (nand_jit_function_t)dlsym(jit->library, FUNCTION_NAME) : NULL;
+
+    void** slots_pointer = jit->library ? (void**)dlsym(jit->library, SLOTS_NAME) : NULL;
+
+    if (!jit->function || !slots_pointer) {
+        if (jit->library) {
+            dlclose(jit->library);
+        }
+
+        error = EIO;
+    }
+    else {
+        *slots_pointer = jit->slots;
+    }
+
+cleanup:
+    if (made) {
+        unlink(so_path);
+        unlink(c_path);
+        rmdir(base);
+    }
+
+    if (error != 0) {
+        free(jit->slots);
+        free(jit);
+        errno = error;
+        return NULL;
+    }
+
+    return jit;
+}
+
+nand_jit_function_t nand_jit_function(nand_jit_t const *j) {
+    if (!j) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return j->function;
+}
+
+void nand_jit_delete(nand_jit_t *j) {
+    if (!j) {
+        return;
+    }
+
+    dlclose(j->library);
+    free(j->slots);
+    free(j);
+}
@@ -0,0 +1,145 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uint64_t and uintptr_t.
+#include <stdlib.h> // For malloc.
+#include <string.h> // For memcpy, memset.
+
+// Number of 64-bit words evaluated together, i.e. one 512-bit vector.
+#define LANE_WORDS 8
+
+/**@brief Block of LANE_WORDS words of one node. Every gate computes its block
+ * with vector instructions as wide as the selected kernel allows: four SSE2,
+ * two AVX2 or one AVX-512 instruction per operation.
+ */
+typedef uint64_t block_t __attribute__((vector_size(LANE_WORDS * sizeof(uint64_t))));
+
+typedef void (*kernel_t)(nand_compiled_t const* c, block_t* values);
+
+/**@brief Evaluates blocks of all gates of c. Blocks of the boolean signals
+ * have to be already in values. Inlined into every kernel, so it is
+ * compiled separately for every instruction set.
+ */
+static inline __attribute__((always_inline))
+void evaluate_blocks(nand_compiled_t const* c, block_t* values) {
+    block_t* gate_values = values + c->number_of_signals;
+    uint32_t const* input_offsets = c->input_offsets;
+    uint32_t const* inputs = c->inputs;
+    block_t ones;
+
+    memset(&ones, 0xff, sizeof(ones));
+
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        block_t all_true = ones;
+
+        for (uint32_t k = input_offsets[i]; k < input_offsets[i + 1]; k++) {
+            all_true &= values[inputs[k]];
+        }
+
+        gate_values[i] = ~all_true;
+    }
+}
+
+static void evaluate_blocks_generic(nand_compiled_t const* c, block_t* values) {
+    evaluate_blocks(c, values);
+}
+
+__attribute__((target("avx2")))
+static void evaluate_blocks_avx2(nand_compiled_t const* c, block_t* values) {
+    evaluate_blocks(c, values);
+}
+
+__attribute__((target("avx512f")))
+static void evaluate_blocks_avx512(nand_compiled_t const* c, block_t* values) {
+    evaluate_blocks(c, values);
+}
+
+// Kernel for the widest instruction set supported by the processor.
+static kernel_t select_kernel(void) {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        return evaluate_blocks_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return evaluate_blocks_avx2;
+    }
+
+    return evaluate_blocks_generic;
+}
+
+size_t nand_compiled_number_of_signals(nand_compiled_t const *c) {
+    if (!c) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    return c->number_of_signals;
+}
+
+bool const* nand_compiled_signal(nand_compiled_t const *c, size_t i) {
+    if (!c || i >= c->number_of_signals) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return c->signals[i];
+}
+
+ssize_t nand_compiled_evaluate_lanes(nand_compiled_t *c, uint64_t const *in,
+                                     uint64_t *out, size_t words) {
+    static kernel_t kernel = NULL;
+
+    if (!c || !in || !out || words == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t number_of_nodes = c->number_of_signals + c->number_of_gates;
+
+    if (!c->lane_values) {
+        if (number_of_nodes > (SIZE_MAX - sizeof(block_t)) / sizeof(block_t)) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        c->lane_memory = malloc((number_of_nodes + 1) * sizeof(block_t));
+
+        if (!c->lane_memory) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        uintptr_t address = (uintptr_t)c->lane_memory;
+        c->lane_values = (void*)((address + sizeof(block_t) - 1) & ~(uintptr_t)(sizeof(block_t) - 1));
+    }
+
+    // Threads evaluating lanes for the first time at once may all select the kernel,
+    // they store the same value.
+    kernel_t selected = __atomic_load_n(&kernel, __ATOMIC_ACQUIRE);
+
+    if (!selected) {
+        selected = select_kernel();
+        __atomic_store_n(&kernel, selected, __ATOMIC_RELEASE);
+    }
+
+    block_t* values = (block_t*)c->lane_values;
+
+    // Words are evaluated in blocks, the last block is filled with zeros.
+    for (size_t first = 0; first < words; first += LANE_WORDS) {
+        size_t length = words - first < LANE_WORDS ? words - first : LANE_WORDS;
+
+        for (size_t i = 0; i < c->number_of_signals; i++) {
+            memset(values + i, 0, sizeof(block_t));
+            memcpy(values + i, in + i * words + first, length * sizeof(uint64_t));
+        }
+
+        selected(c, values);
+
+        for (size_t i = 0; i < c->number_of_outputs; i++) {
+            memcpy(out + i * words + first, values + c->outputs[i], length * sizeof(uint64_t));
+        }
+    }
+
+    return c->longest_path;
+}
@@ -0,0 +1,496 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the module.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uint32_t, uint64_t.
+#include <stdlib.h> // For malloc, calloc, realloc, free.
+
+// Number of nodes and number of ports are kept below these limits, so that a
+// tagged port and a port number fit in 32 bits.
+#define MAX_NODES ((size_t)1 << 31)
+#define MAX_PORTS ((size_t)UINT32_MAX)
+
+// States of the elements in the walkthrough of order_module.
+#define STATE_NEW 0
+#define STATE_ON_STACK 1
+#define STATE_DONE 2
+
+// Number of the last walkthrough of the graph of modules.
+static uint64_t module_epoch = 0;
+
+// Reallocates *array to count elements of given size. Returns false if there is
+// no memory (*array stays valid).
+static bool grow(void* array, size_t count, size_t size) {
+    void* new_array = realloc(*(void**)array, count * size);
+
+    if (!new_array) {
+        return false;
+    }
+
+    *(void**)array = new_array;
+    return true;
+}
+
+nand_module_t* nand_module_new(unsigned inputs, unsigned outputs) {
+    if (inputs >= MAX_NODES) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    nand_module_t* m = (nand_module_t*)calloc(1, sizeof(nand_module_t));
+
+    if (!m) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    m->number_of_inputs = inputs;
+    m->number_of_outputs = outputs;
+    m->outputs = (uint32_t*)malloc((outputs ? outputs : 1) * sizeof(uint32_t));
+    m->elements = (module_element_t*)malloc(sizeof(module_element_t));
+
+    if (!m->outputs || !m->elements) {
+        nand_module_delete(m);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for (unsigned j = 0; j < outputs; j++) {
+        m->outputs[j] = EMPTY_PORT;
+    }
+
+    // Ports of the element e end where ports of the next element begin.
+    m->elements[0].first_port = 0;
+    return m;
+}
+
+void nand_module_delete(nand_module_t *m) {
+    if (!m) {
+        return;
+    }
+
+    free(m->outputs);
+    free(m->elements);
+    free(m->drivers);
+    free(m->owners);
+    free(m->order);
+    free(m->subs);
+    free(m->values);
+    free(m->paths);
+    free(m);
+}
+
+/**@brief Adds an element of the module sub (NULL for a NAND gate) with n ports and
+ * the given number of nodes. Returns its first node or -1 if there is no memory.
+ */
+static ssize_t add_element(nand_module_t* m, nand_module_t* sub, unsigned n, size_t nodes) {
+    if (m->number_of_nodes + nodes >= MAX_NODES || n > MAX_PORTS - m->number_of_ports) {
+        return -1;
+    }
+    if (m->number_of_elements == m->capacity_of_elements) {
+        size_t new_capacity = m->capacity_of_elements ? 2 * m->capacity_of_elements : 64;
+
+        if (!grow(&m->elements, new_capacity + 1, sizeof(module_element_t))) {
+            return -1;
+        }
+
+        m->capacity_of_elements = new_capacity;
+    }
+    if (m->number_of_nodes + nodes > m->capacity_of_nodes) {
+        size_t new_capacity = m->capacity_of_nodes ? 2 * m->capacity_of_nodes : 64;
+
+        while (new_capacity < m->number_of_nodes + nodes) {
+            new_capacity *= 2;
+        }
+        if (!grow(&m->owners, new_capacity, sizeof(uint32_t))) {
+            return -1;
+        }
+
+        m->capacity_of_nodes = new_capacity;
+    }
+    if (m->number_of_ports + n > m->capacity_of_ports) {
+        size_t new_capacity = m->capacity_of_ports ? 2 * m->capacity_of_ports : 64;
+
+        while (new_capacity < m->number_of_ports + n) {
+            new_capacity *= 2;
+        }
+        if (!grow(&m->drivers, new_capacity, sizeof(uint32_t))) {
+            return -1;
+        }
+
+        m->capacity_of_ports = new_capacity;
+    }
+
+    module_element_t* e = m->elements + m->number_of_elements;
+    uint32_t first_node = (uint32_t)m->number_of_nodes;
+
+    e->sub = sub;
+    e->first_node = first_node;
+
+    for (unsigned k = 0; k < n; k++) {
+        m->drivers[m->number_of_ports + k] = EMPTY_PORT;
+    }
+    for (size_t v = 0; v < nodes; v++) {
+        m->owners[first_node + v] = (uint32_t)m->number_of_elements;
+    }
+
+    m->number_of_ports += n;
+    m->number_of_nodes += nodes;
+    e[1].first_port = (uint32_t)m->number_of_ports;
+    m->number_of_elements++;
+    m->ordered = false;
+    return first_node;
+}
+
+ssize_t nand_module_add(nand_module_t *m, unsigned n) {
+    if (!m) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t v = add_element(m, NULL, n, 1);
+
+    if (v < 0) {
+        errno = ENOMEM;
+    }
+
+    return v;
+}
+
+// Returns true if the module m is target or contains its instance at some level.
+// Modules walked are marked with module_epoch.
+static bool contains(nand_module_t* m, nand_module_t const* target) {
+    if (m == target) {
+        return true;
+    }
+    if (m->epoch == module_epoch) {
+        return false;
+    }
+
+    m->epoch = module_epoch;
+
+    for (size_t i = 0; i < m->number_of_subs; i++) {
+        if (contains(m->subs[i], target)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ssize_t nand_module_instance(nand_module_t *m, nand_module_t *sub) {
+    if (!m || !sub || sub->number_of_outputs == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // An instance of a module containing m would make the hierarchy infinite.
+    module_epoch++;
+
+    if (contains(sub, m)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t i = 0;
+
+    while (i < m->number_of_subs && m->subs[i] != sub) {
+        i++;
+    }
+
+    if (i == m->number_of_subs) {
+        if (m->number_of_subs == m->capacity_of_subs) {
+            size_t new_capacity = m->capacity_of_subs ? 2 * m->capacity_of_subs : 4;
+
+            if (!grow(&m->subs, new_capacity, sizeof(nand_module_t*))) {
+                errno = ENOMEM;
+                return -1;
+            }
+
+            m->capacity_of_subs = new_capacity;
+        }
+
+        m->subs[i] = sub;
+    }
+
+    ssize_t v = add_element(m, sub, sub->number_of_inputs, sub->number_of_outputs);
+
+    if (v < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    m->number_of_subs += i == m->number_of_subs;
+    return v;
+}
+
+// Returns the number of the port k of the element whose node is v, or EMPTY_PORT
+// if there is no such port.
+static uint32_t port_number(nand_module_t const* m, uint32_t v, unsigned k) {
+    if (v >= m->number_of_nodes) {
+        return EMPTY_PORT;
+    }
+
+    module_element_t const* e = m->elements + m->owners[v];
+
+    if (e->first_node != v || k >= e[1].first_port - e->first_port) {
+        return EMPTY_PORT;
+    }
+
+    return e->first_port + k;
+}
+
+int nand_module_connect(nand_module_t *m, uint32_t v_out, uint32_t v_in, unsigned k) {
+    uint32_t p = m ? port_number(m, v_in, k) : EMPTY_PORT;
+
+    if (p == EMPTY_PORT || v_out >= m->number_of_nodes) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    m->drivers[p] = v_out << 1;
+    m->ordered = false;
+    return 0;
+}
+
+int nand_module_connect_input(nand_module_t *m, unsigned i, uint32_t v_in, unsigned k) {
+    uint32_t p = m ? port_number(m, v_in, k) : EMPTY_PORT;
+
+    if (p == EMPTY_PORT || i >= m->number_of_inputs) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    m->drivers[p] = ((uint32_t)i << 1) | SIGNAL_PORT;
+    m->ordered = false;
+    return 0;
+}
+
+int nand_module_set_output(nand_module_t *m, unsigned j, uint32_t v) {
+    if (!m || j >= m->number_of_outputs || v >= m->number_of_nodes) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    m->outputs[j] = v;
+    m->ordered = false;
+    return 0;
+}
+
+/**@brief Lists the elements "back" from the outputs of m in topological order. It is
+ * the walkthrough of evaluate_gate in nand.c on elements: an instance is a whole, so
+ * a path from an output of an instance to its input is a cycle.
+ * Returns 0, or ECANCELED (cycle, empty port or output which is not set) or ENOMEM.
+ */
+static int order_module(nand_module_t* m) {
+    uint8_t* states = (uint8_t*)calloc(m->number_of_elements + 1, sizeof(uint8_t));
+    circuit_frame_t* stack = (circuit_frame_t*)malloc((m->number_of_elements + 1) *
+                                                      sizeof(circuit_frame_t));
+    int error = 0;
+
+    if (!states || !stack ||
+        !grow(&m->order, m->number_of_elements + 1, sizeof(uint32_t))) {
+        error = ENOMEM;
+        goto cleanup;
+    }
+
+    m->length_of_order = 0;
+
+    for (unsigned j = 0; j < m->number_of_outputs && !error; j++) {
+        if (m->outputs[j] == EMPTY_PORT) {
+            error = ECANCELED;
+            break;
+        }
+
+        uint32_t first = m->owners[m->outputs[j]];
+        size_t top = 0;
+
+        if (states[first] == STATE_DONE) {
+            continue;
+        }
+
+        states[first] = STATE_ON_STACK;
+        stack[top++] = (circuit_frame_t){first, m->elements[first].first_port};
+
+        while (top > 0) {
+            circuit_frame_t* frame = stack + top - 1;
+            uint32_t p = frame->next_port;
+            uint32_t end = m->elements[frame->gate + 1].first_port;
+            uint32_t next = 0;
+
+            for (; p < end; p++) {
+                uint32_t driver = m->drivers[p];
+
+                if (driver == EMPTY_PORT) { // Empty port - no connection.
+                    error = ECANCELED;
+                    break;
+                }
+                if (driver & SIGNAL_PORT) { // Input of the module.
+                    continue;
+                }
+
+                next = m->owners[driver >> 1];
+
+                if (states[next] == STATE_NEW) {
+                    break;
+                }
+                if (states[next] == STATE_ON_STACK) { // Cycle condition.
+                    error = ECANCELED;
+                    break;
+                }
+            }
+
+            if (error) {
+                break;
+            }
+
+            frame->next_port = p;
+
+            if (p < end) { // Go to the new element.
+                states[next] = STATE_ON_STACK;
+                stack[top++] = (circuit_frame_t){next, m->elements[next].first_port};
+                continue;
+            }
+
+            // All ports processed.
+            states[frame->gate] = STATE_DONE;
+            m->order[m->length_of_order++] = frame->gate;
+            top--;
+        }
+    }
+
+    m->ordered = !error;
+
+cleanup:
+    free(states);
+    free(stack);
+    return error;
+}
+
+/**@brief Orders m and all modules instanced "back" from its outputs, if they are
+ * not ordered, and computes their frame sizes. Every module is prepared once in
+ * the walkthrough number module_epoch. Returns 0 or an error number of order_module.
+ */
+static int prepare(nand_module_t* m) {
+    if (m->epoch == module_epoch) {
+        return 0;
+    }
+
+    m->epoch = module_epoch;
+
+    int error = m->ordered ? 0 : order_module(m);
+    size_t child = 0;
+
+    for (size_t i = 0; i < m->length_of_order && !error; i++) {
+        nand_module_t* sub = m->elements[m->order[i]].sub;
+
+        if (sub) {
+            error = prepare(sub);
+            child = max(sub->number_of_inputs + sub->frame_size, child);
+        }
+    }
+
+    m->frame_size = m->number_of_nodes + child;
+    return error;
+}
+
+/**@brief Evaluates the prepared module m whose inputs have values in and longest paths
+ * in_paths. Values and longest paths of its nodes are written to values and paths,
+ * which are followed by room for the frames of the instances: the inputs of the
+ * instance and then the frame of its module. Every instance is evaluated there in
+ * turn, and only the values of its outputs are copied to its nodes.
+ */
+static void evaluate_module(nand_module_t const* m, bool const* in, uint64_t const* in_paths,
+                            bool* values, uint64_t* paths) {
+    uint32_t const* drivers = m->drivers;
+    bool* child_in = values + m->number_of_nodes;
+    uint64_t* child_paths = paths + m->number_of_nodes;
+
+    for (size_t i = 0; i < m->length_of_order; i++) {
+        module_element_t const* e = m->elements + m->order[i];
+        uint32_t begin = e->first_port;
+        uint32_t end = e[1].first_port;
+
+        if (!e->sub) { // NAND gate.
+            bool any_false = false;
+            uint64_t longest_path = 0;
+
+            for (uint32_t p = begin; p < end; p++) {
+                uint32_t driver = drivers[p];
+                bool input = driver & SIGNAL_PORT;
+
+                any_false |= !(input ? in : values)[driver >> 1];
+                longest_path = max((input ? in_paths : paths)[driver >> 1] + 1, longest_path);
+            }
+
+            values[e->first_node] = any_false;
+            paths[e->first_node] = longest_path;
+            continue;
+        }
+
+        nand_module_t const* sub = e->sub;
+
+        for (uint32_t p = begin; p < end; p++) {
+            uint32_t driver = drivers[p];
+            bool input = driver & SIGNAL_PORT;
+
+            child_in[p - begin] = (input ? in : values)[driver >> 1];
+            child_paths[p - begin] = (input ? in_paths : paths)[driver >> 1];
+        }
+
+        bool* sub_values = child_in + sub->number_of_inputs;
+        uint64_t* sub_paths = child_paths + sub->number_of_inputs;
+
+        evaluate_module(sub, child_in, child_paths, sub_values, sub_paths);
+
+        for (unsigned j = 0; j < sub->number_of_outputs; j++) {
+            values[e->first_node + j] = sub_values[sub->outputs[j]];
+            paths[e->first_node + j] = sub_paths[sub->outputs[j]];
+        }
+    }
+}
+
+ssize_t nand_module_evaluate(nand_module_t *m, bool const *in, bool *out) {
+    if (!m || !out || (!in && m->number_of_inputs > 0) || m->number_of_outputs == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    module_epoch++;
+
+    int error = prepare(m);
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    // Longest paths of the inputs come first, they are 0 like for signals.
+    size_t size = m->number_of_inputs + m->frame_size;
+
+    if (size > m->capacity_of_frame) {
+        if (!grow(&m->values, size, sizeof(bool)) || !grow(&m->paths, size, sizeof(uint64_t))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        m->capacity_of_frame = size;
+    }
+
+    uint64_t* in_paths = m->paths;
+    bool* values = m->values + m->number_of_inputs;
+    uint64_t* paths = m->paths + m->number_of_inputs;
+    uint64_t longest_path = 0;
+
+    for (unsigned i = 0; i < m->number_of_inputs; i++) {
+        in_paths[i] = 0;
+    }
+
+    evaluate_module(m, in, in_paths, values, paths);
+
+    for (unsigned j = 0; j < m->number_of_outputs; j++) {
+        out[j] = values[m->outputs[j]];
+        longest_path = max(paths[m->outputs[j]], longest_path);
+    }
+
+    return (ssize_t)longest_path;
+}
@@ -0,0 +1,412 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structures of logical gates.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uintptr_t.
+#include <stdlib.h> // For malloc, calloc, realloc, free, qsort.
+#include <string.h> // For memcmp, memcpy.
+
+// Values of the gates known by the optimization.
+typedef enum { VALUE_FALSE, VALUE_TRUE, VALUE_VARIABLE } value_t;
+
+/**@brief Node connected to a port: a gate or a boolean signal. Addresses of gates
+ * and signals are distinct, so a node is identified by its address.
+ */
+typedef struct {
+    nand_t* gate;
+    const bool* signal;
+} node_t;
+
+/**@brief Gate kept in the table of structural hashing.
+ * gate   - the gate, representing all gates with the same set of inputs.
+ * hash   - hash of its set of inputs.
+ * first  - position of its sorted set of inputs in the array keys.
+ * length - size of the set.
+ */
+typedef struct {
+    nand_t* gate;
+    size_t hash;
+    size_t first;
+    size_t length;
+} entry_t;
+
+/**@brief State of nand_optimize.
+ * order    - the gates "back" from the kept ones in topological order (gate->index
+ *            is the position of the gate on this list).
+ * kept     - true for gates given to nand_optimize, which are never removed.
+ * values   - value of every gate of order.
+ * constant - the first gate of the given value, to which the other gates of
+ *            this value are redirected (NULL if there is none yet).
+ * entries  - hash table (with linear probing) of gates with distinct sets of inputs,
+ *            NULL gate marks a free slot. capacity is a power of two.
+ * keys     - sorted sets of inputs of the gates of the table, one after another.
+ * set      - technical array for the set of inputs of the current gate.
+ */
+typedef struct {
+    nand_t** order;
+    size_t number_of_gates;
+    bool* kept;
+    uint8_t* values;
+    nand_t* constant[2];
+    entry_t* entries;
+    size_t capacity;
+    size_t count;
+    uintptr_t* keys;
+    size_t length_of_keys;
+    size_t capacity_of_keys;
+    uintptr_t* set;
+    size_t capacity_of_set;
+} optimizer_t;
+
+// Returns the node connected to the port k of g.
+static node_t input_of(nand_t* g, unsigned int k) {
+    node_t node = {g->ports[k].sharing_gate, g->ports[k].direct_signal};
+    return node;
+}
+
+static value_t value_of(optimizer_t const* o, node_t node) {
+    return node.gate ? (value_t)o->values[node.gate->index] : VALUE_VARIABLE;
+}
+
+/**@brief Connects every port reading g to the node instead, thus g has no fan-out
+ * afterwards. Gates reading g keep their functions, as the node gives the same value.
+ * Returns false if there is no memory (g may keep some of its fan-out then).
+ */
+static bool redirect(nand_t* g, node_t node) {
+    while (g->number_of_cables > 0) {
+        cable_t cable = g->cables[g->number_of_cables - 1];
+        int result = node.gate ?
+            nand_connect_nand(node.gate, cable.linked_logical_gate, cable.port_number) :
+            nand_connect_signal(node.signal, cable.linked_logical_gate, cable.port_number);
+
+        if (result != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int compare_addresses(const void* a, const void* b) {
+    uintptr_t x = *(uintptr_t const*)a;
+    uintptr_t y = *(uintptr_t const*)b;
+    return (x > y) - (x < y);
+}
+
+/**@brief Writes the sorted set of inputs of g to o->set, leaving out inputs which
+ * are constantly true (they do not change a NAND gate). Returns the size of the
+ * set or -1 if there is no memory.
+ */
+static ssize_t input_set(optimizer_t* o, nand_t* g) {
+    if (g->number_of_ports > o->capacity_of_set) {
+        uintptr_t* new_set = (uintptr_t*)realloc(o->set, g->number_of_ports * sizeof(uintptr_t));
+
+        if (!new_set) {
+            return -1;
+        }
+
+        o->set = new_set;
+        o->capacity_of_set = g->number_of_ports;
+    }
+
+    size_t length = 0;
+
+    for (unsigned int k = 0; k < g->number_of_ports; k++) {
+        node_t node = input_of(g, k);
+
+        if (value_of(o, node) != VALUE_TRUE) {
+            o->set[length++] = node.gate ? (uintptr_t)node.gate : (uintptr_t)node.signal;
+        }
+    }
+
+    qsort(o->set, length, sizeof(uintptr_t), compare_addresses);
+
+    size_t unique = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        if (unique == 0 || o->set[i] != o->set[unique - 1]) {
+            o->set[unique++] = o->set[i];
+        }
+    }
+
+    return (ssize_t)unique;
+}
+
+static size_t hash_of_set(uintptr_t const* set, size_t length) {
+    uint64_t x = 0x9E3779B97F4A7C15ULL ^ length;
+
+    for (size_t i = 0; i < length; i++) {
+        x = (x ^ (uint64_t)set[i]) * 0xff51afd7ed558ccdULL;
+        x ^= x >> 32;
+    }
+
+    return (size_t)x;
+}
+
+// Returns the slot of the set in the table (a free slot if it is not there).
+static size_t set_slot(optimizer_t const* o, size_t hash, uintptr_t const* set, size_t length) {
+    size_t mask = o->capacity - 1;
+    size_t i = hash & mask;
+
+    while (o->entries[i].gate) {
+        entry_t const* e = o->entries + i;
+
+        if (e->hash == hash && e->length == length &&
+            memcmp(o->keys + e->first, set, length * sizeof(uintptr_t)) == 0) {
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**@brief Finds the gate with the same set of inputs as o->set, or adds g to the
+ * table if there is none. Returns the gate found, g if it is added, or NULL if
+ * there is no memory.
+ */
+static nand_t* find_or_add(optimizer_t* o, nand_t* g, size_t length) {
+    if (2 * (o->count + 1) > o->capacity) {
+        size_t new_capacity = o->capacity ? 2 * o->capacity : 64;
+        entry_t* new_entries = (entry_t*)calloc(new_capacity, sizeof(entry_t));
+
+        if (!new_entries) {
+            return NULL;
+        }
+
+        entry_t* old_entries = o->entries;
+        size_t old_capacity = o->capacity;
+
+        o->entries = new_entries;
+        o->capacity = new_capacity;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_entries[i].gate) {
+                size_t slot = old_entries[i].hash & (new_capacity - 1);
+
+                while (new_entries[slot].gate) {
+                    slot = (slot + 1) & (new_capacity - 1);
+                }
+
+                new_entries[slot] = old_entries[i];
+            }
+        }
+
+        free(old_entries);
+    }
+
+    size_t hash = hash_of_set(o->set, length);
+    size_t slot = set_slot(o, hash, o->set, length);
+
+    if (o->entries[slot].gate) {
+        return o->entries[slot].gate;
+    }
+    if (o->length_of_keys + length > o->capacity_of_keys) {
+        size_t new_capacity = o->capacity_of_keys ? 2 * o->capacity_of_keys : 256;
+
+        while (new_capacity < o->length_of_keys + length) {
+            new_capacity *= 2;
+        }
+
+        uintptr_t* new_keys = (uintptr_t*)realloc(o->keys, new_capacity * sizeof(uintptr_t));
+
+        if (!new_keys) {
+            return NULL;
+        }
+
+        o->keys = new_keys;
+        o->capacity_of_keys = new_capacity;
+    }
+
+    memcpy(o->keys + o->length_of_keys, o->set, length * sizeof(uintptr_t));
+
+    entry_t* e = o->entries + slot;
+    e->gate = g;
+    e->hash = hash;
+    e->first = o->length_of_keys;
+    e->length = length;
+    o->length_of_keys += length;
+    o->count++;
+    return g;
+}
+
+/**@brief Connects the ports of g reading constant true to an input of g which is
+ * not constant. It does not change the value of the NAND gate, and the constant
+ * may lose its fan-out. The value of g has to be variable.
+ * Returns false if there is no memory.
+ */
+static bool drop_true_inputs(optimizer_t* o, nand_t* g) {
+    node_t variable = {NULL, NULL};
+
+    for (unsigned int k = 0; k < g->number_of_ports && !variable.gate && !variable.signal; k++) {
+        if (value_of(o, input_of(g, k)) == VALUE_VARIABLE) {
+            variable = input_of(g, k);
+        }
+    }
+
+    for (unsigned int k = 0; k < g->number_of_ports; k++) {
+        if (value_of(o, input_of(g, k)) != VALUE_TRUE) {
+            continue;
+        }
+
+        int result = variable.gate ? nand_connect_nand(variable.gate, g, k) :
+                                     nand_connect_signal(variable.signal, g, k);
+
+        if (result != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**@brief Optimizes the gate g, whose inputs are already optimized: finds its value
+ * and replaces it with an equivalent gate or signal if there is one. Replaced gates
+ * lose their fan-out and are deleted later. Returns false if there is no memory.
+ */
+static bool optimize_gate(optimizer_t* o, nand_t* g) {
+    // Gates of other kinds are left as they are.
+    if (g->kind != NAND_KIND_NAND) {
+        o->values[g->index] = VALUE_VARIABLE;
+        return true;
+    }
+
+    bool any_false = false;
+    bool all_true = true;
+
+    for (unsigned int k = 0; k < g->number_of_ports; k++) {
+        value_t input = value_of(o, input_of(g, k));
+
+        any_false |= input == VALUE_FALSE;
+        all_true &= input == VALUE_TRUE;
+    }
+
+    // A NAND gate is true if some input is false and false if all inputs are true
+    // (in particular if it has no ports).
+    value_t value = any_false ? VALUE_TRUE : all_true ? VALUE_FALSE : VALUE_VARIABLE;
+
+    o->values[g->index] = (uint8_t)value;
+
+    if (value != VALUE_VARIABLE) {
+        nand_t* constant = o->constant[value];
+
+        if (!constant) {
+            o->constant[value] = g;
+            return true;
+        }
+
+        node_t node = {constant, NULL};
+        return o->kept[g->index] || redirect(g, node);
+    }
+    if (!drop_true_inputs(o, g)) {
+        return false;
+    }
+
+    ssize_t length = input_set(o, g);
+
+    if (length < 0) {
+        return false;
+    }
+
+    // Double inversion: g negates a gate negating the node. Ports of variable gates
+    // read no constants now, so a gate with one input reads it on all ports.
+    nand_t* inverter = g->ports[0].sharing_gate;
+
+    if (length == 1 && !o->kept[g->index] && inverter &&
+        inverter->kind == NAND_KIND_NAND && o->values[inverter->index] == VALUE_VARIABLE) {
+        node_t node = input_of(inverter, 0);
+        bool single = true;
+
+        for (unsigned int k = 1; k < inverter->number_of_ports; k++) {
+            single &= inverter->ports[k].sharing_gate == node.gate &&
+                      inverter->ports[k].direct_signal == node.signal;
+        }
+
+        if (single) {
+            return redirect(g, node);
+        }
+    }
+
+    nand_t* equivalent = find_or_add(o, g, (size_t)length);
+
+    if (!equivalent) {
+        return false;
+    }
+    if (equivalent != g && !o->kept[g->index]) {
+        node_t node = {equivalent, NULL};
+        return redirect(g, node);
+    }
+
+    return true;
+}
+
+static ssize_t optimize_system(nand_t** g, size_t m) {
+    if (!g || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    optimizer_t o = {0};
+    ssize_t listed = nand_topological_order(g, m, &o.order);
+
+    if (listed < 0) {
+        return -1;
+    }
+
+    o.number_of_gates = (size_t)listed;
+    o.kept = (bool*)calloc(o.number_of_gates, sizeof(bool));
+    o.values = (uint8_t*)malloc(o.number_of_gates);
+
+    ssize_t removed = -1;
+
+    if (!o.kept || !o.values) {
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        o.kept[g[i]->index] = true;
+    }
+
+    // Inputs of every gate are optimized before it, so gates are compared
+    // by the gates which replaced their inputs.
+    for (size_t i = 0; i < o.number_of_gates; i++) {
+        if (!optimize_gate(&o, o.order[i])) {
+            goto cleanup;
+        }
+    }
+
+    removed = 0;
+
+    // Gates without fan-out are deleted from the last one, so that the gates
+    // which lose their whole fan-out by these deletions are deleted too.
+    for (size_t i = o.number_of_gates; i-- > 0;) {
+        nand_t* gate = o.order[i];
+
+        if (!o.kept[i] && gate->number_of_cables == 0) {
+            nand_delete(gate);
+            removed++;
+        }
+    }
+
+cleanup:
+    free(o.order);
+    free(o.kept);
+    free(o.values);
+    free(o.entries);
+    free(o.keys);
+    free(o.set);
+
+    if (removed < 0) {
+        errno = ENOMEM;
+    }
+
+    return removed;
+}
+
+ssize_t nand_optimize(nand_t **g, size_t m) {
+    // Readers in contexts see the system before or after the whole optimization.
+    nand_write_lock();
+    ssize_t removed = optimize_system(g, m);
+    nand_write_unlock();
+    return removed;
+}
@@ -0,0 +1,353 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structures of logical gates.
+#include <errno.h> // For errno and its values.
+#include <pthread.h> // For pthread_create, pthread_join.
+#include <sched.h> // For sched_yield.
+#include <stdlib.h> // For malloc, realloc, free.
+#include <unistd.h> // For sysconf.
+
+// Number of outputs taken at once by a thread.
+#define OUTPUTS_PER_TAKE 64
+
+typedef struct worker worker_t;
+
+/**@brief State of nand_evaluate_parallel shared by all threads.
+ * g, m              - the evaluated gates.
+ * number_of_threads - number of workers.
+ * workers           - array of workers.
+ * next_output       - index of the first gate of g not taken by any thread yet.
+ * error             - errno value of the first error, or 0.
+ */
+typedef struct {
+    nand_t** g;
+    size_t m;
+    unsigned int number_of_threads;
+    worker_t* workers;
+    size_t next_output;
+    int error;
+} evaluation_t;
+
+/**@brief Thread of nand_evaluate_parallel. Gates are claimed by the threads by setting
+ * their variable owner to the number of the thread, thus every gate is computed by one
+ * thread. Claimed gates keep their technical variables like in evaluate_gate, but a
+ * computed gate is marked by the bit OWNER_DONE of owner instead of updated.
+ * evaluation  - the shared state.
+ * number      - number of the thread (from 1), written to the claimed gates.
+ * stack       - work stack of the thread.
+ * claimed     - all gates claimed by the thread, cleared at the end.
+ * waiting_for - gate claimed by another thread which the thread waits for, or NULL.
+ * thread      - the thread running the worker.
+ * started     - true if thread was created.
+ */
+struct worker {
+    evaluation_t* evaluation;
+    unsigned int number;
+    nand_t** stack;
+    size_t stack_capacity;
+    nand_t** claimed;
+    size_t number_of_claimed;
+    size_t claimed_capacity;
+    nand_t* waiting_for;
+    pthread_t thread;
+    bool started;
+};
+
+// Stops the evaluation with the error, unless it is already stopped.
+static void set_error(evaluation_t* e, int error) {
+    int expected = 0;
+    __atomic_compare_exchange_n(&e->error, &expected, error, false,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static bool stopped(evaluation_t* e) {
+    return __atomic_load_n(&e->error, __ATOMIC_RELAXED) != 0;
+}
+
+// Returns true if the thread which claimed g has already computed it.
+static bool is_updated(nand_t* g) {
+    return __atomic_load_n(&g->owner, __ATOMIC_ACQUIRE) & OWNER_DONE;
+}
+
+// Makes room for one more gate in the array. Returns false if there is no memory.
+static bool reserve(nand_t*** array, size_t length, size_t* capacity) {
+    if (length < *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity ? 2 * *capacity : 64;
+    nand_t** new_array = (nand_t**)realloc(*array, new_capacity * sizeof(nand_t*));
+
+    if (!new_array) {
+        return false;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**@brief Claims the gate g for the worker w. Returns false if another thread
+ * claimed it earlier. Room for g on the list claimed has to be reserved.
+ */
+static bool claim(worker_t* w, nand_t* g) {
+    unsigned int expected = 0;
+
+    if (!__atomic_compare_exchange_n(&g->owner, &expected, w->number, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    g->next_port = 0;
+    g->any_false = false;
+    g->my_longest_path = 0;
+    w->claimed[w->number_of_claimed++] = g;
+    return true;
+}
+
+/**@brief Checks if the threads wait for each other in a cycle which returns to w.
+ * Every gate claimed and not updated by a thread lies on its stack and depends on
+ * the gate the thread waits for. Such a cycle of waits is therefore a cycle of the
+ * system, and it never ends, so it is found by one of the checks.
+ * @param w - the worker waiting for g.
+ * @param g - gate claimed by another thread.
+ */
+static bool waits_in_cycle(worker_t* w, nand_t* g) {
+    evaluation_t* e = w->evaluation;
+
+    for (unsigned int steps = 0; steps < e->number_of_threads; steps++) {
+        unsigned int owner = __atomic_load_n(&g->owner, __ATOMIC_SEQ_CST) & ~OWNER_DONE;
+
+        // Gates of w which are not updated lie on its stack.
+        if (owner == w->number) {
+            return !is_updated(g);
+        }
+
+        nand_t* next = __atomic_load_n(&e->workers[owner - 1].waiting_for, __ATOMIC_SEQ_CST);
+
+        // The owner of g waits for next only if g is still on its stack.
+        if (!next || is_updated(g)) {
+            return false;
+        }
+
+        g = next;
+    }
+
+    return false;
+}
+
+/**@brief Waits until the gate g claimed by another thread is updated.
+ * Returns false if the evaluation is stopped.
+ */
+static bool wait_for(worker_t* w, nand_t* g) {
+    evaluation_t* e = w->evaluation;
+
+    __atomic_store_n(&w->waiting_for, g, __ATOMIC_SEQ_CST);
+
+    while (!is_updated(g) && !stopped(e)) {
+        if (waits_in_cycle(w, g)) {
+            set_error(e, ECANCELED);
+            break;
+        }
+
+        sched_yield();
+    }
+
+    __atomic_store_n(&w->waiting_for, NULL, __ATOMIC_SEQ_CST);
+    return is_updated(g);
+}
+
+/**@brief Evaluates the gate g claimed by the worker w. It is the walkthrough of
+ * evaluate_gate in nand.c on the stack of the worker. Gates claimed by other threads
+ * are not walked again: the worker waits until they are updated. Errors stop the
+ * whole evaluation.
+ */
+static void evaluate_claimed(worker_t* w, nand_t* g) {
+    evaluation_t* e = w->evaluation;
+    size_t top = 0;
+
+    w->stack[top++] = g;
+
+    while (top > 0 && !stopped(e)) {
+        g = w->stack[top - 1];
+
+        unsigned int i = g->next_port;
+        bool any_false = g->any_false;
+        ssize_t longest_path = g->my_longest_path;
+        nand_t* sharing_gate = NULL;
+
+        for (; i < evaluated_ports(g); i++) {
+            port_t* port = g->ports + i;
+            sharing_gate = port->sharing_gate;
+
+            if (port->direct_signal) { // Signal-nand connection.
+                any_false |= !*port->direct_signal;
+                longest_path = max(1, longest_path);
+                continue;
+            }
+            if (!sharing_gate) { // Empty port - no connection.
+                set_error(e, ECANCELED);
+                return;
+            }
+            if (!is_updated(sharing_gate)) {
+                if (__atomic_load_n(&sharing_gate->owner, __ATOMIC_RELAXED) == w->number) {
+                    set_error(e, ECANCELED); // Cycle condition.
+                    return;
+                }
+                if (!reserve(&w->stack, top, &w->stack_capacity) ||
+                    !reserve(&w->claimed, w->number_of_claimed, &w->claimed_capacity)) {
+                    set_error(e, ENOMEM);
+                    return;
+                }
+                if (claim(w, sharing_gate)) { // Nand-nand connection to a new gate.
+                    break;
+                }
+                if (!wait_for(w, sharing_gate)) {
+                    return;
+                }
+            }
+
+            // Nand-nand connection to an updated gate.
+            any_false |= !sharing_gate->gate_output_signal;
+            longest_path = max(sharing_gate->my_longest_path + 1, longest_path);
+        }
+
+        g->next_port = i;
+        g->any_false = any_false;
+        g->my_longest_path = longest_path;
+
+        if (i < evaluated_ports(g)) { // Go to the new gate.
+            w->stack[top++] = sharing_gate;
+            continue;
+        }
+
+        // All ports processed. The values are published together with OWNER_DONE.
+        g->gate_output_signal = g->kind ? nand_kind_output(g, false) : any_false;
+        __atomic_store_n(&g->owner, w->number | OWNER_DONE, __ATOMIC_RELEASE);
+        top--;
+    }
+}
+
+// Takes the gates of g in portions and evaluates those which are not claimed yet.
+static void* evaluate_worker(void* argument) {
+    worker_t* w = (worker_t*)argument;
+    evaluation_t* e = w->evaluation;
+
+    while (!stopped(e)) {
+        size_t first = __atomic_fetch_add(&e->next_output, OUTPUTS_PER_TAKE, __ATOMIC_RELAXED);
+
+        if (first >= e->m) {
+            break;
+        }
+
+        size_t last = first + OUTPUTS_PER_TAKE < e->m ? first + OUTPUTS_PER_TAKE : e->m;
+
+        for (size_t i = first; i < last && !stopped(e); i++) {
+            if (!reserve(&w->stack, 0, &w->stack_capacity) ||
+                !reserve(&w->claimed, w->number_of_claimed, &w->claimed_capacity)) {
+                set_error(e, ENOMEM);
+            }
+            else if (claim(w, e->g[i])) {
+                evaluate_claimed(w, e->g[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**@brief Releases the gates claimed by the worker. Other technical variables are set
+ * by claim, so they need not be cleared.
+ */
+static void* clear_worker(void* argument) {
+    worker_t* w = (worker_t*)argument;
+
+    for (size_t i = 0; i < w->number_of_claimed; i++) {
+        w->claimed[i]->owner = 0;
+    }
+
+    return NULL;
+}
+
+/**@brief Runs function on all workers: the first one in the calling thread, the others
+ * in new threads. Workers whose threads cannot be created run in the calling thread.
+ */
+static void run_workers(evaluation_t* e, void* (*function)(void*)) {
+    for (unsigned int i = 1; i < e->number_of_threads; i++) {
+        worker_t* w = e->workers + i;
+        w->started = pthread_create(&w->thread, NULL, function, w) == 0;
+    }
+
+    function(e->workers);
+
+    for (unsigned int i = 1; i < e->number_of_threads; i++) {
+        worker_t* w = e->workers + i;
+
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+        }
+        else {
+            function(w);
+        }
+    }
+}
+
+ssize_t nand_evaluate_parallel(nand_t **g, bool *s, size_t m, unsigned threads) {
+    if (!g || !s || m == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        if (!g[i]) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+
+    evaluation_t e = {g, m, threads, NULL, 0, 0};
+    e.workers = (worker_t*)calloc(threads, sizeof(worker_t));
+
+    if (!e.workers) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        e.workers[i].evaluation = &e;
+        e.workers[i].number = i + 1;
+    }
+
+    run_workers(&e, evaluate_worker);
+
+    // Longest path grows along cables, so the maximum is reached
+    // in one of the evaluated gates.
+    ssize_t maximum_length = -1;
+
+    if (!e.error) {
+        for (size_t i = 0; i < m; i++) {
+            s[i] = g[i]->gate_output_signal;
+            maximum_length = max(g[i]->my_longest_path, maximum_length);
+        }
+    }
+
+    run_workers(&e, clear_worker);
+
+    for (unsigned int i = 0; i < threads; i++) {
+        free(e.workers[i].stack);
+        free(e.workers[i].claimed);
+    }
+
+    free(e.workers);
+
+    if (e.error) {
+        errno = e.error;
+        return -1;
+    }
+
+    return maximum_length;
+}
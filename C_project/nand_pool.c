@@ -0,0 +1,195 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the pool.
+#include <errno.h> // For errno and its values.
+#include <stdlib.h> // For malloc, realloc, free.
+#include <string.h> // For memcpy.
+
+// Blocks up to this size have sizes rounded up to multiples of 16 bytes.
+#define SMALL_BLOCK 512
+
+// Number of size classes of the small blocks.
+#define SMALL_CLASSES (SMALL_BLOCK / 16)
+
+// Usual size of a slab. Bigger blocks get their own slabs.
+#define SLAB_SIZE ((size_t)1 << 16)
+
+// Room for the link to the next slab at the beginning of every slab.
+#define SLAB_HEADER 16
+
+// List of all existing pools.
+static nand_pool_t* pools = NULL;
+
+/**@brief Returns the size class of blocks of size bytes and sets block_size
+ * to the size of blocks of this class.
+ */
+static size_t size_class(size_t size, size_t* block_size) {
+    if (size <= SMALL_BLOCK) {
+        size_t class = size <= 16 ? 1 : (size + 15) / 16;
+        *block_size = 16 * class;
+        return class - 1;
+    }
+
+    size_t exponent = 10;
+
+    while (((size_t)1 << exponent) < size) {
+        exponent++;
+    }
+
+    *block_size = (size_t)1 << exponent;
+    return SMALL_CLASSES + exponent - 10;
+}
+
+void* nand_allocate(nand_pool_t* pool, size_t size) {
+    if (!pool) {
+        return malloc(size);
+    }
+
+    size_t block_size;
+    size_t class = size_class(size, &block_size);
+
+    if (class >= NUMBER_OF_SIZE_CLASSES) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // Reuse a free block of the same class.
+    void* block = pool->free_lists[class];
+
+    if (block) {
+        pool->free_lists[class] = *(void**)block;
+        return block;
+    }
+
+    // Otherwise cut it from the newest slab, creating a new slab if needed.
+    if ((size_t)(pool->slab_end - pool->slab_next) < block_size) {
+        size_t slab_size = block_size + SLAB_HEADER > SLAB_SIZE ? block_size + SLAB_HEADER : SLAB_SIZE;
+        char* slab = (char*)malloc(slab_size);
+
+        if (!slab) {
+            return NULL;
+        }
+
+        *(void**)slab = pool->slabs;
+        pool->slabs = slab;
+        pool->slab_next = slab + SLAB_HEADER;
+        pool->slab_end = slab + slab_size;
+    }
+
+    block = pool->slab_next;
+    pool->slab_next += block_size;
+    return block;
+}
+
+void nand_release(nand_pool_t* pool, void* block, size_t size) {
+    if (!pool) {
+        free(block);
+        return;
+    }
+    if (!block) {
+        return;
+    }
+
+    size_t block_size;
+    size_t class = size_class(size, &block_size);
+
+    *(void**)block = pool->free_lists[class];
+    pool->free_lists[class] = block;
+}
+
+void* nand_reallocate(nand_pool_t* pool, void* block, size_t old_size, size_t new_size) {
+    if (!pool) {
+        return realloc(block, new_size);
+    }
+    if (!block) {
+        return nand_allocate(pool, new_size);
+    }
+
+    size_t old_block_size;
+    size_t new_block_size;
+
+    // Blocks of the same size class are interchangeable.
+    if (size_class(old_size, &old_block_size) == size_class(new_size, &new_block_size)) {
+        return block;
+    }
+
+    void* new_block = nand_allocate(pool, new_size);
+
+    if (!new_block) {
+        return NULL;
+    }
+
+    memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+    nand_release(pool, block, old_size);
+    return new_block;
+}
+
+nand_pool_t* nand_pool_list(void) {
+    return pools;
+}
+
+nand_pool_t* nand_pool_new(void) {
+    nand_pool_t* pool = (nand_pool_t*)malloc(sizeof(nand_pool_t));
+
+    if (!pool) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < NUMBER_OF_SIZE_CLASSES; i++) {
+        pool->free_lists[i] = NULL;
+    }
+
+    pool->slabs = NULL;
+    pool->slab_next = NULL;
+    pool->slab_end = NULL;
+    pool->signal_table.slots = NULL;
+    pool->signal_table.capacity = 0;
+    pool->signal_table.number_of_signals = 0;
+    pool->number_of_gates = 0;
+    pool->previous = NULL;
+
+    // The list of pools is changed only by the writer, like in nand_pool_delete.
+    nand_write_lock();
+    pool->next = pools;
+
+    if (pools) {
+        pools->previous = pool;
+    }
+
+    pools = pool;
+    nand_write_unlock();
+    return pool;
+}
+
+void nand_pool_delete(nand_pool_t *p) {
+    if (!p) {
+        return;
+    }
+
+    // Gates of the pool are connected only with each other and their signals
+    // are registered only in the pool, thus nothing outside points to them.
+    nand_write_lock();
+    nand_forget_unordered(p);
+
+    while (p->slabs) {
+        void* slab = p->slabs;
+        p->slabs = *(void**)slab;
+        free(slab);
+    }
+
+    if (p->previous) {
+        p->previous->next = p->next;
+    }
+    else {
+        pools = p->next;
+    }
+    if (p->next) {
+        p->next->previous = p->previous;
+    }
+    if (p->number_of_gates) {
+        nand_forget_gates(p->number_of_gates);
+    }
+
+    nand_write_unlock();
+    free(p);
+}
@@ -0,0 +1,160 @@
+#include "nand.h" // Declaration of the library interface.
+#include "nand_internal.h" // Structure of the compiled system.
+#include <errno.h> // For errno and its values.
+#include <stdint.h> // For uint32_t.
+#include <stdlib.h> // For malloc, free.
+
+// Bit of the first input of a cell which negates the value of the cell.
+#define INVERT ((uint32_t)1 << 31)
+
+/**@brief Cell of the program of nand_step. Its value is the AND of the slots first
+ * (without the bit INVERT) and second, negated if first has the bit INVERT.
+ */
+typedef struct {
+    uint32_t first;
+    uint32_t second;
+} step_cell_t;
+
+/**@brief Program of nand_step: the gates of a compiled system turned into cells with
+ * exactly two inputs, so the loop evaluating a cell has no inner loop. A gate with
+ * one input reads it twice, a gate without inputs reads the constant true twice and
+ * a gate with n > 2 inputs is a chain of n - 1 cells, the last of them negated.
+ * Slots of values are the signals, the constant true and the cells: the cell i
+ * writes the slot number_of_signals + 1 + i.
+ * cells           - the cells in the order of the gates.
+ * number_of_cells - number of cells.
+ * values          - values of all slots.
+ * inputs          - slot of the node connected to the port of every flip-flop.
+ * next            - technical array of the new states of the flip-flops.
+ */
+struct compiled_step {
+    step_cell_t* cells;
+    size_t number_of_cells;
+    uint8_t* values;
+    uint32_t* inputs;
+    uint8_t* next;
+};
+
+/**@brief Makes the program of nand_step of c in one allocated block. Returns NULL
+ * with errno set to ENOMEM if there is no memory or EOVERFLOW if the slots do not
+ * fit in 31 bits.
+ */
+static struct compiled_step* make_step(nand_compiled_t const* c) {
+    size_t number_of_signals = c->number_of_signals;
+    size_t number_of_registers = c->number_of_registers;
+    size_t number_of_cells = 0;
+
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        uint32_t n = c->input_offsets[i + 1] - c->input_offsets[i];
+        number_of_cells += n > 2 ? n - 1 : 1;
+    }
+
+    size_t number_of_slots = number_of_signals + 1 + number_of_cells;
+
+    if (number_of_slots >= INVERT) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+
+    // Cells and inputs come first, so that they are aligned.
+    struct compiled_step* step = (struct compiled_step*)malloc(
+        sizeof(struct compiled_step) + number_of_cells * sizeof(step_cell_t) +
+        number_of_registers * sizeof(uint32_t) + number_of_slots + number_of_registers);
+    uint32_t* slots = (uint32_t*)malloc((number_of_signals + c->number_of_gates) * sizeof(uint32_t));
+
+    if (!step || !slots) {
+        free(step);
+        free(slots);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    step->cells = (step_cell_t*)(step + 1);
+    step->number_of_cells = number_of_cells;
+    step->inputs = (uint32_t*)(step->cells + number_of_cells);
+    step->values = (uint8_t*)(step->inputs + number_of_registers);
+    step->next = step->values + number_of_slots;
+
+    uint32_t one = (uint32_t)number_of_signals;
+    uint32_t first_cell = one + 1;
+    size_t count = 0;
+
+    for (size_t i = 0; i < number_of_signals; i++) {
+        slots[i] = (uint32_t)i;
+    }
+    for (size_t i = 0; i < c->number_of_gates; i++) {
+        uint32_t const* inputs = c->inputs + c->input_offsets[i];
+        uint32_t n = c->input_offsets[i + 1] - c->input_offsets[i];
+        uint32_t a = n > 0 ? slots[inputs[0]] : one;
+        uint32_t b = n > 1 ? slots[inputs[1]] : a;
+
+        // AND of all inputs but the last one, without negation.
+        for (uint32_t k = 2; k < n; k++) {
+            step->cells[count] = (step_cell_t){a, b};
+            a = first_cell + (uint32_t)count++;
+            b = slots[inputs[k]];
+        }
+
+        step->cells[count] = (step_cell_t){a | INVERT, b};
+        slots[number_of_signals + i] = first_cell + (uint32_t)count++;
+    }
+    for (size_t r = 0; r < number_of_registers; r++) {
+        step->inputs[r] = slots[c->registers[r].input];
+    }
+
+    step->values[one] = 1;
+    free(slots);
+    return step;
+}
+
+int nand_step(nand_compiled_t *c, size_t cycles) {
+    if (!c) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!c->step) {
+        c->step = make_step(c);
+
+        if (!c->step) {
+            return -1;
+        }
+    }
+
+    struct compiled_step* step = c->step;
+    compiled_register_t const* registers = c->registers;
+    size_t number_of_registers = c->number_of_registers;
+    step_cell_t const* cells = step->cells;
+    uint8_t* values = step->values;
+    uint8_t* cell_values = values + c->number_of_signals + 1;
+
+    // Signals, the states of the flip-flops among them, are read once. Later
+    // the states live only in the values.
+    for (size_t i = 0; i < c->number_of_signals; i++) {
+        values[i] = *c->signals[i];
+    }
+
+    for (size_t cycle = 0; cycle < cycles; cycle++) {
+        for (size_t i = 0; i < step->number_of_cells; i++) {
+            uint32_t first = cells[i].first;
+            cell_values[i] = (values[first & ~INVERT] & values[cells[i].second]) ^ (first >> 31);
+        }
+
+        // All flip-flops take their inputs at once, as the input of one of them
+        // may be the state of another.
+        for (size_t r = 0; r < number_of_registers; r++) {
+            step->next[r] = values[step->inputs[r]];
+        }
+        for (size_t r = 0; r < number_of_registers; r++) {
+            values[registers[r].state] = step->next[r];
+        }
+    }
+
+    nand_write_lock();
+
+    for (size_t r = 0; r < number_of_registers; r++) {
+        nand_flip_flop_set(registers[r].flip_flop, values[registers[r].state]);
+    }
+
+    nand_write_unlock();
+    return 0;
+}